@@ -0,0 +1,319 @@
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+
+// in-place processing of decoded 16 bit pcm before it goes to i2s:
+//
+// - bass / treble as low and high shelf biquads
+// - loudness: extra bass and treble at low volume, fading out towards full volume
+// - limiter: peak limiter with instant attack and a smooth release to a ceiling below full scale
+//
+// the kernels are fixed-point: coefficients are Q28 in int32, samples run through the filters with 8 extra
+// fractional bits and the rounding error of each filter is fed back into its next sample, which keeps the
+// low frequency shelves accurate with 32 bit coefficients. Each loop is a flat pass over the buffer with
+// 64 bit multiply-accumulates only and no floats
+//
+// floats are only used to compute the coefficients, which happens on configure, on volume and on sample
+// rate change, not per buffer
+//
+// no dependency on the platform
+
+class AudioDsp
+{
+    public:
+
+        static const uint8_t MAX_CHANNELS = 2;
+
+        static constexpr float BASS_FREQ = 250;      // Hz, low shelf corner
+        static constexpr float TREBLE_FREQ = 4000;   // Hz, high shelf corner
+        static constexpr float MAX_GAIN = 15;        // dB, either direction
+        static constexpr float LIMITER_RELEASE = 0.05;  // s, time constant
+
+        struct Params
+        {
+            Params()
+            {
+                tone_enabled = false;
+                bass = 0;
+                treble = 0;
+                loudness = 0;
+                limiter = 0;
+            }
+
+            bool operator == (const Params & params) const
+            {
+                return tone_enabled == params.tone_enabled && bass == params.bass && treble == params.treble &&
+                       loudness == params.loudness && limiter == params.limiter;
+            }
+
+            bool tone_enabled;
+            int8_t bass;        // dB
+            int8_t treble;      // dB
+            uint8_t loudness;   // dB of extra bass at volume 0 (half of it on treble); 0 - off
+            int8_t limiter;     // dBFS ceiling, negative; 0 - off
+        };
+
+        AudioDsp()
+        {
+            volume = 100;
+            sample_rate = 0;
+            dirty = true;
+            limiter_ceiling = 0;
+            limiter_release = 0;
+            limiter_envelope = 0;
+            reset_state();
+        }
+
+        void configure(const Params & _params)
+        {
+            if (!(params == _params))
+            {
+                params = _params;
+                dirty = true;
+            }
+        }
+
+        // may be called from another task than process(), only a byte is handed over
+
+        void set_volume(uint8_t _volume)
+        {
+            if (volume != _volume)
+            {
+                volume = _volume;
+                dirty = true;
+            }
+        }
+
+        bool is_active() const
+        {
+            return (params.tone_enabled && (params.bass != 0 || params.treble != 0)) || params.loudness != 0 || params.limiter < 0;
+        }
+
+        // buff holds frames * channels interleaved samples
+
+        void process(int16_t * buff, uint16_t frames, uint8_t channels, uint32_t _sample_rate)
+        {
+            if (channels == 0 || channels > MAX_CHANNELS || _sample_rate == 0 || is_active() == false)
+            {
+                return;
+            }
+
+            if (dirty || sample_rate != _sample_rate)
+            {
+                sample_rate = _sample_rate;
+                dirty = false;
+                update();
+            }
+
+            if (bass_shelf.bypass == false || treble_shelf.bypass == false)
+            {
+                for (uint8_t c=0; c<channels; ++c)
+                {
+                    run_shelves(buff + c, frames, channels, bass_state[c], treble_state[c]);
+                }
+            }
+
+            if (limiter_ceiling != 0)
+            {
+                run_limiter(buff, frames, channels);
+            }
+        }
+
+    protected:
+
+        static const int COEF_SHIFT = 28;
+        static const int HEADROOM_SHIFT = 8;
+        static const int GAIN_SHIFT = 15;
+
+        struct Biquad
+        {
+            int32_t b0, b1, b2, a1, a2;
+            bool bypass;
+        };
+
+        struct BiquadState
+        {
+            int32_t x1, x2, y1, y2;
+            int64_t err;
+        };
+
+        void reset_state()
+        {
+            for (uint8_t c=0; c<MAX_CHANNELS; ++c)
+            {
+                bass_state[c] = BiquadState();
+                treble_state[c] = BiquadState();
+            }
+
+            bass_shelf.bypass = true;
+            treble_shelf.bypass = true;
+        }
+
+        static float clamp_gain(float gain)
+        {
+            return gain > MAX_GAIN ? MAX_GAIN : (gain < -MAX_GAIN ? -MAX_GAIN : gain);
+        }
+
+        void update()
+        {
+            float bass = params.tone_enabled ? params.bass : 0;
+            float treble = params.tone_enabled ? params.treble : 0;
+
+            if (params.loudness != 0)
+            {
+                float extra = float(params.loudness) * float(100 - (volume > 100 ? 100 : volume)) / 100;
+                bass += extra;
+                treble += extra / 2;
+            }
+
+            design_shelf(bass_shelf, false, clamp_gain(bass), BASS_FREQ);
+            design_shelf(treble_shelf, true, clamp_gain(treble), TREBLE_FREQ);
+
+            if (params.limiter < 0)
+            {
+                limiter_ceiling = int32_t(32767.0f * powf(10, float(params.limiter) / 20));
+                limiter_release = int32_t(expf(-1.0f / (LIMITER_RELEASE * float(sample_rate))) * float(1 << 30));
+            }
+            else
+            {
+                limiter_ceiling = 0;
+                limiter_envelope = 0;
+            }
+        }
+
+        // shelf with slope 1 after the well known audio eq cookbook
+
+        void design_shelf(Biquad & biquad, bool is_high, float gain, float freq)
+        {
+            bool was_bypass = biquad.bypass;
+            biquad.bypass = (gain == 0 || freq * 2 >= float(sample_rate));
+
+            if (biquad.bypass)
+            {
+                return;
+            }
+
+            float A = powf(10, gain / 40);
+            float w0 = 2 * float(M_PI) * freq / float(sample_rate);
+            float cos_w0 = cosf(w0);
+            float alpha = sinf(w0) / 2 * sqrtf(2);
+            float beta = 2 * sqrtf(A) * alpha;
+            float sign = is_high ? -1 : 1;
+
+            float b0 = A * ((A + 1) - sign * (A - 1) * cos_w0 + beta);
+            float b1 = sign * 2 * A * ((A - 1) - sign * (A + 1) * cos_w0);
+            float b2 = A * ((A + 1) - sign * (A - 1) * cos_w0 - beta);
+            float a0 = (A + 1) + sign * (A - 1) * cos_w0 + beta;
+            float a1 = -sign * 2 * ((A - 1) + sign * (A + 1) * cos_w0);
+            float a2 = (A + 1) + sign * (A - 1) * cos_w0 - beta;
+
+            const float scale = float(1 << COEF_SHIFT) / a0;
+
+            biquad.b0 = int32_t(lroundf(b0 * scale));
+            biquad.b1 = int32_t(lroundf(b1 * scale));
+            biquad.b2 = int32_t(lroundf(b2 * scale));
+            biquad.a1 = int32_t(lroundf(a1 * scale));
+            biquad.a2 = int32_t(lroundf(a2 * scale));
+
+            if (was_bypass)
+            {
+                // do not start from the history of a filter that was not running
+
+                for (uint8_t c=0; c<MAX_CHANNELS; ++c)
+                {
+                    (is_high ? treble_state[c] : bass_state[c]) = BiquadState();
+                }
+            }
+        }
+
+        static inline int32_t run_biquad(const Biquad & biquad, BiquadState & state, int32_t x0)
+        {
+            int64_t acc = state.err + int64_t(biquad.b0) * x0 + int64_t(biquad.b1) * state.x1 + int64_t(biquad.b2) * state.x2
+                                    - int64_t(biquad.a1) * state.y1 - int64_t(biquad.a2) * state.y2;
+
+            int32_t y0 = int32_t(acc >> COEF_SHIFT);
+            state.err = acc - (int64_t(y0) << COEF_SHIFT);
+
+            state.x2 = state.x1; state.x1 = x0;
+            state.y2 = state.y1; state.y1 = y0;
+
+            return y0;
+        }
+
+        // both shelves in cascade on one channel, the headroom is kept between them
+
+        void run_shelves(int16_t * samples, uint16_t frames, uint8_t stride, BiquadState & bass, BiquadState & treble)
+        {
+            const bool run_bass = bass_shelf.bypass == false;
+            const bool run_treble = treble_shelf.bypass == false;
+
+            for (uint16_t i=0; i<frames; ++i)
+            {
+                int32_t value = int32_t(samples[i*stride]) << HEADROOM_SHIFT;
+
+                if (run_bass)
+                {
+                    value = run_biquad(bass_shelf, bass, value);
+                }
+
+                if (run_treble)
+                {
+                    value = run_biquad(treble_shelf, treble, value);
+                }
+
+                samples[i*stride] = saturate(value >> HEADROOM_SHIFT);
+            }
+        }
+
+        void run_limiter(int16_t * samples, uint16_t frames, uint8_t channels)
+        {
+            int32_t envelope = limiter_envelope;
+
+            for (uint16_t i=0; i<frames; ++i)
+            {
+                int16_t * frame = samples + i*channels;
+                int32_t peak = 0;
+
+                for (uint8_t c=0; c<channels; ++c)
+                {
+                    int32_t a = frame[c] < 0 ? -int32_t(frame[c]) : frame[c];
+                    peak = a > peak ? a : peak;
+                }
+
+                envelope = int32_t((int64_t(envelope) * limiter_release) >> 30);
+                envelope = peak > envelope ? peak : envelope;
+
+                if (envelope > limiter_ceiling)
+                {
+                    int32_t gain = (limiter_ceiling << GAIN_SHIFT) / envelope;
+
+                    for (uint8_t c=0; c<channels; ++c)
+                    {
+                        frame[c] = int16_t((int32_t(frame[c]) * gain) >> GAIN_SHIFT);
+                    }
+                }
+            }
+
+            limiter_envelope = envelope;
+        }
+
+        static int16_t saturate(int32_t value)
+        {
+            return value > 32767 ? 32767 : (value < -32768 ? -32768 : int16_t(value));
+        }
+
+        Params params;
+        volatile uint8_t volume;
+        volatile bool dirty;
+        uint32_t sample_rate;
+
+        Biquad bass_shelf;
+        Biquad treble_shelf;
+        BiquadState bass_state[MAX_CHANNELS];
+        BiquadState treble_state[MAX_CHANNELS];
+
+        int32_t limiter_ceiling;
+        int32_t limiter_release;    // Q30
+        int32_t limiter_envelope;
+};
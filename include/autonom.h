@@ -7,6 +7,8 @@ void getAutonom(JsonVariant &);
 
 void restoreAutonom(); // from EPROM
 
+String actionAutonomShowerGuardReplay(const JsonVariant & json, JsonVariant & result);
+
 String actionAutonomKeyboxActuate(const String & channel_str);
 
 String actionAutonomRfidLockProgram(const String & code_str, uint16_t timeout);
@@ -20,6 +22,7 @@ void getAutonomRfidLockCodes(JsonVariant &);
 String actionAutonomProportionalCalibrate(const String & channel_str);
 String actionAutonomProportionalActuate(const String & channel_str, const String & value_str, 
                                         const String & ref_str);
+String getAutonomProportionalSignature(const String & channel_str, JsonVariant &);
 
 String actionAutonomZero2tenCalibrateInput(const String & channel_str, const String & value_str);
 String actionAutonomZero2tenInput(const String & channel_str, String & value_str);
@@ -39,6 +42,33 @@ String actionAutonomMultiUartCommand(const String & command, String & response);
 String actionAutonomMultiAudioControl(const String & source, const String & channel, const String & volume, String & response);
 String actionAutonomMultiSetVolatile(const JsonVariant & json);
 
+void actionAutonomProportionalActuateBatch(const std::vector<std::vector<String>> & channel_value_refs, 
+                                           std::vector<String> & results);
+void actionAutonomZero2tenOutputBatch(const std::vector<std::pair<String, String>> & channel_values, 
+                                      std::vector<String> & results);
+
+// the actions by name, e.g. "zero2ten/output", with the arguments of their REST routes in params
+
+enum ActionResultKind
+{
+    arkEmpty = 0,       // nothing but the error
+    arkValue = 1,       // out is a value
+    arkResponse = 2     // out is a response
+};
+
+String actionAutonom(const String & action, const JsonVariant & params, String & out, uint8_t & result_kind);
+
+// several actions in one request, in order or one worker per function; only a run of consecutive
+// proportional/actuate or zero2ten/output takes the lock of its module once, every other action locks on its own
+
+#define AUTONOM_BATCH_MAX_ACTIONS 32
+
+// the caller stops waiting for the workers of a parallel batch after this, their actions are reported as timed out
+
+#define AUTONOM_BATCH_TIMEOUT_MS 10000
+
+String actionAutonomBatch(const JsonVariant & json, JsonVariant & result);
+
 enum FunctionType
 {
     ftShowerGuard =  1,
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <logRing.h>
+
+// binary log for the hot paths (control loops, uart and i2c exchanges): LOG_TRACE(lmMulti, "...", ...) records
+// the format string and the raw arguments into a lock-free ring, the text is made at /poplog time; a record
+// costs no formatting, no allocation and no lock, so it can also be used from the loops that run every few ms
+//
+// - the level is set per module at runtime (/action/log/level), a disabled level does not evaluate the
+//   arguments
+// - records that do not fit into the ring are counted per module as dropped and reported by /poplog
+// - the ring is drained every LOG_RING_DRAIN_MS into a history of numbered records, /poplog?since=<seq> reads
+//   them from there
+// - the format string has to be a literal, at most LogRing<>::MAX_ARGS arguments: int, unsigned, float,
+//   const char * (copied)
+
+enum LogModule
+{
+    lmMain = 0,
+    lmWww = 1,
+    lmAutonom = 2,
+    lmKeybox = 3,
+    lmShowerGuard = 4,
+    lmRfidLock = 5,
+    lmProportional = 6,
+    lmZero2ten = 7,
+    lmMainsProbe = 8,
+    lmMulti = 9,
+    lmAudio = 10,
+    lmCount
+};
+
+enum LogLevel
+{
+    llOff = 0,
+    llError = 1,
+    llTrace = 2,
+    llDebug = 3
+};
+
+#define LOG_RING_SLOTS 64          // burst buffer of the producers
+#define LOG_HISTORY_SIZE 128       // records kept for the collectors, by sequence number
+#define LOG_RING_DRAIN_MS 500
+
+extern uint8_t log_ring_levels[lmCount];
+
+inline bool log_ring_is_enabled(uint8_t module, uint8_t level)
+{
+    return level <= log_ring_levels[module];
+}
+
+void log_ring_push(uint8_t module, uint8_t level, const char * format, const LogArg * argv, uint8_t argc);
+
+inline void log_ring_record(uint8_t module, uint8_t level, const char * format)
+{
+    log_ring_push(module, level, format, NULL, 0);
+}
+
+template <typename... Args> void log_ring_record(uint8_t module, uint8_t level, const char * format, Args... args)
+{
+    const LogArg argv[] = { LogArg(args)... };
+    log_ring_push(module, level, format, argv, uint8_t(sizeof...(args)));
+}
+
+#define LOG_ERROR(_module_, ...) { if (log_ring_is_enabled(_module_, llError)) log_ring_record(_module_, llError, __VA_ARGS__); }
+#define LOG_TRACE(_module_, ...) { if (log_ring_is_enabled(_module_, llTrace)) log_ring_record(_module_, llTrace, __VA_ARGS__); }
+#define LOG_DEBUG(_module_, ...) { if (log_ring_is_enabled(_module_, llDebug)) log_ring_record(_module_, llDebug, __VA_ARGS__); }
+
+String log_ring_set_level(const String & module_str, const String & level_str);
+
+void start_log_ring();
+
+// the records from since on, at most max_records and about max_bytes of JSON memory; "next" is the cursor
+// of the following call. The records stay in the history until they are overwritten, so several collectors
+// can read them and a lost response can be asked for again
+void get_log_ring(JsonVariant & json, uint32_t since, size_t max_records, size_t max_bytes);
+
+// /poplog without a cursor: the records since the previous call
+void pop_log_ring(JsonVariant & json, size_t max_records, size_t max_bytes);
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// boot sequence of the unit: the hardware-only modules are started first, straight from the EEPROM image,
+// the network comes up after them and whatever needs it waits for the readiness event instead of the boot
+// to be over
+//
+// - boot_stage() stamps the end of a stage in ms since power-on, the stamps are reported in /ping
+// - the events are set (and cleared again, e.g. on a lost connection) by main and waited for by the modules
+
+enum BootEvent
+{
+    beNetwork = 0x01,   // WiFi connected
+    beTime    = 0x02,   // time of day fetched by NTP
+    beWww     = 0x04    // REST server listening
+};
+
+void boot_stage(const char * name);  // name has to be a literal, it is kept as a pointer
+
+size_t boot_get_stage_count();
+bool boot_get_stage(size_t index, const char * & name, uint32_t & _millis);
+
+void boot_signal(uint32_t events);
+void boot_clear(uint32_t events);
+bool boot_is(uint32_t events);                          // all of events
+bool boot_wait(uint32_t events, uint32_t timeout_ms);   // all of events, false on timeout
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// bump allocator over a fixed buffer for the memory of one request: allocating moves a pointer, everything
+// is given back at once by reset() when the request is done, so the heap does not see the request at all
+//
+// - freeing or growing the last block works in place (the JSON documents of a handler are destroyed in the
+//   reverse order of their creation), any other free only counts the block as dead until the reset
+// - NULL from allocate means the buffer is used up, the caller takes the block from the heap then
+// - reset() refuses while blocks are still alive, a stale document must not see its memory handed out again
+//
+// not thread-safe, the caller locks
+//
+// no dependency on the platform
+
+class BumpArena
+{
+    public:
+
+        static const size_t ALIGNMENT = 8;
+
+        BumpArena()
+        {
+            buffer = NULL;
+            size = 0;
+            high_water = 0;
+            overflows = 0;
+            refused_resets = 0;
+            clear();
+        }
+
+        void init(void * _buffer, size_t _size)
+        {
+            buffer = (uint8_t *) _buffer;
+            size = _size;
+            clear();
+        }
+
+        bool owns(const void * p) const
+        {
+            return buffer != NULL && (const uint8_t *) p >= buffer && (const uint8_t *) p < buffer + size;
+        }
+
+        void * allocate(size_t block_size)
+        {
+            size_t begin = align(top);
+
+            if (buffer == NULL || begin + block_size > size || begin + block_size < begin)
+            {
+                overflows++;
+                return NULL;
+            }
+
+            last = begin;
+            top = begin + block_size;
+            live++;
+            high_water = top > high_water ? top : high_water;
+
+            return buffer + begin;
+        }
+
+        // p has to be owned by the arena
+
+        void deallocate(void * p)
+        {
+            live--;
+
+            if ((uint8_t *) p == buffer + last)
+            {
+                top = last;
+            }
+        }
+
+        // p has to be owned by the arena; NULL if there is no room for the block in the arena, p stays valid then
+
+        void * reallocate(void * p, size_t block_size)
+        {
+            size_t begin = (uint8_t *) p - buffer;
+
+            if (begin == last)
+            {
+                if (begin + block_size > size)
+                {
+                    overflows++;
+                    return NULL;
+                }
+
+                top = begin + block_size;
+                high_water = top > high_water ? top : high_water;
+                return p;
+            }
+
+            size_t extent = get_extent(p);
+            void * m = allocate(block_size);
+
+            if (m != NULL)
+            {
+                memcpy(m, p, extent < block_size ? extent : block_size);
+                deallocate(p);
+            }
+
+            return m;
+        }
+
+        // upper bound of the size of the block at p (owned by the arena), enough to copy it out
+
+        size_t get_extent(const void * p) const
+        {
+            return top - size_t((const uint8_t *) p - buffer);
+        }
+
+        bool reset()
+        {
+            if (live != 0)
+            {
+                refused_resets++;
+                return false;
+            }
+
+            clear();
+            return true;
+        }
+
+        size_t get_size() const
+        {
+            return size;
+        }
+
+        size_t get_used() const
+        {
+            return top;
+        }
+
+        size_t get_high_water() const
+        {
+            return high_water;
+        }
+
+        uint32_t get_overflows() const
+        {
+            return overflows;
+        }
+
+        uint32_t get_refused_resets() const
+        {
+            return refused_resets;
+        }
+
+    protected:
+
+        static size_t align(size_t offset)
+        {
+            return (offset + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        }
+
+        void clear()
+        {
+            top = 0;
+            last = 0;
+            live = 0;
+        }
+
+        uint8_t * buffer;
+        size_t size;
+        size_t top;
+        size_t last;        // offset of the last block
+        uint32_t live;      // blocks not freed yet
+
+        size_t high_water;
+        uint32_t overflows;
+        uint32_t refused_resets;
+};
@@ -0,0 +1,324 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// small deflate (RFC 1951) encoder for the responses: LZ77 with a one-entry hash table and the fixed Huffman
+// codes, in one pass over a buffer in memory; no dictionary of its own, the input is the window, so it needs
+// only the hash table from the caller. Text like JSON logs shrinks to a third or less.
+//
+// - the output is raw deflate, zlib (RFC 1950, HTTP "deflate") or gzip (RFC 1952, HTTP "gzip")
+// - 0 from compress means the output did not fit, the caller sends the input as it is then
+// - the input is at most MAX_INPUT_LENGTH bytes, the positions in the hash table are 16 bit
+//
+// no dependency on the platform
+
+class DeflateEncoder
+{
+    public:
+
+        enum Format
+        {
+            dfRaw = 0,
+            dfZlib = 1,
+            dfGzip = 2
+        };
+
+        static const uint8_t HASH_BITS = 10;
+        static const size_t HASH_SIZE = size_t(1) << HASH_BITS;     // entries of the table from the caller
+        static const size_t MAX_INPUT_LENGTH = 0xfffe;
+
+        static size_t compress(const uint8_t * in, size_t in_length, uint8_t * out, size_t out_size, uint16_t * hash, uint8_t format)
+        {
+            if (in_length > MAX_INPUT_LENGTH)
+            {
+                return 0;
+            }
+
+            BitWriter writer(out, out_size);
+
+            if (format == dfZlib)
+            {
+                writer.put_byte(0x78);
+                writer.put_byte(0x01);
+            }
+            else if (format == dfGzip)
+            {
+                static const uint8_t gzip_header[10] = { 0x1f, 0x8b, 0x08, 0, 0, 0, 0, 0, 0, 0xff };
+
+                for (size_t i=0; i<sizeof(gzip_header); ++i)
+                {
+                    writer.put_byte(gzip_header[i]);
+                }
+            }
+
+            // one final block with the fixed codes
+
+            writer.put_bits(1, 1);
+            writer.put_bits(1, 2);
+
+            memset(hash, 0, HASH_SIZE * sizeof(uint16_t));  // 0: empty, position + 1 otherwise
+
+            size_t pos = 0;
+
+            while (pos < in_length && writer.is_overflow() == false)
+            {
+                size_t match_length = 0;
+                size_t distance = 0;
+
+                if (pos + MIN_MATCH <= in_length)
+                {
+                    uint16_t & entry = hash[hash_of(in + pos)];
+
+                    if (entry != 0)
+                    {
+                        size_t candidate = entry - 1;
+                        distance = pos - candidate;
+
+                        if (distance <= MAX_DISTANCE)
+                        {
+                            size_t max_length = in_length - pos < MAX_MATCH ? in_length - pos : MAX_MATCH;
+
+                            while (match_length < max_length && in[candidate + match_length] == in[pos + match_length])
+                            {
+                                match_length++;
+                            }
+                        }
+                    }
+
+                    entry = uint16_t(pos + 1);
+                }
+
+                if (match_length >= MIN_MATCH)
+                {
+                    put_match(writer, match_length, distance);
+
+                    // the positions inside the match go into the table too, the next matches find them
+
+                    for (size_t i=pos+1; i<pos+match_length && i+MIN_MATCH<=in_length; ++i)
+                    {
+                        hash[hash_of(in + i)] = uint16_t(i + 1);
+                    }
+
+                    pos += match_length;
+                }
+                else
+                {
+                    put_literal(writer, in[pos]);
+                    pos++;
+                }
+            }
+
+            put_literal(writer, 256);   // end of block
+            writer.flush();
+
+            if (format == dfZlib)
+            {
+                uint32_t adler = adler32(in, in_length);
+
+                for (int shift=24; shift>=0; shift-=8)
+                {
+                    writer.put_byte(uint8_t(adler >> shift));
+                }
+            }
+            else if (format == dfGzip)
+            {
+                uint32_t crc = crc32(in, in_length);
+
+                for (int shift=0; shift<32; shift+=8)
+                {
+                    writer.put_byte(uint8_t(crc >> shift));
+                }
+
+                for (int shift=0; shift<32; shift+=8)
+                {
+                    writer.put_byte(uint8_t(in_length >> shift));
+                }
+            }
+
+            return writer.is_overflow() ? 0 : writer.get_length();
+        }
+
+        static uint32_t crc32(const uint8_t * data, size_t length)
+        {
+            static const uint32_t nibble_table[16] =
+            {
+                0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+                0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+            };
+
+            uint32_t crc = 0xffffffff;
+
+            for (size_t i=0; i<length; ++i)
+            {
+                crc ^= data[i];
+                crc = (crc >> 4) ^ nibble_table[crc & 0x0f];
+                crc = (crc >> 4) ^ nibble_table[crc & 0x0f];
+            }
+
+            return crc ^ 0xffffffff;
+        }
+
+        static uint32_t adler32(const uint8_t * data, size_t length)
+        {
+            uint32_t a = 1;
+            uint32_t b = 0;
+
+            for (size_t i=0; i<length; ++i)
+            {
+                a = (a + data[i]) % 65521;
+                b = (b + a) % 65521;
+            }
+
+            return (b << 16) | a;
+        }
+
+    protected:
+
+        static const size_t MIN_MATCH = 3;
+        static const size_t MAX_MATCH = 258;
+        static const size_t MAX_DISTANCE = 32768;
+
+        class BitWriter
+        {
+            public:
+
+                BitWriter(uint8_t * _out, size_t _size) : out(_out), size(_size), length(0), bits(0), bit_count(0), overflow(false)
+                {
+                }
+
+                // LSB first, as deflate packs its fields
+
+                void put_bits(uint32_t value, uint8_t count)
+                {
+                    bits |= value << bit_count;
+                    bit_count += count;
+
+                    while (bit_count >= 8)
+                    {
+                        put_byte(uint8_t(bits));
+                        bits >>= 8;
+                        bit_count -= 8;
+                    }
+                }
+
+                // Huffman codes are defined MSB first
+
+                void put_code(uint32_t code, uint8_t count)
+                {
+                    uint32_t reversed = 0;
+
+                    for (uint8_t i=0; i<count; ++i)
+                    {
+                        reversed = (reversed << 1) | ((code >> i) & 1);
+                    }
+
+                    put_bits(reversed, count);
+                }
+
+                void put_byte(uint8_t byte)
+                {
+                    if (length < size)
+                    {
+                        out[length] = byte;
+                    }
+                    else
+                    {
+                        overflow = true;
+                    }
+
+                    length++;
+                }
+
+                void flush()
+                {
+                    if (bit_count > 0)
+                    {
+                        put_byte(uint8_t(bits));
+                        bits = 0;
+                        bit_count = 0;
+                    }
+                }
+
+                size_t get_length() const
+                {
+                    return length;
+                }
+
+                bool is_overflow() const
+                {
+                    return overflow;
+                }
+
+            protected:
+
+                uint8_t * out;
+                size_t size;
+                size_t length;
+                uint32_t bits;
+                uint8_t bit_count;
+                bool overflow;
+        };
+
+        static size_t hash_of(const uint8_t * p)
+        {
+            uint32_t v = uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16);
+            return (v * 2654435761u) >> (32 - HASH_BITS);
+        }
+
+        // fixed literal/length code: 0..143 8 bits, 144..255 9 bits, 256..279 7 bits, 280..287 8 bits
+
+        static void put_literal(BitWriter & writer, uint16_t symbol)
+        {
+            if (symbol < 144)
+            {
+                writer.put_code(0x30 + symbol, 8);
+            }
+            else if (symbol < 256)
+            {
+                writer.put_code(0x190 + symbol - 144, 9);
+            }
+            else if (symbol < 280)
+            {
+                writer.put_code(symbol - 256, 7);
+            }
+            else
+            {
+                writer.put_code(0xc0 + symbol - 280, 8);
+            }
+        }
+
+        static void put_match(BitWriter & writer, size_t length, size_t distance)
+        {
+            static const uint16_t length_base[29] =
+                { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+            static const uint8_t length_extra[29] =
+                { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+            static const uint16_t distance_base[30] =
+                { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+                  4097, 6145, 8193, 12289, 16385, 24577 };
+            static const uint8_t distance_extra[30] =
+                { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+            uint8_t l = 28;
+
+            while (length_base[l] > length)
+            {
+                l--;
+            }
+
+            put_literal(writer, uint16_t(257 + l));
+            writer.put_bits(uint32_t(length - length_base[l]), length_extra[l]);
+
+            uint8_t d = 29;
+
+            while (distance_base[d] > distance)
+            {
+                d--;
+            }
+
+            writer.put_code(d, 5);
+            writer.put_bits(uint32_t(distance - distance_base[d]), distance_extra[d]);
+        }
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+
+// piecewise linear gain function compiled once into a fixed-point table over an even grid, so that a
+// lookup is a clamp, one multiply and one interpolation step instead of a search over the segments
+//
+// the input is the same x, y pair array as for MapTable::init_table (x ascending); outside of the range
+// of x the gain of the nearest end is returned. An empty or invalid function gives gain 1
+//
+// with evenly spaced x (as in all gain tables here) the grid is laid over the points and the lookup is
+// exact up to the Q16 rounding, otherwise the table is sampled and corners in between are rounded off
+//
+// no dependency on the platform
+
+class GainLut
+{
+    public:
+
+        static const size_t SIZE = 129;     // max grid points
+        static const int Y_SHIFT = 16;      // y is Q16
+        static const int X_SHIFT = 16;      // fractional bits of the grid position
+
+        GainLut()
+        {
+            clear();
+        }
+
+        void clear()
+        {
+            x_min = 0;
+            x_max = 1;
+            segments = SIZE - 1;
+            x_scale = float(segments << X_SHIFT);
+
+            for (size_t i=0; i<=SIZE; ++i)
+            {
+                lut[i] = int32_t(1) << Y_SHIFT;
+            }
+        }
+
+        bool init(const float * pairs, size_t count)
+        {
+            clear();
+
+            if (pairs == NULL || count < 2)
+            {
+                return false;
+            }
+
+            x_min = pairs[0];
+            x_max = pairs[(count-1)*2];
+
+            const float step = (x_max - x_min) / float(count - 1);
+            bool is_even = count - 1 <= SIZE - 1;
+
+            for (size_t i=1; i<count; ++i)
+            {
+                if (!(pairs[i*2] > pairs[(i-1)*2]))
+                {
+                    x_min = 0;
+                    x_max = 1;
+                    return false;
+                }
+
+                if (fabsf(pairs[i*2] - pairs[(i-1)*2] - step) > step * 1e-4f)
+                {
+                    is_even = false;
+                }
+            }
+
+            segments = is_even ? (count - 1) * ((SIZE - 1) / (count - 1)) : SIZE - 1;
+            x_scale = float(segments << X_SHIFT) / (x_max - x_min);
+
+            size_t segment = 0;
+
+            for (size_t i=0; i<=segments; ++i)
+            {
+                float x = x_min + (x_max - x_min) * float(i) / float(segments);
+
+                while (segment < count-2 && x > pairs[(segment+1)*2])
+                {
+                    segment++;
+                }
+
+                float x0 = pairs[segment*2], y0 = pairs[segment*2+1];
+                float x1 = pairs[(segment+1)*2], y1 = pairs[(segment+1)*2+1];
+                float y = y0 + (y1 - y0) * (x - x0) / (x1 - x0);
+
+                lut[i] = int32_t(lroundf(y * float(int32_t(1) << Y_SHIFT)));
+            }
+
+            lut[segments+1] = lut[segments];  // lets the last grid point interpolate without a bound check
+
+            return true;
+        }
+
+        float x_to_y(float x) const
+        {
+            x = fminf(fmaxf(x, x_min), x_max);
+
+            uint32_t position = uint32_t((x - x_min) * x_scale);
+            uint32_t i = position >> X_SHIFT;
+            int32_t fraction = int32_t(position & ((uint32_t(1) << X_SHIFT) - 1));
+
+            int32_t y = lut[i] + int32_t((int64_t(lut[i+1] - lut[i]) * fraction) >> X_SHIFT);
+
+            return float(y) * (1.0f / float(int32_t(1) << Y_SHIFT));
+        }
+
+    protected:
+
+        float x_min;
+        float x_max;
+        float x_scale;
+        size_t segments;
+        int32_t lut[SIZE + 1];
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+// the measured gain functions of the analog paths as x, y pairs (x ascending) for GainLut::init, in a
+// header of their own so that the host check (test/test_gain_lut) runs over the same tables as the device
+//
+// no dependency on the platform
+
+// * zero2ten output gain is what the duty cycle is multiplied with
+
+static const float zero2ten_output_gain_function[] =   // by true rmc multimeter
+{
+    1, 1,
+    2, 1,
+    3, 1,
+    4, 1,
+    5, 1,
+    6, 1,
+    7, 1.002,
+    8, 1.002,
+    9, 1.003,
+    10, 1.005
+};
+
+// * zero2ten input gain is what the measured value is multiplied with to get the final result
+
+static const float zero2ten_input_gain_function[] =
+{
+    1, 1,
+    2, 1,
+    3, 1,
+    4, 1,
+    5, 1,
+    6, 1,
+    7, 1,
+    8, 1,
+    9, .995,
+    10, .995
+};
+
+// * mainsProbe input gain is what the measured value is multiplied with to get the final result
+
+static const float mains_probe_input_v_gain_function[] =
+{
+    1, 1,
+    2, 1,
+    3, 1
+};
+
+static const float mains_probe_input_a_high_gain_function[] =
+{
+    1, 1,
+    2, 1,
+    3, 1
+};
+
+static const float mains_probe_input_a_low_gain_function[] =
+{
+    1, 1,
+    2, 1,
+    3, 1
+};
+
+#define GAIN_FUNCTION_POINTS(f) ((sizeof(f)/sizeof(float))/2)
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdint.h>
+
+// histogram of durations with fixed power-of-two buckets in microseconds, constant memory and an O(1) record:
+// bucket i counts the samples up to 2^(FIRST_SHIFT+i) us, the first one everything up to 2^FIRST_SHIFT us and
+// the last one everything above the one before it
+//
+// no dependency on the platform
+
+template <uint8_t _NUM_BUCKETS, uint8_t _FIRST_SHIFT>
+class PowerOfTwoHistogram
+{
+    public:
+
+        static const uint8_t NUM_BUCKETS = _NUM_BUCKETS;
+        static const uint8_t FIRST_SHIFT = _FIRST_SHIFT;
+
+        static_assert(FIRST_SHIFT + NUM_BUCKETS - 2 < 32, "the upper bound of the last finite bucket has to fit in 32 bits");
+
+        PowerOfTwoHistogram()
+        {
+            clear();
+        }
+
+        void clear()
+        {
+            for (uint8_t i=0; i<NUM_BUCKETS; ++i)
+            {
+                buckets[i] = 0;
+            }
+
+            count = 0;
+            sum_us = 0;
+        }
+
+        void record(uint32_t us)
+        {
+            buckets[bucket_of(us)]++;
+            count++;
+            sum_us += us;
+        }
+
+        static uint8_t bucket_of(uint32_t us)
+        {
+            if (us <= (uint32_t(1) << FIRST_SHIFT))
+            {
+                return 0;
+            }
+
+            uint8_t i = uint8_t(32 - __builtin_clz(us - 1) - FIRST_SHIFT);
+            return i < NUM_BUCKETS ? i : NUM_BUCKETS - 1;
+        }
+
+        // 0 for the last bucket, which has no upper bound
+
+        static uint32_t get_upper_bound_us(uint8_t i)
+        {
+            return i < NUM_BUCKETS - 1 ? uint32_t(1) << (FIRST_SHIFT + i) : 0;
+        }
+
+        uint32_t get_bucket(uint8_t i) const
+        {
+            return buckets[i];
+        }
+
+        uint32_t get_count() const
+        {
+            return count;
+        }
+
+        uint64_t get_sum_us() const
+        {
+            return sum_us;
+        }
+
+        // upper bound of the bucket the percentile falls in, 0 if there are no samples or it is in the last bucket
+
+        uint32_t get_percentile_us(float percentile) const
+        {
+            if (count == 0)
+            {
+                return 0;
+            }
+
+            uint32_t rank = uint32_t(float(count) * percentile / 100);
+            uint32_t cumulative = 0;
+
+            for (uint8_t i=0; i<NUM_BUCKETS; ++i)
+            {
+                cumulative += buckets[i];
+
+                if (cumulative > rank || cumulative == count)
+                {
+                    return get_upper_bound_us(i);
+                }
+            }
+
+            return 0;
+        }
+
+    protected:
+
+        uint32_t buckets[NUM_BUCKETS];
+        uint32_t count;
+        uint64_t sum_us;
+};
+
+// request latencies: 512 us .. 8.4 s, then +Inf
+
+typedef PowerOfTwoHistogram<16, 9> LatencyHistogram;
+
+// periods of the handler loops, the work plus a delay of up to seconds: 1 ms .. 18 min, then +Inf
+
+typedef PowerOfTwoHistogram<22, 10> PeriodHistogram;
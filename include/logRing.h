@@ -0,0 +1,294 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <atomic>
+
+// binary log records in a fixed ring: a producer stores the format string as a pointer (its id) and the
+// arguments as raw 32 bit words, the text is only made when the records are read out, so a log call in a
+// control loop costs a few word copies instead of a sprintf
+//
+// - any number of producers, lock-free: a slot is claimed by a compare-and-swap on the head, a full ring drops
+//   the new record and push() returns false, the records already in the ring are kept
+// - one consumer (pop), it sees a record only after its producer has finished writing it
+// - the format string has to be a literal, it is kept as a pointer; string arguments are copied into the
+//   record (all of them together up to STR_SIZE, truncated beyond)
+// - the sequence number of a record is its position in the ring, it grows by one per record pushed
+//
+// no dependency on the platform
+
+struct LogArg
+{
+    enum Type
+    {
+        atInt = 0,
+        atUint = 1,
+        atFloat = 2,
+        atStr = 3
+    };
+
+    LogArg(int v) : type(atInt) { value.i = v; }
+    LogArg(long v) : type(atInt) { value.i = int32_t(v); }
+    LogArg(unsigned v) : type(atUint) { value.u = v; }
+    LogArg(unsigned long v) : type(atUint) { value.u = uint32_t(v); }
+    LogArg(float v) : type(atFloat) { value.f = v; }
+    LogArg(double v) : type(atFloat) { value.f = float(v); }
+    LogArg(const char * v) : type(atStr) { value.s = v; }
+
+    uint8_t type;
+
+    union
+    {
+        int32_t i;
+        uint32_t u;
+        float f;
+        const char * s;
+    } value;
+};
+
+template <size_t NUM_SLOTS> class LogRing
+{
+    public:
+
+        static_assert((NUM_SLOTS & (NUM_SLOTS - 1)) == 0, "the number of slots has to be a power of two");
+
+        static const uint8_t MAX_ARGS = 6;
+        static const size_t STR_SIZE = 32;
+
+        struct Record
+        {
+            uint32_t seq;
+            uint32_t millis;
+            const char * format;
+            uint8_t module;
+            uint8_t level;
+            uint8_t argc;
+            uint8_t types[MAX_ARGS];
+            uint32_t args[MAX_ARGS];    // offset into str for the strings
+            char str[STR_SIZE];
+        };
+
+        LogRing()
+        {
+            for (size_t i=0; i<NUM_SLOTS; ++i)
+            {
+                slots[i].sequence.store(uint32_t(i), std::memory_order_relaxed);
+            }
+
+            head.store(0, std::memory_order_relaxed);
+            tail = 0;
+        }
+
+        bool push(uint8_t module, uint8_t level, uint32_t millis, const char * format, const LogArg * argv, uint8_t argc)
+        {
+            uint32_t pos = head.load(std::memory_order_relaxed);
+            Slot * slot = NULL;
+
+            for (;;)
+            {
+                slot = & slots[pos & (NUM_SLOTS - 1)];
+                uint32_t sequence = slot->sequence.load(std::memory_order_acquire);
+                int32_t diff = int32_t(sequence - pos);
+
+                if (diff == 0)
+                {
+                    if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false;   // full
+                }
+                else
+                {
+                    pos = head.load(std::memory_order_relaxed);
+                }
+            }
+
+            Record & r = slot->record;
+
+            r.seq = pos;
+            r.millis = millis;
+            r.format = format;
+            r.module = module;
+            r.level = level;
+            r.argc = argc < MAX_ARGS ? argc : MAX_ARGS;
+
+            size_t str_used = 0;
+
+            for (uint8_t i=0; i<r.argc; ++i)
+            {
+                r.types[i] = argv[i].type;
+
+                if (argv[i].type == LogArg::atStr)
+                {
+                    r.args[i] = uint32_t(str_used < STR_SIZE ? str_used : STR_SIZE - 1);  // used up: the last terminator
+                    str_used += copy_str(r.str + str_used, STR_SIZE - str_used, argv[i].value.s);
+                }
+                else
+                {
+                    r.args[i] = argv[i].value.u;
+                }
+            }
+
+            slot->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        // false if there is no finished record
+
+        bool pop(Record & record)
+        {
+            Slot & slot = slots[tail & (NUM_SLOTS - 1)];
+            uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+
+            if (int32_t(sequence - (tail + 1)) < 0)
+            {
+                return false;
+            }
+
+            record = slot.record;
+            slot.sequence.store(tail + NUM_SLOTS, std::memory_order_release);
+            tail++;
+
+            return true;
+        }
+
+        // records claimed but not popped yet, including those still being written
+
+        size_t get_pending() const
+        {
+            return size_t(head.load(std::memory_order_relaxed) - tail);
+        }
+
+        // the text of the record in buffer, truncated to size; the length of the text is returned
+
+        static size_t format(const Record & record, char * buffer, size_t size)
+        {
+            size_t length = 0;
+            uint8_t arg = 0;
+            const char * f = record.format;
+
+            if (size == 0)
+            {
+                return 0;
+            }
+
+            while (*f != 0 && length + 1 < size)
+            {
+                if (*f != '%')
+                {
+                    buffer[length++] = *f++;
+                    continue;
+                }
+
+                if (f[1] == '%')
+                {
+                    buffer[length++] = '%';
+                    f += 2;
+                    continue;
+                }
+
+                // one conversion at a time: flags, width, precision and length are handed to snprintf as they are
+
+                char spec[16];
+                size_t spec_length = 0;
+
+                spec[spec_length++] = *f++;
+
+                while (*f != 0 && strchr("diouxXcsfFeEgGaAp", *f) == NULL && spec_length < sizeof(spec) - 2)
+                {
+                    spec[spec_length++] = *f++;
+                }
+
+                if (*f == 0)
+                {
+                    break;
+                }
+
+                char conversion = *f++;
+                spec[spec_length++] = conversion;
+                spec[spec_length] = 0;
+
+                int n = 0;
+
+                if (arg >= record.argc)
+                {
+                    n = snprintf(buffer + length, size - length, "<?>");
+                }
+                else
+                {
+                    uint32_t v = record.args[arg];
+
+                    switch(record.types[arg])
+                    {
+                        case LogArg::atStr:
+                            n = strchr("s", conversion) ? snprintf(buffer + length, size - length, spec, record.str + v) : 0;
+                            break;
+
+                        case LogArg::atFloat:
+                        {
+                            float value = 0;
+                            memcpy(& value, & v, sizeof(value));
+                            n = strchr("fFeEgGaA", conversion) ? snprintf(buffer + length, size - length, spec, double(value)) : 0;
+                            break;
+                        }
+
+                        case LogArg::atInt:
+                            n = strchr("fFeEgGaAsp", conversion) ? 0 : snprintf(buffer + length, size - length, spec, int32_t(v));
+                            break;
+
+                        default:
+                            n = strchr("fFeEgGaAsp", conversion) ? 0 : snprintf(buffer + length, size - length, spec, v);
+                            break;
+                    }
+
+                    arg++;
+                }
+
+                if (n > 0)
+                {
+                    length += size_t(n) < size - length ? size_t(n) : size - length - 1;
+                }
+            }
+
+            buffer[length] = 0;
+            return length;
+        }
+
+    protected:
+
+        struct Slot
+        {
+            std::atomic<uint32_t> sequence;     // pos: free for pos, pos+1: written at pos
+            Record record;
+        };
+
+        // the string including its terminator, as much of it as fits; 0 if nothing fits
+
+        static size_t copy_str(char * to, size_t room, const char * from)
+        {
+            if (room == 0)
+            {
+                return 0;
+            }
+
+            size_t length = from == NULL ? 0 : strnlen(from, room - 1);
+
+            if (length > 0)
+            {
+                memcpy(to, from, length);
+            }
+
+            to[length] = 0;
+            return length + 1;
+        }
+
+        Slot slots[NUM_SLOTS];
+        std::atomic<uint32_t> head;
+        uint32_t tail;
+};
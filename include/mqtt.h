@@ -0,0 +1,45 @@
+#pragma once
+
+#include <ArduinoJson.h>
+
+// MQTT transport next to the REST API, for the supervisors that want pushed status and actions without polling
+//
+// - <prefix>/status: a JSON object with the status of the functions as in get autonom that have changed, one
+//   publish per MQTT_STATUS_MIN_INTERVAL_MS at most (the latest one wins); after a connect and every
+//   MQTT_STATUS_FULL_INTERVAL_MS all functions go out and retained, so a late subscriber starts from a status
+//   that is that old at most; the status goes out with QoS 0, PubSubClient publishes nothing else
+// - <prefix>/action/<function>/<action>: subscribed with QoS 1 in a persistent session, so the broker keeps the
+//   actions while the unit is away; the payload is a JSON object with the arguments of the REST route, an
+//   optional "id" that is echoed in the result and an optional "expires" (epoch seconds) after which the
+//   action is refused
+// - <prefix>/result/<function>/<action>: {"id": .., "error": ".."} or {"id": .., "value"/"response": ..}
+// - <prefix>/online: "true" retained, "false" as the last will
+//
+// <prefix> is MQTT_TOPIC_PREFIX/<client id>, the client id is harvester-<mac>; mqttLoop() runs in the task of
+// wwwHandleClient(), the actions are handled one at a time with the REST requests; the lookup of the broker and
+// the TCP connect (seconds if the broker is away) run in a task of their own so they do not hold up REST
+//
+// the transport is off unless MQTT_BROKER_HOST (a name or an address) is given, there is no default broker
+//
+// test/mqtt/mqtt_check.sh exercises a unit against mosquitto
+
+#ifndef MQTT_BROKER_HOST
+#define MQTT_BROKER_HOST ""
+#endif
+
+#ifndef MQTT_BROKER_PORT
+#define MQTT_BROKER_PORT 1883
+#endif
+
+#ifndef MQTT_TOPIC_PREFIX
+#define MQTT_TOPIC_PREFIX "harvester"
+#endif
+
+#define MQTT_STATUS_MIN_INTERVAL_MS 1000
+#define MQTT_STATUS_FULL_INTERVAL_MS 60000
+#define MQTT_BUFFER_SIZE 4096
+
+void mqttBegin();
+void mqttLoop();
+
+void getMqtt(JsonVariant & json);
@@ -2,6 +2,7 @@
 
 #include <ArduinoJson.h>
 #include <map>
+#include <algorithm>
 #include <buzzer.h>
 #include <keypad.h>
 #include <keyboxActuator.h>
@@ -9,12 +10,13 @@
 #include <genericChannelConfig.h>
 #include <bt.h>
 #include <trace.h>
+#include <volumeRamp.h>
 
 class MultiConfig
 {
     public:
 
-        const uint8_t EPROM_VERSION = 2;
+        const uint8_t EPROM_VERSION = 4;
 
         MultiConfig()
         {
@@ -521,6 +523,9 @@ class MultiConfig
                 smOnLowVolume = 2
             };
 
+            static const uint16_t DEFAULT_FADE = 300;           // ms
+            static const uint16_t DEFAULT_SCHEDULE_FADE = 30;   // s
+
             Sound()
             {
                 volume = 0;
@@ -528,6 +533,11 @@ class MultiConfig
                 gain_low_pass = 0;
                 gain_band_pass = 0;
                 gain_high_pass = 0;
+                fade = DEFAULT_FADE;
+                schedule_fade = DEFAULT_SCHEDULE_FADE;
+                fade_curve = VolumeRamp::cSmooth;
+                loudness = 0;
+                limiter = 0;
                 
                 for (size_t i=0; i<sizeof(schedule)/sizeof(schedule[0]); ++i)
                 {
@@ -542,7 +552,7 @@ class MultiConfig
 
             bool is_valid() const 
             {
-                return true;
+                return fade_curve <= VolumeRamp::cSmooth;
             }
 
             bool operator == (const Sound & sound) const
@@ -560,7 +570,10 @@ class MultiConfig
                        volume == sound.volume && volume_low == sound.volume_low && 
                        gain_low_pass == sound.gain_low_pass &&
                        gain_band_pass == sound.gain_band_pass && 
-                       gain_high_pass == sound.gain_high_pass; 
+                       gain_high_pass == sound.gain_high_pass &&
+                       fade == sound.fade && schedule_fade == sound.schedule_fade &&
+                       fade_curve == sound.fade_curve &&
+                       loudness == sound.loudness && limiter == sound.limiter; 
             }
 
             String as_string() const
@@ -587,6 +600,9 @@ class MultiConfig
                        ", gain_low_pass=" + String((int) gain_low_pass) +
                        ", gain_band_pass=" + String((int) gain_band_pass) +
                        ", gain_high_pass=" + String((int) gain_high_pass) + 
+                       ", fade=" + String((int) fade) + ", schedule_fade=" + String((int) schedule_fade) +
+                       ", fade_curve=" + String((int) fade_curve) +
+                       ", loudness=" + String((int) loudness) + ", limiter=" + String((int) limiter) +
                        ", schedule=" + buf + "}";
             }
             
@@ -598,6 +614,11 @@ class MultiConfig
             int8_t gain_low_pass;  // -40..3 
             int8_t gain_band_pass; // -40..3 
             int8_t gain_high_pass; // -40..3 
+            uint16_t fade;         // ms, volume changes
+            uint16_t schedule_fade;// s, volume changes by schedule at hour shift
+            uint8_t fade_curve;    // a value of VolumeRamp::Curve
+            uint8_t loudness;      // dB of extra bass at volume 0 in the i2s path; 0 - off
+            int8_t limiter;        // dBFS ceiling in the i2s path, negative; 0 - off
             uint8_t schedule[24];  // per hour: a value of ScheduleMask; 0 - disabled, 1 - enabled normal volume, 2 - enabled low volume
         };
 
@@ -891,6 +912,21 @@ struct MultiStatus
             return *this;
         }
 
+        // copied on every uart poll, the nodes are only renewed when the indications have changed
+
+        template <class Map>
+        void set_latest_indications(const Map & indications)
+        {
+            if (latest_indications.size() == indications.size() &&
+                std::equal(indications.begin(), indications.end(), latest_indications.begin()))
+            {
+                return;
+            }
+
+            latest_indications.clear();
+            latest_indications.insert(indications.begin(), indications.end());
+        }
+
         void to_json(JsonVariant & json)
         {
             //DEBUG("MultiStatus::Bt::to_json")
@@ -908,7 +944,7 @@ struct MultiStatus
             }
         }
 
-        std::map<String, String> latest_indications;        
+        std::map<String, String> latest_indications;
     };
 
     struct Www
@@ -918,6 +954,8 @@ struct MultiStatus
             is_streaming = false;
             url_index = -1;
             bitrate = 0;
+            connect_millis = 0;
+            switch_millis = 0;
         }
 
         Www(const Www & other)
@@ -931,6 +969,8 @@ struct MultiStatus
             url_index = other.url_index;
             url_name = other.url_name;
             bitrate = other.bitrate;
+            connect_millis = other.connect_millis;
+            switch_millis = other.switch_millis;
         }
 
         Www & operator = (const Www & other)
@@ -944,6 +984,8 @@ struct MultiStatus
             url_index = other.url_index;
             url_name = other.url_name;
             bitrate = other.bitrate;
+            connect_millis = other.connect_millis;
+            switch_millis = other.switch_millis;
 
             return *this;
         }
@@ -958,12 +1000,16 @@ struct MultiStatus
             jsonVariant["url_name"] = url_name;
 
             jsonVariant["bitrate"] = bitrate;
+            jsonVariant["connect_millis"] = connect_millis;
+            jsonVariant["switch_millis"] = switch_millis;
         }
 
         bool is_streaming;
         int url_index;
         String url_name;
         uint32_t bitrate;        
+        uint32_t connect_millis;  // duration of the latest connect to url
+        uint32_t switch_millis;   // from the latest change of channel to its first decoded audio
     };
 
     struct Fm
@@ -1046,9 +1092,39 @@ struct MultiStatus
         bool temp_corr_set;
     };
 
+    struct Memory
+    {
+        Memory()
+        {
+            free_heap = 0;
+            min_free_heap = 0;
+            largest_free_block = 0;
+        }
+
+        void to_json(JsonVariant & json)
+        {
+            json.createNestedObject("memory");
+            JsonVariant jsonVariant = json["memory"];
+
+            jsonVariant["free_heap"] = free_heap;
+            jsonVariant["min_free_heap"] = min_free_heap;
+            jsonVariant["largest_free_block"] = largest_free_block;
+
+            // share of the free heap that cannot be had in one piece
+
+            jsonVariant["fragmentation"] = free_heap == 0 ? 0 : 1 - float(largest_free_block) / float(free_heap);
+        }
+
+        uint32_t free_heap;
+        uint32_t min_free_heap;
+        uint32_t largest_free_block;
+    };
+
     MultiStatus()
     {
         commited_volume = 0;
+        current_volume = 0;
+        dsp_cycles_per_sample = 0;
     }
 
     /*
@@ -1104,8 +1180,17 @@ struct MultiStatus
         audio_control_data.to_json(jsonVariant);
 
         jsonVariant["commited_volume"] = commited_volume;
+        jsonVariant["current_volume"] = current_volume;
+
+        if (dsp_cycles_per_sample > 0)
+        {
+            jsonVariant["dsp_cycles_per_sample"] = dsp_cycles_per_sample;
+        }
+
         jsonVariant["title"] = title;
         jsonVariant["status"] = status;
+
+        memory.to_json(jsonVariant);
     }
 
     Www www;
@@ -1116,8 +1201,12 @@ struct MultiStatus
     AudioControlData audio_control_data;
 
     uint8_t commited_volume;
+    uint8_t current_volume;  // where the volume fade towards commited_volume is now
+    float dsp_cycles_per_sample;
     String title;
     String status;
+
+    Memory memory;
 };
 
 
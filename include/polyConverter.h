@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+// conversion of a raw reading by a polynom of a fixed order, evaluated by Horner with the coefficients in a
+// flat zero-padded array; the loop has a constant trip count and the selection between the polynom and the
+// linear segment below the first calibration point is a select, not a branch
+//
+// an invalid converter (no calibration and no default) converts to 0 and says so in the return value
+//
+// no dependency on the platform
+
+class PolyConverter
+{
+    public:
+
+        static const uint8_t MAX_ORDER = 5;
+
+        PolyConverter()
+        {
+            clear();
+        }
+
+        void clear()
+        {
+            for (uint8_t i=0; i<=MAX_ORDER; ++i)
+            {
+                beta[i] = 0;
+            }
+
+            knee_x = 0;
+            knee_slope = 0;
+            valid = false;
+        }
+
+        // beta c0 first; below knee_x (the first calibration point, if any) the line through [0,0] and the point is used
+
+        bool init(const double * _beta, size_t count, float _knee_x = 0, float knee_y = 0)
+        {
+            clear();
+
+            if (count < 2 || count > MAX_ORDER + 1)  // it has to be at least linear function
+            {
+                return false;
+            }
+
+            for (size_t i=0; i<count; ++i)
+            {
+                beta[i] = float(_beta[i]);
+            }
+
+            if (_knee_x > 0)
+            {
+                knee_x = _knee_x;
+                knee_slope = knee_y / _knee_x;
+            }
+
+            valid = true;
+            return true;
+        }
+
+        bool init(const float * _beta, size_t count)
+        {
+            double __beta[MAX_ORDER + 1];
+
+            for (size_t i=0; i<count && i<=MAX_ORDER; ++i)
+            {
+                __beta[i] = _beta[i];
+            }
+
+            return init(__beta, count);
+        }
+
+        bool is_valid() const
+        {
+            return valid;
+        }
+
+        bool convert(float x, float & y) const
+        {
+            float poly = beta[MAX_ORDER];
+
+            for (int i=MAX_ORDER-1; i>=0; --i)
+            {
+                poly = fmaf(poly, x, beta[i]);
+            }
+
+            float linear = x * knee_slope;
+            float r = x < knee_x ? linear : poly;
+
+            y = (x == 0 || valid == false) ? 0 : r;
+            return valid;
+        }
+
+    protected:
+
+        float beta[MAX_ORDER + 1];
+        float knee_x;
+        float knee_slope;
+        bool valid;
+};
@@ -15,8 +15,8 @@
 
 #define ASYMMETRICAL_OPEN_CLOSE 1
 
-// define this to allow serial execution of calibrations and actuations among channels so that there is always
-// at most one motor in motion;
+// define this to allow serial execution of calibrations among channels so that a calibrating motor is always
+// the only one in motion; actuations go to their channel right away and only wait behind a calibration;
 // this is needed to furher enhance calibration effect since engaging several motors at a time will sink
 // the power supply (more the more motors are connected) thus rendering calibration inaccurate
 
@@ -311,7 +311,7 @@ class ProportionalConfig
         struct ValveProfile
         {
             const uint8_t DEFAULT_OPEN_TIME = 15;
-            const uint8_t DEFAULT_MAX_ACTUATE_ADD_UPS = 1;
+            const uint8_t DEFAULT_MAX_ACTUATE_ADD_UPS = 10;
 
             ValveProfile()
             {
@@ -404,9 +404,10 @@ class ProportionalConfig
 
             uint8_t open_time;  
 
-            // this indicates how many actuations will be made base on the previous actuation as a reference;
-            // after max_actuate_add_ups the motor is reset to a nearest end-state and the actuation
-            // is done from there
+            // this indicates how many actuations will be made from the estimated position since the valve
+            // was last referenced at an end-state; after max_actuate_add_ups the motor is reset to a nearest 
+            // end-state and the actuation is done from there; normally the estimated position drift triggers
+            // this earlier, so this is just a cap
 
             uint8_t max_actuate_add_ups;
 
@@ -509,6 +510,9 @@ struct ProportionalStatus
 
             actuate_add_ups = 0;
             max_actuate_add_ups = 1;
+
+            position = -1;
+            position_drift = 0;
         }
 
         void clear()
@@ -550,6 +554,8 @@ struct ProportionalStatus
 
                        ", actuate_add_ups=" + String((int)actuate_add_ups) + 
                        ", max_actuate_add_ups=" + String((int)max_actuate_add_ups) + 
+                       ", position=" + String((int)position) + 
+                       ", position_drift=" + String((int)position_drift) + 
 
                        "}";
             return r;           
@@ -580,6 +586,11 @@ struct ProportionalStatus
 
             jsonVariant["actuate_add_ups"] = actuate_add_ups;
             jsonVariant["max_actuate_add_ups"] = max_actuate_add_ups;
+
+            // estimated position and its drift in permille of the full travel, position -1 is unknown
+
+            jsonVariant["position"] = position;
+            jsonVariant["position_drift"] = position_drift;
         }
 
         uint8_t value;
@@ -601,11 +612,131 @@ struct ProportionalStatus
 
         uint8_t actuate_add_ups;
         uint8_t max_actuate_add_ups;
+
+        int16_t position;
+        uint16_t position_drift;
     };
     
     std::vector<Channel> channels;
 };
 
+// motor current signature of a channel's last move, sampled from a timer while the motor runs; when the
+// buffer fills up neighbouring samples are merged pairwise and the interval doubles so that the whole 
+// move always fits
+
+struct ProportionalSignature
+{
+    static const size_t MAX_SAMPLES = 128;
+
+    ProportionalSignature()
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        to_open = false;
+        duration = 0;
+        base_interval = 0;
+        interval = 0;
+        num_samples = 0;
+        pending_sum = 0;
+        pending_count = 0;
+        peak = 0;
+        stall_at = 0;
+        result.clear();
+    }
+
+    void begin(bool _to_open, uint32_t _interval)
+    {
+        clear();
+        to_open = _to_open;
+        base_interval = _interval;
+        interval = _interval;
+    }
+
+    void push(float current)
+    {
+        if (current > peak)
+        {
+            peak = current;
+        }
+
+        pending_sum += current;
+        pending_count++;
+
+        if (pending_count * base_interval < interval)
+        {
+            return;
+        }
+
+        if (num_samples == MAX_SAMPLES)
+        {
+            for (size_t i=0; i<MAX_SAMPLES/2; ++i)
+            {
+                samples[i] = (samples[i*2] + samples[i*2+1]) / 2;
+            }
+
+            num_samples = MAX_SAMPLES/2;
+            interval *= 2;
+        }
+
+        samples[num_samples++] = pending_sum / pending_count;
+
+        pending_sum = 0;
+        pending_count = 0;
+    }
+
+    String as_string() const
+    {
+        return String("{to_open=") + String((int) to_open) + 
+                      ", duration=" + String((int) duration) + 
+                      ", interval=" + String((int) interval) + 
+                      ", num_samples=" + String((int) num_samples) + 
+                      ", peak=" + String(peak) + 
+                      ", stall_at=" + String((int) stall_at) + 
+                      ", result=" + result + 
+                      "}";
+    }
+
+    void to_json(JsonVariant & json) const
+    {
+        json["direction"] = to_open ? "open" : "closed";
+        json["result"] = result;
+        json["duration"] = duration;    // ms
+        json["interval"] = interval;    // ms
+        json["peak"] = peak;
+
+        if (stall_at != 0)
+        {
+            json["stall_at"] = stall_at; // ms from the motor start
+        }
+
+        JsonArray json_samples = json.createNestedArray("samples");
+
+        for (size_t i=0; i<num_samples; ++i)
+        {
+            json_samples.add(samples[i]);
+        }
+    }
+
+    bool to_open;
+    uint32_t duration;
+    uint32_t base_interval;
+    uint32_t interval;
+
+    size_t num_samples;
+    float samples[MAX_SAMPLES];
+
+    float pending_sum;
+    uint32_t pending_count;
+
+    float peak;
+    uint32_t stall_at;
+
+    String result;
+};
+
 void start_proportional_task(const ProportionalConfig &);
 void stop_proportional_task();
 ProportionalStatus get_proportional_status();
@@ -614,6 +745,8 @@ void reconfigure_proportional(const ProportionalConfig &);
 
 String proportional_calibrate(const String & channel_str);
 String proportional_actuate(const String & channel_str, const String & value_str, const String & ref_str);
+void proportional_actuate_batch(const std::vector<std::vector<String>> & channel_value_refs, std::vector<String> & results);
+String proportional_get_signature(const String & channel_str, JsonVariant & json);
 
 
 #endif // INCLUDE_PROPORTIONAL
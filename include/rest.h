@@ -1,7 +1,20 @@
 #include <vector>
+#include <restFormat.h>
 
-String restPing(bool include_info);
-String restWifiInfo();
+// the document of a GET route in the format of its request (restFormat.h); a JSON document is the returned
+// String, a binary one (MessagePack) is left in body, valid until restEndRequest(), and the String is empty
+
+struct RestDocument
+{
+    RestDocument(uint8_t _format = rfJson) : format(_format), body(NULL), body_length(0) {}
+
+    uint8_t format;
+    const char * body;
+    size_t body_length;
+};
+
+String restPing(bool include_info, RestDocument & document);
+String restWifiInfo(RestDocument & document);
 
 String restSetup(const String & body, const String & resetStamp);
 String restSetupPm(const String & body, const String & resetStamp);
@@ -11,6 +24,10 @@ String restCleanup();
 String restCleanupPm();
 String restCleanupAutonom();
 
+String restActionAutonomShowerGuardReplay(const String & body, String & response);
+
+String restActionAutonomBatch(const String & body, String & response);
+
 String restActionAutonomKeyboxActuate(const String & channel_str);
 
 String restActionAutonomRfidLockProgram(const String & code_str, uint16_t timeout);
@@ -20,11 +37,12 @@ String restActionAutonomRfidLockAddCode(const String & name_str, const String &
 String restActionAutonomRfidLockDeleteCode(const String & name_str);
 String restActionAutonomRfidLockDeleteAllCodes();
 String restActionAutonomRfidLockUnlock(const String & lock_channel_str);
-String restGetAutonomRfidLockCodes();
+String restGetAutonomRfidLockCodes(RestDocument & document);
 
 String restActionAutonomProportionalCalibrate(const String & channel_str);
 String restActionAutonomProportionalActuate(const String & channel_str, const String & value_str, 
                                             const String & ref_str);
+String restGetAutonomProportionalSignature(const String & channel_str, String & response);
 
 String restActionAutonomZero2tenCalibrateInput(const String & channel_str, const String & value_str);
 String restActionAutonomZero2tenInput(const String & channel_str, String & value_str);
@@ -37,7 +55,7 @@ String restActionAutonomMainsProbeCalibrateALow(const String & channel_str, cons
 String restActionAutonomMainsProbeInputV(const String & addr_str, const String & channel_str, String & value_str);
 String restActionAutonomMainsProbeInputAHigh(const String & addr_str, const String & channel_str, String & value_str);
 String restActionAutonomMainsProbeInputALow(const String & channel_str, String & value_str);
-String restGetAutonomMainsProbeCalibrationData();
+String restGetAutonomMainsProbeCalibrationData(RestDocument & document);
 String restActionAutonomMainsProbeImportCalibrationData(const String & body);
 
 String restActionAutonomMultiUartCommand(const String & command, String & response);
@@ -47,10 +65,18 @@ String restActionAutonomMultiSetVolatile(const String & body);
 String restReset(const String & resetStamp);
 String restResetPm(const String & resetStamp);
 
-String restGet(const String & resetStamp);
-String restGetPm(const String & resetStamp);
-String restGetAutonom();
+String restGet(const String & resetStamp, RestDocument & document);
+String restGetPm(const String & resetStamp, RestDocument & document);
+String restGetAutonom(RestDocument & document);
+
+String restPopLog(RestDocument & document);
+
+// the body stays valid until restEndRequest(), content_encoding is NULL if the body is not compressed
+String restPopLogSince(const String & since_str, const String & max_str, const String & accept_encoding, uint8_t format,
+                       const char * & body, size_t & body_length, const char * & content_encoding);
+String restActionLogLevel(const String & module_str, const String & level_str);
 
-String restPopLog();
+// gives the memory of the request back, after the response has been sent
+void restEndRequest();
 
 #define REST_VERSION  "1.3" 
\ No newline at end of file
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+
+// the format of the documents of the GET routes, negotiated per request from its Accept header: MessagePack if
+// it is accepted, JSON if JSON or any type is accepted or there is no Accept at all, otherwise none of the
+// accepted types is served (CBOR for one) and the request is answered with 406 instead of JSON it did not ask for
+//
+// parameters (q) of the media ranges are not weighed, a listed type counts as accepted
+//
+// no dependency on the platform
+
+enum RestFormat
+{
+    rfJson = 0,
+    rfMsgPack = 1,
+    rfNotAcceptable = 2
+};
+
+inline const char * rest_format_content_type(uint8_t format)
+{
+    return format == rfMsgPack ? "application/msgpack" : "application/json";
+}
+
+inline bool rest_media_type_is(const char * type, size_t length, const char * what)
+{
+    return strlen(what) == length && strncasecmp(type, what, length) == 0;
+}
+
+inline uint8_t rest_format_of(const char * accept)
+{
+    bool has_type = false;
+    bool json = false;
+
+    const char * p = accept != NULL ? accept : "";
+
+    while (*p)
+    {
+        // a media range is up to the next comma, its type up to the first semicolon
+
+        const char * end = p;
+
+        while (*end != 0 && *end != ',')
+        {
+            end++;
+        }
+
+        const char * type = p;
+
+        while (type < end && isspace((unsigned char) *type))
+        {
+            type++;
+        }
+
+        const char * type_end = type;
+
+        while (type_end < end && *type_end != ';' && isspace((unsigned char) *type_end) == 0)
+        {
+            type_end++;
+        }
+
+        size_t length = size_t(type_end - type);
+
+        if (length > 0)
+        {
+            has_type = true;
+
+            if (rest_media_type_is(type, length, "application/msgpack") || rest_media_type_is(type, length, "application/x-msgpack"))
+            {
+                return rfMsgPack;
+            }
+
+            if (rest_media_type_is(type, length, "application/json") || rest_media_type_is(type, length, "application/*") ||
+                rest_media_type_is(type, length, "*/*"))
+            {
+                json = true;
+            }
+        }
+
+        p = *end == ',' ? end + 1 : end;
+    }
+
+    return json || has_type == false ? rfJson : rfNotAcceptable;
+}
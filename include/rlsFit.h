@@ -0,0 +1,416 @@
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+#include <istream>
+#include <ostream>
+
+// calibration polynom fitted by recursive least squares, one O(order^2) update per point and no refit:
+//
+// - three estimators run side by side: y = c1*x (one point, the line goes through [0,0]), y = c0 + c1*x
+//   (two points) and y = c0 + c1*x + c2*x^2 (three points and more), the one matching the amount of points
+//   is used, so the order grows with the calibration like with a refit
+// - each point has a weight; the residual is tested against the spread of the points so far before the point
+//   is taken in and a point far off is rejected
+// - a point can be taken out again (downdate), e.g. when it is replaced
+//
+// x and y are scaled by the first point so that the coefficients and the weights stay in a range where the
+// prior of the estimator does not bias the fit
+//
+// no dependency on the platform
+
+class RlsPolyFit
+{
+    public:
+
+        static const uint8_t MAX_ORDER = 2;
+        static const uint16_t OUTLIER_MIN_POINTS = 5;  // residual spread is not known well enough below
+
+        static constexpr double INITIAL_P = 1e8;       // prior variance of the scaled coefficients
+        static constexpr double OUTLIER_SIGMAS = 4;
+        static constexpr double OUTLIER_MIN = 0.02;    // weighted residual that is never an outlier
+        static constexpr double MIN_DOWNDATE = 1e-6;   // 1-leverage below which a point cannot be taken out
+
+        enum Result
+        {
+            rAccepted = 0,
+            rRejected = 1,
+            rInvalid = 2
+        };
+
+        RlsPolyFit()
+        {
+            clear();
+        }
+
+        void clear()
+        {
+            scale = 0;
+            y_scale = 1;
+            points = 0;
+            rejected = 0;
+
+            estimators[0].reset(1, 1);
+            estimators[1].reset(2, 0);
+            estimators[2].reset(3, 0);
+        }
+
+        bool is_empty() const
+        {
+            return points == 0;
+        }
+
+        uint16_t get_points() const
+        {
+            return points;
+        }
+
+        uint16_t get_rejected() const
+        {
+            return rejected;
+        }
+
+        uint8_t get_order() const
+        {
+            return points == 0 ? 0 : (points < 3 ? 1 : 2);
+        }
+
+        Result add(double x, double y, double w, bool check_outlier = true)
+        {
+            if (!(w > 0) || isfinite(x) == false || isfinite(y) == false)
+            {
+                return rInvalid;
+            }
+
+            if (scale == 0)
+            {
+                if (x == 0)
+                {
+                    return rInvalid;
+                }
+
+                scale = fabs(x);
+                y_scale = y != 0 ? fabs(y) : 1;
+            }
+
+            const double xs = x / scale;
+            y /= y_scale;
+            w *= y_scale * y_scale;
+
+            if (check_outlier && points >= OUTLIER_MIN_POINTS)
+            {
+                const Estimator & e = estimators[2];
+                double phi[3], p_phi[3];
+                e.regressors(xs, phi);
+
+                double residual = (y - e.predict(phi)) * sqrt(w);
+                double s2 = e.sse / double(points - e.size);
+                double limit = OUTLIER_SIGMAS * sqrt(s2 * (1 + w * e.leverage(phi, p_phi)));
+
+                if (fabs(residual) > (limit > OUTLIER_MIN ? limit : OUTLIER_MIN))
+                {
+                    rejected++;
+                    return rRejected;
+                }
+            }
+
+            for (uint8_t i=0; i<3; ++i)
+            {
+                estimators[i].update(xs, y, w);
+            }
+
+            points++;
+            return rAccepted;
+        }
+
+        // takes out a point added before with the same weight; false while there are too few points or if that
+        // would leave an estimator ill-conditioned (the point pins a coefficient down alone), the fit has to be
+        // rebuilt from the points then
+
+        bool remove(double x, double y, double w)
+        {
+            if (points <= estimators[2].size || !(w > 0))
+            {
+                return false;
+            }
+
+            const double xs = x / scale;
+            y /= y_scale;
+            w *= y_scale * y_scale;
+
+            for (uint8_t i=0; i<3; ++i)
+            {
+                if (estimators[i].can_downdate(xs, w) == false)
+                {
+                    return false;
+                }
+            }
+
+            for (uint8_t i=0; i<3; ++i)
+            {
+                estimators[i].update(xs, y, -w);
+            }
+
+            points--;
+            return true;
+        }
+
+        // coefficients of the active estimator for the unscaled x, c0 first, zero-padded to MAX_ORDER+1
+
+        void get_beta(double beta[MAX_ORDER+1]) const
+        {
+            for (uint8_t i=0; i<=MAX_ORDER; ++i)
+            {
+                beta[i] = 0;
+            }
+
+            if (points == 0)
+            {
+                return;
+            }
+
+            const Estimator & e = active();
+
+            for (uint8_t i=0; i<e.size; ++i)
+            {
+                uint8_t power = e.first_power + i;
+                beta[power] = e.theta[i] * y_scale / pow(scale, power);
+            }
+        }
+
+        // standard error of the coefficients, same layout as get_beta; 0 while the points fit exactly
+
+        void get_beta_stderr(double beta_stderr[MAX_ORDER+1]) const
+        {
+            for (uint8_t i=0; i<=MAX_ORDER; ++i)
+            {
+                beta_stderr[i] = 0;
+            }
+
+            const Estimator & e = active();
+
+            if (points <= e.size)
+            {
+                return;
+            }
+
+            double s2 = e.sse / double(points - e.size);
+
+            for (uint8_t i=0; i<e.size; ++i)
+            {
+                uint8_t power = e.first_power + i;
+                beta_stderr[power] = sqrt(e.P[i][i] * s2) * y_scale / pow(scale, power);
+            }
+        }
+
+        // weighted rms residual; with weight 1/y^2 it is the relative error of the fit
+
+        double get_rms() const
+        {
+            const Estimator & e = active();
+            return points > e.size ? sqrt(e.sse / double(points - e.size)) : 0;
+        }
+
+        double calc(double x) const
+        {
+            if (points == 0)
+            {
+                return 0;
+            }
+
+            const Estimator & e = active();
+            double phi[3];
+            e.regressors(x / scale, phi);
+            return e.predict(phi) * y_scale;
+        }
+
+        void to_eprom(std::ostream & os) const
+        {
+            float _scale = scale;
+            os.write((const char *)&_scale, sizeof(_scale));
+            _scale = y_scale;
+            os.write((const char *)&_scale, sizeof(_scale));
+            os.write((const char *)&points, sizeof(points));
+            os.write((const char *)&rejected, sizeof(rejected));
+
+            for (uint8_t k=0; k<3; ++k)
+            {
+                const Estimator & e = estimators[k];
+                float value = e.sse;
+                os.write((const char *)&value, sizeof(value));
+
+                for (uint8_t i=0; i<e.size; ++i)
+                {
+                    value = e.theta[i];
+                    os.write((const char *)&value, sizeof(value));
+
+                    for (uint8_t j=i; j<e.size; ++j)
+                    {
+                        value = e.P[i][j];
+                        os.write((const char *)&value, sizeof(value));
+                    }
+                }
+            }
+        }
+
+        bool from_eprom(std::istream & is)
+        {
+            clear();
+
+            float _scale = 0;
+            float _y_scale = 1;
+            is.read((char *)&_scale, sizeof(_scale));
+            is.read((char *)&_y_scale, sizeof(_y_scale));
+            is.read((char *)&points, sizeof(points));
+            is.read((char *)&rejected, sizeof(rejected));
+            scale = _scale;
+            y_scale = _y_scale;
+
+            for (uint8_t k=0; k<3; ++k)
+            {
+                Estimator & e = estimators[k];
+                float value = 0;
+                is.read((char *)&value, sizeof(value));
+                e.sse = value;
+
+                for (uint8_t i=0; i<e.size; ++i)
+                {
+                    is.read((char *)&value, sizeof(value));
+                    e.theta[i] = value;
+
+                    for (uint8_t j=i; j<e.size; ++j)
+                    {
+                        is.read((char *)&value, sizeof(value));
+                        e.P[i][j] = value;
+                        e.P[j][i] = value;
+                    }
+                }
+            }
+
+            // a short record only sets failbit
+
+            if (is.fail() || (points > 0 && !(scale > 0 && y_scale > 0)))
+            {
+                clear();
+                return false;
+            }
+
+            return true;
+        }
+
+    protected:
+
+        struct Estimator
+        {
+            void reset(uint8_t _size, uint8_t _first_power)
+            {
+                size = _size;
+                first_power = _first_power;
+                sse = 0;
+
+                for (uint8_t i=0; i<3; ++i)
+                {
+                    theta[i] = 0;
+
+                    for (uint8_t j=0; j<3; ++j)
+                    {
+                        P[i][j] = i == j ? INITIAL_P : 0;
+                    }
+                }
+            }
+
+            void regressors(double xs, double phi[3]) const
+            {
+                double value = first_power == 0 ? 1 : xs;
+
+                for (uint8_t i=0; i<size; ++i)
+                {
+                    phi[i] = value;
+                    value *= xs;
+                }
+            }
+
+            double predict(const double phi[3]) const
+            {
+                double y = 0;
+
+                for (uint8_t i=0; i<size; ++i)
+                {
+                    y += theta[i] * phi[i];
+                }
+
+                return y;
+            }
+
+            // phi' P phi, P phi goes to p_phi
+
+            double leverage(const double phi[3], double p_phi[3]) const
+            {
+                double s = 0;
+
+                for (uint8_t i=0; i<size; ++i)
+                {
+                    p_phi[i] = 0;
+
+                    for (uint8_t j=0; j<size; ++j)
+                    {
+                        p_phi[i] += P[i][j] * phi[j];
+                    }
+
+                    s += phi[i] * p_phi[i];
+                }
+
+                return s;
+            }
+
+            bool can_downdate(double xs, double w) const
+            {
+                double phi[3], p_phi[3];
+                regressors(xs, phi);
+                return 1 - w * leverage(phi, p_phi) > MIN_DOWNDATE;
+            }
+
+            // negative w takes the point out
+
+            void update(double xs, double y, double w)
+            {
+                double phi[3], p_phi[3];
+                regressors(xs, phi);
+
+                double s = leverage(phi, p_phi);
+                double denominator = 1 / w + s;
+                double error = y - predict(phi);
+
+                for (uint8_t i=0; i<size; ++i)
+                {
+                    double k = p_phi[i] / denominator;
+                    theta[i] += k * error;
+
+                    for (uint8_t j=0; j<size; ++j)
+                    {
+                        P[i][j] -= k * p_phi[j];
+                    }
+                }
+
+                sse += error * error / denominator;
+                sse = sse < 0 ? 0 : sse;
+            }
+
+            uint8_t size;
+            uint8_t first_power;    // 1 - no constant term
+            double theta[3];
+            double P[3][3];
+            double sse;             // weighted sum of squared residuals
+        };
+
+        const Estimator & active() const
+        {
+            return estimators[points <= 1 ? 0 : (points == 2 ? 1 : 2)];
+        }
+
+        double scale;
+        double y_scale;
+        uint16_t points;
+        uint16_t rejected;
+        Estimator estimators[3];
+};
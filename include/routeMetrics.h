@@ -0,0 +1,127 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <latencyHistogram.h>
+
+// per route metrics of the REST api and their Prometheus text exposition; the text type is a template
+// parameter (String on the device, std::string on the host), it only needs clear(), += and length()
+//
+// no dependency on the platform
+
+struct RouteMetrics
+{
+    RouteMetrics()
+    {
+        body_too_big = 0;
+    }
+
+    LatencyHistogram latency;
+    uint32_t body_too_big;
+};
+
+enum MetricFamily
+{
+    mfRequests = 0,
+    mfBodyTooBig = 1,
+    mfDuration = 2
+};
+
+static const char * const metric_family_type[] =
+{
+    "# TYPE harvester_http_requests_total counter\n",
+    "# TYPE harvester_http_body_too_big_total counter\n",
+    "# TYPE harvester_http_request_duration_seconds histogram\n"
+};
+
+// the lines of one family for one route; nothing for the duration of a route that has not been called
+
+template <class Text>
+void route_metrics_to_text(Text & text, const char * route, const char * method, const RouteMetrics & metrics, uint8_t family)
+{
+    char labels[96];
+    snprintf(labels, sizeof(labels), "route=\"%s\",method=\"%s\"", route, method);
+
+    char line[192];  // labels plus the longest metric name and value
+    const LatencyHistogram & latency = metrics.latency;
+
+    if (family == mfRequests)
+    {
+        snprintf(line, sizeof(line), "harvester_http_requests_total{%s} %lu\n", labels, (unsigned long) latency.get_count());
+        text += line;
+        return;
+    }
+
+    if (family == mfBodyTooBig)
+    {
+        snprintf(line, sizeof(line), "harvester_http_body_too_big_total{%s} %lu\n", labels, (unsigned long) metrics.body_too_big);
+        text += line;
+        return;
+    }
+
+    if (latency.get_count() == 0)
+    {
+        return;
+    }
+
+    uint32_t cumulative = 0;
+
+    for (uint8_t i=0; i<LatencyHistogram::NUM_BUCKETS; ++i)
+    {
+        cumulative += latency.get_bucket(i);
+        uint32_t upper_bound_us = LatencyHistogram::get_upper_bound_us(i);
+
+        if (upper_bound_us == 0)
+        {
+            snprintf(line, sizeof(line), "harvester_http_request_duration_seconds_bucket{%s,le=\"+Inf\"} %lu\n", labels, (unsigned long) cumulative);
+        }
+        else
+        {
+            snprintf(line, sizeof(line), "harvester_http_request_duration_seconds_bucket{%s,le=\"%g\"} %lu\n", labels,
+                     double(upper_bound_us) / 1e6, (unsigned long) cumulative);
+        }
+
+        text += line;
+    }
+
+    snprintf(line, sizeof(line), "harvester_http_request_duration_seconds_sum{%s} %.6f\n", labels, double(latency.get_sum_us()) / 1e6);
+    text += line;
+    snprintf(line, sizeof(line), "harvester_http_request_duration_seconds_count{%s} %lu\n", labels, (unsigned long) latency.get_count());
+    text += line;
+}
+
+// the whole exposition; the lines of one metric family have to come as one group, hence a pass over the
+// routes per family. It is handed to send(text) in chunks of one family and route so that it
+// does not need to fit in memory at once; route(i, route, method, metrics) gives the route i of count
+//
+// an empty chunk is never sent, in a chunked response it is the end of the response
+
+template <class Text, class GetRoute, class Send>
+void route_metrics_exposition(Text & text, size_t count, GetRoute route, Send send)
+{
+    for (uint8_t family=mfRequests; family<=mfDuration; ++family)
+    {
+        text.clear();
+        text += metric_family_type[family];
+        send(text);
+
+        for (size_t i=0; i<count; ++i)
+        {
+            const char * route_name = "";
+            const char * method = "";
+            const RouteMetrics * metrics = NULL;
+
+            route(i, route_name, method, metrics);
+
+            text.clear();
+            route_metrics_to_text(text, route_name, method, *metrics, family);
+
+            if (text.length() > 0)
+            {
+                send(text);
+            }
+        }
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+// one task for all timed jobs of the modules, jobs are kept in a min-heap by due time and the task sleeps
+// until the earliest one is due:
+//
+// - interval jobs run every interval_ms on the monotonic clock, they do not need the time of day
+// - time-of-day jobs run when the local time matches minute / hour (-1 matches any), cron-like; they only
+//   run after the time has been fetched by NTP and once more right when it becomes valid, since whatever
+//   the job maintains was computed without the time
+//
+// jobs run in the scheduler task and have to be short, a longer piece of work should be handed over to
+// the task of the module
+
+typedef void (*SchedulerJobFunc)(void * arg);
+typedef int SchedulerJobId;
+
+const SchedulerJobId SCHEDULER_NO_JOB = -1;
+
+SchedulerJobId scheduler_add_interval(const char * name, uint32_t interval_ms, SchedulerJobFunc func, void * arg, bool run_now = true);
+SchedulerJobId scheduler_add_time_of_day(const char * name, int8_t minute, int8_t hour, SchedulerJobFunc func, void * arg);
+void scheduler_remove(SchedulerJobId id);
+
+// false while the time is not fetched by NTP yet, tm is filled with the local time otherwise
+
+bool scheduler_get_local_time(tm & _tm);
@@ -411,6 +411,8 @@ struct ShowerGuardStatus
         fan = false;
         light_decision = "";
         fan_decision = "";
+        light_on_time = 0;
+        fan_on_time = 0;
     }
 
     ShowerGuardStatus(const ShowerGuardStatus & other)
@@ -429,6 +431,8 @@ struct ShowerGuardStatus
         fan = other.fan;
         light_decision = other.light_decision;
         fan_decision = other.fan_decision;
+        light_on_time = other.light_on_time;
+        fan_on_time = other.fan_on_time;
     }
 
     ShowerGuardStatus & operator = (const ShowerGuardStatus & other)
@@ -447,6 +451,8 @@ struct ShowerGuardStatus
         fan = other.fan;
         light_decision = other.light_decision;
         fan_decision = other.fan_decision;
+        light_on_time = other.light_on_time;
+        fan_on_time = other.fan_on_time;
 
         return *this;
     }
@@ -465,6 +471,8 @@ struct ShowerGuardStatus
         jsonVariant["fan"] = fan;
         jsonVariant["light_decision"] = light_decision;
         jsonVariant["fan_decision"] = fan_decision;
+        jsonVariant["light_on_time"] = light_on_time;
+        jsonVariant["fan_on_time"] = fan_on_time;
     }
 
     float temp;
@@ -476,6 +484,11 @@ struct ShowerGuardStatus
     bool fan;
     String light_decision;
     String fan_decision;
+
+    // seconds the light / fan decision has been on since the task started
+
+    uint32_t light_on_time;
+    uint32_t fan_on_time;
 };
 
 void start_shower_guard_task(const ShowerGuardConfig &);
@@ -484,4 +497,6 @@ ShowerGuardStatus get_shower_guard_status();
 
 void reconfigure_shower_guard(const ShowerGuardConfig &);
 
+String shower_guard_replay(const JsonVariant & json, JsonVariant & result);
+
 #endif // INCLUDE_SHOWERGUARD
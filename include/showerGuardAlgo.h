@@ -0,0 +1,442 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <slidingWindow.h>
+
+// the light / fan decisions of the shower-guard, apart from the task and the hardware so that recorded traces
+// run through the same code on the device (the replay endpoint) and on the host (test/sim, test/test_shower_guard_algo)
+//
+// no dependency on the platform, the clock is passed in by the caller
+
+struct ShowerGuardAlgoParams
+{
+    // as ShowerGuardConfig::Light::Mode
+
+    enum Mode
+    {
+        mOff  = 0,
+        mOn   = 1,
+        mAuto = 2,
+    };
+
+    ShowerGuardAlgoParams()
+    {
+        light_linger = 60;
+        fan_linger = 60;
+        rh_on = 55;
+        rh_off = 50;
+        light_mode = mAuto;
+        fan_mode = mAuto;
+    }
+
+    unsigned light_linger;  // seconds
+    unsigned fan_linger;    // seconds
+    unsigned rh_on;
+    unsigned rh_off;
+    uint8_t light_mode;
+    uint8_t fan_mode;
+};
+
+// formats the time in the decision strings, the device uses its own (local time), the host defaults to UTC
+
+typedef void (*ShowerGuardTimeFormat)(time_t time, char * buf, size_t size);
+
+inline void shower_guard_format_time_utc(time_t time, char * buf, size_t size)
+{
+    struct tm tm;
+    gmtime_r(&time, &tm);
+    strftime(buf, size, "%Y-%m-%d %H:%M:%S", &tm);
+}
+
+class ShowerGuardAlgo
+{
+public:
+
+    static const size_t DECISION_SIZE = 64;
+    static const size_t LIGHT_DECISION_LEVELS = 2;
+    static const size_t FAN_DECISION_LEVELS = 3;
+
+    ShowerGuardAlgo(ShowerGuardTimeFormat _time_format = shower_guard_format_time_utc) : time_format(_time_format)
+    {
+        init();
+    }
+
+    void start(const ShowerGuardAlgoParams & params)
+    {
+        init();
+        reconfigure(params);
+    }
+
+    void stop() {}
+
+    void reconfigure(const ShowerGuardAlgoParams & params)
+    {
+        light_linger = params.light_linger;
+        fan_linger = params.fan_linger;
+
+        rh_off = params.rh_off;
+        rh_on = params.rh_on;
+        light_mode = params.light_mode;
+        fan_mode = params.fan_mode;
+
+        reset_rh_window();
+    }
+
+    void loop_once(float rh, float temp, bool motion, uint32_t now_millis, time_t now_time);
+
+    bool get_light() const { return light; }
+    bool get_fan() const { return fan; }
+
+    // time the light / fan decision has been on since start, seconds
+
+    uint32_t get_light_on_time() const { return uint32_t(light_on_millis / 1000); }
+    uint32_t get_fan_on_time() const { return uint32_t(fan_on_millis / 1000); }
+
+    // the highest level that has something to say
+
+    const char * get_last_light_decision() const { return last_decision(last_light_decision, LIGHT_DECISION_LEVELS); }
+    const char * get_last_fan_decision() const { return last_decision(last_fan_decision, FAN_DECISION_LEVELS); }
+
+    const char * get_light_decision(size_t level) const { return last_light_decision[level]; }
+    const char * get_fan_decision(size_t level) const { return last_fan_decision[level]; }
+
+protected:
+
+    // number of averaged rh readings the soft toggle-down condition looks back at
+
+    static const size_t RH_SLIDING_WINDOW_SIZE = 10;
+
+    void init();
+
+    void reset_rh_window()
+    {
+        rh_sliding_window.reset();
+    }
+
+    void update_rh_window(float rh)
+    {
+        // add average to sliding window. if sliding window is full - the oldest one drops out (ring buffer,
+        // nothing is shifted)
+
+        rh_sliding_window.push(rh);
+    }
+
+    bool is_soft_rh_toggle_down_condition() const;
+
+    static const char * last_decision(const char (* decisions)[DECISION_SIZE], size_t levels)
+    {
+        for (int i = int(levels) - 1; i >= 0; --i)
+        {
+            if (decisions[i][0] != 0)
+            {
+                return decisions[i];
+            }
+        }
+
+        return "";
+    }
+
+    const char * time_str(time_t time)
+    {
+        time_format(time, time_buf, sizeof(time_buf));
+        return time_buf;
+    }
+
+    ShowerGuardTimeFormat time_format;
+    char time_buf[32];
+
+    bool light;
+    bool fan;
+
+    bool reset_rh_decision;
+    uint32_t last_motion_millis;
+    time_t last_motion_time;
+
+    uint32_t last_loop_millis;
+    uint64_t light_on_millis;
+    uint64_t fan_on_millis;
+
+    SlidingWindow<float, RH_SLIDING_WINDOW_SIZE> rh_sliding_window;
+
+    bool rh_toggle;
+
+    unsigned light_linger;
+    unsigned fan_linger;
+    unsigned rh_off, rh_on;
+    uint8_t light_mode;
+    uint8_t fan_mode;
+
+    char last_light_decision[LIGHT_DECISION_LEVELS][DECISION_SIZE];
+    char last_fan_decision[FAN_DECISION_LEVELS][DECISION_SIZE];
+};
+
+inline void ShowerGuardAlgo::loop_once(float rh, float temp, bool motion, uint32_t now_millis, time_t now_time)
+{
+    // run algo even if there are overrides to fan and light (mode not auto)
+
+    // account on-time with the decisions of the previous loop, they were in effect until now
+
+    if (reset_rh_decision == false)
+    {
+        uint32_t passed_millis = now_millis - last_loop_millis;
+
+        if (light)
+        {
+            light_on_millis += passed_millis;
+        }
+
+        if (fan)
+        {
+            fan_on_millis += passed_millis;
+        }
+    }
+
+    last_loop_millis = now_millis;
+
+    update_rh_window(rh);
+
+    bool motion_light = false;
+    bool motion_fan = false;
+
+    if (reset_rh_decision) // running first time after init
+    {
+        motion = true; // imitate initial motion to put on everything
+
+        unsigned rh_middle = rh_off + (rh_on - rh_off) / 2;
+
+        if (rh >= rh_middle)
+        {
+            rh_toggle = true;
+        }
+
+        snprintf(last_fan_decision[0], DECISION_SIZE, "init %.1f/%.1f (middle) at %s", rh, (float)rh_middle, time_str(now_time));
+
+        reset_rh_decision = false;
+    }
+
+    if (motion)
+    {
+        motion_light = true;
+        motion_fan = true;
+        last_motion_millis = now_millis;
+        last_motion_time = now_time;
+    }
+    else
+    {
+        if (((now_millis - last_motion_millis) / 1000) < light_linger)
+        {
+            motion_light = true;
+        }
+
+        if (((now_millis - last_motion_millis) / 1000) < fan_linger)
+        {
+            motion_fan = true;
+        }
+    }
+
+    if (motion_light == true)
+    {
+        snprintf(last_light_decision[0], DECISION_SIZE, "motion at %s (+%d s)", time_str(last_motion_time), light_linger);
+    }
+    else
+    {
+        strcpy(last_light_decision[0], "linger out");
+    }
+
+    light = motion_light;
+
+    if (rh >= rh_on)
+    {
+        if (rh_toggle == false)
+        {
+            rh_toggle = true;
+            snprintf(last_fan_decision[0], DECISION_SIZE, "rh-high %.1f/%.1f at %s", rh, (float)rh_on, time_str(now_time));
+        }
+    }
+    else if (rh <= rh_off)
+    {
+        if (rh_toggle == true)
+        {
+            rh_toggle = false;
+            snprintf(last_fan_decision[0], DECISION_SIZE, "rh-low %.1f/%.1f at %s", rh, (float)rh_off, time_str(now_time));
+        }
+    }
+    else
+    {
+        if (rh_toggle == true)
+        {
+            if (is_soft_rh_toggle_down_condition())
+            {
+                rh_toggle = false;
+                snprintf(last_fan_decision[0], DECISION_SIZE, "rh-soft-down at %s", time_str(now_time));
+            }
+        }
+    }
+
+    if (motion_fan == true)
+    {
+        fan = true;
+        snprintf(last_fan_decision[1], DECISION_SIZE, "motion at %s (+%d s)", time_str(last_motion_time), fan_linger);
+    }
+    else
+    {
+        last_fan_decision[1][0] = 0;
+        fan = rh_toggle;
+    }
+
+    if (light_mode != ShowerGuardAlgoParams::mAuto)
+    {
+        light = light_mode == ShowerGuardAlgoParams::mOn ? true : false;
+        strcpy(last_light_decision[1], "nonauto-mode");
+    }
+    else
+    {
+        last_light_decision[1][0] = 0;
+    }
+
+    if (fan_mode != ShowerGuardAlgoParams::mAuto)
+    {
+        fan = fan_mode == ShowerGuardAlgoParams::mOn ? true : false;
+        strcpy(last_fan_decision[2], "nonauto-mode");
+    }
+    else
+    {
+        last_fan_decision[2][0] = 0;
+    }
+}
+
+inline void ShowerGuardAlgo::init()
+{
+    light = false;
+    fan = false;
+    reset_rh_decision = true;
+    last_motion_millis = 0;
+    last_motion_time = 0;
+    last_loop_millis = 0;
+    light_on_millis = 0;
+    fan_on_millis = 0;
+    rh_toggle = false;
+    reset_rh_window();
+
+    light_linger = 0;
+    fan_linger = 0;
+    rh_off = 0;
+    rh_on = 0;
+    light_mode = ShowerGuardAlgoParams::mAuto;
+    fan_mode = ShowerGuardAlgoParams::mAuto;
+
+    for (size_t i = 1; i < LIGHT_DECISION_LEVELS; ++i)
+    {
+        last_light_decision[i][0] = 0;
+    }
+
+    for (size_t i = 1; i < FAN_DECISION_LEVELS; ++i)
+    {
+        last_fan_decision[i][0] = 0;
+    }
+
+    strcpy(last_light_decision[0], "init");
+    strcpy(last_fan_decision[0], "init");
+}
+
+inline bool ShowerGuardAlgo::is_soft_rh_toggle_down_condition() const
+{
+    // current condition for soft toggling down of rh_switch is that the sliding window is fully filled and
+    // all its values are under the lowest 10 %of the span rh_off -> rh_on
+
+    if (rh_sliding_window.is_window_full()) // sliding window is fully filled
+    {
+        float upper = rh_off + float(rh_on - rh_off) / 10.0;
+
+        // all values are under upper when the maximum is, the window keeps its maximum up to date on push
+
+        return rh_sliding_window.get_max(0) <= upper;
+    }
+
+    return false;
+}
+
+// a recorded trace row by row through an algo of its own, with the clock taken from the trace: a day of data
+// replays in well under a second and the outcome only depends on the trace and the parameters; the outputs
+// are replayed as in auto mode, an override would make the replay meaningless
+
+class ShowerGuardReplay
+{
+public:
+
+    ShowerGuardReplay(const ShowerGuardAlgoParams & params, ShowerGuardTimeFormat time_format = shower_guard_format_time_utc) :
+        algo(time_format)
+    {
+        ShowerGuardAlgoParams auto_params = params;
+        auto_params.light_mode = ShowerGuardAlgoParams::mAuto;
+        auto_params.fan_mode = ShowerGuardAlgoParams::mAuto;
+
+        algo.start(auto_params);
+
+        first_time = 0;
+        last_time = 0;
+        rows = 0;
+        light_switches = 0;
+        fan_switches = 0;
+        changed = false;
+    }
+
+    // one algo loop [time (s), rh, temp, motion]; false if the row goes back in time, it is not run then
+
+    bool push(time_t now_time, float rh, float temp, bool motion)
+    {
+        if (rows == 0)
+        {
+            first_time = now_time;
+        }
+        else if (now_time < last_time)
+        {
+            return false;
+        }
+
+        bool last_light = algo.get_light();
+        bool last_fan = algo.get_fan();
+
+        algo.loop_once(rh, temp, motion, uint32_t(now_time - first_time) * 1000, now_time);
+
+        changed = rows == 0 || algo.get_light() != last_light || algo.get_fan() != last_fan;
+
+        if (rows > 0)
+        {
+            light_switches += algo.get_light() != last_light ? 1 : 0;
+            fan_switches += algo.get_fan() != last_fan ? 1 : 0;
+        }
+
+        last_time = now_time;
+        rows++;
+
+        return true;
+    }
+
+    // the last push changed the light or the fan (the first one always does)
+
+    bool is_changed() const { return changed; }
+
+    const ShowerGuardAlgo & get_algo() const { return algo; }
+
+    size_t get_rows() const { return rows; }
+    long get_duration() const { return long(last_time - first_time); }
+    size_t get_light_switches() const { return light_switches; }
+    size_t get_fan_switches() const { return fan_switches; }
+
+protected:
+
+    ShowerGuardAlgo algo;
+
+    time_t first_time;
+    time_t last_time;
+    size_t rows;
+    size_t light_switches;
+    size_t fan_switches;
+    bool changed;
+};
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// fixed size sliding window over the last window_size values with O(1) push and O(1) statistics:
+//
+// - the values live in a ring buffer, nothing is shifted on push
+// - min / max are kept in monotonic deques (each holding at most window_size entries)
+// - mean and slope are kept as running sums which are recomputed from the values once per window
+//   to keep the float error from accumulating
+//
+// no heap is used, the whole window is a member of its owner
+
+template<class T, size_t window_size> class SlidingWindow
+{
+    public:
+
+        SlidingWindow()
+        {
+            reset();
+        }
+
+        void reset()
+        {
+            head = 0;
+            count = 0;
+            pushed = 0;
+            pushes_since_resync = 0;
+            sum = 0;
+            weighted_sum = 0;
+            min_deque.reset();
+            max_deque.reset();
+        }
+
+        void push(T value)
+        {
+            if (count == window_size)
+            {
+                T oldest = values[head];
+                head = (head + 1) % window_size;
+                count--;
+
+                // after the oldest is gone the remaining ones have all moved one position closer to the beginning
+
+                sum -= oldest;
+                weighted_sum -= sum;
+            }
+
+            weighted_sum += double(count) * value;
+            sum += value;
+
+            values[(head + count) % window_size] = value;
+            count++;
+
+            uint32_t seq = pushed++;
+            uint32_t oldest_seq = pushed - count;
+
+            // drop what has left the window first so that a deque never holds more than window_size entries
+
+            min_deque.pop_older(oldest_seq);
+
+            while (min_deque.len > 0 && !(min_deque.back().value < value))
+            {
+                min_deque.pop_back();
+            }
+
+            min_deque.push_back(seq, value);
+
+            max_deque.pop_older(oldest_seq);
+
+            while (max_deque.len > 0 && !(value < max_deque.back().value))
+            {
+                max_deque.pop_back();
+            }
+
+            max_deque.push_back(seq, value);
+
+            if (count == window_size)
+            {
+                pushes_since_resync++;
+
+                if (pushes_since_resync >= window_size)
+                {
+                    resync();
+                }
+            }
+        }
+
+        size_t size() const
+        {
+            return count;
+        }
+
+        bool empty() const
+        {
+            return count == 0;
+        }
+
+        bool is_window_full() const
+        {
+            return count == window_size;
+        }
+
+        // oldest first
+
+        T operator [] (size_t i) const
+        {
+            return values[(head + i) % window_size];
+        }
+
+        T latest() const
+        {
+            return values[(head + count - 1) % window_size];
+        }
+
+        T get_min(T empty) const
+        {
+            return count == 0 ? empty : min_deque.front().value;
+        }
+
+        T get_max(T empty) const
+        {
+            return count == 0 ? empty : max_deque.front().value;
+        }
+
+        double get_sum() const
+        {
+            return sum;
+        }
+
+        double get_mean(double empty) const
+        {
+            return count == 0 ? empty : sum / count;
+        }
+
+        T get_average(T empty) const
+        {
+            return count == 0 ? empty : T(sum / count);
+        }
+
+        // least squares slope over the window, per sample (oldest to latest)
+
+        double get_slope() const
+        {
+            if (count < 2)
+            {
+                return 0;
+            }
+
+            double n = count;
+            double sum_x = n * (n - 1) / 2;
+            double sum_xx = (n - 1) * n * (2 * n - 1) / 6;
+
+            return (n * weighted_sum - sum_x * sum) / (n * sum_xx - sum_x * sum_x);
+        }
+
+    protected:
+
+        void resync()
+        {
+            pushes_since_resync = 0;
+            sum = 0;
+            weighted_sum = 0;
+
+            for (size_t i=0; i<count; ++i)
+            {
+                T value = (*this)[i];
+                sum += value;
+                weighted_sum += double(i) * value;
+            }
+        }
+
+        struct Entry
+        {
+            uint32_t seq;
+            T value;
+        };
+
+        struct Deque
+        {
+            void reset()
+            {
+                first = 0;
+                len = 0;
+            }
+
+            const Entry & front() const { return entries[first]; }
+            const Entry & back() const { return entries[(first + len - 1) % window_size]; }
+
+            void push_back(uint32_t seq, T value)
+            {
+                Entry & entry = entries[(first + len) % window_size];
+                entry.seq = seq;
+                entry.value = value;
+                len++;
+            }
+
+            void pop_back()
+            {
+                len--;
+            }
+
+            void pop_older(uint32_t oldest_seq)
+            {
+                // wrap-safe comparison of sequence numbers
+
+                while (len > 0 && int32_t(entries[first].seq - oldest_seq) < 0)
+                {
+                    first = (first + 1) % window_size;
+                    len--;
+                }
+            }
+
+            Entry entries[window_size];
+            size_t first;
+            size_t len;
+        };
+
+        T values[window_size];
+        size_t head;
+        size_t count;
+
+        uint32_t pushed;
+        size_t pushes_since_resync;
+
+        double sum;
+        double weighted_sum;
+
+        Deque min_deque;
+        Deque max_deque;
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <ArduinoJson.h>
+
+// telemetry of the tasks and the memory, reported in /get under "system":
+//
+// - per task: CPU share since the previous sample, minimum free stack ever (to right-size the stack sizes
+//   given to xTaskCreate), state and priority; sampled every TELEMETRY_SAMPLE_MS by a scheduler job
+// - heap of the internal RAM and of the PSRAM (if any): free, largest free block, minimum free ever
+// - per handler loop: the period of the iterations (work plus the delay), so that a loop blocking for
+//   longer than it should shows up
+//
+// a loop is registered by name once per task start and marked at the top of each iteration, the mark is
+// a few instructions; the figures of a loop are written by its task only and read without a lock, they
+// may be a sample apart
+
+#define TELEMETRY_SAMPLE_MS 10000
+
+struct TelemetryLoop;
+
+void start_telemetry();
+
+TelemetryLoop * telemetry_loop(const char * name);  // name has to be a literal, NULL if the table is full
+void telemetry_loop_mark(TelemetryLoop * loop);
+
+void get_telemetry(JsonVariant & json);
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+
+// volume fade between the last written value and a target, driven by periodic ticks:
+//
+// - set_target() only records the request, nothing is written; a new target while a fade is in progress
+//   restarts the fade from the value written last, so that any number of requests between two ticks
+//   coalesce into one
+// - tick() returns at most one value to write and only when it differs from the value written last
+//
+// no dependency on the platform, time is passed in by the caller
+
+class VolumeRamp
+{
+    public:
+
+        enum Curve
+        {
+            cStep = 0,     // no fade, the target is written on the next tick
+            cLinear = 1,
+            cSmooth = 2    // s-curve, slow at both ends
+        };
+
+        VolumeRamp()
+        {
+            reset(0);
+        }
+
+        // the device is known to be at volume, no fade
+
+        void reset(uint8_t volume)
+        {
+            from = volume;
+            target = volume;
+            current = volume;
+            curve = cStep;
+            duration_ms = 0;
+            start_ms = 0;
+        }
+
+        void set_target(uint8_t _target, uint32_t _duration_ms, uint8_t _curve, uint32_t now_ms)
+        {
+            if (_target == target)
+            {
+                return;  // same target again, keep the timing of the fade in progress
+            }
+
+            from = current;
+            target = _target;
+            curve = _curve;
+            duration_ms = _duration_ms;
+            start_ms = now_ms;
+        }
+
+        bool tick(uint32_t now_ms, uint8_t & volume)
+        {
+            if (current == target)
+            {
+                return false;
+            }
+
+            uint8_t next = value_at(now_ms - start_ms);
+
+            if (next == current)
+            {
+                return false;
+            }
+
+            current = next;
+            volume = next;
+            return true;
+        }
+
+        bool is_ramping() const
+        {
+            return current != target;
+        }
+
+        uint8_t get_target() const
+        {
+            return target;
+        }
+
+        uint8_t get_current() const
+        {
+            return current;
+        }
+
+    protected:
+
+        uint8_t value_at(uint32_t elapsed_ms) const
+        {
+            if (curve == cStep || elapsed_ms >= duration_ms)
+            {
+                return target;
+            }
+
+            float t = float(elapsed_ms) / float(duration_ms);
+
+            if (curve == cSmooth)
+            {
+                t = t * t * (3 - 2 * t);
+            }
+
+            return (uint8_t) lroundf(float(from) + (float(target) - float(from)) * t);
+        }
+
+        uint8_t from;
+        uint8_t target;
+        uint8_t current;
+        uint8_t curve;
+        uint32_t duration_ms;
+        uint32_t start_ms;
+};
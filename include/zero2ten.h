@@ -17,7 +17,7 @@ class Zero2tenConfig
 {
     public:
 
-        const uint8_t EPROM_VERSION = 1;
+        const uint8_t EPROM_VERSION = 2;
 
         Zero2tenConfig()
         {
@@ -218,6 +218,9 @@ class Zero2tenConfig
                     output = channel.output;
                     max_voltage = channel.max_voltage;
                     loopback = channel.loopback;
+                    slew_rate = channel.slew_rate;
+                    freq = channel.freq;
+                    resolution = channel.resolution;
                 }
 
                 return *this;
@@ -228,6 +231,9 @@ class Zero2tenConfig
                 output.clear();
                 max_voltage = 10;
                 loopback.clear();
+                slew_rate = 0;
+                freq = 0;
+                resolution = 0;
             }
 
             void from_json(const JsonVariant & json);
@@ -254,12 +260,25 @@ class Zero2tenConfig
                     ERROR("loopback.is_valid() == false")
                     return false;
                 }
+
+                if (slew_rate < 0)
+                {
+                    ERROR("slew_rate is invalid")
+                    return false;
+                }
+
+                if (resolution > 20)
+                {
+                    ERROR("resolution is invalid")
+                    return false;
+                }
                 return true;
             }
 
             bool operator == (const OutputChannel & channel) const
             {
-                return output == channel.output && loopback == channel.loopback;
+                return output == channel.output && loopback == channel.loopback && 
+                       slew_rate == channel.slew_rate && freq == channel.freq && resolution == channel.resolution;
             }
 
             String as_string() const
@@ -267,6 +286,9 @@ class Zero2tenConfig
                 return String("{output=") + output.as_string() + 
                               ",max_voltage=" + String(max_voltage) + 
                               ",loopback=" + loopback.as_string() + 
+                              ",slew_rate=" + String(slew_rate) + 
+                              ",freq=" + String(freq) + 
+                              ",resolution=" + String((int) resolution) + 
                               "}";
             }
             
@@ -274,6 +296,9 @@ class Zero2tenConfig
             DigitalOutputChannelConfig output;
             float max_voltage;  // the voltage that corresponds to 100% pwm duty (always on)            
             InputChannel loopback;            
+            float slew_rate;     // V/s, output changes run as a hardware fade; 0 - immediate
+            uint32_t freq;       // Hz of the pwm; 0 - default
+            uint8_t resolution;  // bits of the pwm duty; 0 - default
         };
 
         std::vector<InputChannel> input_channels;
@@ -715,6 +740,7 @@ String zero2ten_calibrate_input(const String & channel_str, const String & value
 String zero2ten_input(const String & channel_str, String & value_str);
 String zero2ten_calibrate_output(const String & channel_str, const String & value_str);
 String zero2ten_output(const String & channel_str, const String & value_str);
+void zero2ten_output_batch(const std::vector<std::pair<String, String>> & channel_values, std::vector<String> & results);
 
 
 #endif // INCLUDE_ZERO2TEN
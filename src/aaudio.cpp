@@ -5,6 +5,8 @@
 #include <aaudio.h>
 #include <gpio.h>
 #include <trace.h>
+#include <telemetry.h>
+#include <boot.h>
 #include <binarySemaphore.h>
 #include <esp_log.h>
 #include <time.h>
@@ -639,8 +641,12 @@ void AudioHandler::task(void *parameter)
     bool should_log_for_stats = true;
     uint32_t last_log_for_stats_millis = 0;
 
+    TelemetryLoop * loop_telemetry = telemetry_loop("audio_task");
+
     while (_this->_is_active)
     {
+        telemetry_loop_mark(loop_telemetry);
+
         now_millis = millis();
 
         should_log_for_stats = false;
@@ -767,7 +773,9 @@ void AudioHandler::task(void *parameter)
                   (int)motion_hys, (int)audio_on, (int)volume, status_copy.url_index, status_copy.bitrate, status_copy.title.c_str())
         }
 
-        if (wait_retry_audio_millis == 0 || wait_retry_audio_millis+AUDIO_RECONNECT_TIMEOUT <= now_millis || now_millis < wait_retry_audio_millis)
+        // nothing to connect to without the network, it is waited for by the boot event
+
+        if (boot_is(beNetwork) && (wait_retry_audio_millis == 0 || wait_retry_audio_millis+AUDIO_RECONNECT_TIMEOUT <= now_millis || now_millis < wait_retry_audio_millis))
         {
             if (audio_on == true)
             {
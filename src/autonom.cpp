@@ -2,6 +2,7 @@
 #include <ArduinoJson.h>
 #include <string>
 #include <sstream>
+#include <atomic>
 
 #include <autonom.h>
 
@@ -39,6 +40,7 @@
 
 #include <trace.h>
 #include <epromImage.h>
+#include <boot.h>
 
 
 class AutonomTaskManager
@@ -65,6 +67,8 @@ class AutonomTaskManager
 
         ShowerGuardStatus getShowerGuardStatus() const;
 
+        String showerGuardReplay(const JsonVariant & json, JsonVariant & result);
+
         bool isShowerGuardActive() const { return showerGuardActive; }
 
         #endif
@@ -128,6 +132,8 @@ class AutonomTaskManager
         
         String proportionalCalibrate(const String & channel_str);
         String proportionalActuate(const String & channel_str, const String & value_str, const String & ref_str);
+        void proportionalActuateBatch(const std::vector<std::vector<String>> & channel_value_refs, std::vector<String> & results);
+        String proportionalGetSignature(const String & channel_str, JsonVariant &);
 
         ProportionalStatus getProportionalStatus() const;
 
@@ -145,6 +151,7 @@ class AutonomTaskManager
         String zero2tenInput(const String & channel_str, String & value_str);
         String zero2tenCalibrateOutput(const String & channel_str, const String & value_str);
         String zero2tenOutput(const String & channel_str, const String & value_str);
+        void zero2tenOutputBatch(const std::vector<std::pair<String, String>> & channel_values, std::vector<String> & results);
 
         Zero2tenStatus getZero2tenStatus() const;
 
@@ -232,6 +239,12 @@ ShowerGuardStatus AutonomTaskManager::getShowerGuardStatus() const
     return get_shower_guard_status();
 }
 
+String AutonomTaskManager::showerGuardReplay(const JsonVariant & json, JsonVariant & result)
+{
+    TRACE("showerGuardReplay")
+    return shower_guard_replay(json, result);
+}
+
 #endif // INCLUDE_SHOWERGUARD
 
 #ifdef INCLUDE_KEYBOX
@@ -424,6 +437,19 @@ String AutonomTaskManager::proportionalActuate(const String & channel_str, const
     return proportional_actuate(channel_str, value_str, ref_str);
 }
 
+void AutonomTaskManager::proportionalActuateBatch(const std::vector<std::vector<String>> & channel_value_refs, 
+                                                  std::vector<String> & results)
+{
+    TRACE("proportionalActuateBatch %d", (int) channel_value_refs.size())
+    proportional_actuate_batch(channel_value_refs, results);
+}
+
+String AutonomTaskManager::proportionalGetSignature(const String & channel_str, JsonVariant & json_variant)
+{
+    TRACE("proportionalGetSignature")
+    return proportional_get_signature(channel_str, json_variant);
+}
+
 #endif // INCLUDE_PROPORTIONAL
 
 
@@ -479,6 +505,13 @@ String AutonomTaskManager::zero2tenOutput(const String & channel_str, const Stri
     return zero2ten_output(channel_str, value_str);
 }
 
+void AutonomTaskManager::zero2tenOutputBatch(const std::vector<std::pair<String, String>> & channel_values, 
+                                             std::vector<String> & results)
+{
+    TRACE("zero2tenOutputBatch %d", (int) channel_values.size())
+    zero2ten_output_batch(channel_values, results);
+}
+
 
 #endif // INCLUDE_ZERO2TEN
 
@@ -1448,6 +1481,21 @@ void cleanupAutonom()
     autonomTaskManager.stopAll();
 }
 
+String actionAutonomShowerGuardReplay(const JsonVariant & json, JsonVariant & result)
+{
+    #ifdef INCLUDE_SHOWERGUARD
+
+    // the replay runs on its own algo instance, it does not need the shower-guard task to be active
+
+    return autonomTaskManager.showerGuardReplay(json, result);
+    
+    #else
+
+    return "shower-guard is not built in currrent module";
+
+    #endif // INCLUDE_SHOWERGUARD
+}
+
 String actionAutonomKeyboxActuate(const String & channel_str)
 {
     #ifdef INCLUDE_KEYBOX
@@ -1638,6 +1686,45 @@ String actionAutonomProportionalActuate(const String & channel_str, const String
     #endif // INCLUDE_PROPORTIONAL
 }
 
+void actionAutonomProportionalActuateBatch(const std::vector<std::vector<String>> & channel_value_refs, 
+                                           std::vector<String> & results)
+{
+    #ifdef INCLUDE_PROPORTIONAL
+    if (autonomTaskManager.isProportionalActive())
+    {
+        autonomTaskManager.proportionalActuateBatch(channel_value_refs, results);
+    }
+    else
+    {
+        results.assign(channel_value_refs.size(), String("proportional not active"));
+    }
+    
+    #else
+
+    results.assign(channel_value_refs.size(), String("proportional is not built in currrent module"));
+
+    #endif // INCLUDE_PROPORTIONAL
+}
+
+String getAutonomProportionalSignature(const String & channel_str, JsonVariant & json_variant)
+{
+    #ifdef INCLUDE_PROPORTIONAL
+    if (autonomTaskManager.isProportionalActive())
+    {
+        return autonomTaskManager.proportionalGetSignature(channel_str, json_variant);
+    }
+    else
+    {
+        return "proportional not active";
+    }
+    
+    #else
+
+    return "proportional is not built in currrent module";
+
+    #endif // INCLUDE_PROPORTIONAL
+}
+
 String actionAutonomZero2tenCalibrateInput(const String & channel_str, const String & value_str)
 {
     #ifdef INCLUDE_ZERO2TEN
@@ -1714,6 +1801,26 @@ String actionAutonomZero2tenOutput(const String & channel_str, const String & va
     #endif // INCLUDE_ZERO2TEN
 }
 
+void actionAutonomZero2tenOutputBatch(const std::vector<std::pair<String, String>> & channel_values, 
+                                      std::vector<String> & results)
+{
+    #ifdef INCLUDE_ZERO2TEN
+    if (autonomTaskManager.isZero2tenActive())
+    {
+        autonomTaskManager.zero2tenOutputBatch(channel_values, results);
+    }
+    else
+    {
+        results.assign(channel_values.size(), String("zero2ten not active"));
+    }
+    
+    #else
+
+    results.assign(channel_values.size(), String("zero2ten is not built in currrent module"));
+
+    #endif // INCLUDE_ZERO2TEN
+}
+
 String actionAutonomMainsProbeCalibrateV(const String & addr_str, const String & channel_str, const String & value_str)
 {
     #ifdef INCLUDE_MAINSPROBE
@@ -1915,6 +2022,434 @@ String actionAutonomMultiSetVolatile(const JsonVariant & json)
     #endif // INCLUDE_MULTI
 }
 
+// actions by name, for the batch route and the MQTT transport; the arguments are strings as in the query
+// of the REST routes
+
+static String arg_of(const JsonVariant & params, const char * name)
+{
+    JsonVariant v = params[name];
+
+    if (v.isNull())
+    {
+        return String();
+    }
+
+    if (v.is<const char*>())
+    {
+        return String(v.as<const char*>());
+    }
+
+    String s;
+    serializeJson(v, s);
+    return s;
+}
+
+static const uint8_t MAX_ACTION_PARAMS = 3;
+
+typedef String (*AutonomActionCall)(const JsonVariant & params, String & out);
+
+// several actions of the same kind in a row under one lock of the module, one result per params
+
+typedef void (*AutonomActionBatchCall)(const std::vector<JsonVariant> & params, std::vector<String> & results);
+
+struct AutonomAction
+{
+    const char * name;
+    FunctionType function;
+    const char * required[MAX_ACTION_PARAMS];
+    uint8_t result_kind;
+    AutonomActionCall call;
+    AutonomActionBatchCall batch_call;    // NULL if the module has no batch
+};
+
+static String call_keybox_actuate(const JsonVariant & p, String &) { return actionAutonomKeyboxActuate(arg_of(p, "channel")); }
+static String call_rfid_lock_unlock(const JsonVariant & p, String &) { return actionAutonomRfidLockUnlock(arg_of(p, "lock_channel")); }
+static String call_proportional_calibrate(const JsonVariant & p, String &) { return actionAutonomProportionalCalibrate(arg_of(p, "channel")); }
+static String call_proportional_actuate(const JsonVariant & p, String &) { return actionAutonomProportionalActuate(arg_of(p, "channel"), arg_of(p, "value"), arg_of(p, "ref")); }
+static String call_zero2ten_input(const JsonVariant & p, String & out) { return actionAutonomZero2tenInput(arg_of(p, "channel"), out); }
+static String call_zero2ten_output(const JsonVariant & p, String &) { return actionAutonomZero2tenOutput(arg_of(p, "channel"), arg_of(p, "value")); }
+static String call_mains_probe_input_v(const JsonVariant & p, String & out) { return actionAutonomMainsProbeInputV(arg_of(p, "addr"), arg_of(p, "channel"), out); }
+static String call_mains_probe_input_a_high(const JsonVariant & p, String & out) { return actionAutonomMainsProbeInputAHigh(arg_of(p, "addr"), arg_of(p, "channel"), out); }
+static String call_mains_probe_input_a_low(const JsonVariant & p, String & out) { return actionAutonomMainsProbeInputALow(arg_of(p, "channel"), out); }
+static String call_multi_uart_command(const JsonVariant & p, String & out) { return actionAutonomMultiUartCommand(arg_of(p, "command"), out); }
+static String call_multi_audio_control(const JsonVariant & p, String & out) { return actionAutonomMultiAudioControl(arg_of(p, "source"), arg_of(p, "channel"), arg_of(p, "volume"), out); }
+
+static void batch_proportional_actuate(const std::vector<JsonVariant> & params, std::vector<String> & results)
+{
+    std::vector<std::vector<String>> channel_value_refs;
+
+    for (const JsonVariant & p : params)
+    {
+        channel_value_refs.push_back({arg_of(p, "channel"), arg_of(p, "value"), arg_of(p, "ref")});
+    }
+
+    actionAutonomProportionalActuateBatch(channel_value_refs, results);
+}
+
+static void batch_zero2ten_output(const std::vector<JsonVariant> & params, std::vector<String> & results)
+{
+    std::vector<std::pair<String, String>> channel_values;
+
+    for (const JsonVariant & p : params)
+    {
+        channel_values.push_back(std::make_pair(arg_of(p, "channel"), arg_of(p, "value")));
+    }
+
+    actionAutonomZero2tenOutputBatch(channel_values, results);
+}
+
+static const AutonomAction autonom_actions[] =
+{
+    {"keybox/actuate", ftKeybox, {"channel"}, arkEmpty, call_keybox_actuate, NULL},
+    {"rfid-lock/unlock", ftRfidLock, {"lock_channel"}, arkEmpty, call_rfid_lock_unlock, NULL},
+    {"proportional/calibrate", ftProportional, {"channel"}, arkEmpty, call_proportional_calibrate, NULL},
+    {"proportional/actuate", ftProportional, {"channel", "value"}, arkEmpty, call_proportional_actuate, batch_proportional_actuate},
+    {"zero2ten/input", ftZero2ten, {"channel"}, arkValue, call_zero2ten_input, NULL},
+    {"zero2ten/output", ftZero2ten, {"channel", "value"}, arkEmpty, call_zero2ten_output, batch_zero2ten_output},
+    {"mains-probe/input_v", ftMainsProbe, {"channel"}, arkValue, call_mains_probe_input_v, NULL},
+    {"mains-probe/input_a_high", ftMainsProbe, {"channel"}, arkValue, call_mains_probe_input_a_high, NULL},
+    {"mains-probe/input_a_low", ftMainsProbe, {"channel"}, arkValue, call_mains_probe_input_a_low, NULL},
+    {"multi/uart_command", ftMulti, {"command"}, arkResponse, call_multi_uart_command, NULL},
+    {"multi/audio_control", ftMulti, {}, arkResponse, call_multi_audio_control, NULL}
+};
+
+static const AutonomAction * find_autonom_action(const String & action, const JsonVariant & params, String & r)
+{
+    for (size_t i=0; i<sizeof(autonom_actions)/sizeof(autonom_actions[0]); ++i)
+    {
+        if (action == autonom_actions[i].name)
+        {
+            const AutonomAction * a = & autonom_actions[i];
+
+            for (uint8_t j=0; j<MAX_ACTION_PARAMS && a->required[j] != NULL; ++j)
+            {
+                if (params[a->required[j]].isNull())
+                {
+                    r = String(a->required[j]) + " is missing";
+                    return NULL;
+                }
+            }
+
+            return a;
+        }
+    }
+
+    r = String("action ") + action + " is not known";
+    return NULL;
+}
+
+String actionAutonom(const String & action, const JsonVariant & params, String & out, uint8_t & result_kind)
+{
+    String r;
+    result_kind = arkEmpty;
+
+    const AutonomAction * a = find_autonom_action(action, params, r);
+
+    if (a != NULL)
+    {
+        r = a->call(params, out);
+        result_kind = a->result_kind;
+    }
+
+    return r;
+}
+
+// the entries of a batch; the workers of a parallel batch write only their own entries, the JSON result is
+// made by the caller from the groups that are done
+
+struct BatchEntry
+{
+    BatchEntry() : action(NULL), result_kind(arkEmpty), skipped(false) {}
+
+    const AutonomAction * action;   // NULL if the entry was refused
+    JsonVariant params;
+    String error;
+    String out;
+    uint8_t result_kind;
+    bool skipped;
+};
+
+struct BatchRun;
+
+struct BatchGroup
+{
+    BatchGroup() : run(NULL), stop_on_error(false), is_finished(true) {}
+
+    BatchRun * run;
+    std::vector<size_t> indices;    // in order, of the entries of this group
+    bool stop_on_error;
+    std::atomic<bool> is_finished;
+};
+
+// a batch lives on the heap with a reference for the caller and one for each worker, the last one out deletes
+// it: a worker the caller has given up on still has its entries and its params; the params are copied out of
+// the request, whose document goes with the request
+
+struct BatchRun
+{
+    BatchRun(size_t actions, size_t groups_size, size_t params_size) :
+        entries(actions), groups(groups_size), params(params_size), references(1) {}
+
+    std::vector<BatchEntry> entries;
+    std::vector<BatchGroup> groups;
+    DynamicJsonDocument params;
+    std::atomic<uint8_t> references;
+};
+
+static void release_batch_run(BatchRun * run)
+{
+    if (run->references.fetch_sub(1) == 1)
+    {
+        delete run;
+    }
+}
+
+static void run_batch_group(BatchGroup & group)
+{
+    std::vector<BatchEntry> & entries = group.run->entries;
+    bool failed = false;
+
+    for (size_t i=0; i<group.indices.size();)
+    {
+        BatchEntry & entry = entries[group.indices[i]];
+
+        if (entry.action == NULL || failed)
+        {
+            entry.skipped = entry.action != NULL;
+            failed = failed || group.stop_on_error;
+            ++i;
+            continue;
+        }
+
+        // a run of the same action goes to the module in one call when it can take a batch
+
+        size_t end = i + 1;
+
+        if (entry.action->batch_call != NULL)
+        {
+            while (end < group.indices.size() && entries[group.indices[end]].action == entry.action)
+            {
+                ++end;
+            }
+        }
+
+        if (end - i > 1)
+        {
+            std::vector<JsonVariant> params;
+            std::vector<String> results;
+
+            for (size_t j=i; j<end; ++j)
+            {
+                params.push_back(entries[group.indices[j]].params);
+            }
+
+            entry.action->batch_call(params, results);
+
+            // the module has done the whole run, for stop_on_error it is one step
+
+            for (size_t j=i; j<end; ++j)
+            {
+                BatchEntry & e = entries[group.indices[j]];
+
+                e.error = j-i < results.size() ? results[j-i] : String("no result");
+                e.result_kind = e.action->result_kind;
+                failed = failed || (e.error.length() > 0 && group.stop_on_error);
+            }
+        }
+        else
+        {
+            entry.error = entry.action->call(entry.params, entry.out);
+            entry.result_kind = entry.action->result_kind;
+            failed = entry.error.length() > 0 && group.stop_on_error;
+        }
+
+        i = end;
+    }
+}
+
+static void batch_group_task(void * parameter)
+{
+    BatchGroup * group = (BatchGroup *) parameter;
+    BatchRun * run = group->run;
+
+    run_batch_group(* group);
+    group->is_finished = true;
+    release_batch_run(run);
+    vTaskDelete(NULL);
+}
+
+String actionAutonomBatch(const JsonVariant & json, JsonVariant & result)
+{
+    // {"mode": "sequential"|"parallel", "stop_on_error": bool, "actions": [{"action": "..", "params": {..}}, ..]}
+    // or just the array of the actions
+
+    JsonArray actions_json = json.is<JsonArray>() ? json.as<JsonArray>() : json["actions"].as<JsonArray>();
+
+    if (actions_json.isNull())
+    {
+        return "actions is missing";
+    }
+
+    if (actions_json.size() > AUTONOM_BATCH_MAX_ACTIONS)
+    {
+        return String("at most ") + String(AUTONOM_BATCH_MAX_ACTIONS) + " actions in a batch";
+    }
+
+    String mode = json["mode"].isNull() ? String("sequential") : String(json["mode"].as<const char*>());
+
+    if (mode != "sequential" && mode != "parallel")
+    {
+        return String("mode ") + mode + " is not known";
+    }
+
+    bool stop_on_error = json["stop_on_error"].isNull() ? false : json["stop_on_error"].as<bool>();
+
+    TRACE("actionAutonomBatch %d actions, %s", (int) actions_json.size(), mode.c_str())
+
+    // sequential: one group in the order of the request; parallel: one group per function, each in its own
+    // order, the modules lock for themselves so that different functions do not wait for each other
+
+    BatchRun * run = new BatchRun(actions_json.size(), mode == "parallel" ? ftMulti + 1 : 1, actions_json.memoryUsage());
+    std::vector<BatchEntry> & entries = run->entries;
+    std::vector<BatchGroup> & groups = run->groups;
+    JsonArray params_json = run->params.to<JsonArray>();
+
+    for (size_t i=0; i<entries.size(); ++i)
+    {
+        JsonVariant action_json = actions_json[i];
+        const char * action = action_json["action"].as<const char*>();
+
+        entries[i].params = params_json.add();
+        entries[i].params.set(action_json["params"]);
+
+        if (action == NULL)
+        {
+            entries[i].error = "action is missing";
+        }
+        else
+        {
+            entries[i].action = find_autonom_action(action, entries[i].params, entries[i].error);
+        }
+    }
+
+    if (run->params.overflowed())
+    {
+        release_batch_run(run);
+        return "params of the actions do not fit";
+    }
+
+    for (size_t i=0; i<entries.size(); ++i)
+    {
+        size_t g = groups.size() == 1 || entries[i].action == NULL ? 0 : entries[i].action->function;
+        groups[g].indices.push_back(i);
+    }
+
+    for (BatchGroup & group : groups)
+    {
+        group.run = run;
+        group.stop_on_error = stop_on_error;
+    }
+
+    // the first group with work runs in this task, the others each in a worker of their own
+
+    unsigned long started = millis();
+    BatchGroup * own_group = NULL;
+
+    for (BatchGroup & group : groups)
+    {
+        if (group.indices.empty())
+        {
+            continue;
+        }
+
+        if (own_group == NULL)
+        {
+            own_group = & group;
+            continue;
+        }
+
+        group.is_finished = false;
+        run->references++;
+
+        if (xTaskCreate(batch_group_task, "autonom_batch", 4096, & group, 1, NULL) != pdPASS)
+        {
+            ERROR("failed to create batch worker task, running the group in the caller")
+            run->references--;
+            run_batch_group(group);
+            group.is_finished = true;
+        }
+    }
+
+    if (own_group != NULL)
+    {
+        run_batch_group(* own_group);
+    }
+
+    // the web server waits with us, a worker that is stuck in its module is left behind and its entries are
+    // reported as timed out; it finishes on its own and releases the batch
+
+    std::vector<bool> timed_out(entries.size(), false);
+
+    for (BatchGroup & group : groups)
+    {
+        while (group.is_finished == false && millis() - started < AUTONOM_BATCH_TIMEOUT_MS)
+        {
+            delay(10);
+        }
+
+        if (group.is_finished == false)
+        {
+            ERROR("batch worker not done in %d ms, %d actions timed out", (int) AUTONOM_BATCH_TIMEOUT_MS, (int) group.indices.size())
+
+            for (size_t i : group.indices)
+            {
+                timed_out[i] = true;
+            }
+        }
+    }
+
+    JsonArray results = result.createNestedArray("results");
+    size_t errors = 0;
+
+    for (size_t i=0; i<entries.size(); ++i)
+    {
+        const BatchEntry & entry = entries[i];
+        JsonObject result_json = results.createNestedObject();
+
+        result_json["action"] = actions_json[i]["action"];
+
+        // the entries of a worker that is not done are still its own, they are not read
+
+        if (timed_out[i])
+        {
+            result_json["error"] = "timed out";
+            errors++;
+        }
+        else if (entry.skipped)
+        {
+            result_json["skipped"] = true;
+        }
+        else if (entry.error.length() > 0)
+        {
+            result_json["error"] = entry.error;
+            errors++;
+        }
+        else if (entry.result_kind == arkValue)
+        {
+            result_json["value"] = entry.out;
+        }
+        else if (entry.result_kind == arkResponse)
+        {
+            result_json["response"] = entry.out;
+        }
+    }
+
+    result["errors"] = errors;
+    release_batch_run(run);
+
+    return String();
+}
+
 void getAutonom(JsonVariant & json)
 {
   TRACE("getAutonom")
@@ -1991,6 +2526,14 @@ void getAutonom(JsonVariant & json)
   #endif
 }
 
+// the functions that need the network for what they do; they are started after the hardware-only ones and
+// wait for beNetwork themselves before they connect anywhere
+
+static bool is_network_function(uint8_t ft)
+{
+    return ft == ftAudio || ft == ftMulti;
+}
+
 void restoreAutonom() 
 {
   TRACE("restoreAutonom")
@@ -2000,8 +2543,20 @@ void restoreAutonom()
   
   if (configVolume.read() == true)
   {
+    boot_stage("eeprom");
+
+    // stage 0 - hardware-only functions, their outputs are live before anything waits for the network;
+    // stage 1 - network functions
+
+    for (int stage=0; stage<2; ++stage)
+    {
       for (auto it = configVolume.blocks.begin(); it != configVolume.blocks.end(); ++it)
       {
+          if (is_network_function(it->first) != (stage == 1))
+          {
+              continue;
+          }
+
           const char * function_type_str = function_type_2_str((FunctionType) it->first);
           TRACE("Restoring from EEPROM config for function %s", function_type_str)
 
@@ -2166,10 +2721,15 @@ void restoreAutonom()
                 TRACE("Unhandled config for function %s", function_type_str)
                 break;
           }
+
+          boot_stage(function_type_str);
       }
+    }
   }
   else
   {
       ERROR("Cannot read EEPROM image")
   }
+
+  boot_stage("autonom");
 }
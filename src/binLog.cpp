@@ -0,0 +1,209 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+
+#include <binLog.h>
+#include <binarySemaphore.h>
+#include <scheduler.h>
+#include <trace.h>
+
+static const char * module_names[lmCount] =
+    { "main", "www", "autonom", "keybox", "shower-guard", "rfid-lock", "proportional", "zero2ten", "mains-probe", "multi", "audio" };
+
+static const char * level_names[] = { "off", "error", "trace", "debug" };
+
+uint8_t log_ring_levels[lmCount] = { llDebug, llDebug, llDebug, llDebug, llDebug, llDebug, llDebug, llDebug, llDebug, llDebug, llDebug };
+
+typedef LogRing<LOG_RING_SLOTS> BinLogRing;
+
+static BinLogRing log_ring;
+static std::atomic<uint32_t> dropped[lmCount];
+
+void log_ring_push(uint8_t module, uint8_t level, const char * format, const LogArg * argv, uint8_t argc)
+{
+    if (log_ring.push(module, level, millis(), format, argv, argc) == false)
+    {
+        dropped[module].fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+String log_ring_set_level(const String & module_str, const String & level_str)
+{
+    int level = -1;
+
+    for (size_t i=0; i<sizeof(level_names)/sizeof(level_names[0]); ++i)
+    {
+        if (level_str == level_names[i])
+        {
+            level = int(i);
+            break;
+        }
+    }
+
+    if (level < 0)
+    {
+        return String("log level ") + level_str + " is not known";
+    }
+
+    bool found = false;
+
+    for (size_t i=0; i<lmCount; ++i)
+    {
+        if (module_str == "*" || module_str == module_names[i])
+        {
+            log_ring_levels[i] = uint8_t(level);
+            found = true;
+        }
+    }
+
+    if (found == false)
+    {
+        return String("log module ") + module_str + " is not known";
+    }
+
+    TRACE("log level of %s set to %s", module_str.c_str(), level_str.c_str())
+    return String();
+}
+
+static void get_log_ring_state(JsonVariant & json)
+{
+    json.createNestedObject("dropped");
+    JsonVariant dropped_json = json["dropped"];
+    json.createNestedObject("levels");
+    JsonVariant levels_json = json["levels"];
+
+    for (size_t i=0; i<lmCount; ++i)
+    {
+        uint32_t d = dropped[i].load(std::memory_order_relaxed);
+
+        if (d > 0)
+        {
+            dropped_json[module_names[i]] = d;
+        }
+
+        levels_json[module_names[i]] = level_names[log_ring_levels[i]];
+    }
+}
+
+// the ring has one consumer, the drain: records move from the ring into the history under the semaphore,
+// the scheduler job and the readers of /poplog take turns
+
+class LogHistory
+{
+public:
+
+    static_assert((LOG_HISTORY_SIZE & (LOG_HISTORY_SIZE - 1)) == 0, "the history size has to be a power of two");
+
+    LogHistory()
+    {
+        next = 0;
+        count = 0;
+        legacy_cursor = 0;
+    }
+
+    void start()
+    {
+        scheduler_add_interval("log_ring", LOG_RING_DRAIN_MS, drain_job_func, this);
+    }
+
+    void to_json(JsonVariant & json, uint32_t since, size_t max_records, size_t max_bytes)
+    {
+        Lock lock(semaphore);
+        drain();
+
+        // the sequence numbers of the ring have no gaps, a record that did not fit was never numbered
+
+        uint32_t oldest = next - count;
+        uint32_t from = since;
+
+        if (int32_t(since - next) > 0)
+        {
+            // a cursor from before a restart, the numbering started again
+
+            json["reset"] = true;
+            from = oldest;
+        }
+        else if (int32_t(since - oldest) < 0)
+        {
+            json.createNestedObject("overflow");
+            JsonVariant overflow = json["overflow"];
+            overflow["from"] = since;
+            overflow["lost"] = oldest - since;
+            from = oldest;
+        }
+
+        JsonArray records = json.createNestedArray("records");
+
+        char text[128];
+        uint32_t seq = from;
+
+        for (size_t i=0; seq != next && i < max_records && records.memoryUsage() < max_bytes; ++i, ++seq)
+        {
+            const BinLogRing::Record & record = history[seq & (LOG_HISTORY_SIZE - 1)];
+            BinLogRing::format(record, text, sizeof(text));
+
+            JsonObject record_json = records.createNestedObject();
+
+            record_json["seq"] = record.seq;
+            record_json["millis"] = record.millis;
+            record_json["module"] = record.module < lmCount ? module_names[record.module] : "<unknown>";
+            record_json["level"] = level_names[record.level <= llDebug ? record.level : llOff];
+            record_json["text"] = String(text);
+        }
+
+        json["next"] = seq;
+        json["more"] = seq != next;
+    }
+
+    void pop_to_json(JsonVariant & json, size_t max_records, size_t max_bytes)
+    {
+        to_json(json, legacy_cursor, max_records, max_bytes);
+        legacy_cursor = json["next"].as<uint32_t>();
+    }
+
+protected:
+
+    static void drain_job_func(void * parameter)
+    {
+        LogHistory * _this = (LogHistory *) parameter;
+        Lock lock(_this->semaphore);
+        _this->drain();
+    }
+
+    void drain()
+    {
+        while (log_ring.pop(scratch))
+        {
+            history[scratch.seq & (LOG_HISTORY_SIZE - 1)] = scratch;
+            next = scratch.seq + 1;
+            count = count < LOG_HISTORY_SIZE ? count + 1 : LOG_HISTORY_SIZE;
+        }
+    }
+
+    BinarySemaphore semaphore;
+
+    BinLogRing::Record history[LOG_HISTORY_SIZE];
+    BinLogRing::Record scratch;
+    uint32_t next;      // sequence number of the next record
+    uint32_t count;     // records in the history
+    uint32_t legacy_cursor;
+};
+
+static LogHistory log_history;
+
+void start_log_ring()
+{
+    log_history.start();
+}
+
+void get_log_ring(JsonVariant & json, uint32_t since, size_t max_records, size_t max_bytes)
+{
+    log_history.to_json(json, since, max_records, max_bytes);
+    get_log_ring_state(json);
+}
+
+void pop_log_ring(JsonVariant & json, size_t max_records, size_t max_bytes)
+{
+    log_history.pop_to_json(json, max_records, max_bytes);
+    get_log_ring_state(json);
+}
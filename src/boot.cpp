@@ -0,0 +1,126 @@
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/event_groups.h>
+
+#include <boot.h>
+#include <trace.h>
+
+class Boot
+{
+public:
+
+    static const size_t MAX_STAGES = 24;
+
+    struct Stage
+    {
+        const char * name;
+        uint32_t millis;
+    };
+
+    Boot()
+    {
+        stage_count = 0;
+        mux = portMUX_INITIALIZER_UNLOCKED;
+        events = xEventGroupCreateStatic(&events_buffer);
+    }
+
+    void stage(const char * name)
+    {
+        // esp_timer counts from power-on, millis() only from the start of the arduino task
+
+        uint32_t _millis = uint32_t(esp_timer_get_time() / 1000);
+        bool r = false;
+
+        taskENTER_CRITICAL(&mux);
+
+        if (stage_count < MAX_STAGES)
+        {
+            stages[stage_count].name = name;
+            stages[stage_count].millis = _millis;
+            stage_count++;
+            r = true;
+        }
+
+        taskEXIT_CRITICAL(&mux);
+
+        if (r)
+        {
+            TRACE("boot stage %s done at %d ms", name, (int) _millis)
+        }
+    }
+
+    size_t get_stage_count()
+    {
+        taskENTER_CRITICAL(&mux);
+        size_t r = stage_count;
+        taskEXIT_CRITICAL(&mux);
+
+        return r;
+    }
+
+    bool get_stage(size_t index, const char * & name, uint32_t & _millis)
+    {
+        bool r = false;
+
+        taskENTER_CRITICAL(&mux);
+
+        if (index < stage_count)
+        {
+            name = stages[index].name;
+            _millis = stages[index].millis;
+            r = true;
+        }
+
+        taskEXIT_CRITICAL(&mux);
+
+        return r;
+    }
+
+    EventGroupHandle_t events;
+
+protected:
+
+    Stage stages[MAX_STAGES];
+    size_t stage_count;
+    portMUX_TYPE mux;
+
+    StaticEventGroup_t events_buffer;
+};
+
+static Boot boot;
+
+void boot_stage(const char * name)
+{
+    boot.stage(name);
+}
+
+size_t boot_get_stage_count()
+{
+    return boot.get_stage_count();
+}
+
+bool boot_get_stage(size_t index, const char * & name, uint32_t & _millis)
+{
+    return boot.get_stage(index, name, _millis);
+}
+
+void boot_signal(uint32_t events)
+{
+    xEventGroupSetBits(boot.events, (EventBits_t) events);
+}
+
+void boot_clear(uint32_t events)
+{
+    xEventGroupClearBits(boot.events, (EventBits_t) events);
+}
+
+bool boot_is(uint32_t events)
+{
+    return (xEventGroupGetBits(boot.events) & events) == events;
+}
+
+bool boot_wait(uint32_t events, uint32_t timeout_ms)
+{
+    EventBits_t bits = xEventGroupWaitBits(boot.events, (EventBits_t) events, pdFALSE, pdTRUE, pdMS_TO_TICKS(timeout_ms));
+    return (bits & events) == events;
+}
@@ -4,6 +4,7 @@
 #include <keybox.h>
 #include <gpio.h>
 #include <trace.h>
+#include <telemetry.h>
 #include <binarySemaphore.h>
 
 extern GpioHandler gpioHandler;
@@ -380,8 +381,29 @@ void KeyboxHandler::reconfigure(const KeyboxConfig &_config)
     if (!(config == _config))
     {
         TRACE("keybox_task: config changed")
+
+        // a change of the codes alone needs no hw, the buzzer, keypad and actuator tasks keep running
+
+        bool should_configure_buzzer = !(config.buzzer == _config.buzzer);
+        bool should_configure_keypad = !(config.keypad == _config.keypad);
+        bool should_configure_actuator = !(config.actuator == _config.actuator);
+
         config = _config;
-        configure_hw();
+
+        if (should_configure_buzzer)
+        {
+            configure_hw_buzzer(config.buzzer);
+        }
+
+        if (should_configure_keypad)
+        {
+            configure_hw_keypad(config.keypad);
+        }
+
+        if (should_configure_actuator)
+        {
+            configure_hw_actuator(config.actuator);
+        }
     }
 }
 
@@ -435,8 +457,12 @@ void KeyboxHandler::task(void *parameter)
     
     String keypad_input;
 
+    TelemetryLoop * loop_telemetry = telemetry_loop("keybox_task");
+
     while (_this->_is_active)
     {
+        telemetry_loop_mark(loop_telemetry);
+
         String keypad_queue = pop_keypad_queue();
 
         for (size_t i=0; i<keypad_queue.length(); ++i)
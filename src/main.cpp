@@ -8,6 +8,7 @@
 #include <esp_log.h>
 #include <esp_phy_init.h>
 #include <esp_wifi.h>
+#include <esp_sntp.h>
 
 #ifdef INCLUDE_ETHHUB
 #include <EthernetESP32.h>
@@ -21,6 +22,13 @@
 #include <www.h>
 #include <onboardLed.h>
 #include <trace.h>
+#include <boot.h>
+#include <telemetry.h>
+#include <binLog.h>
+
+#ifdef INCLUDE_MQTT
+#include <mqtt.h>
+#endif
 
 // note: something strange in handling header files that are included in the Esp32Utils library; the eeprom.h included in 
 // epromimage.cpp would not be found unless it is included and used (?) here, in the main project
@@ -89,7 +97,7 @@ void print_ntp_time()
 {
     struct tm _tm;
 
-    if (!getLocalTime(&_tm))
+    if (!getLocalTime(&_tm, 0))
     {
         ERROR("Failed to obtain time")
     }
@@ -99,6 +107,18 @@ void print_ntp_time()
     }
 }
 
+// runs in the lwip task when SNTP has set the clock, the boot does not wait for it
+
+void on_ntp_time_sync(struct timeval * tv)
+{
+    if (boot_is(beTime) == false)
+    {
+        boot_stage("ntp");
+        boot_signal(beTime);
+        print_ntp_time();
+    }
+}
+
 void setup()
 {
     #if CONFIG_IDF_TARGET_ESP32S3
@@ -132,6 +152,8 @@ void setup()
     EEPROM.begin(EEPROM_SIZE);
 
     //delay(2000);
+    start_telemetry();
+    start_log_ring();
     restoreAutonom();
     initKnownNetworks(knownNetworks);
     //delay(3000);
@@ -139,13 +161,25 @@ void setup()
     esp_wifi_set_max_tx_power(40);
 
     connectWifi();
+    boot_stage("wifi");
+    boot_signal(beNetwork);
+
+    // the time comes in the background, whatever needs it waits for beTime (or the scheduler for a valid time)
+
     TRACE("Fetching date and time from NTP ...")
+    sntp_set_time_sync_notification_cb(on_ntp_time_sync);
     configTime(gmtOffset_sec, daylightOffset_sec, ntpServer);
-    print_ntp_time();
     wwwSetupRouting();
     //TRACE("wwwSetupRouting OK")
     //delay(3000);
     wwwBegin();
+    boot_stage("www");
+    boot_signal(beWww);
+
+    #ifdef INCLUDE_MQTT
+    mqttBegin();
+    #endif
+
     //TRACE("wwwBegin OK")
     //delay(3000);
 
@@ -198,6 +232,7 @@ void setup()
 
     ArduinoOTA.begin();
     TRACE("WIFI MAC: %s", WiFi.macAddress().c_str())
+    boot_stage("setup");
 }
 
 
@@ -210,12 +245,18 @@ void loop()
 
     wwwHandleClient();
 
+    #ifdef INCLUDE_MQTT
+    mqttLoop();
+    #endif
+
     if (wifiHandler.isConnected() == false)
     {
         ERROR("Lost WIFI connection, retrying")
+        boot_clear(beNetwork);
         wifiHandler.disconnect();
         onboard_led_wifi_on = false;
         connectWifi();
+        boot_signal(beNetwork);
     }
     else
     {
@@ -4,13 +4,18 @@
 #include <autonom.h>
 #include <gpio.h>
 #include <binarySemaphore.h>
+#include <telemetry.h>
+#include <binLog.h>
 #include <mapTable.h>
+#include <gainLut.h>
+#include <gainTables.h>
+#include <rlsFit.h>
+#include <polyConverter.h>
 #include <Wire.h>
 #include <deque>
 #include <epromImage.h>
 #include <sstream>
 #include <i2c_utils.h>
-#include <PolyFitNasa.h>
 
 extern GpioHandler gpioHandler;
 
@@ -648,7 +653,11 @@ class MainsProbeHandler
 {
 public:
 
-    static const int DATA_EPROM_VERSION = 1;
+    static const int DATA_EPROM_VERSION = 2;
+
+    // version 1 has the points without the estimator state, the fit is redone from them on read
+
+    static const int DATA_EPROM_VERSION_POINTS_ONLY = 1;
 
     class InputChannelData
     {
@@ -660,6 +669,11 @@ public:
         //
         // this way even minimum calibration with one point will give a feasible result; the accuracy will increase
         // when adding new points both because of more input material and also because the order of polynom will increase
+        //
+        // the polynom is fitted by recursive least squares as the points come, so the amount of points is not limited;
+        // the mapping table only keeps the last X_2_Y_MAP_MAX_SIZE points for display, export and replacing a point
+        // with the same x. Points are weighted by 1/y^2, i.e. the fit minimizes the relative error, and a point far off
+        // the others is rejected
 
         static const uint8_t X_2_Y_MAP_MAX_SIZE = 5;
 
@@ -686,16 +700,22 @@ public:
             os.write((const char *)&addr, sizeof(addr));
             os.write((const char *)&index, sizeof(index));
             os.write((const char *)x_2_y_map, sizeof(x_2_y_map));
+            fit.to_eprom(os);
         }
 
-        bool from_eprom(std::istream &is)
+        bool from_eprom(std::istream &is, uint8_t eprom_version)
         {
             clear();
             is.read((char *)&addr, sizeof(addr));
             is.read((char *)&index, sizeof(index));
             is.read((char *)x_2_y_map, sizeof(x_2_y_map));
 
-            recalc_poly_beta();
+            if (eprom_version == DATA_EPROM_VERSION_POINTS_ONLY || fit.from_eprom(is) == false)
+            {
+                refit();
+            }
+
+            update_poly_beta();
 
             return !is.bad();
         }
@@ -732,6 +752,25 @@ public:
                     jsonArray.add(poly_beta[i]);
                 }    
             }
+
+            {json.createNestedObject("confidence");
+            JsonVariant jsonVariant = json["confidence"];
+
+            jsonVariant["points"] = fit.get_points();
+            jsonVariant["rejected"] = fit.get_rejected();
+            jsonVariant["order"] = fit.get_order();
+            jsonVariant["rms"] = fit.get_rms();
+
+            double beta_stderr[MAX_POLY_ORDER+1];
+            fit.get_beta_stderr(beta_stderr);
+
+            jsonVariant.createNestedArray("beta_stderr");
+            JsonArray jsonArray = jsonVariant["beta_stderr"];
+
+            for (size_t i=0;i<MAX_POLY_ORDER+1;++i)
+            {
+                jsonArray.add(beta_stderr[i]);
+            }}
         }
 
         bool from_json(const JsonVariant & json)
@@ -802,7 +841,8 @@ public:
                     }
 
                     sort_x_2_y_map();
-                    recalc_poly_beta();
+                    refit();
+                    update_poly_beta();
                 }
             }
             else
@@ -850,6 +890,7 @@ public:
         void uncalibrate()
         {
             uncalibrate(& (x_2_y_map[0][0]));
+            fit.clear();
             clear_poly_beta();
         }
 
@@ -861,11 +902,16 @@ public:
             }
         }
 
-        void add_calibration_point(float x, float y)
+        static double weight(float y)
+        {
+            return y != 0 ? 1. / (double(y) * double(y)) : 1.;
+        }
+
+        String add_calibration_point(float x, float y)
         {
             if (x <= 0)
             {
-                return;
+                return String("calibration point x=") + String(x, 3) + " should be > 0";
             }
 
             // first try to find a point with the same x, if found - replace
@@ -874,12 +920,32 @@ public:
             {
                 if (x_2_y_map[i][0] == x)
                 {
-                    x_2_y_map[i][1] = y;
-                    recalc_poly_beta();
-                    return;
+                    if (fit.remove(x, x_2_y_map[i][1], weight(x_2_y_map[i][1])))
+                    {
+                        fit.add(x, y, weight(y), false);
+                        x_2_y_map[i][1] = y;
+                    }
+                    else
+                    {
+                        // too few points to take one out, all of them are in the mapping table then
+
+                        x_2_y_map[i][1] = y;
+                        refit();
+                    }
+
+                    update_poly_beta();
+                    return String();
                 }
             }
 
+            if (fit.add(x, y, weight(y)) == RlsPolyFit::rRejected)
+            {
+                return String("calibration point x=") + String(x, 3) + ", y=" + String(y, 3) + " is too far off the fit (" + 
+                       String(fit.calc(x), 3) + "), rejected";
+            }
+
+            update_poly_beta();
+
             // then try to find an empty cell 
 
             for (size_t i=0;i<X_2_Y_MAP_MAX_SIZE;++i)
@@ -889,12 +955,11 @@ public:
                     x_2_y_map[i][0] = x;
                     x_2_y_map[i][1] = y;
                     sort_x_2_y_map();
-                    recalc_poly_beta();
-                    return;
+                    return String();
                 }
             }
 
-            // if no empty cells left - replace a cell with the closest x value
+            // if no empty cells left - replace a cell with the closest x value; the point it held stays in the fit
 
             float delta_x = 0;
             size_t delta_i = -1;
@@ -916,9 +981,10 @@ public:
             {
                 x_2_y_map[delta_i][0] = x;
                 x_2_y_map[delta_i][1] = y;
-                // sort shouldn't be needed as well?
+                sort_x_2_y_map();
             }
-            recalc_poly_beta();
+
+            return String();
         }
 
         void sort_x_2_y_map()
@@ -979,44 +1045,33 @@ public:
             return c;
         }
 
-        void recalc_poly_beta()
-        {
-            clear_poly_beta();
+        // the fit from the points in the mapping table only, where the points are all that is known (import, replacing
+        // one of few points, a damaged fit in eprom)
 
-            size_t n = get_num_calibration_points(); 
+        void refit()
+        {
+            fit.clear();
 
-            if (n == 0)
+            for (size_t i=0;i<X_2_Y_MAP_MAX_SIZE;++i)
             {
-                return;
+                if (x_2_y_map[i][0] > 0)
+                {
+                    fit.add(x_2_y_map[i][0], x_2_y_map[i][1], weight(x_2_y_map[i][1]), false);
+                }
             }
+        }
 
-            _poly_order = n-1;
+        void update_poly_beta()
+        {
+            clear_poly_beta();
 
-            if (_poly_order > MAX_POLY_ORDER)
+            if (fit.is_empty())
             {
-                _poly_order = MAX_POLY_ORDER;
+                return;
             }
 
-            double x[X_2_Y_MAP_MAX_SIZE];
-            double y[X_2_Y_MAP_MAX_SIZE];
-
-            if (_poly_order == 0)
-            {
-                x[0] = 0;
-                y[0] = 0;    
-                x[1] = x_2_y_map[1][0];
-                y[1] = x_2_y_map[1][1];
-            }
-            else
-            {
-                for (size_t i=0;i<n; ++i)
-                {
-                    x[i] = x_2_y_map[i][0];
-                    y[i] = x_2_y_map[i][1];
-                }
-            }
-    
-            PolyFitEasy(x, y, n, _poly_order, poly_beta);
+            fit.get_beta(poly_beta);
+            _poly_order = fit.get_order();
             _has_poly_beta = true;
         }
 
@@ -1025,53 +1080,24 @@ public:
             return _has_poly_beta;
         }
 
-        float poly_calc(float x) const 
-        {
-            if (x == 0.)
-            {
-                return 0.;
-            }
-
-            if (x_2_y_map[0][0] > 0. && x < x_2_y_map[0][0])
-            {
-               // if x is less than the first point in the mapping table - do a local linear approximation between [0,0]
-               // and the first point in the mapping table
-
-               // this is due to the fact that beginning of the range (most for input_v, less for input_a_high and even less for input_a_low)
-               // is more non-linear than the rest of the range due to schematics; artificially including point [0,0] will do more harm
-               // to the higher end of the range
+        // the converter for the reads: the calibration if there is one, otherwise the default from config; rebuilt
+        // by the handler under its semaphore on any change of either, the reads convert under the same semaphore
 
-               return (x * x_2_y_map[0][1]) / x_2_y_map[0][0];
-            }
+        bool update_converter(const std::vector<float> * default_poly_beta)
+        {
+            PolyConverter _converter;
 
             if (_has_poly_beta == true)
             {
-                return (float) calculatePoly(x, poly_beta, _poly_order);
+                _converter.init(poly_beta, _poly_order+1, x_2_y_map[0][0], x_2_y_map[0][1]);
             }
-            return 0.;
-        }
-
-        static float poly_calc(float x, const std::vector<float> & _poly_beta) 
-        {
-            if (x == 0.)
+            else if (default_poly_beta != NULL && default_poly_beta->size() > 1)
             {
-                return 0.;
+                _converter.init(default_poly_beta->data(), default_poly_beta->size());
             }
 
-            if (_poly_beta.size() >= 2)  // it has to be at least linear function, 0 coefficient first
-            {
-                double * __poly_beta = new double[_poly_beta.size()];
-
-                for (size_t i=0; i<_poly_beta.size(); ++i)
-                {
-                    __poly_beta[i] = _poly_beta[i];
-                }
-                
-                float r = (float) calculatePoly(x, __poly_beta, _poly_beta.size()-1);
-                delete __poly_beta;
-                return r;
-            }
-            return 0.;
+            converter = _converter;
+            return _converter.is_valid() || (default_poly_beta == NULL || default_poly_beta->size() <= 1);
         }
 
         uint8_t addr;  // not used for input_a_low
@@ -1085,6 +1111,9 @@ public:
         double poly_beta[MAX_POLY_ORDER+1];
         bool _has_poly_beta;
         int _poly_order;
+
+        RlsPolyFit fit;
+        PolyConverter converter;
     };
 
     class AppletHandler
@@ -1114,32 +1143,11 @@ public:
         _is_active = false;
         _is_finished = true;
 
-        // * input gain is what the measured value is multiplied with to get the final result
-
-        const float input_v_gain_function[] =
-        {
-            1, 1,
-            2, 1,
-            3, 1
-        };
-
-        const float input_a_high_gain_function[] =
-        {
-            1, 1,
-            2, 1,
-            3, 1
-        };
-
-        const float input_a_low_gain_function[] =
-        {
-            1, 1,
-            2, 1,
-            3, 1
-        };
+        // * input gain is what the measured value is multiplied with to get the final result (gainTables.h)
 
-        input_v_gain_map_table.init_table(input_v_gain_function, (sizeof(input_v_gain_function)/sizeof(float))/2);
-        input_a_high_gain_map_table.init_table(input_a_high_gain_function, (sizeof(input_a_high_gain_function)/sizeof(float))/2);
-        input_a_low_gain_map_table.init_table(input_a_low_gain_function, (sizeof(input_a_low_gain_function)/sizeof(float))/2);
+        input_v_gain_lut.init(mains_probe_input_v_gain_function, GAIN_FUNCTION_POINTS(mains_probe_input_v_gain_function));
+        input_a_high_gain_lut.init(mains_probe_input_a_high_gain_function, GAIN_FUNCTION_POINTS(mains_probe_input_a_high_gain_function));
+        input_a_low_gain_lut.init(mains_probe_input_a_low_gain_function, GAIN_FUNCTION_POINTS(mains_probe_input_a_low_gain_function));
 
         two_wire = &Wire;
     }
@@ -1210,6 +1218,7 @@ protected:
     void configure_i2c();
     void configure_channels();
     void configure_applets();
+    void update_converters();
 
     String calibrate_ina3221(MainsProbeConfig::InputWhat iw, uint8_t addr, size_t channel, float value);
     String input_ina3221(MainsProbeConfig::InputWhat iw, uint8_t addr, size_t channel, float & value, bool no_trace = false, float * raw_voltage = NULL);
@@ -1234,9 +1243,9 @@ protected:
     bool _is_active;
     bool _is_finished;
 
-    MapTable input_v_gain_map_table;
-    MapTable input_a_high_gain_map_table;
-    MapTable input_a_low_gain_map_table;
+    GainLut input_v_gain_lut;
+    GainLut input_a_high_gain_lut;
+    GainLut input_a_low_gain_lut;
 
     std::map<uint8_t, Ina3221*> input_v_ina3221;
     std::map<uint8_t, Ina3221*> input_a_high_ina3221;
@@ -1357,8 +1366,12 @@ void MainsProbeHandler::task(void *parameter)
     uint32_t last_i2c_scan_millis = 0;
     const uint32_t I2C_SCAN_INTERVAL_MILLIS = 10000; // 10 minutes (seconds)
 
+    TelemetryLoop * loop_telemetry = telemetry_loop("mains_probe_task");
+
     while (_this->_is_active)
     {
+        telemetry_loop_mark(loop_telemetry);
+
         unsigned long now_millis = millis();
 
         if (now_millis < last_save_data_millis || 
@@ -1647,11 +1660,73 @@ void MainsProbeHandler::configure_channels()
         analogSetPinAttenuation(it->gpio, (adc_attenuation_t)it->atten);
     }
 
+    update_converters();
+
     _data_needs_save = true;
 
     TRACE("configure channels done")
 }
 
+// under the semaphore
+
+void MainsProbeHandler::update_converters()
+{
+    for (auto it=input_v_channel_data.begin(); it!=input_v_channel_data.end(); ++it)
+    {
+        const std::vector<float> * default_poly_beta = NULL;
+
+        for (auto jt=config.input_v.begin(); jt!=config.input_v.end(); ++jt)
+        {
+            for (auto xt=jt->channels.begin(); xt!=jt->channels.end(); ++xt)
+            {
+                if (jt->addr == it->addr && xt->channel == it->index)
+                {
+                    default_poly_beta = & xt->default_poly_beta;
+                }
+            }
+        }
+
+        if (it->update_converter(default_poly_beta) == false)
+        {
+            ERROR("input V addr 0x%02x channel %d, default_poly_beta has more than %d coefficients", (int) it->addr, (int) it->index,
+                  (int) PolyConverter::MAX_ORDER+1)
+        }
+    }
+
+    for (auto it=input_a_high_channel_data.begin(); it!=input_a_high_channel_data.end(); ++it)
+    {
+        const std::vector<float> * default_poly_beta = NULL;
+
+        for (auto jt=config.input_a_high.begin(); jt!=config.input_a_high.end(); ++jt)
+        {
+            for (auto xt=jt->channels.begin(); xt!=jt->channels.end(); ++xt)
+            {
+                if (jt->addr == it->addr && xt->channel == it->index)
+                {
+                    default_poly_beta = & xt->default_poly_beta;
+                }
+            }
+        }
+
+        if (it->update_converter(default_poly_beta) == false)
+        {
+            ERROR("input A-High addr 0x%02x channel %d, default_poly_beta has more than %d coefficients", (int) it->addr, (int) it->index,
+                  (int) PolyConverter::MAX_ORDER+1)
+        }
+    }
+
+    for (size_t i=0; i<input_a_low_channel_data.size(); ++i)
+    {
+        const std::vector<float> * default_poly_beta = i < config.input_a_low_channels.size() ? 
+                                                       & config.input_a_low_channels[i].default_poly_beta : NULL;
+
+        if (input_a_low_channel_data[i].update_converter(default_poly_beta) == false)
+        {
+            ERROR("input A-Low channel %d, default_poly_beta has more than %d coefficients", (int) i, (int) PolyConverter::MAX_ORDER+1)
+        }
+    }
+}
+
 void MainsProbeHandler::configure_applets()
 {    
     TRACE("configure_applets")
@@ -1773,13 +1848,16 @@ String MainsProbeHandler::calibrate_ina3221(MainsProbeConfig::InputWhat iw, uint
                 if (jt != ina3221_map->end())
                 {
                     float x = jt->second->read_voltage(channel);
-                    it->add_calibration_point(x, value);
-
-                    TRACE("Added calibration point for %s addr 0x%02x channel %d: x=%.2f, y=%.2f", iw_text1, (int) addr, (int) channel, x, value)
-                    
-                    it->debug_x_2_y_map();
+                    r = it->add_calibration_point(x, value);
+                    update_converters();
+                    _data_needs_save = true;  // also keeps the count of rejected points
 
-                    _data_needs_save = true;
+                    if (r.isEmpty())
+                    {
+                        TRACE("Added calibration point for %s addr 0x%02x channel %d: x=%.2f, y=%.2f", iw_text1, (int) addr, (int) channel, x, value)
+                        
+                        it->debug_x_2_y_map();
+                    }
                 }
                 else
                 {
@@ -1834,13 +1912,16 @@ String MainsProbeHandler::calibrate_a_low(size_t channel, float value)
         
             float x = MainsProbeConfig::InputChannel::adc_value_2_mv(sample_average, atten);
         
-            input_a_low_channel_data[channel].add_calibration_point(x, value);
-
-            TRACE("Added calibration point for input A-Low channel %d: x=%.2f, y=%.2f", (int) channel, x, value)
-            
-            input_a_low_channel_data[channel].debug_x_2_y_map();
+            r = input_a_low_channel_data[channel].add_calibration_point(x, value);
+            update_converters();
+            _data_needs_save = true;  // also keeps the count of rejected points
 
-            _data_needs_save = true;
+            if (r.isEmpty())
+            {
+                TRACE("Added calibration point for input A-Low channel %d: x=%.2f, y=%.2f", (int) channel, x, value)
+                
+                input_a_low_channel_data[channel].debug_x_2_y_map();
+            }
 }
         else
         {
@@ -1872,6 +1953,7 @@ String MainsProbeHandler::uncalibrate_v(uint8_t addr, size_t channel)
         if (it->addr == addr && it->index == channel)
         {
             it->uncalibrate();
+            update_converters();
             return r;
         }
     }
@@ -1894,6 +1976,7 @@ String MainsProbeHandler::uncalibrate_a_high(uint8_t addr, size_t channel)
         if (it->addr == addr && it->index == channel)
         {
             it->uncalibrate();
+            update_converters();
             return r;
         }
     }
@@ -1914,6 +1997,7 @@ String MainsProbeHandler::uncalibrate_a_low(size_t channel)
     if (channel < input_a_low_channel_data.size())
     {
         input_a_low_channel_data[channel].uncalibrate();
+        update_converters();
     }
     else
     {
@@ -1930,7 +2014,6 @@ String MainsProbeHandler::input_ina3221(MainsProbeConfig::InputWhat iw, uint8_t
     const char * iw_text2 = NULL;
     std::map<uint8_t, Ina3221*> * ina3221_map = NULL;
     std::vector<InputChannelData> * channel_data_vector = NULL;
-    std::vector<MainsProbeConfig::Ina3221Config> * ina3221_config_vector = NULL;
     std::vector<MainsProbeStatus::Channel> * channel_status_vector = NULL;
 
     switch(iw)
@@ -1941,7 +2024,6 @@ String MainsProbeHandler::input_ina3221(MainsProbeConfig::InputWhat iw, uint8_t
             iw_text2 = "input_v";
             ina3221_map = & input_v_ina3221;
             channel_data_vector = & input_v_channel_data;
-            ina3221_config_vector = & config.input_v;
             channel_status_vector = & status.input_v_channels;
             break;
 
@@ -1951,7 +2033,6 @@ String MainsProbeHandler::input_ina3221(MainsProbeConfig::InputWhat iw, uint8_t
             iw_text2 = "input_a_high";
             ina3221_map = & input_a_high_ina3221;
             channel_data_vector = & input_a_high_channel_data;
-            ina3221_config_vector = & config.input_a_high;
             channel_status_vector = & status.input_a_high_channels;
             break;
 
@@ -1961,7 +2042,7 @@ String MainsProbeHandler::input_ina3221(MainsProbeConfig::InputWhat iw, uint8_t
 
     if (no_trace == false)
     {
-        TRACE("getting %s for addr 0x%02x, channel %d", iw_text1, (int) addr, (int) channel)
+        LOG_TRACE(lmMainsProbe, "getting %s for addr 0x%02x, channel %d", iw_text1, (int) addr, (int) channel)
     }
 
     value = 0;
@@ -1986,7 +2067,7 @@ String MainsProbeHandler::input_ina3221(MainsProbeConfig::InputWhat iw, uint8_t
             
             if (no_trace == false)
             {
-                DEBUG("%s_raw[addr=0x%02x][%d]=%f V", iw_text2, (int) addr, (int) channel, raw_voltage)
+                LOG_DEBUG(lmMainsProbe, "%s_raw[addr=0x%02x][%d]=%f V", iw_text2, (int) addr, (int) channel, raw_voltage)
             }
         }
         else
@@ -2001,73 +2082,26 @@ String MainsProbeHandler::input_ina3221(MainsProbeConfig::InputWhat iw, uint8_t
 
     if (r.length() == 0)
     {
-        bool found_and_set = false;
-
-        /*
-        if (raw_voltage == 0)
-        {
-            value = 0;
-            found_and_set = true;
-        }*/
+        // calibration data or default_poly_beta from config, whichever applies, is compiled into the converter
 
-        // first try poly calc from channel data (will work if has enough calibration points)
+        bool found_and_set = false;
 
-        if (found_and_set == false)  
+        for (auto it=channel_data_vector->begin(); it!=channel_data_vector->end(); ++it)
         {
-            for (auto it=channel_data_vector->begin(); it!=channel_data_vector->end(); ++it)
+            if (it->addr == addr && it->index == channel)
             {
-                if (it->addr == addr && it->index == channel)
-                {
-                    if (it->has_poly_beta() == true)
-                    {
-                        value = (float) it->poly_calc(raw_voltage);
-                        
-                        if (no_trace == false)
-                        {
-                            DEBUG("%s, value for [addr=0x%02x][%d] calculated via calibration data %f", iw_text1, (int) addr, (int) channel, value)
-                            //DEBUG("poly_beta [addr=0x%02x][%d]:", (int) addr, (int) channel)
-                            //it->debug_poly_beta();
-                        }
-
-                        found_and_set = true;
-                        break;
-                    }
-                }
+                found_and_set = it->converter.convert(raw_voltage, value);
+                break;
             }
         }
 
-        // otherwise - try default_poly_beta from config
-        
-        if (found_and_set == false)  
+        if (found_and_set == false)
         {
-            for (auto it=ina3221_config_vector->begin(); it!=ina3221_config_vector->end(); ++it)
-            {
-                if (it->addr == addr)
-                {
-                    for (auto jt=it->channels.begin(); jt!=it->channels.end(); ++jt)
-                    {
-                        if (jt->channel == channel)
-                        {
-                            if (jt->default_poly_beta.size() > 1) // at least a linear function
-                            {
-                                value = InputChannelData::poly_calc(raw_voltage,jt->default_poly_beta);
-
-                                if (no_trace == false)
-                                {
-                                    DEBUG("%s, value for [addr=0x%02x][%d] calculated via default_poly_beta %f", iw_text1, (int) addr, (int) channel, value)
-                                }
-
-                                found_and_set = true;
-                            }
-                        }
-                    }
-                }
-            }
-
-            if (found_and_set == false)
-            {
-                r = String(iw_text1) + " for address 0x" + String((int) addr, 16) + " channel " + String(channel) + " cannot be evaluated";
-            }
+            r = String(iw_text1) + " for address 0x" + String((int) addr, 16) + " channel " + String(channel) + " cannot be evaluated";
+        }
+        else if (no_trace == false)
+        {
+            LOG_DEBUG(lmMainsProbe, "%s, value for [addr=0x%02x][%d] calculated %f", iw_text1, (int) addr, (int) channel, value)
         }
     }
 
@@ -2104,7 +2138,7 @@ String MainsProbeHandler::input_a_low(size_t channel, float & value, bool no_tra
 {
     if (no_trace == false)
     {
-        TRACE("getting input A-Low of channel %d", (int) channel)
+        LOG_TRACE(lmMainsProbe, "getting input A-Low of channel %d", (int) channel)
     }
 
     String r;
@@ -2121,7 +2155,7 @@ String MainsProbeHandler::input_a_low(size_t channel, float & value, bool no_tra
 
         if (no_trace == false)
         {
-            DEBUG("analog read gpio %d sample average %lu based on %d samples", (int) gpio, sample_average, (int) sample_count)
+            LOG_DEBUG(lmMainsProbe, "analog read gpio %d sample average %lu based on %d samples", (int) gpio, sample_average, (int) sample_count)
         }
 
         float _value = MainsProbeConfig::InputChannel::adc_value_2_mv(sample_average, atten);
@@ -2133,60 +2167,18 @@ String MainsProbeHandler::input_a_low(size_t channel, float & value, bool no_tra
 
         if (no_trace == false)
         {
-            DEBUG("analog read mv %f", _value)
+            LOG_DEBUG(lmMainsProbe, "analog read mv %f", _value)
         }
         
-        if (r.length() == 0)
-        {
-            bool found_and_set = false;
-    
-            /*
-            if (raw_voltage == 0)
-            {
-                value = 0;
-                found_and_set = true;
-            }*/
-    
-            // first try poly calc from channel data (will work if has enough calibration points)
-    
-            if (found_and_set == false)  
-            {
-                if (input_a_low_channel_data[channel].has_poly_beta() == true)
-                {
-                    value = (float) input_a_low_channel_data[channel].poly_calc(_value);
-                            
-                    if (no_trace == false)
-                    {
-                        DEBUG("input A-Low, value for [%d] calculated via calibration data %f", (int) channel, value)
-                        //DEBUG("poly_beta [%d]:", (int) channel)
-                        //input_a_low_channel_data[channel].debug_poly_beta();
-                    }
+        // calibration data or default_poly_beta from config, whichever applies, is compiled into the converter
 
-                    found_and_set = true;
-                }
-            }
-    
-            // otherwise - try default_poly_beta from config
-            
-            if (found_and_set == false)  
-            {
-                if (config.input_a_low_channels[channel].default_poly_beta.size() > 1) // at least a linear function
-                {
-                    value = InputChannelData::poly_calc(_value,config.input_a_low_channels[channel].default_poly_beta);
-
-                    if (no_trace == false)
-                    {
-                        DEBUG("input A-Low, value for [%d] calculated via default_poly_beta %f", (int) channel, value)
-                    }
-
-                    found_and_set = true;
-                }
-    
-                if (found_and_set == false)
-                {
-                    r = String("input A-Low for channel ") + String(channel) + " cannot be evaluated";
-                }
-            }
+        if (input_a_low_channel_data[channel].converter.convert(_value, value) == false)
+        {
+            r = String("input A-Low for channel ") + String(channel) + " cannot be evaluated";
+        }
+        else if (no_trace == false)
+        {
+            LOG_DEBUG(lmMainsProbe, "input A-Low, value for [%d] calculated %f", (int) channel, value)
         }
     
         // update in status            
@@ -2341,8 +2333,8 @@ String MainsProbeHandler::import_calibration_data(const JsonVariant & json)
             }
         }
 
+        update_converters();
         _data_needs_save = true;
-        // TODO: recalculate interpolation coefficients
     }
 
     return r;
@@ -2401,7 +2393,7 @@ bool MainsProbeHandler::data_from_eprom(std::istream &is)
 
     DEBUG("MainsProbeHandler data_from_eprom")
 
-    if (eprom_version == DATA_EPROM_VERSION)
+    if (eprom_version == DATA_EPROM_VERSION || eprom_version == DATA_EPROM_VERSION_POINTS_ONLY)
     {
         DEBUG("Version match")
 
@@ -2418,7 +2410,7 @@ bool MainsProbeHandler::data_from_eprom(std::istream &is)
         {
             InputChannelData input_channel_data_item;
             
-            if (input_channel_data_item.from_eprom(is) == false)
+            if (input_channel_data_item.from_eprom(is, eprom_version) == false)
             {
                 ERROR("error reading input V channel data %d from eprom. corrupt?", (int) i)
                 return false;
@@ -2472,7 +2464,7 @@ bool MainsProbeHandler::data_from_eprom(std::istream &is)
         {
             InputChannelData input_channel_data_item;
             
-            if (input_channel_data_item.from_eprom(is) == false)
+            if (input_channel_data_item.from_eprom(is, eprom_version) == false)
             {
                 ERROR("error reading input A-HIGH channel data %d from eprom. corrupt?", (int) i)
                 return false;
@@ -2526,7 +2518,7 @@ bool MainsProbeHandler::data_from_eprom(std::istream &is)
         {
             InputChannelData input_channel_data_item;
             
-            if (input_channel_data_item.from_eprom(is) == false)
+            if (input_channel_data_item.from_eprom(is, eprom_version) == false)
             {
                 ERROR("error reading input A-Low channel data %d from eprom. corrupt?", (int) i)
                 return false;
@@ -2557,7 +2549,17 @@ bool MainsProbeHandler::data_from_eprom(std::istream &is)
             //status.input_a_low_channels[i].calibration_coefficient =  input_a_low_channel_data[i].calibration_coefficient; 
         }
 
+        update_converters();
+
         _data_needs_save = false;  // output(..) sets this to true, but we just read the values from eprom 
+
+        if (eprom_version == DATA_EPROM_VERSION_POINTS_ONLY)
+        {
+            // the calibration of a unit that was upgraded, the task saves it with the estimator state
+
+            TRACE("mains-probe data of version %d refitted from its points, will be saved as version %d", (int) eprom_version, (int) DATA_EPROM_VERSION)
+            _data_needs_save = true;
+        }
     }
     else
     {
@@ -0,0 +1,446 @@
+#ifdef INCLUDE_MQTT
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <WiFi.h>
+#include <PubSubClient.h>
+#include <map>
+#include <vector>
+#include <atomic>
+#include <time.h>
+
+#include <mqtt.h>
+#include <autonom.h>
+#include <boot.h>
+#include <trace.h>
+
+// FNV-1a of what is printed, to see whether a status has changed without keeping it
+
+class HashPrint : public Print
+{
+public:
+
+    HashPrint() : hash(2166136261u)
+    {
+    }
+
+    size_t write(uint8_t c) override
+    {
+        hash = (hash ^ c) * 16777619u;
+        return 1;
+    }
+
+    uint32_t hash;
+};
+
+class MqttTransport
+{
+public:
+
+    static const uint32_t MIN_RECONNECT_MS = 5000;
+    static const uint32_t MAX_RECONNECT_MS = 60000;
+    static const size_t STATUS_DOCUMENT_SIZE = 8192;
+
+    // the socket is handed between the loop and the connect task: only the connect task touches it while it is
+    // ssConnecting, only the loop otherwise
+
+    enum SocketState
+    {
+        ssIdle = 0,
+        ssConnecting = 1,
+        ssOpen = 2,
+        ssFailed = 3
+    };
+
+    MqttTransport() : client(wifi_client), status_document(STATUS_DOCUMENT_SIZE), action_document(1024), socket_state(ssIdle)
+    {
+        enabled = false;
+        connect_task_handle = NULL;
+        reconnect_ms = MIN_RECONNECT_MS;
+        last_connect_millis = 0;
+        last_status_millis = 0;
+        last_full_status_millis = 0;
+        connects = 0;
+        published = 0;
+        publish_failures = 0;
+        actions_handled = 0;
+        action_errors = 0;
+    }
+
+    void begin()
+    {
+        if (strlen(MQTT_BROKER_HOST) == 0)
+        {
+            TRACE("MQTT off, no MQTT_BROKER_HOST")
+            return;
+        }
+
+        uint8_t mac[6];
+        WiFi.macAddress(mac);
+
+        char id[24];
+        sprintf(id, "harvester-%02x%02x%02x%02x%02x%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+        client_id = id;
+        prefix = String(MQTT_TOPIC_PREFIX) + "/" + client_id;
+
+        client.setServer(MQTT_BROKER_HOST, MQTT_BROKER_PORT);
+        client.setBufferSize(MQTT_BUFFER_SIZE);
+        client.setSocketTimeout(2);     // the wait for CONNACK on an open socket blocks the REST requests meanwhile
+        client.setCallback(on_message);
+
+        xTaskCreate(
+            connect_task,           // Function that should be called
+            "mqtt_connect_task",    // Name of the task (for debugging)
+            3072,                   // Stack size (bytes)
+            this,                   // Parameter to pass
+            0,                      // Task priority
+            & connect_task_handle   // Task handle
+        );
+
+        enabled = true;
+
+        TRACE("MQTT client %s, broker %s:%d", client_id.c_str(), MQTT_BROKER_HOST, (int) MQTT_BROKER_PORT)
+    }
+
+    void loop()
+    {
+        if (enabled == false || boot_is(beNetwork) == false)
+        {
+            return;
+        }
+
+        if (is_connected() == false && connect() == false)
+        {
+            return;
+        }
+
+        client.loop();
+
+        uint32_t _millis = millis();
+
+        if (_millis - last_status_millis >= MQTT_STATUS_MIN_INTERVAL_MS)
+        {
+            last_status_millis = _millis;
+            publish_status();
+        }
+    }
+
+    void to_json(JsonVariant & json)
+    {
+        json["broker"] = MQTT_BROKER_HOST;
+        json["enabled"] = enabled;
+        json["client_id"] = client_id;
+        json["connected"] = is_connected();
+        json["state"] = client.state();
+        json["connects"] = connects;
+        json["published"] = published;
+        json["publish_failures"] = publish_failures;
+        json["actions"] = actions_handled;
+        json["action_errors"] = action_errors;
+    }
+
+protected:
+
+    static void connect_task(void * parameter);
+
+    // the client looks at the socket, which is not the business of this task while the connect task has it
+
+    bool is_connected()
+    {
+        return socket_state.load(std::memory_order_acquire) == ssIdle && client.connected();
+    }
+
+    // the socket is opened by the connect task, what is left here is the MQTT handshake on it; false until the
+    // client is connected
+
+    bool connect()
+    {
+        uint8_t state = socket_state.load(std::memory_order_acquire);
+
+        if (state == ssConnecting)
+        {
+            return false;
+        }
+
+        if (state == ssFailed)
+        {
+            socket_state.store(ssIdle, std::memory_order_relaxed);
+            return connect_failed("socket");
+        }
+
+        if (state == ssIdle)
+        {
+            uint32_t _millis = millis();
+
+            if (last_connect_millis != 0 && _millis - last_connect_millis < reconnect_ms)
+            {
+                return false;
+            }
+
+            last_connect_millis = _millis;
+
+            socket_state.store(ssConnecting, std::memory_order_release);
+            xTaskNotifyGive(connect_task_handle);
+            return false;
+        }
+
+        socket_state.store(ssIdle, std::memory_order_relaxed);
+
+        String online_topic = prefix + "/online";
+
+        // clean session false: the subscription and the QoS 1 actions queued while away survive a reconnect;
+        // the socket is open already, so the client does not connect it again
+
+        #ifdef MQTT_USER
+        bool r = client.connect(client_id.c_str(), MQTT_USER, MQTT_PASSWORD, online_topic.c_str(), 1, true, "false", false);
+        #else
+        bool r = client.connect(client_id.c_str(), NULL, NULL, online_topic.c_str(), 1, true, "false", false);
+        #endif
+
+        if (r == false)
+        {
+            return connect_failed("handshake");
+        }
+
+        TRACE("MQTT connected to %s", MQTT_BROKER_HOST)
+
+        connects++;
+        reconnect_ms = MIN_RECONNECT_MS;
+        client.publish(online_topic.c_str(), "true", true);
+        client.subscribe((prefix + "/action/#").c_str(), 1);
+
+        // the retained status may be stale after a break, all of it goes out again
+
+        status_hashes.clear();
+        last_full_status_millis = millis();
+        return true;
+    }
+
+    bool connect_failed(const char * stage)
+    {
+        ERROR("MQTT connect to %s failed (%s), state %d, retry in %d s", MQTT_BROKER_HOST, stage, client.state(), (int) (reconnect_ms / 1000))
+        reconnect_ms = reconnect_ms * 2 < MAX_RECONNECT_MS ? reconnect_ms * 2 : MAX_RECONNECT_MS;
+        return false;
+    }
+
+    // one publish per tick with the functions that have changed; all of them go out retained after a connect and
+    // every MQTT_STATUS_FULL_INTERVAL_MS, so that a late subscriber starts from a complete status
+
+    void publish_status()
+    {
+        status_document.clear();
+        JsonVariant json = status_document.as<JsonVariant>();
+        getAutonom(json);
+
+        uint32_t _millis = millis();
+        bool is_full = status_hashes.empty() || _millis - last_full_status_millis >= MQTT_STATUS_FULL_INTERVAL_MS;
+
+        std::vector<std::pair<const char *, uint32_t>> changed;
+        std::vector<const char *> unchanged;
+
+        for (JsonPair kv : status_document.as<JsonObject>())
+        {
+            const char * function = kv.key().c_str();
+
+            HashPrint hash_print;
+            serializeJson(kv.value(), hash_print);
+
+            auto it = status_hashes.find(function);
+
+            if (is_full == false && it != status_hashes.end() && it->second == hash_print.hash)
+            {
+                unchanged.push_back(function);
+            }
+            else
+            {
+                changed.push_back(std::make_pair(function, hash_print.hash));
+            }
+        }
+
+        if (changed.empty())
+        {
+            return;
+        }
+
+        // the keys stay valid, a removal in the document does not move its strings
+
+        for (const char * function : unchanged)
+        {
+            status_document.remove(function);
+        }
+
+        // streamed, the status may be larger than the buffer of the client
+
+        String topic = prefix + "/status";
+
+        if (client.beginPublish(topic.c_str(), measureJson(status_document), is_full) && serializeJson(status_document, client) > 0 &&
+            client.endPublish())
+        {
+            for (const auto & function_hash : changed)
+            {
+                status_hashes[function_hash.first] = function_hash.second;
+            }
+
+            if (is_full)
+            {
+                last_full_status_millis = _millis;
+            }
+
+            published++;
+        }
+        else
+        {
+            publish_failures++;
+        }
+    }
+
+    static void on_message(char * topic, uint8_t * payload, unsigned int length);
+
+    void handle_action(const String & topic, const uint8_t * payload, unsigned int length)
+    {
+        String action_path = topic.substring(prefix.length() + strlen("/action/"));
+        String result_topic = prefix + "/result/" + action_path;
+
+        action_document.clear();
+
+        // const input: the strings are copied, the buffer of the client is reused by the publish below
+
+        DeserializationError error;
+
+        if (length > 0)
+        {
+            error = deserializeJson(action_document, (const char *) payload, length);
+        }
+
+        JsonVariant args = action_document.as<JsonVariant>();
+
+        String r;
+        String out;
+        uint8_t result_kind = arkEmpty;
+
+        if (error)
+        {
+            r = String("payload is not JSON: ") + error.c_str();
+        }
+        else if (args["expires"].isNull() == false && boot_is(beTime) && time(NULL) > args["expires"].as<long>())
+        {
+            r = "action expired";
+        }
+        else
+        {
+            TRACE("MQTT action %s", action_path.c_str())
+            r = actionAutonom(action_path, args, out, result_kind);
+        }
+
+        actions_handled++;
+
+        StaticJsonDocument<512> result;
+
+        if (args["id"].isNull() == false)
+        {
+            result["id"] = args["id"];
+        }
+
+        if (r.length() > 0)
+        {
+            ERROR("MQTT action %s: %s", action_path.c_str(), r.c_str())
+            action_errors++;
+            result["error"] = r;
+        }
+        else if (result_kind == arkValue)
+        {
+            result["value"] = out;
+        }
+        else if (result_kind == arkResponse)
+        {
+            result["response"] = out;
+        }
+
+        String result_str;
+        serializeJson(result, result_str);
+
+        if (client.publish(result_topic.c_str(), result_str.c_str()))
+        {
+            published++;
+        }
+        else
+        {
+            publish_failures++;
+        }
+    }
+
+    WiFiClient wifi_client;
+    PubSubClient client;
+
+    bool enabled;
+    TaskHandle_t connect_task_handle;
+    std::atomic<uint8_t> socket_state;
+
+    String client_id;
+    String prefix;
+
+    uint32_t reconnect_ms;
+    uint32_t last_connect_millis;
+    uint32_t last_status_millis;
+    uint32_t last_full_status_millis;
+
+    DynamicJsonDocument status_document;    // allocated once, the status goes out every second
+    DynamicJsonDocument action_document;
+    std::map<String, uint32_t> status_hashes;
+
+    uint32_t connects;
+    uint32_t published;
+    uint32_t publish_failures;
+    uint32_t actions_handled;
+    uint32_t action_errors;
+};
+
+static MqttTransport mqttTransport;
+
+void MqttTransport::on_message(char * topic, uint8_t * payload, unsigned int length)
+{
+    mqttTransport.handle_action(String(topic), payload, length);
+}
+
+void MqttTransport::connect_task(void * parameter)
+{
+    MqttTransport * _this = (MqttTransport *) parameter;
+
+    TRACE("mqtt_connect_task started")
+
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        if (_this->socket_state.load(std::memory_order_acquire) != ssConnecting)
+        {
+            continue;
+        }
+
+        // the lookup of a name and the connect block up to their timeouts, here they hold up nothing else
+
+        uint32_t start_millis = millis();
+        bool r = WiFi.status() == WL_CONNECTED && _this->wifi_client.connect(MQTT_BROKER_HOST, MQTT_BROKER_PORT) == 1;
+
+        DEBUG("mqtt_connect_task: %s:%d %s in %d ms", MQTT_BROKER_HOST, (int) MQTT_BROKER_PORT, r ? "open" : "failed", (int) (millis() - start_millis))
+
+        _this->socket_state.store(r ? ssOpen : ssFailed, std::memory_order_release);
+    }
+}
+
+void mqttBegin()
+{
+    mqttTransport.begin();
+}
+
+void mqttLoop()
+{
+    mqttTransport.loop();
+}
+
+void getMqtt(JsonVariant & json)
+{
+    mqttTransport.to_json(json);
+}
+
+#endif // INCLUDE_MQTT
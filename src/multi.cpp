@@ -4,17 +4,25 @@
 #include <esp_task_wdt.h>
 #include <ArduinoJson.h>
 #include <Wire.h>
+#include <WiFi.h>
 #include <multi.h>
 #include <gpio.h>
 #include <trace.h>
+#include <telemetry.h>
+#include <binLog.h>
 #include <binarySemaphore.h>
 #include <esp_log.h>
 #include <time.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <scheduler.h>
+#include <boot.h>
 #include <i2c_utils.h>
 #include <at.h>
 #include <tda8425.h>
 #include <rda5807.h>
 #include <tm1638.h>
+#include <audioDsp.h>
 
 #define USE_HARDWARE_SERIAL
 
@@ -28,22 +36,29 @@
 #define AUDIO_RECONNECT_TIMEOUT  5000 // ms
 #define AUDIO_MAX_RECONNECT_ATTEMPTS  3
 
-// NOTE: has to overload new / delete to clean the memory because the Audio class (library)
-// DOES NOT INITIALIZES ITS MEMBER VARIABLES! thus relying on that it is created statically
-// in clean memory
+// NOTE: the Audio class (library) DOES NOT INITIALIZE ITS MEMBER VARIABLES! thus relying on that it is
+// created in clean memory, only this one is zeroed
 
-void* operator new(size_t size)
+class ZeroedAudio : public Audio
 {
-    void * m = calloc(size, 1);
-    return m;
-}
+public:
 
-void operator delete(void* m)
-{
-    if (m)
+    static void* operator new(size_t size)
+    {
+        return calloc(size, 1);
+    }
+
+    static void operator delete(void* m)
     {
         free(m);
     }
+};
+
+static void get_memory_status(MultiStatus::Memory & memory)
+{
+    memory.free_heap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    memory.min_free_heap = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    memory.largest_free_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
 }
 
 
@@ -1241,6 +1256,22 @@ public:
     static const size_t UART_READ_WAIT_MS = 10;
     static const size_t UART_POLL_INTERVAL_MS = 1000;
 
+    // volume fades are written to the sound hw by a dedicated task at most once per tick; the tick
+    // timer runs only while a fade is in progress
+
+    static const uint32_t RAMP_TICK_MS = 20;
+    static const uint32_t RAMP_IDLE_WAIT_MS = 1000;
+
+    // the hosts of the current www channel and of its neighbours are resolved ahead of a switch so that
+    // the connect finds them in the dns cache; refreshed well within typical ttls
+
+    static const uint32_t PREWARM_INTERVAL_MS = 120000;
+    static const uint32_t PREWARM_IDLE_WAIT_MS = 1000;
+
+    // a change of www channel is timed to its first decoded audio, the target is a switch within this
+
+    static const uint32_t SWITCH_TARGET_MS = 300;
+
     MultiHandler()
     {
         _is_active = false;
@@ -1248,8 +1279,12 @@ public:
         _audio_task_finished = true;
         _i2c_scan_task_finished = true;
         _ui_task_finished = true;
+        _ramp_task_finished = true;
+        _prewarm_task_finished = true;
         _should_reconnect_www = false;
         _reconnect_count = 0;
+        _is_switching = false;
+        switch_start_millis = 0;
 
         #ifdef USE_HARDWARE_SERIAL
         hardware_serial = NULL;
@@ -1266,6 +1301,15 @@ public:
         rda5807 = NULL;
         tm1638_bus = NULL;
         uism = NULL;
+
+        ramp_timer = NULL;
+        ramp_timer_running = false;
+        ramp_task_handle = NULL;
+        prewarm_task_handle = NULL;
+
+        dsp_cycles_per_sample = 0;
+
+        hour_shift_job = SCHEDULER_NO_JOB;
     }
 
     ~MultiHandler()
@@ -1309,6 +1353,14 @@ public:
             _status = status;
         }
 
+        {
+            Lock lock(ramp_semaphore);
+            _status.current_volume = volume_ramp.get_current();
+        }
+
+        _status.dsp_cycles_per_sample = dsp_cycles_per_sample;
+        get_memory_status(_status.memory);
+
         return _status;
     }
 
@@ -1334,16 +1386,75 @@ protected:
     static void audio_task(void *parameter);
     static void i2c_scan_task(void *parameter);
     static void ui_task(void *parameter);
+    static void ramp_task(void *parameter);
+    static void prewarm_task(void *parameter);
+    static void ramp_timer_callback(void *parameter);
+    static void hour_shift_job_func(void *parameter);
 
     bool audio_control(const String & source, const String & channel, const String & volume, String & response, String * error = NULL);
     bool audio_control(const AudioControlData &);
 
     String choose_url();
+    void prewarm_www();
     float choose_fm_freq();
+    int select_url_index(const MultiConfig::Service & service) const;
+    int select_fm_freq_index(const MultiConfig::Service & service) const;
+
+    // what a new config needs to be applied live, part by part; whatever is not in the plan keeps running
+    // untouched, the tasks are never stopped and the stream only reconnects if the url it plays has changed
+
+    struct ReconfigurePlan
+    {
+        ReconfigurePlan()
+        {
+            uart = false;
+            i2c = false;
+            bt = false;
+            fm = false;
+            audio_engine = false;
+            sound = false;
+            tm1638_bus = false;
+            ui = false;
+            fm_freq = false;
+            reconnect_www = false;
+        }
+
+        String as_string() const
+        {
+            String r;
+
+            r += uart ? " uart" : "";
+            r += i2c ? " i2c" : "";
+            r += bt ? " bt" : "";
+            r += fm ? " fm" : "";
+            r += audio_engine ? " audio_engine" : "";
+            r += sound ? " sound" : "";
+            r += tm1638_bus ? " tm1638_bus" : "";
+            r += ui ? " ui" : "";
+            r += fm_freq ? " fm_freq" : "";
+            r += reconnect_www ? " reconnect_www" : "";
+
+            return r.isEmpty() ? String("{}") : String("{") + r.substring(1) + "}";
+        }
+
+        bool uart;
+        bool i2c;
+        bool bt;
+        bool fm;
+        bool audio_engine;
+        bool sound;
+        bool tm1638_bus;
+        bool ui;
+        bool fm_freq;
+        bool reconnect_www;
+    };
+
+    ReconfigurePlan plan_reconfigure(const MultiConfig & from, const MultiConfig & to) const;
     uint8_t get_max_volume(bool trace=false) const;
     uint8_t get_volume() const;
 
     void commit_volume();
+    void commit_volume(uint8_t volume, uint32_t fade_ms, uint8_t fade_curve);
     void commit_fm_freq();
 
     BinarySemaphore semaphore;
@@ -1353,14 +1464,36 @@ protected:
     MultiConfig config;
     MultiStatus status;
     bool _should_reconnect_www;
+    volatile bool _is_switching;        // set with switch_start_millis under semaphore, cleared by the first audio
+    uint32_t switch_start_millis;
     int _reconnect_count;
     bool _is_active;
     bool _task_finished;
     bool _audio_task_finished;
     bool _i2c_scan_task_finished;
     bool _ui_task_finished;
+    bool _ramp_task_finished;
+    bool _prewarm_task_finished;
+
+    VolumeRamp volume_ramp;
+    BinarySemaphore ramp_semaphore;
+    esp_timer_handle_t ramp_timer;
+    bool ramp_timer_running;
+    TaskHandle_t ramp_task_handle;
+
+    // the hosts to resolve, handed from prewarm_www() to prewarm_task under semaphore
+
+    String prewarm_hosts[3];
+    TaskHandle_t prewarm_task_handle;
 
-    Audio * audio_engine;
+    // runs in audio_task inside audio_engine->loop(), i.e. with new_delete_semaphore taken
+
+    AudioDsp audio_dsp;
+    float dsp_cycles_per_sample;
+
+    SchedulerJobId hour_shift_job;
+
+    ZeroedAudio * audio_engine;
     
     #ifdef USE_HARDWARE_SERIAL
     HardwareSerial * hardware_serial;
@@ -1382,6 +1515,7 @@ protected:
 
     friend void audio_showstreamtitle(const char *info);
     friend void audio_bitrate(const char *info);
+    friend void audio_process_extern(int16_t * buff, uint16_t len, bool * continueI2S);
     friend bool multi_handler_uart_command_func(const String & command, AtResponse & response, String * error);
     friend String multi_uart_command(const String & command, String & response);
 };
@@ -1409,6 +1543,45 @@ void audio_bitrate(const char *info)
     handler.status.www.bitrate = bitrate;
 }
 
+void audio_process_extern(int16_t * buff, uint16_t len, bool * continueI2S)
+{
+    // decoded pcm on its way to i2s, len is per channel
+
+    *continueI2S = true;
+
+    if (handler._is_switching)
+    {
+        // runs with new_delete_semaphore taken, the semaphore comes after it as in choose_url
+
+        Lock lock(handler.semaphore);
+
+        uint32_t switch_millis = millis() - handler.switch_start_millis;
+        handler.status.www.switch_millis = switch_millis;
+        handler._is_switching = false;
+
+        TRACE("www channel switched in %d ms (target %d ms, connect %d ms)", (int) switch_millis, (int) MultiHandler::SWITCH_TARGET_MS,
+              (int) handler.status.www.connect_millis)
+    }
+
+    if (handler.audio_engine && handler.audio_dsp.is_active())
+    {
+        uint8_t channels = handler.audio_engine->getChannels();
+        uint32_t start_cycles = ESP.getCycleCount();
+
+        handler.audio_dsp.process(buff, len, channels, handler.audio_engine->getSampleRate());
+
+        uint32_t cycles = ESP.getCycleCount() - start_cycles;
+
+        if (len > 0 && channels > 0)
+        {
+            float cycles_per_sample = float(cycles) / float(uint32_t(len) * channels);
+
+            handler.dsp_cycles_per_sample = handler.dsp_cycles_per_sample == 0 ? cycles_per_sample : 
+                                            handler.dsp_cycles_per_sample * 0.95 + cycles_per_sample * 0.05;
+        }
+    }
+}
+
 bool multi_handler_uart_command_func(const String & command, AtResponse & response, String * error = NULL)
 {
     return handler.uart_command(command, response, error);
@@ -1421,11 +1594,27 @@ void MultiHandler::start(const MultiConfig &_config)
         return; // already running
     }
 
-    while(_task_finished == false  || _audio_task_finished == false || _i2c_scan_task_finished == false || _ui_task_finished == false)
+    while(_task_finished == false  || _audio_task_finished == false || _i2c_scan_task_finished == false || _ui_task_finished == false ||
+          _ramp_task_finished == false || _prewarm_task_finished == false)
     {
         delay(100);
     }
 
+    if (ramp_timer == NULL)
+    {
+        esp_timer_create_args_t ramp_timer_args = {};
+        ramp_timer_args.callback = ramp_timer_callback;
+        ramp_timer_args.arg = this;
+        ramp_timer_args.dispatch_method = ESP_TIMER_TASK;
+        ramp_timer_args.name = "multi_ramp";
+
+        if (esp_timer_create(&ramp_timer_args, &ramp_timer) != ESP_OK)
+        {
+            ERROR("failed to create volume ramp timer, volume fades will be coarse")
+            ramp_timer = NULL;
+        }
+    }
+
     Lock lock(semaphore);
     config = _config;
     configure_uart();
@@ -1442,6 +1631,8 @@ void MultiHandler::start(const MultiConfig &_config)
     _audio_task_finished = false;
     _i2c_scan_task_finished = false;
     _ui_task_finished = false;
+    _ramp_task_finished = false;
+    _prewarm_task_finished = false;
 
     xTaskCreate(
         task,                // Function that should be called
@@ -1475,154 +1666,197 @@ void MultiHandler::start(const MultiConfig &_config)
         1,                   // Task priority
         NULL                 // Task handle
     );
+    xTaskCreate(
+        ramp_task,          // Function that should be called
+        "multi_task-ramp",  // Name of the task (for debugging)
+        2048,                // Stack size (bytes)
+        this,                // Parameter to pass
+        1,                   // Task priority
+        &ramp_task_handle    // Task handle
+    );
+    xTaskCreate(
+        prewarm_task,          // Function that should be called
+        "multi_task-prewarm",  // Name of the task (for debugging)
+        3072,                // Stack size (bytes)
+        this,                // Parameter to pass
+        0,                   // Task priority, below the others: a dns lookup may take seconds
+        &prewarm_task_handle // Task handle
+    );
+
+    // the max volume follows config.sound.schedule per hour
+
+    hour_shift_job = scheduler_add_time_of_day("multi_hour_shift", 0, -1, hour_shift_job_func, this);
 }
 
 void MultiHandler::stop()
 {
     _is_active = false;
 
-    while(_task_finished == false || _audio_task_finished == false || _i2c_scan_task_finished == false || _ui_task_finished == false)
+    scheduler_remove(hour_shift_job);
+    hour_shift_job = SCHEDULER_NO_JOB;
+
+    while(_task_finished == false || _audio_task_finished == false || _i2c_scan_task_finished == false || _ui_task_finished == false ||
+          _ramp_task_finished == false || _prewarm_task_finished == false)
     {
         delay(100);
     }
 }
 
-void MultiHandler::reconfigure(const MultiConfig &_config)
+MultiHandler::ReconfigurePlan MultiHandler::plan_reconfigure(const MultiConfig & from, const MultiConfig & to) const
 {
-    TRACE("multi_task: reconfigure enters")
+    // runs with semaphore taken, reads the source and channel that play now
 
-    MultiConfig current_config;
-
-    {Lock lock(semaphore);
-    current_config = config;}
-
-    bool should_configure_uart = false;
-    bool should_configure_i2c = false;
-    bool should_configure_bt = false;
-    bool should_configure_fm = false;
-    bool should_configure_audio_engine = false;
-    bool should_configure_sound = false;
-    bool should_configure_tm1638_bus = false;
-    bool should_configure_ui = false;
-    bool should_commit_fm_freq = false;
-    bool will_reconnect_www = false;
+    ReconfigurePlan plan;
 
-    if (!(current_config.uart == _config.uart))
+    if (!(from.uart == to.uart))
     {
         TRACE("multi_task: uart config changed")
-        should_configure_uart = true;
+        plan.uart = true;
     }
 
-    if (!(current_config.bt == _config.bt))
+    if (!(from.bt == to.bt))
     {
         TRACE("multi_task: bt config changed")
-        should_configure_bt = true;
+        plan.bt = true;
     }
 
-    if (!(current_config.fm == _config.fm))
+    if (!(from.fm == to.fm))
     {
         TRACE("multi_task: fm config changed")
-        should_configure_fm = true;
+        plan.fm = true;
     }
 
-    if (!(current_config.i2s == _config.i2s))
+    if (!(from.i2s == to.i2s))
     {
         TRACE("multi_task: i2s config changed")
-        should_configure_audio_engine = true;
+        plan.audio_engine = true;
+        plan.reconnect_www = true;
     }
 
-    if (!(current_config.i2c == _config.i2c))
+    if (!(from.i2c == to.i2c))
     {
         TRACE("multi_task: i2c config changed")
-        should_configure_i2c = true;
+        plan.i2c = true;
     }
 
-    if (!(current_config.sound == _config.sound))
+    if (!(from.sound == to.sound))
     {
         TRACE("multi_task: sound config changed")
-        should_configure_sound = true;
+        plan.sound = true;
     }
 
-    if (!(current_config.service == _config.service))
+    if (!(from.service == to.service))
     {
         TRACE("multi_task: service config changed")
-        will_reconnect_www = true;
-        should_commit_fm_freq = true;
-        should_configure_ui = true;
+        plan.ui = true;
+
+        // only what plays now matters, the other urls and freqs are picked up when they are selected
+
+        const MultiConfig::Service::Url & from_url = from.service.url[select_url_index(from.service)];
+        const MultiConfig::Service::Url & to_url = to.service.url[select_url_index(to.service)];
+
+        if (status.audio_control_data.source == AudioControlData::sWww && from_url.value != to_url.value)
+        {
+            TRACE("multi_task: url playing now changed")
+            plan.reconnect_www = true;
+        }
+
+        const MultiConfig::Service::FmFreq & from_fm_freq = from.service.fm_freq[select_fm_freq_index(from.service)];
+        const MultiConfig::Service::FmFreq & to_fm_freq = to.service.fm_freq[select_fm_freq_index(to.service)];
+
+        if (!(from_fm_freq == to_fm_freq))
+        {
+            TRACE("multi_task: fm freq selected now changed")
+            plan.fm_freq = true;
+        }
     }
 
-    if (!(current_config.tm1638 == _config.tm1638))
+    if (!(from.tm1638 == to.tm1638))
     {
         TRACE("multi_task: tm1638 config changed")
-        should_configure_tm1638_bus = true;
+        plan.tm1638_bus = true;
     }
 
-    if (!(current_config.thermostat == _config.thermostat))
+    if (!(from.thermostat == to.thermostat))
     {
         TRACE("multi_task: thermostat config changed")
-        should_configure_ui = true;
+        plan.ui = true;
     }
 
-    if (!(current_config.ui == _config.ui))
+    if (!(from.ui == to.ui))
     {
         TRACE("multi_task: UI config changed")
-        should_configure_ui = true;
+        plan.ui = true;
     }
 
-    if (!(current_config == _config))
+    return plan;
+}
+
+void MultiHandler::reconfigure(const MultiConfig &_config)
+{
+    TRACE("multi_task: reconfigure enters")
+
+    ReconfigurePlan plan;
+
+    {Lock lock(semaphore);
+
+    if (config == _config)
     {
-        TRACE("multi_task: config changed")
-        Lock lock(semaphore);
-        config = _config;
+        TRACE("multi_task: reconfigure leaves, config unchanged")
+        return;
     }
 
-    if (should_configure_uart == true)
+    plan = plan_reconfigure(config, _config);
+    config = _config;}
+
+    TRACE("multi_task: reconfigure plan %s", plan.as_string().c_str())
+
+    if (plan.uart == true)
     {
         configure_uart();
     }
 
-    if (should_configure_i2c == true)
+    if (plan.i2c == true)
     {
         configure_i2c();
     }
 
-    if (should_configure_bt == true)
+    if (plan.bt == true)
     {
         configure_bt();
     }
 
-    if (should_configure_fm == true)
+    if (plan.fm == true)
     {
         configure_fm();
     }
 
-    if (should_configure_audio_engine == true)
+    if (plan.audio_engine == true)
     {
         configure_audio_engine();
-        will_reconnect_www = true;
     }
 
-    if (should_commit_fm_freq == true)
+    if (plan.fm_freq == true)
     {
         commit_fm_freq();
     }
 
-    if (should_configure_sound == true)
+    if (plan.sound == true)
     {
         configure_sound();
     }
 
-    if (should_configure_tm1638_bus == true)
+    if (plan.tm1638_bus == true)
     {
         configure_tm1638_bus();
     }
 
-    if (should_configure_ui == true)
+    if (plan.ui == true)
     {
         configure_ui();
     }
 
-    if (will_reconnect_www)
+    if (plan.reconnect_www == true)
     {
         _should_reconnect_www = true;
     }
@@ -1644,18 +1878,20 @@ void MultiHandler::task(void *parameter)
     bool should_log_for_stats = true;
     uint32_t last_log_for_stats_millis = 0;
 
-    uint32_t last_check_hour_shift_millis = 0;
-    const uint32_t CHECK_HOUR_SHIFT_INTERVAL_MILLIS = 60000;
-
     uint32_t last_uart_poll_millis = 0;
 
+    uint32_t last_prewarm_millis = 0;
+    int prewarm_channel = -1;
+
     const size_t BT_SETUP_DELAY_MS = 8000;
     bool bt_setup_done = false;
 
-    int hour = -1;
+    TelemetryLoop * loop_telemetry = telemetry_loop("multi_task");
 
     while (_this->_is_active)
     {
+        telemetry_loop_mark(loop_telemetry);
+
         now_millis = millis();
 
         if (bt_setup_done == false)
@@ -1690,27 +1926,6 @@ void MultiHandler::task(void *parameter)
             }
         }
 
-        if (last_check_hour_shift_millis > now_millis || (now_millis-last_check_hour_shift_millis) >= CHECK_HOUR_SHIFT_INTERVAL_MILLIS)
-        {
-            last_check_hour_shift_millis = now_millis;
-
-            // check if we need to limit max volume at hour shift
-
-            time_t _time_t;
-            time(& _time_t);
-            tm _tm = {0};
-            _tm = *localtime(&_time_t);
-        
-            if (_tm.tm_year+1900 > 2000) // otherwise - NTP failed to fetch time 
-            {
-                if (_tm.tm_hour != hour)
-                {
-                    hour = _tm.tm_hour;
-                    _this->commit_volume();
-                }
-            }
-        }
-
         if (last_uart_poll_millis > now_millis || (now_millis-last_uart_poll_millis) >= _this->UART_POLL_INTERVAL_MS)
         {
             last_uart_poll_millis = now_millis;
@@ -1720,12 +1935,29 @@ void MultiHandler::task(void *parameter)
             _this->uart_poll_indications(dummy);  // this will update at_poll_indications
 
             Lock lock(_this->semaphore);
-            _this->status.bt.latest_indications = _this->at_latest_indications.indications; 
+            _this->status.bt.set_latest_indications(_this->at_latest_indications.indications);
             //DEBUG("_this->status.bt.latest_indications.size() %d", (int) _this->status.bt.latest_indications.size())
 
             // TODO: update BT title, etc.
         }
 
+        if (_this->status.audio_control_data.source == AudioControlData::sWww)
+        {
+            int channel = _this->status.audio_control_data.channel;
+
+            if (channel != prewarm_channel || last_prewarm_millis > now_millis || 
+                (now_millis-last_prewarm_millis) >= PREWARM_INTERVAL_MS)
+            {
+                prewarm_channel = channel;
+                last_prewarm_millis = now_millis;
+                _this->prewarm_www();
+            }
+        }
+        else
+        {
+            prewarm_channel = -1;
+        }
+
         should_log_for_stats = false;
 
         AudioControlData::Source last_source = source;
@@ -1796,8 +2028,12 @@ void MultiHandler::audio_task(void *parameter)
     uint32_t wait_retry_audio_millis = 0;
     bool streaming_on = false;
 
+    TelemetryLoop * loop_telemetry = telemetry_loop("multi_task-audio");
+
     while (_this->_is_active)
     {
+        telemetry_loop_mark(loop_telemetry);
+
         now_millis = millis();
         bool last_streaming_on = streaming_on;
 
@@ -1833,7 +2069,9 @@ void MultiHandler::audio_task(void *parameter)
 
         // ATTENTION: no delay while semaphore is taken due to risk of deadlocks
 
-        if (_this->_reconnect_count < AUDIO_MAX_RECONNECT_ATTEMPTS && (wait_retry_audio_millis == 0 || 
+        // without the network the connection attempts would be used up before WiFi is there after the boot
+
+        if (boot_is(beNetwork) && _this->_reconnect_count < AUDIO_MAX_RECONNECT_ATTEMPTS && (wait_retry_audio_millis == 0 || 
             wait_retry_audio_millis+AUDIO_RECONNECT_TIMEOUT <= now_millis || now_millis < wait_retry_audio_millis))
         {
             if (_this->audio_engine != NULL)
@@ -1849,9 +2087,13 @@ void MultiHandler::audio_task(void *parameter)
                             DEBUG("audio_task: chosing url")
                             //esp_log_level_set("*", ESP_LOG_ERROR);  
                             String url = _this->choose_url();
+                            uint32_t connect_start_millis = millis();
                             bool connect_ok = _this->audio_engine->connecttohost(url.c_str());
                             _this->audio_engine->setVolume(100);
 
+                            {Lock lock(_this->semaphore);
+                            _this->status.www.connect_millis = millis() - connect_start_millis;}
+
                             TRACE("audio_task: connection attempt %d/%d to URL %s, result %d", (int) _this->_reconnect_count+1, (int) AUDIO_MAX_RECONNECT_ATTEMPTS, 
                                   url.c_str(), (int) connect_ok)
 
@@ -1935,8 +2177,12 @@ void MultiHandler::i2c_scan_task(void *parameter)
     uint32_t last_i2c_scan_millis = 0;
     const uint32_t I2C_SCAN_INTERVAL_MILLIS = 600000; // 10 minutes
 
+    TelemetryLoop * loop_telemetry = telemetry_loop("multi_task-i2c_scan");
+
     while (_this->_is_active)
     {
+        telemetry_loop_mark(loop_telemetry);
+
         now_millis = millis();
 
         if (last_i2c_scan_millis > now_millis || (now_millis-last_i2c_scan_millis) >= I2C_SCAN_INTERVAL_MILLIS)
@@ -1988,8 +2234,12 @@ void MultiHandler::ui_task(void *parameter)
     size_t i=0;
     size_t j=0;
 
+    TelemetryLoop * loop_telemetry = telemetry_loop("multi_task-ui");
+
     while (_this->_is_active)
     {
+        telemetry_loop_mark(loop_telemetry);
+
         uint32_t time_in = millis();
 
         if ((i % display_shift_ratio) == 0)
@@ -2049,6 +2299,99 @@ void MultiHandler::ui_task(void *parameter)
     vTaskDelete(NULL);
 }
 
+void MultiHandler::hour_shift_job_func(void *parameter)
+{
+    // runs in the scheduler task on every hour boundary and once when the time gets valid
+
+    MultiHandler *_this = (MultiHandler *)parameter;
+
+    if (_this->_is_active)
+    {
+        // reconfigure replaces config under the semaphore; it is let go before the commit takes
+        // new_delete_semaphore, audio_task takes the two the other way round (choose_url)
+
+        uint8_t volume = 0;
+        uint32_t fade_ms = 0;
+        uint8_t fade_curve = 0;
+
+        {Lock lock(_this->semaphore);
+
+        _this->get_max_volume(true);  // trace selection once
+        volume = _this->get_volume();
+        fade_ms = uint32_t(_this->config.sound.schedule_fade) * 1000;
+        fade_curve = _this->config.sound.fade_curve;}
+
+        _this->commit_volume(volume, fade_ms, fade_curve);
+    }
+}
+
+void MultiHandler::ramp_timer_callback(void *parameter)
+{
+    MultiHandler *_this = (MultiHandler *)parameter;
+    TaskHandle_t task_handle = _this->ramp_task_handle;
+
+    if (task_handle != NULL)
+    {
+        xTaskNotifyGive(task_handle);
+    }
+}
+
+void MultiHandler::ramp_task(void *parameter)
+{
+    MultiHandler *_this = (MultiHandler *)parameter;
+
+    TRACE("multi_task: ramp_task started")
+
+    TelemetryLoop * loop_telemetry = telemetry_loop("multi_task-ramp");
+
+    while (_this->_is_active)
+    {
+        telemetry_loop_mark(loop_telemetry);
+
+        // ticks missed while waiting for the sound hw collapse into one notification, the fade
+        // position is computed from time so nothing is lost but the intermediate values
+
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(RAMP_IDLE_WAIT_MS));
+
+        uint8_t volume = 0;
+        bool should_write = false;
+
+        {Lock lock(_this->ramp_semaphore);
+
+        should_write = _this->volume_ramp.tick(millis(), volume);
+
+        if (_this->volume_ramp.is_ramping() == false && _this->ramp_timer_running)
+        {
+            esp_timer_stop(_this->ramp_timer);
+            _this->ramp_timer_running = false;
+        }}
+
+        if (should_write)
+        {
+            //DEBUG("new_delete_semaphore ramp")
+            Lock lock(_this->new_delete_semaphore);
+
+            if (_this->tda8425)
+            {
+                _this->tda8425->set_volume(volume);
+            }
+        }
+    }
+
+    {Lock lock(_this->ramp_semaphore);
+
+    if (_this->ramp_timer_running)
+    {
+        esp_timer_stop(_this->ramp_timer);
+        _this->ramp_timer_running = false;
+    }}
+
+    _this->ramp_task_handle = NULL;
+    _this->_ramp_task_finished = true;
+    TRACE("multi_task: ramp_task finished")
+    vTaskDelete(NULL);
+}
+
 bool MultiHandler::audio_control_ext(const String & source, const String & channel, const String & volume, String & response, String * error)
 {
     TRACE("audio_control_ext enters")
@@ -2183,7 +2526,7 @@ bool MultiHandler::audio_control(const String & source, const String & channel,
                 audio_engine = NULL;
             }
 
-            audio_engine = new Audio(); }
+            audio_engine = new ZeroedAudio(); }
             //DEBUG("free heap after audio_engine alloc %ul", (long)ESP.getFreeHeap())
             configure_audio_engine(); 
 
@@ -2323,7 +2666,7 @@ bool MultiHandler::audio_control(const AudioControlData & new_audio_control_data
                 audio_engine = NULL;
             }
 
-            audio_engine = new Audio(); }
+            audio_engine = new ZeroedAudio(); }
             //DEBUG("free heap after audio_engine alloc %ul", (long)ESP.getFreeHeap())
             configure_audio_engine(); 
 
@@ -2373,6 +2716,8 @@ bool MultiHandler::audio_control(const AudioControlData & new_audio_control_data
     if (will_reconnect_www == true)
     {
         _should_reconnect_www = true; 
+        switch_start_millis = millis();
+        _is_switching = true;
     }}
 
     // commit what might change from other places
@@ -2454,23 +2799,23 @@ bool MultiHandler::set_volatile(const JsonVariant & json, String * error)
     return r;
 }
 
-String MultiHandler::choose_url() 
+int MultiHandler::select_url_index(const MultiConfig::Service & service) const
 {
-    Lock lock(semaphore);
+    // semaphore taken by the caller
 
     int index = 0;
 
-    if (status.audio_control_data.channel >= 0 && status.audio_control_data.channel < config.service.NUM_URLS)
+    if (status.audio_control_data.channel >= 0 && status.audio_control_data.channel < service.NUM_URLS)
     {
         index = status.audio_control_data.channel;
     }
     else
     {
-        if (config.service.url_select >= 0)
+        if (service.url_select >= 0)
         {
-            if (config.service.url_select < config.service.NUM_URLS)
+            if (service.url_select < service.NUM_URLS)
             {
-                index = config.service.url_select;
+                index = service.url_select;
             }
         }
         else
@@ -2479,28 +2824,151 @@ String MultiHandler::choose_url()
         }
     }
 
+    return index;
+}
+
+String MultiHandler::choose_url() 
+{
+    Lock lock(semaphore);
+
+    int index = select_url_index(config.service);
+
     status.www.url_index = index;
     status.www.url_name = config.service.url[index].name;
     return config.service.url[index].value;
 }
 
-float MultiHandler::choose_fm_freq() 
+static String url_2_host(const String & url)
 {
-    Lock lock(semaphore);
+    int start = url.indexOf("://");
+    start = start < 0 ? 0 : start + 3;
+
+    int end = start;
+
+    while (end < (int) url.length() && url[end] != '/' && url[end] != ':' && url[end] != '?')
+    {
+        end++;
+    }
+
+    return url.substring(start, end);
+}
+
+void MultiHandler::prewarm_www()
+{
+    const int NUM_URLS = (int) MultiConfig::Service::NUM_URLS;
+
+    {Lock lock(semaphore);
+
+    // the url that plays, also when it is chosen by url_select and not by the channel
+
+    int index = select_url_index(config.service);
+
+    for (size_t i=0; i<sizeof(prewarm_hosts)/sizeof(prewarm_hosts[0]); ++i)
+    {
+        prewarm_hosts[i] = "";
+    }
+
+    if (config.service.url[index].is_defined() == false)
+    {
+        return;
+    }
+
+    // the url itself and the nearest defined ones up and down, as they are stepped by the UI
+
+    prewarm_hosts[0] = url_2_host(config.service.url[index].value);
+
+    for (int i=1; i<NUM_URLS; ++i)
+    {
+        int next = (index + i) % NUM_URLS;
+
+        if (config.service.url[next].is_defined())
+        {
+            prewarm_hosts[1] = url_2_host(config.service.url[next].value);
+            break;
+        }
+    }
+
+    for (int i=1; i<NUM_URLS; ++i)
+    {
+        int prev = (index - i + NUM_URLS) % NUM_URLS;
+
+        if (config.service.url[prev].is_defined())
+        {
+            prewarm_hosts[2] = url_2_host(config.service.url[prev].value);
+            break;
+        }
+    }}
+
+    TaskHandle_t task_handle = prewarm_task_handle;
+
+    if (task_handle != NULL)
+    {
+        xTaskNotifyGive(task_handle);
+    }
+}
+
+void MultiHandler::prewarm_task(void *parameter)
+{
+    MultiHandler *_this = (MultiHandler *)parameter;
+
+    TRACE("multi_task: prewarm_task started")
+
+    while (_this->_is_active)
+    {
+        // a lookup blocks up to the dns timeout, here it holds up nothing but the next lookup
+
+        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(PREWARM_IDLE_WAIT_MS)) == 0 || WiFi.status() != WL_CONNECTED)
+        {
+            continue;
+        }
+
+        String hosts[3];
+
+        {Lock lock(_this->semaphore);
+
+        for (size_t i=0; i<sizeof(hosts)/sizeof(hosts[0]); ++i)
+        {
+            hosts[i] = _this->prewarm_hosts[i];
+        }}
+
+        for (size_t i=0; i<sizeof(hosts)/sizeof(hosts[0]) && _this->_is_active; ++i)
+        {
+            if (hosts[i].isEmpty() || (i > 0 && hosts[i] == hosts[0]) || (i > 1 && hosts[i] == hosts[1]))
+            {
+                continue;
+            }
+
+            IPAddress ip;
+            uint32_t start_millis = millis();
+            bool r = WiFi.hostByName(hosts[i].c_str(), ip) == 1;
+
+            DEBUG("prewarm_www: %s resolved %d to %s in %d ms", hosts[i].c_str(), (int) r, ip.toString().c_str(), (int) (millis() - start_millis))
+        }
+    }
+
+    _this->prewarm_task_handle = NULL;
+    _this->_prewarm_task_finished = true;
+    TRACE("multi_task: prewarm_task finished")
+    vTaskDelete(NULL);
+}
+
+int MultiHandler::select_fm_freq_index(const MultiConfig::Service & service) const
+{
+    // semaphore taken by the caller
 
     int index = 0;
 
-    if (status.audio_control_data.channel >= 0 && status.audio_control_data.channel < config.service.NUM_FM_FREQS)
+    if (status.audio_control_data.channel >= 0 && status.audio_control_data.channel < service.NUM_FM_FREQS)
     {
         index = status.audio_control_data.channel;
     }
     else
     {
-        if (config.service.fm_freq_select >= 0)
+        if (service.fm_freq_select >= 0)
         {
-            if (config.service.fm_freq_select < config.service.NUM_FM_FREQS)
+            if (service.fm_freq_select < service.NUM_FM_FREQS)
             {
-                index = config.service.fm_freq_select;
+                index = service.fm_freq_select;
             }
         }
         else
@@ -2509,6 +2977,15 @@ float MultiHandler::choose_fm_freq()
         }
     }
 
+    return index;
+}
+
+float MultiHandler::choose_fm_freq() 
+{
+    Lock lock(semaphore);
+
+    int index = select_fm_freq_index(config.service);
+
     status.fm.index = index;
     status.fm.name = config.service.fm_freq[index].name;
     status.fm.freq = config.service.fm_freq[index].value;
@@ -2522,12 +2999,9 @@ uint8_t MultiHandler::get_max_volume(bool trace) const
         DEBUG("get_max_volume")
     }
 
-    time_t _time_t;
-    time(& _time_t);
     tm _tm = {0};
-    _tm = *localtime(&_time_t);
 
-    if (_tm.tm_year+1900 > 2000) // otherwise - NTP failed to fetch time 
+    if (scheduler_get_local_time(_tm))
     {
         uint8_t hour = (uint8_t)((size_t) _tm.tm_hour % (sizeof(config.sound.schedule)/sizeof(config.sound.schedule[0])));
 
@@ -2590,16 +3064,28 @@ uint8_t MultiHandler::get_volume() const
 
 void MultiHandler::commit_volume()
 {
+    commit_volume(get_volume(), uint32_t(config.sound.fade), config.sound.fade_curve);
+}
+
+void MultiHandler::commit_volume(uint8_t volume, uint32_t fade_ms, uint8_t fade_curve)
+{
+    // only sets the target of the fade, the write to the sound hw is done by ramp_task; the loudness of the
+    // i2s path follows the volume with or without the sound hw
+
+    //DEBUG("new_delete_semaphore 12")
+    Lock lock(new_delete_semaphore);
+
+    status.commited_volume = volume;
+    audio_dsp.set_volume(status.commited_volume);
+
     if (tda8425)
     {
-        //DEBUG("new_delete_semaphore 12")
-        Lock lock(new_delete_semaphore);
-        
-        status.commited_volume = get_volume();
+        Lock lock(ramp_semaphore);
+        volume_ramp.set_target(status.commited_volume, fade_ms, fade_curve, millis());
 
-        if (tda8425)
+        if (volume_ramp.is_ramping() && ramp_timer != NULL && ramp_timer_running == false)
         {
-            tda8425->set_volume(status.commited_volume);
+            ramp_timer_running = esp_timer_start_periodic(ramp_timer, RAMP_TICK_MS * 1000) == ESP_OK;
         }
     }
 }
@@ -2817,6 +3303,11 @@ void MultiHandler::configure_sound()
         if (tda8425 == NULL)
         {
             tda8425 = new Tda8425(two_wire);
+
+            // fresh hw, fade in from silence
+
+            Lock lock(ramp_semaphore);
+            volume_ramp.reset(0);
         }
     }
     
@@ -2833,14 +3324,23 @@ void MultiHandler::configure_sound()
         tda8425->commit_all();
     }
 
-    pinMode(config.sound.mute.gpio, OUTPUT);}
+    // without the tone control of the sound hw the same bass / treble is done in the i2s path
 
-    /*
-    if (audio_engine)
+    AudioDsp::Params dsp_params;
+    dsp_params.tone_enabled = tda8425 == NULL;
+    dsp_params.bass = config.sound.gain_low_pass - config.sound.gain_band_pass;
+    dsp_params.treble = config.sound.gain_high_pass - config.sound.gain_band_pass;
+    dsp_params.loudness = config.sound.loudness;
+    dsp_params.limiter = config.sound.limiter;
+
+    audio_dsp.configure(dsp_params);
+
+    if (audio_dsp.is_active() == false)
     {
-        audio_engine->setTone(config.sound.gain_low_pass, config.sound.gain_band_pass, config.sound.gain_high_pass);
+        dsp_cycles_per_sample = 0;
     }
-    */
+
+    pinMode(config.sound.mute.gpio, OUTPUT);}
 
     get_max_volume(true);  // trace selection once
     commit_volume();
@@ -2898,7 +3398,7 @@ bool MultiHandler::uart_command(const String & command, AtResponse & response, S
 {
     char crlf[] = {0x0d, 0x0a, 0};
     String command_crlf = command + (const char *) crlf;
-    TRACE("¤ %s", command.c_str())
+    LOG_TRACE(lmMulti, "¤ %s", command.c_str())
 
     #ifdef USE_HARDWARE_SERIAL
     
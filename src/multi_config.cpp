@@ -840,6 +840,31 @@ void MultiConfig::Sound::from_json(const JsonVariant &json)
         gain_high_pass = (int8_t) (int) json["gain_high_pass"];
     }
 
+    if (json.containsKey("fade"))
+    {
+        fade = (uint16_t) (int) json["fade"];
+    }
+
+    if (json.containsKey("schedule_fade"))
+    {
+        schedule_fade = (uint16_t) (int) json["schedule_fade"];
+    }
+
+    if (json.containsKey("fade_curve"))
+    {
+        fade_curve = (uint8_t) (int) json["fade_curve"];
+    }
+
+    if (json.containsKey("loudness"))
+    {
+        loudness = (uint8_t) (int) json["loudness"];
+    }
+
+    if (json.containsKey("limiter"))
+    {
+        limiter = (int8_t) (int) json["limiter"];
+    }
+
     if (json.containsKey("schedule"))
     {
         const JsonVariant &_json = json["schedule"];
@@ -896,6 +921,12 @@ void MultiConfig::Sound::to_eprom(std::ostream &os) const
     os.write((const char *)&gain_band_pass, sizeof(gain_band_pass));
     os.write((const char *)&gain_high_pass, sizeof(gain_high_pass));
 
+    os.write((const char *)&fade, sizeof(fade));
+    os.write((const char *)&schedule_fade, sizeof(schedule_fade));
+    os.write((const char *)&fade_curve, sizeof(fade_curve));
+    os.write((const char *)&loudness, sizeof(loudness));
+    os.write((const char *)&limiter, sizeof(limiter));
+
     os.write((const char *)schedule, sizeof(schedule));
 }
 
@@ -942,6 +973,12 @@ bool MultiConfig::Sound::from_eprom(std::istream &is)
     is.read((char *)&gain_band_pass, sizeof(gain_band_pass));
     is.read((char *)&gain_high_pass, sizeof(gain_high_pass));
 
+    is.read((char *)&fade, sizeof(fade));
+    is.read((char *)&schedule_fade, sizeof(schedule_fade));
+    is.read((char *)&fade_curve, sizeof(fade_curve));
+    is.read((char *)&loudness, sizeof(loudness));
+    is.read((char *)&limiter, sizeof(limiter));
+
     is.read((char *)schedule, sizeof(schedule));
 
     return is_valid() && !is.bad();
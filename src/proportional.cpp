@@ -4,70 +4,17 @@
 #include <autonom.h>
 #include <gpio.h>
 #include <binarySemaphore.h>
+#include <telemetry.h>
 #include <Wire.h>
 #include <deque>
 #include <epromImage.h>
 #include <sstream>
+#include <esp_timer.h>
+#include <slidingWindow.h>
 
 extern GpioHandler gpioHandler;
 
 
-template<class T, size_t window_size> class Averager
-{
-    public:
-
-        Averager()
-        {
-            reset();
-        }
-
-        void reset()
-        {
-            window_pos = -1;
-        }
-
-        void push(T value)
-        {
-            if (window_pos == window_size-1)
-            {
-                memmove((char*) window, (const char*) window + sizeof(T), sizeof(T) * (window_size-1));
-                window[window_pos] = value;
-            }
-            else
-            {
-                window_pos++;
-                window[window_pos] = value;
-            }
-        }
-
-        bool is_window_full() const
-        {
-            return window_pos == window_size-1;   
-        }
-
-        T get_average(T empty) const
-        {
-            if (window_pos == -1)
-            {
-                return empty;
-            }
-
-            T average = window[0];
-            
-            for(size_t i=1; i<=window_pos; ++i)
-            {
-                average += window[i];
-            }
-
-            return average / (window_pos+1);
-        }
-
-        T window[window_size];
-        int window_pos;
-};
-
-
-
 static void _err_dup(const char *name, int value)
 {
     ERROR("%s %d is duplicated / reused", name, value)
@@ -538,6 +485,11 @@ bool ProportionalConfig::ValveProfile::from_eprom(std::istream &is)
 
     After calibration value needs to be set again manually!
 
+    Each channel owns one persistent worker task which is created at start and lives until stop; calibrations
+    and actuations are posted to it through a command queue instead of creating a new task per request. 
+    While the motor runs the worker sleeps on its task notification which is signalled from the open / closed 
+    endstop interrupts, by cancel (stop / reconfigure) and by retarget (new value while actuating).
+
 */
 
 class ChannelHandler
@@ -546,23 +498,111 @@ public:
 
     const uint8_t MAX_ACTUATE_ADD_UPS = 1;
 
+    // while the motor runs its current is sampled from a timer into the move's signature; the same samples 
+    // drive the online no-load and stall detection which wake the worker up (it is otherwise asleep)
+
+    static const uint32_t CURRENT_SAMPLE_INTERVAL = 20; // ms
+
+    // samples within the motor inrush are recorded but not used for detection
+
+    static const uint32_t MOTOR_INRUSH_TIME = 500; // ms
+
+    // no load is the mean of the last NO_LOAD_SAMPLES samples after the inrush under current_threshold
+
+    static const size_t NO_LOAD_SAMPLES = 25;
+
+    // a stall is a current rising above STALL_CURRENT_FACTOR times the running current for STALL_SAMPLES
+    // samples in a row; without limit switches this is how a valve tells it is at its mechanical end
+
+    static constexpr float STALL_CURRENT_FACTOR = 1.6;
+    static const uint8_t STALL_SAMPLES = 3;
+
+    static const size_t COMMAND_QUEUE_LENGTH = 4;
+
+    // the valve position is estimated in permille of the full travel (0 == closed, POSITION_FULL == open) by
+    // integrating motor run time in both directions; every timed move adds to the estimated drift, an endstop
+    // (or no load right at an expected end-state) resets it; once the drift exceeds MAX_POSITION_DRIFT the 
+    // next actuation goes through the nearest end-state to reference the valve again
+
+    static const int16_t POSITION_FULL = 1000;
+    static const int16_t POSITION_UNKNOWN = -1;
+
+    static const uint16_t MAX_POSITION_DRIFT = 50;          // permille of the full travel
+    static const uint16_t POSITION_DRIFT_PER_MOVE = 5;      // motor start / stop inertia, permille
+    static const uint16_t POSITION_DRIFT_PER_TRAVEL = 20;   // permille of the distance travelled
+
+    // moves shorter than this give no predictable motor movement and are skipped
+
+    static const uint32_t MIN_MOVE_TIME = 50; // ms
+
+    // task notification bits of the worker
+
+    static const uint32_t NOTIFY_ENDSTOP = 0x01;
+    static const uint32_t NOTIFY_CANCEL = 0x02;
+    static const uint32_t NOTIFY_RETARGET = 0x04;
+    static const uint32_t NOTIFY_STALL = 0x08;
+    static const uint32_t NOTIFY_NO_LOAD = 0x10;
+
+    enum Command
+    {
+        cNone = 0,
+        cCalibrate = 1,
+        cActuate = 2,
+        cTerminate = 3
+    };
+
+    enum TravelResult
+    {
+        trElapsed = 0,
+        trEndstop = 1,
+        trTimeout = 2,
+        trNoLoad = 3,
+        trCancelled = 4,
+        trRetargeted = 5,
+        trStall = 6
+    };
+
+    static const char * travel_result_2_str(TravelResult travel_result)
+    {
+        switch(travel_result)
+        {
+            case trElapsed:     return "elapsed";
+            case trEndstop:     return "endstop";
+            case trTimeout:     return "timeout";
+            case trNoLoad:      return "no load";
+            case trCancelled:   return "cancelled";
+            case trRetargeted:  return "retargeted";
+            case trStall:       return "stall";
+        }
+
+        return "<unknown>";
+    }
+
     ChannelHandler()
     {
         _is_active = false;
         _calib_data_needs_save = false;
         _value_needs_save = false;
-        actuate_ref = UINT8_MAX;
-        actuate_ms = 0;
+        position = POSITION_UNKNOWN;
+        position_drift = 0;
         actuate_add_ups = 0;
         next_actuate_ref = UINT8_MAX;
+        worker_handle = NULL;
+        command_queue = NULL;
+        _is_worker_finished = true;
+        sampler = NULL;
+        _is_sampling = false;
     }
 
     ~ChannelHandler()
     {
+        stop_worker();
     }
 
     bool is_active() const { return _is_active; }
     bool is_idle() const { return status.state == ProportionalStatus::Channel::sIdle; }
+    bool is_actuating() const { return status.state == ProportionalStatus::Channel::sActuating; }
+    bool is_calibrating() const { return status.state == ProportionalStatus::Channel::sCalibrating; }
 
     void start(const ProportionalConfig::Channel &_config, const ProportionalConfig::ValveProfile &_valve_profile);
     void stop();
@@ -578,12 +618,20 @@ public:
             Lock lock(semaphore);
             status.config_open_time = get_config_open_time();
             status.max_actuate_add_ups = valve_profile.max_actuate_add_ups; 
+            status.position = position;
+            status.position_drift = position_drift;
             _status = status;
         }
 
         return _status;
     }
 
+    ProportionalSignature get_signature()
+    {
+        Lock lock(semaphore);
+        return last_signature;
+    }
+
     uint32_t get_config_open_time() const
     {
         return valve_profile.open_time * 1000; // ms
@@ -682,6 +730,22 @@ public:
     protected:
 
     void configure_hw();
+    void cleanup_hw();
+
+    void start_worker();
+    void stop_worker();
+    bool post_command(Command command);
+    void notify_worker(uint32_t bits);
+
+    static void worker_task(void *parameter);
+    static void endstop_interrupt_handler(gpio_num_t gpio);
+    static void sampler_callback(void *parameter);
+
+    void begin_sampling(bool to_open);
+    void end_sampling(TravelResult travel_result, uint32_t duration);
+
+    TravelResult travel(bool to_open, const DigitalInputChannelConfig * wait_on, uint32_t run_ms, 
+                        uint32_t timeout_ms, bool can_retarget, uint32_t & elapsed_ms);
 
     static void write_one(const ProportionalConfig::Channel & config, bool a_value, bool b_value);
 
@@ -695,8 +759,22 @@ public:
 
     static unsigned analog_read(uint8_t gpio);
 
-    static void calibration_task(void *parameter);
-    static void actuation_task(void *parameter);
+    static void run_calibration(ChannelHandler * _this);
+    static void run_actuation(ChannelHandler * _this);
+
+    void reset_position(int16_t _position)
+    {
+        position = _position;
+        position_drift = 0;
+        actuate_add_ups = 0;
+    }
+
+    void add_position(bool to_open, uint32_t run_ms, uint32_t full_time);
+
+    static uint32_t position_2_time(int16_t distance, uint32_t full_time)
+    {
+        return (uint32_t(distance) * full_time) / POSITION_FULL;
+    }
 
     static uint32_t flow_2_time(const ProportionalConfig::ValveProfile & _valve_profile,  
                                 int flow_percent, uint32_t open_time, uint8_t from);
@@ -710,17 +788,41 @@ public:
     bool _calib_data_needs_save;
     bool _value_needs_save;
 
-    uint8_t actuate_ref;
-    uint32_t actuate_ms;
+    int16_t position;
+    uint16_t position_drift;
 
-    // this indicates how many actuations were made from the previous actuation as a reference
-    // after some (MAX_ACTUATE_ADD_UPS or value from valve_profile) the motor is reset to a nearest end-state and the actuation
-    // is done from there
+    // this indicates how many actuations were made since the valve was last referenced at an end-state;
+    // after max_actuate_add_ups from valve_profile (or once the position drift is too big) the motor is reset 
+    // to a nearest end-state and the actuation is done from there
 
     uint8_t actuate_add_ups;
     uint8_t next_actuate_ref;
+
+    TaskHandle_t worker_handle;
+    QueueHandle_t command_queue;
+    bool _is_worker_finished;
+
+    // signature capture and detection state, written from the sampler under the semaphore
+
+    esp_timer_handle_t sampler;
+    bool _is_sampling;
+    uint32_t sampling_begin;
+    float running_current;
+    float previous_current;
+    SlidingWindow<float, NO_LOAD_SAMPLES> load_window;
+    uint8_t stall_samples;
+    bool _is_detected;
+
+    ProportionalSignature signature;
+    ProportionalSignature last_signature;
+
+    // endstop gpio -> channel, looked up from the interrupt handler; a plain table to stay allocation-free
+
+    static ChannelHandler * endstop_channels[GPIO_NUM_MAX];
 };
 
+ChannelHandler * ChannelHandler::endstop_channels[GPIO_NUM_MAX] = {NULL};
+
 class ProportionalHandler
 {
 public:
@@ -804,6 +906,17 @@ public:
     String calibrate(size_t channel);
     String actuate(size_t channel, uint8_t value, uint8_t ref = UINT8_MAX, bool force = false);
 
+    struct Actuation
+    {
+        size_t channel;
+        uint8_t value;
+        uint8_t ref;
+    };
+
+    void actuate_batch(const std::vector<Actuation> & actuations, std::vector<String> & results);  // one lock for all
+
+    String get_signature(size_t channel, ProportionalSignature & signature);
+
     void calibrate_uncalibrated();
     
     bool does_data_need_save();
@@ -826,6 +939,12 @@ public:
 protected:
 
     void delete_all_channel_handlers();
+    String _actuate(size_t channel, uint8_t value, uint8_t ref, bool force);  // the caller locks
+
+    #ifdef USE_ACTION_QUEUE
+    bool is_any_calibrating() const;                // the caller locks
+    bool is_queued(size_t channel) const;           // the caller locks
+    #endif // USE_ACTION_QUEUE
 
     static void task(void *parameter);
 
@@ -869,6 +988,7 @@ void ChannelHandler::start(const ProportionalConfig::Channel &_config,
 
         status.value = config.default_value;
 
+        start_worker();
         configure_hw();
 
         set_valve_profile(_valve_profile);
@@ -884,6 +1004,7 @@ void ChannelHandler::stop()
     TRACE("ChannelHandler::stop channel %s, status %s", config.as_string().c_str(), status.as_string().c_str())
 
     _is_active = false; // this should trigger aborting possible calibration or actuation
+    notify_worker(NOTIFY_CANCEL);
 
     while(status.state == ProportionalStatus::Channel::sCalibrating || 
             status.state == ProportionalStatus::Channel::sActuating)
@@ -891,10 +1012,14 @@ void ChannelHandler::stop()
         delay(100);
     }
 
+    stop_worker();
+
     write_one(config, false, false);  // just in case
+    cleanup_hw();
 
     status.clear();
     config.clear();
+    last_signature.clear();
 
     TRACE("ChannelHandler::stop returns, status %s", status.as_string().c_str())
 }
@@ -910,6 +1035,7 @@ void ChannelHandler::reconfigure(const ProportionalConfig::Channel &_config)
         TRACE("channel: config changed")
 
         _is_active = false;
+        notify_worker(NOTIFY_CANCEL);
 
         while(status.state == ProportionalStatus::Channel::sCalibrating || 
                 status.state == ProportionalStatus::Channel::sActuating)
@@ -927,6 +1053,8 @@ void ChannelHandler::reconfigure(const ProportionalConfig::Channel &_config)
             status.clear();
         }
 
+        cleanup_hw();
+
         config = _config;
         
         status.state = ProportionalStatus::Channel::sIdle;
@@ -981,16 +1109,14 @@ String ChannelHandler::calibrate()
        {
             status.state = ProportionalStatus::Channel::sCalibrating;
 
-            TRACE("starting calibration task")
+            TRACE("posting calibration to channel worker")
 
-            xTaskCreate(
-                calibration_task,      // Function that should be called
-                "calibration",         // Name of the task (for debugging)
-                4096,                  // Stack size (bytes)
-                this,                  // Parameter to pass
-                1,                     // Task priority
-                NULL                   // Task handle
-            );
+            if (post_command(cCalibrate) == false)
+            {
+                status.state = ProportionalStatus::Channel::sIdle;
+                r = "Channel worker not available";
+                ERROR("Request to calibrate, channel worker not available")
+            }
        }
     }
     else
@@ -1012,8 +1138,8 @@ String ChannelHandler::actuate(uint8_t value, uint8_t ref, bool force)
     {
         // actuation should be possible at any time
         // if calibration is ongoing - then actuation will always be done afterwards
-        // if another actuation is ongoing - then the task will check at the end and restart actuation if the
-        // new value is different from its former target value
+        // if another actuation is ongoing - then the worker is told to retarget: a timed move is cut short
+        // and the actuation restarts from where the motor is towards the new value
 
         if (value > 100)
         {
@@ -1025,6 +1151,12 @@ String ChannelHandler::actuate(uint8_t value, uint8_t ref, bool force)
             ref = UINT8_MAX;
         }
 
+        bool should_post = false;
+        bool should_retarget = false;
+
+        // the state is checked and changed under the same lock the worker uses when it decides to go idle,
+        // so a new value can not fall between the chairs at the moment an ongoing actuation finishes
+
         {Lock lock(semaphore);
 
         if (force || status.value != value)
@@ -1037,30 +1169,37 @@ String ChannelHandler::actuate(uint8_t value, uint8_t ref, bool force)
             r = "Value unchanged, actuation skipped";
         }   
 
-        next_actuate_ref = ref; } 
-
-        // theoretically there could be a slight chance that we fall between the chairs and
-        // do not start new actuation at exact moment the one which is ongoing finishes
-        // TODO?
+        next_actuate_ref = ref; 
 
         if (r.isEmpty())
         {
             if (status.state == ProportionalStatus::Channel::sIdle)
             {
                 status.state = ProportionalStatus::Channel::sActuating;
+                should_post = true;
+            }
+            else if (status.state == ProportionalStatus::Channel::sActuating)
+            {
+                should_retarget = true;
+            }
+        }}
 
-                TRACE("starting actuation task")
+        if (should_post)
+        {
+            TRACE("posting actuation to channel worker")
 
-                xTaskCreate(
-                    actuation_task,        // Function that should be called
-                    "actuation",           // Name of the task (for debugging)
-                    4096,                  // Stack size (bytes)
-                    this,                  // Parameter to pass
-                    1,                     // Task priority
-                    NULL                   // Task handle
-                );
+            if (post_command(cActuate) == false)
+            {
+                status.state = ProportionalStatus::Channel::sIdle;
+                r = "Channel worker not available, actuation skipped";
             }
         }
+
+        if (should_retarget)
+        {
+            TRACE("retargeting ongoing actuation")
+            notify_worker(NOTIFY_RETARGET);
+        }
     }
     else
     {
@@ -1077,140 +1216,535 @@ String ChannelHandler::actuate(uint8_t value, uint8_t ref, bool force)
     return r;
 }
 
-void ChannelHandler::configure_hw()
+void ChannelHandler::start_worker()
 {
-    // ignore debounce, the circuit contains schmidt trigger that should fix the dribble
+    if (worker_handle == NULL)
+    {
+        command_queue = xQueueCreate(COMMAND_QUEUE_LENGTH, sizeof(uint8_t));
 
-    TRACE("configure open: gpio=%d, inverted=%d", (int)config.open.gpio, (int)config.open.inverted)
-    gpioHandler.setupChannel(config.open.gpio, INPUT_PULLUP, config.open.inverted, NULL);
+        if (command_queue == NULL)
+        {
+            ERROR("failed to create channel command queue")
+            return;
+        }
 
-    TRACE("configure closed: gpio=%d, inverted=%d", (int)config.closed.gpio, (int)config.closed.inverted)
-    gpioHandler.setupChannel(config.closed.gpio, INPUT_PULLUP, config.closed.inverted, NULL);
+        esp_timer_create_args_t sampler_args = {};
+        sampler_args.callback = sampler_callback;
+        sampler_args.arg = this;
+        sampler_args.dispatch_method = ESP_TIMER_TASK;
+        sampler_args.name = "proportional_sampler";
 
-    write_one(config, false, false);
+        if (esp_timer_create(&sampler_args, &sampler) != ESP_OK)
+        {
+            ERROR("failed to create channel current sampler, no signature and stall detection")
+            sampler = NULL;
+        }
 
-    TRACE("configure one_a: gpio=%d, inverted=%d", (int)config.one_a.gpio, (int)config.one_a.inverted)
-    gpioHandler.setupChannel(config.one_a.gpio, OUTPUT, config.one_a.inverted, NULL);
+        _is_worker_finished = false;
 
-    TRACE("configure one_b: gpio=%d, inverted=%d", (int)config.one_b.gpio, (int)config.one_b.inverted)
-    gpioHandler.setupChannel(config.one_b.gpio, OUTPUT, config.one_b.inverted, NULL);
+        TRACE("starting channel worker task")
 
-    TRACE("configure load_detect.pin: gpio=%d, atten=%d", (int)config.load_detect.pin.gpio, 
-          (int)config.load_detect.pin.atten)
-    analogSetPinAttenuation(config.load_detect.pin.gpio, (adc_attenuation_t)config.load_detect.pin.atten);
+        xTaskCreate(
+            worker_task,           // Function that should be called
+            "proportional_ch",     // Name of the task (for debugging)
+            4096,                  // Stack size (bytes)
+            this,                  // Parameter to pass
+            1,                     // Task priority
+            &worker_handle         // Task handle
+        );
+    }
 }
 
-void ChannelHandler::write_one(const ProportionalConfig::Channel & config, bool a_value, bool b_value)
+void ChannelHandler::stop_worker()
 {
-    // avoid using non-static functions of gpiochannel to skip thread synchronisation
+    if (worker_handle != NULL)
+    {
+        TRACE("stopping channel worker task")
 
-    GpioChannel::write(config.one_a.gpio, config.one_a.inverted, a_value);
-    GpioChannel::write(config.one_b.gpio, config.one_b.inverted, b_value);
+        uint8_t command = cTerminate;
+        xQueueSend(command_queue, &command, portMAX_DELAY);
 
-    DEBUG("write_one (a=%s gpio%d, b=%s gpio%d)", a_value ? "true":"false", (int) config.one_a.gpio, b_value ? "true":"false", (int) config.one_b.gpio)
+        while(_is_worker_finished == false)
+        {
+            delay(100);
+        }
+
+        worker_handle = NULL;
+    }
+
+    if (command_queue != NULL)
+    {
+        vQueueDelete(command_queue);
+        command_queue = NULL;
+    }
+
+    if (sampler != NULL)
+    {
+        esp_timer_stop(sampler);
+        esp_timer_delete(sampler);
+        sampler = NULL;
+    }
 }
 
-void ChannelHandler::write_one_2_open(const ProportionalConfig::Channel & config)
+bool ChannelHandler::post_command(Command command)
 {
-    write_one(config, false, true);
+    if (worker_handle == NULL || command_queue == NULL)
+    {
+        return false;
+    }
+
+    uint8_t _command = (uint8_t) command;
+    return xQueueSend(command_queue, &_command, 0) == pdTRUE;
 }
 
-void ChannelHandler::write_one_2_closed(const ProportionalConfig::Channel & config)
+void ChannelHandler::notify_worker(uint32_t bits)
 {
-    write_one(config, true, false);
+    if (worker_handle != NULL)
+    {
+        xTaskNotify(worker_handle, bits, eSetBits);
+    }
 }
 
-void ChannelHandler::write_one_stop(const ProportionalConfig::Channel & config)
+void ChannelHandler::worker_task(void *parameter)
 {
-    write_one(config, false, false);
+    ChannelHandler *_this = (ChannelHandler *)parameter;
+
+    TRACE("channel worker_task: started")
+
+    while(1)
+    {
+        uint8_t command = cNone;
+
+        if (xQueueReceive(_this->command_queue, &command, portMAX_DELAY) != pdTRUE)
+        {
+            continue;
+        }
+
+        if (command == cTerminate)
+        {
+            break;
+        }
+
+        // drop cancel / retarget requests that were addressed to a previous command
+
+        ulTaskNotifyValueClear(NULL, NOTIFY_CANCEL | NOTIFY_RETARGET);
+
+        if (command == cCalibrate)
+        {
+            run_calibration(_this);
+        }
+        else if (command == cActuate)
+        {
+            run_actuation(_this);
+        }
+    }
+
+    TRACE("channel worker_task: terminated")
+
+    _this->_is_worker_finished = true;
+    vTaskDelete(NULL);
 }
 
-bool ChannelHandler::read(const DigitalInputChannelConfig & config)
+void IRAM_ATTR ChannelHandler::endstop_interrupt_handler(gpio_num_t gpio)
 {
-    // avoid using non-static functions of gpiochannel to skip thread synchronisation
+    if (gpio < 0 || gpio >= GPIO_NUM_MAX)
+    {
+        return;
+    }
 
-    return GpioChannel::read(config.gpio, config.inverted);
+    ChannelHandler * channel_handler = endstop_channels[gpio];
+
+    if (channel_handler != NULL && channel_handler->worker_handle != NULL)
+    {
+        BaseType_t higher_priority_task_woken = pdFALSE;
+        xTaskNotifyFromISR(channel_handler->worker_handle, NOTIFY_ENDSTOP, eSetBits, &higher_priority_task_woken);
+
+        if (higher_priority_task_woken == pdTRUE)
+        {
+            portYIELD_FROM_ISR();
+        }
+    }
 }
 
-float ChannelHandler::read_current(const ProportionalConfig::Channel::LoadDetect & _config)
+void ChannelHandler::begin_sampling(bool to_open)
 {
-    unsigned readout = analog_read(_config.pin.gpio);
-    float voltage = (readout * 0.75 ) / 8191;  
-    float current = voltage * _config.resistance;
-    DEBUG("read_current: readout %d, voltage %f, current %f", (int) readout, voltage, current)
-    return current;
+    {Lock lock(semaphore);
+
+    signature.begin(to_open, CURRENT_SAMPLE_INTERVAL);
+
+    sampling_begin = millis();
+    running_current = 0;
+    previous_current = 0;
+    load_window.reset();
+    stall_samples = 0;
+    _is_detected = false;
+    _is_sampling = true; }
+
+    if (sampler != NULL)
+    {
+        esp_timer_start_periodic(sampler, CURRENT_SAMPLE_INTERVAL * 1000);
+    }
 }
 
-unsigned ChannelHandler::analog_read(uint8_t gpio)
+void ChannelHandler::end_sampling(TravelResult travel_result, uint32_t duration)
 {
-    adcAttachPin(gpio);
-    /* adcStart(gpio);
-    
-    int max_attempts = 10;
-
-    while(adcBusy(gpio) == true)
+    if (sampler != NULL)
     {
-        delay(10);
-        max_attempts--;
+        esp_timer_stop(sampler);
+    }
 
-        if (max_attempts <= 0)
-        {
-            ERROR("Timeout reading adc, gpio=%d", (int) gpio)
-            return 0;
-        }
-    } */
+    // a sample that is being taken right now is dropped by the callback once it gets the lock
 
-    return analogRead(gpio);
+    Lock lock(semaphore);
+
+    _is_sampling = false;
+
+    signature.duration = duration;
+    signature.result = travel_result_2_str(travel_result);
+    last_signature = signature;
+
+    DEBUG("move signature %s", last_signature.as_string().c_str())
 }
 
-void ChannelHandler::calibration_task(void *parameter)
+void ChannelHandler::sampler_callback(void *parameter)
 {
+    // runs in the esp_timer task every CURRENT_SAMPLE_INTERVAL while the motor of this channel runs
+
     ChannelHandler *_this = (ChannelHandler *)parameter;
 
-    TRACE("calibration_task started, status %s", _this->status.as_string().c_str())
+    if (_this->_is_sampling == false)
+    {
+        return;
+    }
 
-    // try to minimize go-time by either going to another end-state if the motor is in one of the end-states
-    // or making to end-state + open-close cycle so that we end up closest to the value 
+    float current = read_current(_this->config.load_detect);
+    uint32_t notify = 0;
 
-    size_t timeout_seconds = 40;
+    {Lock lock(_this->semaphore);
 
-    if (_this->valve_profile.open_time != 0)
+    if (_this->_is_sampling == false)
     {
-        timeout_seconds = _this->valve_profile.open_time * 4;    
+        return;
     }
 
-    DEBUG("calibration timeout set to %d seconds", (int) timeout_seconds)
-
-    size_t num_passes = 3;
+    _this->signature.push(current);
 
-    uint8_t run_to[3];
-    uint32_t milliseconds[3];
-    
-    bool is_open = read(_this->config.open);
-    bool is_closed = read(_this->config.closed);
+    // keep this path short and free of logging, the esp_timer task has a small stack and serves others too;
+    // the worker reports what was detected
 
-    #ifdef ASYMMETRICAL_OPEN_CLOSE
+    uint32_t time_passed = millis() - _this->sampling_begin;
+    bool is_inrush = time_passed < MOTOR_INRUSH_TIME;
 
-    if (is_open == true || is_closed == true)
+    if (_this->_is_detected == false)
     {
-        num_passes = 2;
+        if (is_inrush == false)
+        {
+            _this->load_window.push(current);
+        }
 
-        if (is_open == true)
+        if (_this->load_window.is_window_full() && 
+            _this->load_window.get_mean(0) < _this->config.load_detect.current_threshold)
         {
-            run_to[0] = 0;
-            run_to[1] = 100;
+            notify = NOTIFY_NO_LOAD;
+            _this->_is_detected = true;
+        }
+        else if (is_inrush == false && current > _this->running_current * STALL_CURRENT_FACTOR && 
+                 current >= _this->previous_current)
+        {
+            _this->stall_samples++;
+
+            if (_this->stall_samples >= STALL_SAMPLES)
+            {
+                _this->signature.stall_at = time_passed;
+                notify = NOTIFY_STALL;
+                _this->_is_detected = true;
+            }
         }
         else
         {
-            run_to[0] = 100;
-            run_to[1] = 0;
+            // the running current only follows the samples which are not part of a possible stall
+
+            _this->stall_samples = 0;
+            _this->running_current = _this->running_current == 0 ? current : 
+                                     _this->running_current + (current - _this->running_current) / 8;
         }
     }
-    else
-    {
-        num_passes = 3;
 
-        if (_this->status.value > 50)
+    _this->previous_current = current; }
+
+    if (notify != 0)
+    {
+        _this->notify_worker(notify);
+    }
+}
+
+ChannelHandler::TravelResult ChannelHandler::travel(bool to_open, const DigitalInputChannelConfig * wait_on, 
+                                                    uint32_t run_ms, uint32_t timeout_ms, bool can_retarget, 
+                                                    uint32_t & elapsed_ms)
+{
+    // runs the motor until the wait_on endstop is reached (if given), run_ms has passed (if non-zero), the
+    // timeout expires, the sampler detects no load or a stall or the move is cancelled / retargeted; the 
+    // worker does not poll in between, it sleeps on its notification
+
+    elapsed_ms = 0;
+
+    if (wait_on != NULL && read(*wait_on) == true)
+    {
+        return trEndstop;
+    }
+
+    // an edge or a detection left over from the previous move would end this one immediately
+
+    ulTaskNotifyValueClear(NULL, NOTIFY_ENDSTOP | NOTIFY_STALL | NOTIFY_NO_LOAD);
+
+    begin_sampling(to_open);
+
+    uint32_t t_begin = millis();
+
+    if (to_open)
+    {
+        write_one_2_open(config);
+    }
+    else
+    {
+        write_one_2_closed(config);
+    }
+
+    TravelResult r = trElapsed;
+
+    while(1)
+    {
+        uint32_t time_passed = millis() - t_begin;
+
+        if (run_ms > 0 && time_passed >= run_ms)
+        {
+            r = trElapsed;
+            break;
+        }
+
+        if (time_passed > timeout_ms)
+        {
+            ERROR("travel timeout detected, time passed %d ms", (int) time_passed)
+            r = trTimeout;
+            break;
+        }
+
+        uint32_t wait_ms = timeout_ms - time_passed + 1;
+
+        if (run_ms > 0 && run_ms - time_passed < wait_ms)
+        {
+            wait_ms = run_ms - time_passed;
+        }
+
+        uint32_t notified = 0;
+        xTaskNotifyWait(0, NOTIFY_ENDSTOP | NOTIFY_CANCEL | NOTIFY_RETARGET | NOTIFY_STALL | NOTIFY_NO_LOAD, 
+                        &notified, pdMS_TO_TICKS(wait_ms));
+
+        if (_is_active == false || (notified & NOTIFY_CANCEL))
+        {
+            r = trCancelled;
+            break;
+        }
+
+        // check the level rather than trusting the edge alone, an endstop could bounce or be missed
+
+        if (wait_on != NULL && read(*wait_on) == true)
+        {
+            r = trEndstop;
+            break;
+        }
+
+        if (notified & NOTIFY_NO_LOAD)
+        {
+            ERROR("no load detected, measured current %f, configured threshold %f", 
+                (float) load_window.get_mean(0), config.load_detect.current_threshold)
+            r = trNoLoad;
+            break;
+        }
+
+        if (notified & NOTIFY_STALL)
+        {
+            TRACE("stall detected after %d ms, running current %f", (int) (millis() - t_begin), running_current)
+            r = trStall;
+            break;
+        }
+
+        if (can_retarget && (notified & NOTIFY_RETARGET))
+        {
+            r = trRetargeted;
+            break;
+        }
+    }
+
+    write_one_stop(config);
+
+    elapsed_ms = millis() - t_begin;
+
+    end_sampling(r, elapsed_ms);
+    return r;
+}
+
+void ChannelHandler::configure_hw()
+{
+    // ignore debounce, the circuit contains schmidt trigger that should fix the dribble
+
+    // endstops are registered before their interrupts are enabled, the handler might fire right away 
+
+    if (config.open.gpio >= 0 && config.open.gpio < GPIO_NUM_MAX)
+    {
+        endstop_channels[config.open.gpio] = this;
+    }
+
+    if (config.closed.gpio >= 0 && config.closed.gpio < GPIO_NUM_MAX)
+    {
+        endstop_channels[config.closed.gpio] = this;
+    }
+
+    TRACE("configure open: gpio=%d, inverted=%d", (int)config.open.gpio, (int)config.open.inverted)
+    gpioHandler.setupChannel(config.open.gpio, INPUT_PULLUP, config.open.inverted, endstop_interrupt_handler);
+
+    TRACE("configure closed: gpio=%d, inverted=%d", (int)config.closed.gpio, (int)config.closed.inverted)
+    gpioHandler.setupChannel(config.closed.gpio, INPUT_PULLUP, config.closed.inverted, endstop_interrupt_handler);
+
+    write_one(config, false, false);
+
+    TRACE("configure one_a: gpio=%d, inverted=%d", (int)config.one_a.gpio, (int)config.one_a.inverted)
+    gpioHandler.setupChannel(config.one_a.gpio, OUTPUT, config.one_a.inverted, NULL);
+
+    TRACE("configure one_b: gpio=%d, inverted=%d", (int)config.one_b.gpio, (int)config.one_b.inverted)
+    gpioHandler.setupChannel(config.one_b.gpio, OUTPUT, config.one_b.inverted, NULL);
+
+    TRACE("configure load_detect.pin: gpio=%d, atten=%d", (int)config.load_detect.pin.gpio, 
+          (int)config.load_detect.pin.atten)
+    analogSetPinAttenuation(config.load_detect.pin.gpio, (adc_attenuation_t)config.load_detect.pin.atten);
+}
+
+void ChannelHandler::cleanup_hw()
+{
+    // detach the endstop interrupts so that a reused gpio does not notify this channel anymore
+
+    if (config.open.gpio >= 0 && config.open.gpio < GPIO_NUM_MAX && endstop_channels[config.open.gpio] == this)
+    {
+        gpioHandler.cleanupChannel(config.open.gpio);
+        endstop_channels[config.open.gpio] = NULL;
+    }
+
+    if (config.closed.gpio >= 0 && config.closed.gpio < GPIO_NUM_MAX && endstop_channels[config.closed.gpio] == this)
+    {
+        gpioHandler.cleanupChannel(config.closed.gpio);
+        endstop_channels[config.closed.gpio] = NULL;
+    }
+}
+
+void ChannelHandler::write_one(const ProportionalConfig::Channel & config, bool a_value, bool b_value)
+{
+    // avoid using non-static functions of gpiochannel to skip thread synchronisation
+
+    GpioChannel::write(config.one_a.gpio, config.one_a.inverted, a_value);
+    GpioChannel::write(config.one_b.gpio, config.one_b.inverted, b_value);
+
+    DEBUG("write_one (a=%s gpio%d, b=%s gpio%d)", a_value ? "true":"false", (int) config.one_a.gpio, b_value ? "true":"false", (int) config.one_b.gpio)
+}
+
+void ChannelHandler::write_one_2_open(const ProportionalConfig::Channel & config)
+{
+    write_one(config, false, true);
+}
+
+void ChannelHandler::write_one_2_closed(const ProportionalConfig::Channel & config)
+{
+    write_one(config, true, false);
+}
+
+void ChannelHandler::write_one_stop(const ProportionalConfig::Channel & config)
+{
+    write_one(config, false, false);
+}
+
+bool ChannelHandler::read(const DigitalInputChannelConfig & config)
+{
+    // avoid using non-static functions of gpiochannel to skip thread synchronisation
+
+    return GpioChannel::read(config.gpio, config.inverted);
+}
+
+float ChannelHandler::read_current(const ProportionalConfig::Channel::LoadDetect & _config)
+{
+    unsigned readout = analog_read(_config.pin.gpio);
+    float voltage = (readout * 0.75 ) / 8191;  
+    float current = voltage * _config.resistance;
+    // no logging here, this is called from the sampler at CURRENT_SAMPLE_INTERVAL
+    return current;
+}
+
+unsigned ChannelHandler::analog_read(uint8_t gpio)
+{
+    adcAttachPin(gpio);
+    /* adcStart(gpio);
+    
+    int max_attempts = 10;
+
+    while(adcBusy(gpio) == true)
+    {
+        delay(10);
+        max_attempts--;
+
+        if (max_attempts <= 0)
+        {
+            ERROR("Timeout reading adc, gpio=%d", (int) gpio)
+            return 0;
+        }
+    } */
+
+    return analogRead(gpio);
+}
+
+void ChannelHandler::run_calibration(ChannelHandler * _this)
+{
+    TRACE("run_calibration started, status %s", _this->status.as_string().c_str())
+
+    // try to minimize go-time by either going to another end-state if the motor is in one of the end-states
+    // or making to end-state + open-close cycle so that we end up closest to the value 
+
+    size_t timeout_seconds = 40;
+
+    if (_this->valve_profile.open_time != 0)
+    {
+        timeout_seconds = _this->valve_profile.open_time * 4;    
+    }
+
+    DEBUG("calibration timeout set to %d seconds", (int) timeout_seconds)
+
+    size_t num_passes = 3;
+
+    uint8_t run_to[3];
+    uint32_t milliseconds[3];
+    
+    bool is_open = read(_this->config.open);
+    bool is_closed = read(_this->config.closed);
+
+    #ifdef ASYMMETRICAL_OPEN_CLOSE
+
+    if (is_open == true || is_closed == true)
+    {
+        num_passes = 2;
+
+        if (is_open == true)
+        {
+            run_to[0] = 0;
+            run_to[1] = 100;
+        }
+        else
+        {
+            run_to[0] = 100;
+            run_to[1] = 0;
+        }
+    }
+    else
+    {
+        num_passes = 3;
+
+        if (_this->status.value > 50)
         {
             run_to[0] = 100;
             run_to[1] = 0;
@@ -1260,7 +1794,6 @@ void ChannelHandler::calibration_task(void *parameter)
     int pass = 0;
     bool is_error = false;
     const char * error_str = "";
-    Averager<float, 5> current_averager;
 
     int _is_open = (int)read(_this->config.open);
     int _is_closed = (int)read(_this->config.closed);
@@ -1279,112 +1812,41 @@ void ChannelHandler::calibration_task(void *parameter)
         {
             TRACE("calibration pass %d, run_to %d", pass, (int) run_to[pass])
 
-            uint32_t t_begin = millis();
-            DigitalInputChannelConfig wait_on;
-
-            if (run_to[pass] == 100)
-            {
-                wait_on = _this->config.open;
-            }
-            else
-            {
-                wait_on = _this->config.closed;
-            }
-
-            bool ready = read(wait_on);
-
-            if (ready == false)
-            {
-                if (run_to[pass] == 100)
-                {
-                    write_one_2_open(_this->config);
-                }
-                else
-                {
-                    write_one_2_closed(_this->config);
-                }
-            }
-
-            size_t c_count = 0;
-            current_averager.reset();
-
-            while(_this->_is_active == true)
-            {
-                if (ready == true)
-                {
-                    break;
-                }
-
-                delay(1);
-                ready = read(wait_on);
-
-                if (c_count % 200 == 0)
-                {
-                    unsigned long t_probe = millis();
-                    unsigned long time_passed = 0;
-
-                    if (t_begin <= t_probe)
-                    {
-                        time_passed = t_probe - t_begin;
-                    }
-                    else
-                    {
-                        time_passed = t_probe + (ULONG_MAX - t_begin);
-                    }
-
-                    if (time_passed > timeout_seconds * 1000)
-                    {
-                        ERROR("calibration timeout detected, t_begin %d, t_probe %d", (int) t_begin, (int) t_probe)
-                        is_error = true;
-                        error_str = "calibration error: timeout";
-                        break;
-                    }
-
-                    float current = read_current(_this->config.load_detect);
-                    current_averager.push(current);
-
-                    if (current_averager.is_window_full())
-                    {
-                        float average_current = current_averager.get_average(0);
-                        TRACE("average current %f", average_current)
-
-                        if (average_current < _this->config.load_detect.current_threshold)
-                        {
-                            ERROR("calibration no load detected, measured current %f, configured threshold %f", 
-                                current, _this->config.load_detect.current_threshold)
-                            is_error = true;
-                            error_str = "calibration error: no load";
-                            break;
-                        }
-                    }
-                }
-                
-                c_count ++;
-            }
+            const DigitalInputChannelConfig & wait_on = run_to[pass] == 100 ? _this->config.open : _this->config.closed;
 
-            write_one_stop(_this->config);
+            uint32_t elapsed_ms = 0;
+            TravelResult travel_result = _this->travel(run_to[pass] == 100, &wait_on, 0, timeout_seconds * 1000, 
+                                                       false, elapsed_ms);
 
-            if (_this->_is_active == false)
+            if (travel_result == trCancelled || _this->_is_active == false)
             {
                 break;
             }
             
-            if (is_error == true)
+            if (travel_result == trTimeout)
             {
+                ERROR("calibration timeout detected after %d ms", (int) elapsed_ms)
+                is_error = true;
+                error_str = "calibration error: timeout";
                 break;
             }
 
-            unsigned long t_end = millis();
-
-            if (t_begin < t_end)
+            if (travel_result == trNoLoad)
             {
-                milliseconds[pass] = t_end - t_begin;
+                is_error = true;
+                error_str = "calibration error: no load";
+                break;
             }
-            else
+
+            if (travel_result == trStall)
             {
-                milliseconds[pass] = t_end + (ULONG_MAX - t_begin);
+                // valves without limit switches stall at their mechanical end instead
+
+                TRACE("calibration pass %d ended by stall", pass)
             }
 
+            milliseconds[pass] = elapsed_ms;
+
             _this->status.value = run_to[pass]; 
 
             TRACE("milliseconds %d", (int) milliseconds[pass])
@@ -1409,7 +1871,7 @@ void ChannelHandler::calibration_task(void *parameter)
 
         #endif // ASYMMETRICAL_OPEN_CLOSE
 
-        _this->actuate_ref = UINT8_MAX;
+        _this->reset_position(POSITION_UNKNOWN);
 
         if  (_this->_is_active == false)
         {
@@ -1430,14 +1892,14 @@ void ChannelHandler::calibration_task(void *parameter)
             _this->status.calib_open_2_closed_time = run_to[1] == 0 ? milliseconds[1] : milliseconds[2];
             _this->status.calib_closed_2_open_time = run_to[1] == 100 ? milliseconds[1] : milliseconds[2];
 
-            _this->actuate_ref = run_to[2];
+            _this->reset_position(run_to[2] == 100 ? POSITION_FULL : 0);
         }
         else
         {
             _this->status.calib_open_2_closed_time = run_to[0] == 0 ? milliseconds[0] : milliseconds[1];
             _this->status.calib_closed_2_open_time = run_to[0] == 100 ? milliseconds[0] : milliseconds[1];
 
-            _this->actuate_ref = run_to[1];
+            _this->reset_position(run_to[1] == 100 ? POSITION_FULL : 0);
         }
 
         #else
@@ -1445,36 +1907,46 @@ void ChannelHandler::calibration_task(void *parameter)
         if (num_passes == 2)
         {
             _this->status.calib_open_time = milliseconds[1];
-            _this->actuate_ref = run_to[1];
+            _this->reset_position(run_to[1] == 100 ? POSITION_FULL : 0);
         }
         else
         {
             _this->status.calib_open_time = milliseconds[0];
-            _this->actuate_ref = run_to[0];
+            _this->reset_position(run_to[0] == 100 ? POSITION_FULL : 0);
         }
 
         #endif // ASYMMETRICAL_OPEN_CLOSE
     }
 
-    _this->actuate_ms = 0;
     _this->status.state = ProportionalStatus::Channel::sIdle; 
 
     _this->_calib_data_needs_save = true; }
 
-    TRACE("calibration_task: terminated, status %s", _this->status.as_string().c_str())
-    vTaskDelete(NULL);
+    TRACE("run_calibration: finished, status %s", _this->status.as_string().c_str())
 }
 
-void ChannelHandler::actuation_task(void *parameter)
+void ChannelHandler::add_position(bool to_open, uint32_t run_ms, uint32_t full_time)
 {
-    ChannelHandler *_this = (ChannelHandler *)parameter;
+    // integrates a timed move into the position estimate, the drift grows with every move since the motor
+    // speed is never exactly the calibrated one and the motor does not start / stop instantly
 
-    TRACE("actuation_task started, status %s", _this->status.as_string().c_str())
+    int16_t distance = full_time == 0 ? POSITION_FULL : (int16_t) std::min<uint32_t>((run_ms * POSITION_FULL) / full_time, 
+                                                                                     POSITION_FULL);
+    int32_t new_position = to_open ? position + distance : position - distance;
+
+    position = (int16_t) std::max<int32_t>(0, std::min<int32_t>(new_position, POSITION_FULL));
+    position_drift += POSITION_DRIFT_PER_MOVE + (distance * POSITION_DRIFT_PER_TRAVEL) / POSITION_FULL;
+    actuate_add_ups++;
+}
+
+void ChannelHandler::run_actuation(ChannelHandler * _this)
+{
+    TRACE("run_actuation started, status %s", _this->status.as_string().c_str())
 
     while(1)  // in case value has changed while actuation is ongoing
     {
-        TRACE("before: actuate_ref %d, actuate_ms %d, actuate_add_ups %d next_actuate_ref %d", (int) _this->actuate_ref,
-            (int) _this->actuate_ms, (int) _this->actuate_add_ups, (int) _this->next_actuate_ref)
+        TRACE("before: position %d, position_drift %d, actuate_add_ups %d next_actuate_ref %d", (int) _this->position,
+            (int) _this->position_drift, (int) _this->actuate_add_ups, (int) _this->next_actuate_ref)
         
         // store and use this in case actuation value changes during this task; if it happens - restart the while loop 
         uint8_t current_value = _this->status.value;  
@@ -1482,17 +1954,6 @@ void ChannelHandler::actuation_task(void *parameter)
         uint32_t open_2_closed_time = 0;
         uint32_t closed_2_open_time = 0;
 
-        // unset actuate_ref means tbat we need to restart to some reference and go from there;
-        // one of the use cases including this - reading calibration data from eprom and then directly
-        // setting the value
-
-        bool should_restart = !(_this->actuate_ref == 0 || _this->actuate_ref == 100);
-
-        if (should_restart)
-        {
-            DEBUG("will restart due to unset actuate_ref")
-        }
-
         #ifdef ASYMMETRICAL_OPEN_CLOSE
 
         open_2_closed_time = _this->status.calib_open_2_closed_time;
@@ -1519,62 +1980,48 @@ void ChannelHandler::actuation_task(void *parameter)
 
         if (open_2_closed_time > 0 && closed_2_open_time > 0)
         {
-            // none of these will be needed if the next_actuate_ref is specified (see should_restart condition
-            // below) but we declare them here because they are used for other parts of algo
-            
-            uint32_t new_actuate_ms_from_closed = flow_2_time(_this->valve_profile, current_value, closed_2_open_time, 0);
-            uint32_t new_actuate_ms_from_open = flow_2_time(_this->valve_profile, current_value, open_2_closed_time, 100);  
+            // target position in permille of the full travel counted from closed; flow_2_time does the 
+            // mapping through the flow table, it just gets the "full time" in permille
+
+            int16_t target = (int16_t) flow_2_time(_this->valve_profile, current_value, POSITION_FULL, 0);
+
+            // we only go through an end-state when we have to: explicit command, unknown position (e.g. after 
+            // boot or an error) or when the estimate has drifted too far; otherwise move directly from the 
+            // estimated position to the target
 
-            uint32_t open_time = closed_2_open_time; 
-            uint32_t new_actuate_ms = new_actuate_ms_from_closed;
-            int delta = (int) new_actuate_ms;
+            bool should_restart = false;
+            uint8_t go_through = 0;
 
-            if (should_restart)
+            if (_this->next_actuate_ref == 0 || _this->next_actuate_ref == 100)
             {
-                // this means unset reference, go the simple case with restarting through reference 0 
-                _this->next_actuate_ref = current_value == 100 ? 100 : 0;   
+                DEBUG("will restart from %d due to explicit command", (int) _this->next_actuate_ref)
+                should_restart = true;
+                go_through = _this->next_actuate_ref;
             }
-            else
+            else if (_this->position == POSITION_UNKNOWN)
             {
-                open_time = _this->actuate_ref == 0 ? closed_2_open_time : open_2_closed_time; 
-                new_actuate_ms = _this->actuate_ref == 0 ? new_actuate_ms_from_closed : new_actuate_ms_from_open;
-                delta = (int) new_actuate_ms - (int) _this->actuate_ms;
-
-                DEBUG("new_actuate_ms_from_closed %d, new_actuate_ms_from_open %d, new_actuate_ms %d, delta %d",
-                    (int) new_actuate_ms_from_closed, (int) new_actuate_ms_from_open, (int)new_actuate_ms, delta)
+                DEBUG("will restart due to unknown position")
+                should_restart = true;
+                go_through = current_value == 100 ? 100 : 0;   
+            }
+            else if (_this->position_drift > MAX_POSITION_DRIFT || 
+                     _this->actuate_add_ups >= _this->valve_profile.max_actuate_add_ups)
+            {
+                DEBUG("will restart due to position drift %d or add-up threshold", (int) _this->position_drift)
+                should_restart = true;
 
-                if (_this->next_actuate_ref == 0 || _this->next_actuate_ref == 100)
-                {
-                    DEBUG("will restart from %d due to explicit command", (int) _this->next_actuate_ref)
-                    should_restart = true;
-                }
-                else if (_this->actuate_ms >= open_time || _this->actuate_add_ups >= _this->valve_profile.max_actuate_add_ups)
-                {
-                    DEBUG("will restart due to invalid actuate_ms or add-up threshold")
-                    should_restart = true;
-                }
-                else if (current_value <= 10 || current_value >= 90)
-                {
-                    DEBUG("will restart due to value is too close to an end-state")
-                    // if value is close enough to an end-state - dont bother with add-up, restart and go from there 
-                    should_restart = true;
-                }
-                else
-                {
-                    #ifdef ASYMMETRICAL_OPEN_CLOSE
+                // select nearest by minimum of go-time sum : go-to-end-state + go-to-new-value
 
-                    // if we have asymmetrical times closed-2-open and open-2-closed then we should 
-                    // only continue if delta is > 0
+                uint32_t go_time_through_closed = position_2_time(_this->position, open_2_closed_time) + 
+                                                  position_2_time(target, closed_2_open_time);
+                uint32_t go_time_through_open = position_2_time(POSITION_FULL - _this->position, closed_2_open_time) + 
+                                                position_2_time(POSITION_FULL - target, open_2_closed_time);
 
-                    if (delta < 0)
-                    {
-                        should_restart = true;
-                        DEBUG("will restart due to negative delta")
-                    }                
-                    # endif // ASYMMETRICAL_OPEN_CLOSE
-                }
+                go_through = go_time_through_closed < go_time_through_open ? 0 : 100;
             }
 
+            _this->next_actuate_ref = UINT8_MAX;
+
             size_t timeout_seconds = 30;
 
             if (_this->valve_profile.open_time != 0)
@@ -1584,134 +2031,33 @@ void ChannelHandler::actuation_task(void *parameter)
 
             bool is_error = false;
             const char * error_str = "";
-            Averager<float, 5> current_averager;
 
             if (should_restart == true)
             {
-                // we need to reset to a nearest end-state and start from there;
-
-                uint8_t go_through = 0;
-
-                if (_this->next_actuate_ref == 0 || _this->next_actuate_ref == 100)
-                {
-                    go_through = _this->next_actuate_ref;
-                    _this->next_actuate_ref = UINT8_MAX;
-                }
-                else if (_this->actuate_ms >= open_time)
-                {
-                    go_through = new_actuate_ms_from_closed < new_actuate_ms_from_open ? 0 : 100;
-                }
-                /*else if (current_value <= 10)
-                {
-                    go_through = 0;
-                }
-                else if (current_value >= 90)
-                {
-                    go_through = 100;
-                }*/
-                else
-                {
-                    // select nearest by minimum of go-time sum : go-to-end-state + go-to-new-value
-
-                    uint32_t go_time_to_closed = _this->actuate_ref == 0 ? _this->actuate_ms : (open_2_closed_time -_this->actuate_ms);
-                    uint32_t go_time_to_open = _this->actuate_ref == 100 ? _this->actuate_ms : (closed_2_open_time-_this->actuate_ms);
-
-                    uint32_t go_time_through_closed = go_time_to_closed + new_actuate_ms_from_closed;
-                    uint32_t go_time_through_open = go_time_to_open + new_actuate_ms_from_open;
-
-                    go_through = go_time_through_closed < go_time_through_open ? 0 : 100;
-                }
-
-                new_actuate_ms = go_through == 0 ? new_actuate_ms_from_closed : new_actuate_ms_from_open;                    
-                delta = new_actuate_ms;
-
-                TRACE("Will actuate going through state %d, go-time is %d ms", (int) go_through, (int) new_actuate_ms)                    
                 TRACE("Resetting to end-state %d", (int) go_through)                    
 
-                uint32_t t_begin = millis();
-                DigitalInputChannelConfig wait_on;
+                const DigitalInputChannelConfig & wait_on = go_through == 100 ? _this->config.open : _this->config.closed;
 
-                if (go_through == 100)
-                {
-                    wait_on = _this->config.open;
-                }
-                else
+                uint32_t elapsed_ms = 0;
+                TravelResult travel_result = _this->travel(go_through == 100, &wait_on, 0, timeout_seconds * 1000, 
+                                                           false, elapsed_ms);
+
+                if (travel_result == trTimeout)
                 {
-                    wait_on = _this->config.closed;
+                    ERROR("actuation timeout detected after %d ms", (int) elapsed_ms)
+                    is_error = true;
+                    error_str = "actuation error: timeout at resetting to end-state";
                 }
-
-                bool ready = read(wait_on);
-
-                if (ready == false)
+                else if (travel_result == trNoLoad)
                 {
-                    if (go_through == 100)
-                    {
-                        write_one_2_open(_this->config);
-                    }
-                    else
-                    {
-                        write_one_2_closed(_this->config);
-                    }
+                    is_error = true;
+                    error_str = "actuation error: no load";
                 }
-
-                size_t c_count = 0;
-
-                while(_this->_is_active == true)
+                else if (travel_result == trStall)
                 {
-                    if (ready == true)
-                    {
-                        break;
-                    }
-
-                    delay(1);
-                    ready = read(wait_on);
-
-                    if (c_count % 200 == 0)
-                    {
-                        unsigned long t_probe = millis();
-                        unsigned long time_passed = 0;
-
-                        if (t_begin <= t_probe)
-                        {
-                            time_passed = t_probe - t_begin;
-                        }
-                        else
-                        {
-                            time_passed = t_probe + (ULONG_MAX - t_begin);
-                        }
-
-                        if (time_passed > timeout_seconds * 1000)
-                        {
-                            ERROR("actuation timeout detected, t_begin %d, t_probe %d", (int) t_begin, (int) t_probe)
-                            is_error = true;
-                            error_str = "actuation error: timeout at resetting to end-state";
-                            break;
-                        }
-
-                        float current = read_current(_this->config.load_detect);
-                        current_averager.push(current);
-
-                        if (current_averager.is_window_full())
-                        {
-                            float average_current = current_averager.get_average(0);
-                            TRACE("average current %f", average_current)
-
-                            if (average_current < _this->config.load_detect.current_threshold)
-                            {                        
-                                ERROR("actuation no load detected, measured current %f, configured threshold %f", 
-                                    current, _this->config.load_detect.current_threshold)
-                                is_error = true;
-                                error_str = "actuation error: no load";
-                                break;
-                            }
-                        }
-                    }
-                    
-                    c_count ++;
+                    TRACE("end-state %d taken as reached by stall", (int) go_through)
                 }
 
-                write_one_stop(_this->config);
-                
                 if (is_error == true || _this->_is_active == false)
                 {
                     if  (_this->_is_active == false)
@@ -1722,121 +2068,113 @@ void ChannelHandler::actuation_task(void *parameter)
                     _this->status.error = error_str;
                     ERROR(error_str)
 
-                    _this->actuate_ref = UINT8_MAX;
+                    _this->reset_position(POSITION_UNKNOWN);
                 }
                 else
                 {
                     TRACE("End-state %d reached", (int) go_through)                    
 
-                    _this->actuate_ref = go_through;    
+                    _this->reset_position(go_through == 100 ? POSITION_FULL : 0);
                     _this->status.error.clear();
 
                     delay(1000); // let the motor stop
                 }
-
-                _this->actuate_ms = 0;
-                _this->actuate_add_ups = 0;
-            }
-            else
-            {
-                TRACE("Will actuate from current ref, delta %d ms", (int) delta)
             }
 
             if (_this->_is_active == true && is_error == false)
             {
-                TRACE("Adding up delta %d ms", (int) delta)                    
+                bool is_end_target = target == 0 || target == POSITION_FULL;
+                bool to_open = is_end_target ? target == POSITION_FULL : target > _this->position;
 
-                // continue with add-up
+                uint32_t full_time = to_open ? closed_2_open_time : open_2_closed_time;
+                uint32_t run_ms = position_2_time(abs(target - _this->position), full_time);
 
-                if (abs(delta)  <= 50)
+                TRACE("Moving from position %d to %d, run time %d ms", (int) _this->position, (int) target, 
+                    (int) run_ms)                    
+
+                if (is_end_target == false && run_ms <= MIN_MOVE_TIME)
                 {                
-                    TRACE("Delta is too short - do nothing")                    
+                    TRACE("Move is too short - do nothing")                    
 
-                    // do nothing since we cannot get a predictable motor movement for this time (50ms)
-                    // neither update actuate_ms and actuate_add_ups
+                    // do nothing since we cannot get a predictable motor movement for this time;
+                    // neither update position nor actuate_add_ups
                 }
                 else
                 {
-                    read_current(_this->config.load_detect);
+                    // an end target is run until its endstop which also references the position; a timed move 
+                    // still stops early if it hits the endstop in its direction
+
+                    const DigitalInputChannelConfig & wait_on = to_open ? _this->config.open : _this->config.closed;
 
-                    uint32_t t_begin = millis();
+                    uint32_t elapsed_ms = 0;
+                    TravelResult travel_result = _this->travel(to_open, &wait_on, is_end_target ? 0 : run_ms, 
+                                                               timeout_seconds * 1000, true, elapsed_ms);
 
-                    if (_this->actuate_ref == 100)
+                    if (travel_result == trEndstop)
                     {
-                        if (delta > 0)
-                        {
-                            write_one_2_closed(_this->config);
-                        }
-                        else
+                        if (is_end_target == false)
                         {
-                            write_one_2_open(_this->config);
+                            TRACE("endstop reached after %d ms of %d ms, position corrected", (int) elapsed_ms, 
+                                (int) run_ms)
                         }
+
+                        _this->reset_position(to_open ? POSITION_FULL : 0);
                     }
-                    else
+                    else if (travel_result == trElapsed || 
+                             (travel_result == trRetargeted && _this->_is_active == true))
                     {
-                        if (delta > 0)
-                        {
-                            write_one_2_open(_this->config);
-                        }
-                        else
+                        // a retargeted move was cut short by a new value; account for the part that was 
+                        // actually travelled and let the value check below restart the actuation from here
+
+                        if (travel_result == trRetargeted)
                         {
-                            write_one_2_closed(_this->config);
+                            TRACE("actuation retargeted after %d ms of %d ms", (int) elapsed_ms, (int) run_ms)
                         }
-                    }
 
-                    read_current(_this->config.load_detect);
-
-                    size_t c_count = 0;
-
-                    while(_this->_is_active == true)
+                        _this->add_position(to_open, elapsed_ms, full_time);
+                    }
+                    else if ((travel_result == trNoLoad || travel_result == trStall) && is_end_target == false)
                     {
-                        delay(1);
+                        // motorized valves cut their motor at their own mechanical end, others stall there; 
+                        // if either happens where we expect that end anyway take it as reaching it rather 
+                        // than as an error
 
-                        unsigned long t_probe = millis();
-                        unsigned long time_passed = 0;
+                        _this->add_position(to_open, elapsed_ms, full_time);
 
-                        if (t_begin <= t_probe)
-                        {
-                            time_passed = t_probe - t_begin;
-                        }
-                        else
-                        {
-                            time_passed = t_probe + (ULONG_MAX - t_begin);
-                        }
+                        int16_t distance_to_end = to_open ? POSITION_FULL - _this->position : _this->position;
 
-                        if (time_passed >= abs(delta))
+                        if (distance_to_end <= (int16_t) _this->position_drift)
                         {
-                            break;
-                        }
+                            TRACE("%s within drift %d of end-state, position corrected", 
+                                travel_result_2_str(travel_result), (int) _this->position_drift)
 
-                        if (c_count % 200 == 0)
+                            _this->reset_position(to_open ? POSITION_FULL : 0);
+                        }
+                        else
                         {
-                            float current = read_current(_this->config.load_detect);
-                            current_averager.push(current);
-
-                            if (current_averager.is_window_full())
-                            {
-                                float average_current = current_averager.get_average(0);
-                                TRACE("average current %f", average_current)
-
-                                if (average_current < _this->config.load_detect.current_threshold)
-                                {
-                                ERROR("actuation no load detected, measured current %f, configured threshold %f", 
-                                    current, _this->config.load_detect.current_threshold)
-                                is_error = true;
-                                error_str = "actuation error: no load";
-                                break;
-                                }
-                            }
+                            is_error = true;
+                            error_str = travel_result == trStall ? "actuation error: stall" : "actuation error: no load";
                         }
-
-                        c_count++;
                     }
+                    else if (travel_result == trNoLoad)
+                    {
+                        is_error = true;
+                        error_str = "actuation error: no load";
+                    }
+                    else if (travel_result == trStall)
+                    {
+                        // an end target is run until its endstop, a stall is its mechanical end (no limit switch)
 
-                    read_current(_this->config.load_detect);
+                        TRACE("stall at end-state, taken as reached")
+                        _this->reset_position(to_open ? POSITION_FULL : 0);
+                    }
+                    else if (travel_result == trTimeout)
+                    {
+                        ERROR("actuation timeout detected after %d ms", (int) elapsed_ms)
+                        is_error = true;
+                        error_str = "actuation error: timeout at going to end-state";
+                    }
 
-                    write_one_stop(_this->config);
-                    
                     if (is_error == true || _this->_is_active == false)
                     {
                         if (_this->_is_active == false)
@@ -1847,13 +2185,10 @@ void ChannelHandler::actuation_task(void *parameter)
                         _this->status.error = error_str;
                         ERROR(error_str)
 
-                        _this->actuate_ms = UINT32_MAX;
+                        _this->reset_position(POSITION_UNKNOWN);
                     }
                     else
                     {
-                        _this->actuate_ms += delta;
-                        _this->actuate_add_ups++;
-
                         _this->status.error.clear();
                     }
                 }
@@ -1861,13 +2196,13 @@ void ChannelHandler::actuation_task(void *parameter)
             
             _this->status.actuate_add_ups = _this->actuate_add_ups;
 
-            TRACE("after: actuate_ref %d, actuate_ms %d, actuate_add_ups %d next_actuate_ref %d", (int) _this->actuate_ref,
-                (int) _this->actuate_ms, (int) _this->actuate_add_ups, (int) _this->next_actuate_ref)
+            TRACE("after: position %d, position_drift %d, actuate_add_ups %d next_actuate_ref %d", (int) _this->position,
+                (int) _this->position_drift, (int) _this->actuate_add_ups, (int) _this->next_actuate_ref)
 
             if (current_value != _this->status.value)
             {
-                TRACE("actuation value has changed while actuation task was ongoing (current value %d, new value %d), "
-                    "restarting the task", (int) current_value, (int) _this->status.value)
+                TRACE("actuation value has changed while actuation was ongoing (current value %d, new value %d), "
+                    "restarting the actuation", (int) current_value, (int) _this->status.value)
 
                 continue; // while(1)    
             }
@@ -1879,13 +2214,30 @@ void ChannelHandler::actuation_task(void *parameter)
             ERROR(error_str)
         }
 
-        break;
+        // go idle under the same lock as actuate() takes; a value set after the check above would otherwise 
+        // be lost since actuate() only retargets (and does not post) while the state is still actuating
+
+        bool is_done = true;
+
+        {Lock lock(_this->semaphore);
+
+        if (current_value != _this->status.value && _this->_is_active == true)
+        {
+            is_done = false;
+        }
+        else
+        {
+            _this->status.state = ProportionalStatus::Channel::sIdle;
+        }}
+
+        if (is_done)
+        {
+            break;
+        }
 
     } // while(1)
 
-    _this->status.state = ProportionalStatus::Channel::sIdle;
-    TRACE("actuation_task: terminated, status %s", _this->status.as_string().c_str())
-    vTaskDelete(NULL);
+    TRACE("run_actuation: finished, status %s", _this->status.as_string().c_str())
 }
 
 uint32_t ChannelHandler::flow_2_time(const ProportionalConfig::ValveProfile & _valve_profile,  
@@ -2153,44 +2505,61 @@ void ProportionalHandler::task(void *parameter)
     const size_t SAVE_DATA_INTERVAL = 10; // seconds
     unsigned long last_save_data_millis = millis();
 
+    TelemetryLoop * loop_telemetry = telemetry_loop("proportional_task");
+
     while (_this->_is_active)
     {
+        telemetry_loop_mark(loop_telemetry);
+
         #ifdef USE_ACTION_QUEUE
 
+        // a calibration starts when all channels are idle, the actuations queued behind it as soon as no
+        // channel calibrates; they all go in the same pass
+
         { Lock lock(_this->semaphore);
 
-        if (_this->action_queue.empty() == false)
+        while (_this->action_queue.empty() == false)
         {
-            bool all_are_idle = true;
+            auto action = _this->action_queue.front();
 
-            for (auto it=_this->channel_handlers.begin(); it!=_this->channel_handlers.end(); ++it)
+            if (action.second.action == ActionAndValue::aCalibrate)
             {
-                if ((*it)->is_idle() == false)
+                bool all_are_idle = true;
+
+                for (auto it=_this->channel_handlers.begin(); it!=_this->channel_handlers.end(); ++it)
+                {
+                    if ((*it)->is_idle() == false)
+                    {
+                        all_are_idle = false;
+                        break;
+                    }
+                }
+
+                if (all_are_idle == false)
                 {
-                    all_are_idle = false;
                     break;
                 }
             }
-
-            if (all_are_idle == true)
+            else if (_this->is_any_calibrating())
             {
-                auto action = _this->action_queue.front();
-                _this->action_queue.pop_front();
+                break;
+            }
 
-                DEBUG("proportional task pop action from queue: channel %d, action %d, value %d, ref %d",
-                      (int) action.first, (int) action.second.action, (int) action.second.value, 
-                      (int) action.second.ref)
+            _this->action_queue.pop_front();
 
-                if (action.first >= 0 && action.first < _this->channel_handlers.size())
+            DEBUG("proportional task pop action from queue: channel %d, action %d, value %d, ref %d",
+                  (int) action.first, (int) action.second.action, (int) action.second.value, 
+                  (int) action.second.ref)
+
+            if (action.first >= 0 && action.first < _this->channel_handlers.size())
+            {
+                if (action.second.action == ActionAndValue::aCalibrate)
                 {
-                    if (action.second.action == ActionAndValue::aCalibrate)
-                    {
-                        _this->channel_handlers[action.first]->calibrate();
-                    }
-                    else if (action.second.action == ActionAndValue::aActuate)
-                    {
-                        _this->channel_handlers[action.first]->actuate(action.second.value, action.second.ref, action.second.force);
-                    }
+                    _this->channel_handlers[action.first]->calibrate();
+                }
+                else if (action.second.action == ActionAndValue::aActuate)
+                {
+                    _this->channel_handlers[action.first]->actuate(action.second.value, action.second.ref, action.second.force);
                 }
             }
         }}
@@ -2438,15 +2807,38 @@ String ProportionalHandler::calibrate(size_t channel)
 
 String ProportionalHandler::actuate(size_t channel, uint8_t value, uint8_t ref, bool force)
 {
-    TRACE("actuate channel %d value %d ref %d", (int) channel, (int) value, (int) ref)
-    String r;
+    Lock lock(semaphore);
+    return _actuate(channel, value, ref, force);
+}
 
+void ProportionalHandler::actuate_batch(const std::vector<Actuation> & actuations, std::vector<String> & results)
+{
     Lock lock(semaphore);
 
+    for (size_t i=0; i<actuations.size(); ++i)
+    {
+        results[i] = _actuate(actuations[i].channel, actuations[i].value, actuations[i].ref, false);
+    }
+}
+
+String ProportionalHandler::_actuate(size_t channel, uint8_t value, uint8_t ref, bool force)
+{
+    TRACE("actuate channel %d value %d ref %d", (int) channel, (int) value, (int) ref)
+    String r;
+
     if (channel >= 0 && channel < channel_handlers.size())
     {
         #ifdef USE_ACTION_QUEUE
 
+        // an actuation goes straight to the worker of its channel, a moving channel is retargeted mid-travel and
+        // the channels move side by side; it only waits in the queue behind a calibration, a running one (it
+        // needs the power supply for itself) or a queued one of the same channel (it has to go first)
+
+        if (channel_handlers[channel]->is_actuating() || (is_any_calibrating() == false && is_queued(channel) == false))
+        {
+            return channel_handlers[channel]->actuate(value, ref, force);
+        }
+
         DEBUG("push action to queue: channel %d, action aActuate, value %d, ref %d, force %d", (int) channel, (int) value, (int) ref, (int) force)
         action_queue.push_back(std::make_pair(channel, ActionAndValue(ActionAndValue::aActuate, value, ref, force)));
 
@@ -2464,6 +2856,54 @@ String ProportionalHandler::actuate(size_t channel, uint8_t value, uint8_t ref,
     return r;
 }
 
+#ifdef USE_ACTION_QUEUE
+
+bool ProportionalHandler::is_any_calibrating() const
+{
+    for (auto it=channel_handlers.begin(); it!=channel_handlers.end(); ++it)
+    {
+        if ((*it)->is_calibrating())
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ProportionalHandler::is_queued(size_t channel) const
+{
+    for (auto it=action_queue.begin(); it!=action_queue.end(); ++it)
+    {
+        if (it->first == (int) channel)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#endif // USE_ACTION_QUEUE
+
+String ProportionalHandler::get_signature(size_t channel, ProportionalSignature & signature)
+{
+    String r;
+
+    Lock lock(semaphore);
+
+    if (channel >= 0 && channel < channel_handlers.size())
+    {
+        signature = channel_handlers[channel]->get_signature();
+    }
+    else
+    {
+        r = "channel out of range";
+    }
+
+    return r;
+}
+
 bool ProportionalHandler::does_data_need_save() 
 {
     Lock lock(semaphore);
@@ -2737,37 +3177,32 @@ bool __is_number_or_empty(const String & value)
     return true;
 }
 
-String proportional_actuate(const String & channel_str, const String & value_str, const String & ref_str)
+static String parse_actuate_args(const String & channel_str, const String & value_str, const String & ref_str,
+                                 ProportionalHandler::Actuation & actuation)
 {
-    bool param_ok = true;
-
     if (!channel_str.isEmpty() && !value_str.isEmpty())
     {
-        param_ok = __is_number_or_empty(channel_str) && __is_number_or_empty(value_str) && 
-                   __is_number_or_empty(ref_str);
-
-        size_t channel = (size_t)  channel_str.toInt();
-        uint8_t value = (uint8_t)  value_str.toInt();
-        
-        uint8_t ref = UINT8_MAX;
+        actuation.channel = (size_t)  channel_str.toInt();
+        actuation.value = (uint8_t)  value_str.toInt();
+        actuation.ref = UINT8_MAX;
 
         if (!ref_str.isEmpty())
         {
-            ref = (uint8_t)  ref_str.toInt();
+            actuation.ref = (uint8_t)  ref_str.toInt();
         }        
 
         DEBUG("validating channel number, get_num_channels %d", (int)handler.get_num_channels())
-        if (channel >= 0 && channel < handler.get_num_channels())
+        if (actuation.channel >= 0 && actuation.channel < handler.get_num_channels())
         {
-            if (value >= 0 && value <= 100)
+            if (actuation.value >= 0 && actuation.value <= 100)
             {
-                if (!(ref == 0 || ref == 100 || ref == UINT8_MAX))
+                if (!(actuation.ref == 0 || actuation.ref == 100 || actuation.ref == UINT8_MAX))
                 {
                     return "Optional ref could only be 0 or 100"; 
                 }
                 else
                 {
-                    return handler.actuate(channel, value, ref);
+                    return String();
                 }
             }
             else
@@ -2780,9 +3215,75 @@ String proportional_actuate(const String & channel_str, const String & value_str
             return "Channel out of range"; 
         }
     }
-    else
+    
+    return "Parameter error";
+}
+
+String proportional_actuate(const String & channel_str, const String & value_str, const String & ref_str)
+{
+    ProportionalHandler::Actuation actuation;
+    String r = parse_actuate_args(channel_str, value_str, ref_str, actuation);
+
+    if (r.length() > 0)
     {
-        param_ok = false;
+        return r;
+    }
+
+    return handler.actuate(actuation.channel, actuation.value, actuation.ref);
+}
+
+void proportional_actuate_batch(const std::vector<std::vector<String>> & channel_value_refs, std::vector<String> & results)
+{
+    results.assign(channel_value_refs.size(), String());
+
+    std::vector<ProportionalHandler::Actuation> actuations;
+    std::vector<size_t> indices;    // of the actuations in channel_value_refs
+
+    for (size_t i=0; i<channel_value_refs.size(); ++i)
+    {
+        const std::vector<String> & args = channel_value_refs[i];
+        ProportionalHandler::Actuation actuation;
+
+        results[i] = args.size() == 3 ? parse_actuate_args(args[0], args[1], args[2], actuation) : String("Parameter error");
+
+        if (results[i].length() == 0)
+        {
+            actuations.push_back(actuation);
+            indices.push_back(i);
+        }
+    }
+
+    std::vector<String> actuation_results(actuations.size());
+    handler.actuate_batch(actuations, actuation_results);
+
+    for (size_t i=0; i<indices.size(); ++i)
+    {
+        results[indices[i]] = actuation_results[i];
+    }
+}
+
+String proportional_get_signature(const String & channel_str, JsonVariant & json)
+{
+    if (!channel_str.isEmpty() && __is_number_or_empty(channel_str))
+    {
+        size_t channel = (size_t)  channel_str.toInt();
+
+        if (channel >= 0 && channel < handler.get_num_channels())
+        {
+            ProportionalSignature signature;
+            String r = handler.get_signature(channel, signature);
+
+            if (r.isEmpty())
+            {
+                signature.to_json(json);
+            }
+
+            return r;
+        }
+        else
+        {
+            return "Channel out of range"; 
+        }
     }
     
     return "Parameter error";
@@ -7,15 +7,154 @@
 #include <autonom.h>
 #include <wifiHandler.h>
 #include <logBuffer.h>
+#include <bumpArena.h>
+#include <boot.h>
+#include <telemetry.h>
+#include <binLog.h>
+#include <deflate.h>
+
+#ifdef INCLUDE_MQTT
+#include <mqtt.h>
+#endif
 
 extern WifiHandler wifiHandler;
 
 #define BIG_JSON_BUFFER_SIZE 8192
 #define SMALL_JSON_BUFFER_SIZE 256
 
+#define LOG_RING_MAX_POP 32       // binary log records per /poplog, the rest stays for the next call
+#define LOG_RING_MAX_BATCH 64     // per /poplog?since=, the collector asks again while "more" is true
+#define MIN_ENCODED_BODY_SIZE 256 // smaller responses are not worth compressing
+
 #define SERIALIZE_BUFFER_SIZE 16384
 static char _buffer[SERIALIZE_BUFFER_SIZE]; // for serialization of bigger things, not thread safe!
 
+#ifndef REQUEST_ARENA_SIZE
+#define REQUEST_ARENA_SIZE (2*BIG_JSON_BUFFER_SIZE+1024)  // the biggest handler has two big documents
+#endif
+
+// the JSON documents of a request come from a bump arena that is reset when the response has been sent,
+// what does not fit goes to the heap; requests are served one at a time by the web server, like _buffer
+
+static uint8_t request_arena_buffer[REQUEST_ARENA_SIZE] __attribute__((aligned(BumpArena::ALIGNMENT)));
+static BumpArena request_arena;
+
+// a compressed response body, kept in the arena until the response has been sent
+static void * encoded_body = NULL;
+
+static void initRequestArena()
+{
+  if (request_arena.get_size() == 0)
+  {
+    request_arena.init(request_arena_buffer, sizeof(request_arena_buffer));
+  }
+}
+
+struct RequestArenaAllocator
+{
+  void * allocate(size_t size)
+  {
+    initRequestArena();
+
+    void * m = request_arena.allocate(size);
+    return m ? m : malloc(size);
+  }
+
+  void deallocate(void * m)
+  {
+    if (request_arena.owns(m))
+    {
+      request_arena.deallocate(m);
+    }
+    else
+    {
+      free(m);
+    }
+  }
+
+  void * reallocate(void * m, size_t size)
+  {
+    if (request_arena.owns(m) == false)
+    {
+      return realloc(m, size);
+    }
+
+    void * r = request_arena.reallocate(m, size);
+
+    if (r == NULL)
+    {
+      size_t extent = request_arena.get_extent(m);
+      r = malloc(size);
+
+      if (r)
+      {
+        memcpy(r, m, extent < size ? extent : size);
+        request_arena.deallocate(m);
+      }
+    }
+
+    return r;
+  }
+};
+
+typedef BasicJsonDocument<RequestArenaAllocator> RequestJsonDocument;
+
+// the documents of the GET routes go out as JSON or, if the request accepts it, as MessagePack: the same
+// document, 30-50% smaller and without number formatting; MessagePack is binary, so it is left in _buffer and
+// handed to the web server in the RestDocument of the request instead of the returned String
+
+// the length of the document in _buffer
+
+static size_t serializeDocument(const RequestJsonDocument & jsonDocument, uint8_t format)
+{
+  if (format == rfMsgPack)
+  {
+    return serializeMsgPack(jsonDocument, _buffer, SERIALIZE_BUFFER_SIZE);
+  }
+
+  return serializeJson(jsonDocument, _buffer, SERIALIZE_BUFFER_SIZE);
+}
+
+// empty if the document is binary, it is in document.body then
+
+static String serializeResponse(const RequestJsonDocument & jsonDocument, RestDocument & document)
+{
+  size_t length = serializeDocument(jsonDocument, document.format);
+
+  if (document.format == rfMsgPack)
+  {
+    document.body = _buffer;
+    document.body_length = length;
+    return String();
+  }
+
+  return String(_buffer);
+}
+
+
+void restEndRequest()
+{
+  if (encoded_body != NULL)
+  {
+    request_arena.deallocate(encoded_body);
+    encoded_body = NULL;
+  }
+
+  if (request_arena.reset() == false)
+  {
+    ERROR("request arena not reset, a document of the request is still alive")
+  }
+}
+
+
+static void getRequestArena(JsonVariant & json)
+{
+  json["size"] = sizeof(request_arena_buffer);
+  json["high_water"] = request_arena.get_high_water();
+  json["overflows"] = request_arena.get_overflows();
+  json["refused_resets"] = request_arena.get_refused_resets();
+}
+
 
 void getSystem(JsonVariant & json)
 {
@@ -31,15 +170,52 @@ void getSystem(JsonVariant & json)
     sprintf(buf, "%02dd %02dh %02dm %02ds", days, hours, minutes, seconds);
     json["uptime"] = String(buf);
 
+  json.createNestedObject("request_arena");
+  JsonVariant request_arena_json = json["request_arena"];
+  getRequestArena(request_arena_json);
+
+  #ifdef INCLUDE_MQTT
+  json.createNestedObject("mqtt");
+  JsonVariant mqtt_json = json["mqtt"];
+  getMqtt(mqtt_json);
+  #endif
+
     TRACE("System uptime %s", buf)
 }
 
 
-String restPing(bool include_info) 
+void getBoot(JsonVariant & json)
+{
+  // ms since power-on at the end of each stage, in the order they were done
+
+  json.createNestedObject("stages");
+  JsonVariant stages = json["stages"];
+
+  for (size_t i=0; i<boot_get_stage_count(); ++i)
+  {
+    const char * name = NULL;
+    uint32_t _millis = 0;
+
+    if (boot_get_stage(i, name, _millis))
+    {
+      stages[name] = _millis;
+    }
+  }
+
+  json.createNestedObject("ready");
+  JsonVariant ready = json["ready"];
+
+  ready["network"] = boot_is(beNetwork);
+  ready["time"] = boot_is(beTime);
+  ready["www"] = boot_is(beWww);
+}
+
+
+String restPing(bool include_info, RestDocument & document) 
 {
   TRACE("REST ping")
 
-  DynamicJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
+  RequestJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
 
   jsonDocument["version"] = REST_VERSION;
 
@@ -104,6 +280,12 @@ String restPing(bool include_info)
 
   #endif
 
+#ifdef INCLUDE_MQTT
+
+  sw_caps.add("mqtt");
+
+  #endif
+
   if (include_info)
   {
     jsonDocument["wifiinfo"] = wifiHandler.getWifiInfo();
@@ -113,21 +295,23 @@ String restPing(bool include_info)
   JsonVariant system = jsonDocument["system"];
   getSystem(system);
 
-  serializeJson(jsonDocument, _buffer, SERIALIZE_BUFFER_SIZE); 
-  return String(_buffer);
+  jsonDocument.createNestedObject("boot");
+  JsonVariant boot = jsonDocument["boot"];
+  getBoot(boot);
+
+  return serializeResponse(jsonDocument, document);
 }
 
 
-String restWifiInfo() 
+String restWifiInfo(RestDocument & document) 
 {
   TRACE("REST wifiinfo")
 
-  DynamicJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
+  RequestJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
 
   jsonDocument["wifiinfo"] = wifiHandler.getWifiInfo();
 
-  serializeJson(jsonDocument, _buffer, SERIALIZE_BUFFER_SIZE); 
-  return String(_buffer);
+  return serializeResponse(jsonDocument, document);
 }
 
 
@@ -137,7 +321,7 @@ String restSetup(const String & body, const String & resetStamp)
   DEBUG("resetStamp %s", resetStamp.c_str())
   DEBUG(body.c_str())
 
-  DynamicJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
+  RequestJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
 
   deserializeJson(jsonDocument, body);
 
@@ -163,7 +347,7 @@ String restSetupPm(const String & body, const String & resetStamp)
   DEBUG("resetStamp %s", resetStamp.c_str())
   DEBUG(body.c_str())
 
-  DynamicJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
+  RequestJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
 
   deserializeJson(jsonDocument, body);
 
@@ -178,7 +362,7 @@ String restSetupAutonom(const String & body)
   TRACE("REST setup AUTONOM")
   //DEBUG(body.c_str())
 
-  DynamicJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
+  RequestJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
 
   deserializeJson(jsonDocument, body);
 
@@ -240,6 +424,63 @@ String restResetPm(const String & resetStamp)
   return String("{}");
 }
 
+String restActionAutonomShowerGuardReplay(const String & body, String & response)
+{
+  TRACE("REST action autonom shower-guard replay")
+
+  // the trace comes in and the decisions go out, two documents keep either from eating into the other
+
+  RequestJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
+
+  DeserializationError error = deserializeJson(jsonDocument, body);
+
+  if (error)
+  {
+    return String("json parse error: ") + error.c_str();
+  }
+
+  RequestJsonDocument resultDocument(BIG_JSON_BUFFER_SIZE);
+  JsonVariant result_variant = resultDocument.to<JsonVariant>();
+
+  String r = actionAutonomShowerGuardReplay(jsonDocument.as<JsonVariant>(), result_variant);
+
+  if (r.isEmpty())
+  {
+    serializeJson(resultDocument, _buffer, SERIALIZE_BUFFER_SIZE); 
+    response = _buffer;
+  }
+
+  return r;
+}
+
+String restActionAutonomBatch(const String & body, String & response)
+{
+  TRACE("REST action autonom batch")
+  DEBUG(body.c_str())
+
+  RequestJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
+
+  DeserializationError error = deserializeJson(jsonDocument, body);
+
+  if (error)
+  {
+    return String("json parse error: ") + error.c_str();
+  }
+
+  RequestJsonDocument resultDocument(BIG_JSON_BUFFER_SIZE);
+  JsonVariant result_variant = resultDocument.to<JsonVariant>();
+
+  String r = actionAutonomBatch(jsonDocument.as<JsonVariant>(), result_variant);
+
+  if (r.isEmpty())
+  {
+    serializeJson(resultDocument, _buffer, SERIALIZE_BUFFER_SIZE); 
+    response = _buffer;
+  }
+
+  return r;
+}
+
 String restActionAutonomKeyboxActuate(const String & channel_str)
 {
   TRACE("REST action autonom keybox actuate")
@@ -303,17 +544,16 @@ String restActionAutonomRfidLockUnlock(const String & lock_channel_str)
   return actionAutonomRfidLockUnlock(lock_channel_str);
 }
 
-String restGetAutonomRfidLockCodes()
+String restGetAutonomRfidLockCodes(RestDocument & document)
 {
   TRACE("REST get autonom rfid-lock codes")
 
-  DynamicJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
+  RequestJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
 
   JsonVariant json_variant = jsonDocument.as<JsonVariant>();
   getAutonomRfidLockCodes(json_variant);
 
-  serializeJson(jsonDocument, _buffer, SERIALIZE_BUFFER_SIZE); 
-  return String(_buffer);
+  return serializeResponse(jsonDocument, document);
 }
 
 String restActionAutonomProportionalCalibrate(const String & channel_str)
@@ -333,6 +573,25 @@ String restActionAutonomProportionalActuate(const String & channel_str, const St
   return actionAutonomProportionalActuate(channel_str, value_str, ref_str);
 }
 
+String restGetAutonomProportionalSignature(const String & channel_str, String & response)
+{
+  TRACE("REST get autonom proportional signature")
+  DEBUG("channel %s", channel_str.c_str())
+
+  RequestJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
+
+  JsonVariant json_variant = jsonDocument.as<JsonVariant>();
+  String r = getAutonomProportionalSignature(channel_str, json_variant);
+
+  if (r.isEmpty())
+  {
+    serializeJson(jsonDocument, _buffer, SERIALIZE_BUFFER_SIZE); 
+    response = _buffer;
+  }
+
+  return r;
+}
+
 String restActionAutonomZero2tenCalibrateInput(const String & channel_str, const String & value_str)
 {
   TRACE("REST action autonom zero2ten calibrate input")
@@ -413,17 +672,16 @@ String restActionAutonomMainsProbeInputALow(const String & channel_str, String &
   return actionAutonomMainsProbeInputALow(channel_str, value_str);
 }
 
-String restGetAutonomMainsProbeCalibrationData()
+String restGetAutonomMainsProbeCalibrationData(RestDocument & document)
 {
   TRACE("REST get autonom mains-probe calibration data")
 
-  DynamicJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
+  RequestJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
 
   JsonVariant json_variant = jsonDocument.as<JsonVariant>();
   getAutonomMainsProbeCalibrationData(json_variant);
 
-  serializeJson(jsonDocument, _buffer, SERIALIZE_BUFFER_SIZE); 
-  return String(_buffer);
+  return serializeResponse(jsonDocument, document);
 }
 
 String restActionAutonomMainsProbeImportCalibrationData(const String & body)
@@ -431,7 +689,7 @@ String restActionAutonomMainsProbeImportCalibrationData(const String & body)
   TRACE("REST action autonom mains-probe import calibration data")
   DEBUG(body.c_str())
 
-  DynamicJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
+  RequestJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
 
   deserializeJson(jsonDocument, body);
   JsonVariant json_variant = jsonDocument.as<JsonVariant>();
@@ -466,12 +724,20 @@ String restActionAutonomMultiAudioControl(const String & source, const String &
   return actionAutonomMultiAudioControl(source, channel, volume, response);
 }
 
+String restActionLogLevel(const String & module_str, const String & level_str)
+{
+  TRACE("REST action log level")
+  DEBUG("module %s, level %s", module_str.c_str(), level_str.c_str())
+
+  return log_ring_set_level(module_str, level_str);
+}
+
 String restActionAutonomMultiSetVolatile(const String & body)
 {
   TRACE("REST action autonom multi set volatile")
   DEBUG(body.c_str())
 
-  DynamicJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
+  RequestJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
 
   deserializeJson(jsonDocument, body);
   JsonVariant json_variant = jsonDocument.as<JsonVariant>();
@@ -491,11 +757,11 @@ String restActionAutonomMultiSetVolatile(const String & body)
   return r;
 }
 
-String restGet(const String & resetStamp) 
+String restGet(const String & resetStamp, RestDocument & document) 
 {
   TRACE("REST get")
 
-  DynamicJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
+  RequestJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
 
   #ifdef INCLUDE_PM 
 
@@ -511,53 +777,174 @@ String restGet(const String & resetStamp)
   jsonDocument.createNestedObject("system");
   JsonVariant system = jsonDocument["system"];
   getSystem(system);
+  get_telemetry(system);
 
-  serializeJson(jsonDocument, _buffer, SERIALIZE_BUFFER_SIZE); 
-  return String(_buffer);
+  return serializeResponse(jsonDocument, document);
 }
 
 
-String restGetPm(const String & resetStamp) 
+String restGetPm(const String & resetStamp, RestDocument & document) 
 {
   TRACE("REST get PM")
 
-  DynamicJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
+  RequestJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
 
   JsonVariant pm = jsonDocument.as<JsonVariant>();
   getPm(pm, resetStamp);
 
-  serializeJson(jsonDocument, _buffer, SERIALIZE_BUFFER_SIZE); 
-  return String(_buffer);
+  return serializeResponse(jsonDocument, document);
 }
 
 
-String restGetAutonom() 
+String restGetAutonom(RestDocument & document) 
 {
   TRACE("REST get AUTONOM")
 
-  DynamicJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
+  RequestJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
 
   JsonVariant autonom = jsonDocument.as<JsonVariant>();
   getAutonom(autonom);
 
-  serializeJson(jsonDocument, _buffer, SERIALIZE_BUFFER_SIZE); 
-  return String(_buffer);
+  return serializeResponse(jsonDocument, document);
 }
 
 
-String restPopLog() 
+String restPopLog(RestDocument & document) 
 {
   TRACE("REST pop log")
 
-  DynamicJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
+  RequestJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
 
   jsonDocument.createNestedObject("log");
   JsonVariant log = jsonDocument["log"];
   popLog(log);
+  jsonDocument.createNestedObject("log_ring");
+  JsonVariant log_ring = jsonDocument["log_ring"];
+  pop_log_ring(log_ring, LOG_RING_MAX_POP, BIG_JSON_BUFFER_SIZE/2);
   jsonDocument.createNestedObject("system");
   JsonVariant system = jsonDocument["system"];
   getSystem(system);
 
-  serializeJson(jsonDocument, _buffer, SERIALIZE_BUFFER_SIZE); 
-  return String(_buffer);
+  return serializeResponse(jsonDocument, document);
+}
+
+static size_t serializeLogRing(uint32_t since, size_t max_records, uint8_t format)
+{
+  RequestJsonDocument jsonDocument(BIG_JSON_BUFFER_SIZE);
+
+  JsonVariant log_ring = jsonDocument.as<JsonVariant>();
+  get_log_ring(log_ring, since, max_records, BIG_JSON_BUFFER_SIZE*3/4);
+
+  return serializeDocument(jsonDocument, format);
+}
+
+// compresses _buffer into the arena, the arena is empty here; NULL if it does not fit or does not pay off
+
+static void * encodeBody(size_t length, uint8_t format, size_t & encoded_length)
+{
+  initRequestArena();
+
+  const size_t hash_size = DeflateEncoder::HASH_SIZE * sizeof(uint16_t);
+  size_t room = request_arena.get_size() - request_arena.get_used();
+
+  if (room < hash_size + 2 * BumpArena::ALIGNMENT + MIN_ENCODED_BODY_SIZE)
+  {
+    return NULL;
+  }
+
+  size_t out_size = room - hash_size - 2 * BumpArena::ALIGNMENT;
+  out_size = out_size < length ? out_size : length;
+
+  // the hash table is the last block, it is given back in place
+
+  uint8_t * out = (uint8_t *) request_arena.allocate(out_size);
+  uint16_t * hash = out ? (uint16_t *) request_arena.allocate(hash_size) : NULL;
+
+  if (hash == NULL)
+  {
+    if (out)
+    {
+      request_arena.deallocate(out);
+    }
+
+    return NULL;
+  }
+
+  encoded_length = DeflateEncoder::compress((const uint8_t *) _buffer, length, out, out_size, hash, format);
+  request_arena.deallocate(hash);
+
+  if (encoded_length == 0)
+  {
+    request_arena.deallocate(out);
+    return NULL;
+  }
+
+  return out;
+}
+
+String restPopLogSince(const String & since_str, const String & max_str, const String & accept_encoding, uint8_t format,
+                       const char * & body, size_t & body_length, const char * & content_encoding)
+{
+  TRACE("REST pop log since")
+  DEBUG("since %s, max %s, accept-encoding %s", since_str.c_str(), max_str.c_str(), accept_encoding.c_str())
+
+  body = NULL;
+  body_length = 0;
+  content_encoding = NULL;
+
+  char * end = NULL;
+  uint32_t since = strtoul(since_str.c_str(), &end, 10);
+
+  if (since_str.length() == 0 || *end != 0)
+  {
+    return String("since ") + since_str + " is not a sequence number";
+  }
+
+  size_t max_records = LOG_RING_MAX_BATCH;
+
+  if (max_str.length() > 0)
+  {
+    max_records = strtoul(max_str.c_str(), &end, 10);
+
+    if (*end != 0 || max_records == 0)
+    {
+      return String("max ") + max_str + " is not a positive number";
+    }
+
+    max_records = max_records < LOG_RING_MAX_BATCH ? max_records : LOG_RING_MAX_BATCH;
+  }
+
+  size_t length = serializeLogRing(since, max_records, format);
+
+  body = _buffer;
+  body_length = length;
+
+  int encoding = -1;
+
+  if (accept_encoding.indexOf("gzip") >= 0)
+  {
+    encoding = DeflateEncoder::dfGzip;
+    content_encoding = "gzip";
+  }
+  else if (accept_encoding.indexOf("deflate") >= 0)
+  {
+    encoding = DeflateEncoder::dfZlib;
+    content_encoding = "deflate";
+  }
+
+  if (encoding >= 0 && length >= MIN_ENCODED_BODY_SIZE)
+  {
+    size_t encoded_length = 0;
+    encoded_body = encodeBody(length, uint8_t(encoding), encoded_length);
+
+    if (encoded_body != NULL)
+    {
+      body = (const char *) encoded_body;
+      body_length = encoded_length;
+      return String();
+    }
+  }
+
+  content_encoding = NULL;
+  return String();
 }
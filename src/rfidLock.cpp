@@ -19,6 +19,7 @@
 #include <autonom.h>
 #include <gpio.h>
 #include <trace.h>
+#include <telemetry.h>
 #include <binarySemaphore.h>
 #include <epromImage.h>
 #include <onboardLed.h>
@@ -465,8 +466,12 @@ void RfidLockHandler::task(void *parameter)
     _this->red_led_state = ledOn;
     _this->green_led_state = ledOff;
 
+    TelemetryLoop * loop_telemetry = telemetry_loop("rfid_lock_task");
+
     while (_this->_is_active)
     {
+        telemetry_loop_mark(loop_telemetry);
+
         unsigned long now_millis = millis();
 
         if (now_millis < last_save_data_millis || 
@@ -0,0 +1,354 @@
+#include <Arduino.h>
+#include <vector>
+#include <algorithm>
+#include <sys/time.h>
+
+#include <scheduler.h>
+#include <binarySemaphore.h>
+#include <trace.h>
+
+class Scheduler
+{
+public:
+
+    static const uint32_t MAX_SLEEP_MS = 60000;            // to notice a step of the clock by NTP
+    static const uint32_t TIME_INVALID_SLEEP_MS = 1000;    // while time of day jobs wait for NTP
+    static const int64_t CLOCK_STEP_TOLERANCE_MS = 2000;
+
+    struct Job
+    {
+        SchedulerJobId id;
+        const char * name;
+        SchedulerJobFunc func;
+        void * arg;
+
+        uint32_t interval_ms;   // 0 - time of day job
+        int8_t minute;
+        int8_t hour;
+
+        uint32_t due_millis;
+    };
+
+    Scheduler()
+    {
+        next_id = 0;
+        task_handle = NULL;
+        time_valid = false;
+        last_epoch_ms = 0;
+        last_millis = 0;
+        running_id = SCHEDULER_NO_JOB;
+        running_removed = false;
+    }
+
+    SchedulerJobId add(Job & job, bool run_now)
+    {
+        {Lock lock(semaphore);
+
+        job.id = next_id++;
+
+        if (job.interval_ms == 0)
+        {
+            if (time_valid)
+            {
+                job.due_millis = next_time_of_day_millis(job);
+                push(job);
+            }
+            else
+            {
+                waiting.push_back(job);
+            }
+        }
+        else
+        {
+            job.due_millis = millis() + (run_now ? 0 : job.interval_ms);
+            push(job);
+        }
+
+        if (task_handle == NULL)
+        {
+            xTaskCreate(
+                task,                // Function that should be called
+                "scheduler_task",    // Name of the task (for debugging)
+                4096,                // Stack size (bytes)
+                this,                // Parameter to pass
+                1,                   // Task priority
+                &task_handle         // Task handle
+            );
+        }}
+
+        TRACE("scheduler: added job %s, id %d", job.name, (int) job.id)
+        xTaskNotifyGive(task_handle);
+        return job.id;
+    }
+
+    void remove(SchedulerJobId id)
+    {
+        Lock lock(semaphore);
+
+        if (running_id == id)
+        {
+            running_removed = true;
+        }
+
+        for (auto it=heap.begin(); it!=heap.end(); ++it)
+        {
+            if (it->id == id)
+            {
+                heap.erase(it);
+                std::make_heap(heap.begin(), heap.end(), is_later);
+                return;
+            }
+        }
+
+        for (auto it=waiting.begin(); it!=waiting.end(); ++it)
+        {
+            if (it->id == id)
+            {
+                waiting.erase(it);
+                return;
+            }
+        }
+    }
+
+protected:
+
+    static bool is_later(const Job & a, const Job & b)
+    {
+        return int32_t(a.due_millis - b.due_millis) > 0;
+    }
+
+    static int64_t epoch_ms()
+    {
+        timeval tv;
+        gettimeofday(&tv, NULL);
+        return int64_t(tv.tv_sec) * 1000 + tv.tv_usec / 1000;
+    }
+
+    void push(const Job & job)
+    {
+        heap.push_back(job);
+        std::push_heap(heap.begin(), heap.end(), is_later);
+    }
+
+    // the next local time boundary that matches minute / hour; mktime takes care of dst
+
+    static time_t next_time_of_day(time_t now, int8_t minute, int8_t hour)
+    {
+        tm t;
+        localtime_r(&now, &t);
+        t.tm_sec = 0;
+        t.tm_min += 1;
+
+        for (int i=0; i<24+60+2; ++i)
+        {
+            t.tm_isdst = -1;
+            time_t next = mktime(&t);
+            localtime_r(&next, &t);
+
+            if (hour >= 0 && t.tm_hour != hour)
+            {
+                t.tm_min = minute >= 0 ? minute : 0;
+                t.tm_hour += 1;
+            }
+            else if (minute >= 0 && t.tm_min != minute)
+            {
+                t.tm_min = minute > t.tm_min ? minute : minute + 60;
+            }
+            else
+            {
+                return next;
+            }
+        }
+
+        return now + 60;
+    }
+
+    static uint32_t next_time_of_day_millis(const Job & job)
+    {
+        int64_t now_ms = epoch_ms();
+        time_t next = next_time_of_day(time_t(now_ms / 1000), job.minute, job.hour);
+        return millis() + uint32_t(int64_t(next) * 1000 - now_ms);
+    }
+
+    // under the semaphore
+
+    void check_clock()
+    {
+        tm _tm;
+        bool _time_valid = scheduler_get_local_time(_tm);
+
+        uint32_t now_millis = millis();
+        int64_t now_epoch_ms = epoch_ms();
+
+        if (_time_valid && time_valid == false)
+        {
+            TRACE("scheduler: time is valid, %d time of day jobs are released", (int) waiting.size())
+
+            for (auto it=waiting.begin(); it!=waiting.end(); ++it)
+            {
+                it->due_millis = now_millis;
+                push(*it);
+            }
+
+            waiting.clear();
+        }
+        else if (_time_valid && time_valid)
+        {
+            int64_t expected_epoch_ms = last_epoch_ms + int64_t(uint32_t(now_millis - last_millis));
+            int64_t step = now_epoch_ms - expected_epoch_ms;
+
+            if (step > CLOCK_STEP_TOLERANCE_MS || step < -CLOCK_STEP_TOLERANCE_MS)
+            {
+                TRACE("scheduler: clock stepped by %d ms, time of day jobs are rescheduled", (int) step)
+
+                for (auto it=heap.begin(); it!=heap.end(); ++it)
+                {
+                    if (it->interval_ms == 0)
+                    {
+                        it->due_millis = next_time_of_day_millis(*it);
+                    }
+                }
+
+                std::make_heap(heap.begin(), heap.end(), is_later);
+            }
+        }
+
+        time_valid = _time_valid;
+        last_epoch_ms = now_epoch_ms;
+        last_millis = now_millis;
+    }
+
+    static void task(void *parameter)
+    {
+        Scheduler *_this = (Scheduler *)parameter;
+
+        TRACE("scheduler_task: started")
+
+        while (true)
+        {
+            {Lock lock(_this->semaphore);
+            _this->check_clock();}
+
+            while (true)
+            {
+                Job job;
+
+                {Lock lock(_this->semaphore);
+
+                if (_this->heap.empty() || int32_t(millis() - _this->heap.front().due_millis) < 0)
+                {
+                    break;
+                }
+
+                std::pop_heap(_this->heap.begin(), _this->heap.end(), is_later);
+                job = _this->heap.back();
+                _this->heap.pop_back();
+
+                _this->running_id = job.id;
+                _this->running_removed = false;}
+
+                job.func(job.arg);
+
+                {Lock lock(_this->semaphore);
+
+                _this->running_id = SCHEDULER_NO_JOB;
+
+                if (_this->running_removed == false)
+                {
+                    if (job.interval_ms == 0)
+                    {
+                        job.due_millis = next_time_of_day_millis(job);
+                    }
+                    else
+                    {
+                        job.due_millis += job.interval_ms;
+
+                        if (int32_t(millis() - job.due_millis) >= 0)
+                        {
+                            job.due_millis = millis() + job.interval_ms;  // fell behind, do not catch up
+                        }
+                    }
+
+                    _this->push(job);
+                }}
+            }
+
+            uint32_t sleep_ms = MAX_SLEEP_MS;
+
+            {Lock lock(_this->semaphore);
+
+            if (_this->heap.empty() == false)
+            {
+                uint32_t until_due = _this->heap.front().due_millis - millis();
+                sleep_ms = until_due < sleep_ms ? until_due : sleep_ms;
+            }
+
+            if (_this->waiting.empty() == false && TIME_INVALID_SLEEP_MS < sleep_ms)
+            {
+                sleep_ms = TIME_INVALID_SLEEP_MS;
+            }}
+
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(sleep_ms) + 1);
+        }
+    }
+
+    BinarySemaphore semaphore;
+
+    std::vector<Job> heap;      // by due_millis, earliest at front
+    std::vector<Job> waiting;   // time of day jobs waiting for NTP
+
+    SchedulerJobId next_id;
+    TaskHandle_t task_handle;
+
+    bool time_valid;
+    int64_t last_epoch_ms;
+    uint32_t last_millis;
+
+    SchedulerJobId running_id;
+    bool running_removed;
+};
+
+static Scheduler scheduler;
+
+SchedulerJobId scheduler_add_interval(const char * name, uint32_t interval_ms, SchedulerJobFunc func, void * arg, bool run_now)
+{
+    Scheduler::Job job;
+    job.name = name;
+    job.func = func;
+    job.arg = arg;
+    job.interval_ms = interval_ms > 0 ? interval_ms : 1;
+    job.minute = -1;
+    job.hour = -1;
+
+    return scheduler.add(job, run_now);
+}
+
+SchedulerJobId scheduler_add_time_of_day(const char * name, int8_t minute, int8_t hour, SchedulerJobFunc func, void * arg)
+{
+    Scheduler::Job job;
+    job.name = name;
+    job.func = func;
+    job.arg = arg;
+    job.interval_ms = 0;
+    job.minute = minute;
+    job.hour = hour;
+
+    return scheduler.add(job, false);
+}
+
+void scheduler_remove(SchedulerJobId id)
+{
+    if (id != SCHEDULER_NO_JOB)
+    {
+        scheduler.remove(id);
+    }
+}
+
+bool scheduler_get_local_time(tm & _tm)
+{
+    time_t _time_t;
+    time(& _time_t);
+    localtime_r(&_time_t, &_tm);
+
+    return _tm.tm_year+1900 > 2000; // otherwise - NTP failed to fetch time
+}
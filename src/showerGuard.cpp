@@ -4,7 +4,9 @@
 #include <showerGuard.h>
 #include <gpio.h>
 #include <trace.h>
+#include <telemetry.h>
 #include <binarySemaphore.h>
+#include <showerGuardAlgo.h>
 #include <OneWire.h>
 #include <DallasTemperature.h>
 #include <AHT10.h>
@@ -584,58 +586,43 @@ bool ShowerGuardConfig::Fan::from_eprom(std::istream &is)
     return is_valid() && !is.bad();
 }
 
-class ShowerGuardAlgo
-{
-public:
-    ShowerGuardAlgo()
-    {
-        init();
-    }
-
-    void start(const ShowerGuardConfig &config);
-    void stop() {}
-    void reconfigure(const ShowerGuardConfig &config);
-
-    void loop_once(float rh, float temp, bool motion);
-
-    bool get_light() const { return light; }
-    bool get_fan() const { return fan; }
+// the algo runs on the params of the config, the decision strings carry the local time of the device
 
-    String get_last_light_decision() const;
-    String get_last_fan_decision() const;
-
-    void debug_last_light_decision() const;
-    void debug_last_fan_decision() const;
-
-protected:
-    void init();
-
-    void reset_rh_window();
-    void update_rh_window(float rh);
+static ShowerGuardAlgoParams algo_params(const ShowerGuardConfig & config)
+{
+    ShowerGuardAlgoParams params;
 
-    bool is_soft_rh_toggle_down_condition() const;
+    params.light_linger = config.light.linger;
+    params.fan_linger = config.fan.linger;
+    params.rh_on = config.fan.rh_on;
+    params.rh_off = config.fan.rh_off;
+    params.light_mode = uint8_t(config.light.mode);
+    params.fan_mode = uint8_t(config.fan.mode);
 
-    bool light;
-    bool fan;
+    return params;
+}
 
-    bool reset_rh_decision;
-    uint32_t last_motion_millis;
-    time_t last_motion_time;
+static void format_time(time_t time, char * buf, size_t size)
+{
+    strlcpy(buf, time_t_2_str(time).c_str(), size);
+}
 
-    float rh_sliding_window[10];
-    size_t rh_sliding_window_pos;
+static void debug_decisions(const char * name, const ShowerGuardAlgo & algo, bool light)
+{
+    DEBUG("last_%s_decision:", name)
 
-    bool rh_toggle;
+    size_t levels = light ? ShowerGuardAlgo::LIGHT_DECISION_LEVELS : ShowerGuardAlgo::FAN_DECISION_LEVELS;
 
-    unsigned light_linger;
-    unsigned fan_linger;
-    unsigned rh_off, rh_on;
-    ShowerGuardConfig::Light::Mode light_mode;
-    ShowerGuardConfig::Light::Mode fan_mode;
+    for (int i = int(levels) - 1; i >= 0; --i)
+    {
+        const char * decision = light ? algo.get_light_decision(i) : algo.get_fan_decision(i);
 
-    String last_light_decision[2]; // 2 levels
-    String last_fan_decision[3];   // 3 levels
-};
+        if (decision[0] != 0 || i==0)
+        {
+            DEBUG("[%d]=%s", i, decision)
+        }
+    }
+}
 
 class ShowerGuardHandler
 {
@@ -646,7 +633,7 @@ public:
     static const unsigned MOTION_HYS = 10;
     static const unsigned LOGGING_SLOT = 60;
 
-    ShowerGuardHandler()
+    ShowerGuardHandler() : algo(format_time)
     {
         _is_active = false;
         _is_finished = true;
@@ -681,6 +668,12 @@ public:
         return _status;
     }
 
+    ShowerGuardConfig get_config()
+    {
+        Lock lock(semaphore);
+        return config;
+    }
+
     static unsigned analog_read(uint8_t gpio);
 
 protected:
@@ -717,331 +710,6 @@ protected:
 
 static ShowerGuardHandler handler;
 
-void ShowerGuardAlgo::start(const ShowerGuardConfig &config)
-{
-    init();
-    reconfigure(config);
-}
-
-void ShowerGuardAlgo::reconfigure(const ShowerGuardConfig &config)
-{
-    light_linger = config.light.linger;
-    fan_linger = config.fan.linger;
-
-    rh_off = config.fan.rh_off;
-    rh_on = config.fan.rh_on;
-    light_mode = config.light.mode;
-    fan_mode = config.fan.mode;
-
-    reset_rh_window();
-}
-
-void ShowerGuardAlgo::loop_once(float rh, float temp, bool motion)
-{
-    // run algo even if there are overrides to fan and light (mode not auto)
-
-    char buf[128];
-
-    uint32_t now_millis = millis();
-
-    time_t now_time;
-    time(&now_time);
-
-    update_rh_window(rh);
-
-    bool motion_light = false;
-    bool motion_fan = false;
-
-    if (reset_rh_decision) // running first time after init
-    {
-        motion = true; // imitate initial motion to put on everything
-
-        unsigned rh_middle = rh_off + (rh_on - rh_off) / 2;
-
-        if (rh >= rh_middle)
-        {
-            rh_toggle = true;
-        }
-
-        sprintf(buf, "init %.1f/%.1f (middle) at %s", rh, (float)rh_middle, time_t_2_str(now_time).c_str());
-        last_fan_decision[0] = buf;
-
-        reset_rh_decision = false;
-    }
-
-    if (motion)
-    {
-        motion_light = true;
-        motion_fan = true;
-        last_motion_millis = now_millis;
-        last_motion_time = now_time;
-    }
-    else
-    {
-        if (((now_millis - last_motion_millis) / 1000) < light_linger)
-        {
-            motion_light = true;
-        }
-
-        if (((now_millis - last_motion_millis) / 1000) < fan_linger)
-        {
-            motion_fan = true;
-        }
-    }
-
-    if (motion_light == true)
-    {
-        sprintf(buf, "motion at %s (+%d s)", time_t_2_str(last_motion_time).c_str(), light_linger);
-        last_light_decision[0] = buf;
-    }
-    else 
-    {
-        last_light_decision[0] = "linger out";
-    }
-
-    light = motion_light;
-
-    bool last_rh_toggle = rh_toggle;
-
-    if (rh >= rh_on)
-    {
-        if (rh_toggle == false)
-        {
-            rh_toggle = true;
-            sprintf(buf, "rh-high %.1f/%.1f at %s", rh, (float)rh_on, time_t_2_str(now_time).c_str());
-            last_fan_decision[0] = buf;
-        }
-    }
-    else if (rh <= rh_off)
-    {
-        if (rh_toggle == true)
-        {
-            rh_toggle = false;
-            sprintf(buf, "rh-low %.1f/%.1f at %s", rh, (float)rh_off, time_t_2_str(now_time).c_str());
-            last_fan_decision[0] = buf;
-        }
-    }
-    else
-    {
-        if (rh_toggle == true)
-        {
-            if (is_soft_rh_toggle_down_condition())
-            {
-                TRACE("Soft rh_toggle condition")
-                rh_toggle = false;
-                sprintf(buf, "rh-soft-down at %s", time_t_2_str(now_time).c_str());
-                last_fan_decision[0] = buf;
-
-                DEBUG("rh_sliding_window at rh_toggle condition")
-                String dbg_str;
-
-                for (int i=0;i<sizeof(rh_sliding_window)/sizeof(rh_sliding_window[0]);++i)
-                {    
-                    if (i > 0)
-                    {
-                        dbg_str += ",";
-                    }
-                    dbg_str += rh_sliding_window[i];
-                }
-                DEBUG("[%s]", dbg_str.c_str())
-            }
-        }
-    }
-
-    if (last_rh_toggle != rh_toggle)
-    {
-        // DEBUG("rh_toggle=%d", (int) rh_toggle)
-    }
-
-    if (motion_fan == true)
-    {
-        //if (fan == false)
-        //{
-            fan = true;
-            sprintf(buf, "motion at %s (+%d s)", time_t_2_str(last_motion_time).c_str(), fan_linger);
-            last_fan_decision[1] = buf;
-        //}
-    }
-    else
-    {
-        if (last_fan_decision[1].length() > 0)
-        {
-            last_fan_decision[1] = "";
-        }
-        fan = rh_toggle;
-    }
-
-    if (light_mode != ShowerGuardConfig::Light::mAuto)
-    {
-        light = light_mode == ShowerGuardConfig::Light::mOn ? true : false;
-        last_light_decision[1] = "nonauto-mode";
-    }
-    else
-    {
-        last_light_decision[1] = "";
-    }
-
-    if (fan_mode != ShowerGuardConfig::Fan::mAuto)
-    {
-        fan = fan_mode == ShowerGuardConfig::Fan::mOn ? true : false;
-        last_fan_decision[2] = "nonauto-mode";
-    }
-    else
-    {
-        last_fan_decision[2] = "";
-    }
-}
-
-String ShowerGuardAlgo::get_last_light_decision() const
-{
-    for (int i = sizeof(last_light_decision) / sizeof(last_light_decision[0]) - 1; i >= 0; --i)
-    {
-        if (!last_light_decision[i].isEmpty())
-        {
-            return last_light_decision[i];
-        }
-    }
-
-    return String("");
-}
-
-String ShowerGuardAlgo::get_last_fan_decision() const
-{
-    for (int i = sizeof(last_fan_decision) / sizeof(last_fan_decision[0]) - 1; i >= 0; --i)
-    {
-        if (!last_fan_decision[i].isEmpty())
-        {
-            return last_fan_decision[i];
-        }
-    }
-
-    return String("");
-}
-
-void ShowerGuardAlgo::debug_last_light_decision() const
-{
-    DEBUG("last_light_decision:")
-
-    for (int i = sizeof(last_light_decision) / sizeof(last_light_decision[0]) - 1; i >= 0; --i)
-    {
-        if (!last_light_decision[i].isEmpty() || i==0)
-        {
-            DEBUG("[%d]=%s", i, last_light_decision[i].c_str())
-        }
-    }
-}
-
-void ShowerGuardAlgo::debug_last_fan_decision() const
-{
-    DEBUG("last_fan_decision:")
-
-    for (int i = sizeof(last_fan_decision) / sizeof(last_fan_decision[0]) - 1; i >= 0; --i)
-    {
-        if (!last_fan_decision[i].isEmpty() || i==0)
-        {
-            DEBUG("[%d]=%s", i, last_fan_decision[i].c_str())
-        }
-    }
-}
-
-void ShowerGuardAlgo::init()
-{
-    light = false;
-    fan = false;
-    reset_rh_decision = true;
-    last_motion_millis = 0;
-    time(&last_motion_time);
-    rh_toggle = false;
-    reset_rh_window();
-
-    light_linger = 0;
-    fan_linger = 0;
-    rh_off = 0;
-    rh_on = 0;
-    light_mode = ShowerGuardConfig::Light::mAuto;
-    fan_mode = ShowerGuardConfig::Light::mAuto;
-
-    for (size_t i = 1; i < sizeof(last_light_decision) / sizeof(last_light_decision[0]); ++i)
-    {
-        last_light_decision[i] = "";
-    }
-
-    for (size_t i = 1; i < sizeof(last_fan_decision) / sizeof(last_fan_decision[0]); ++i)
-    {
-        last_fan_decision[i] = "";
-    }
-
-    last_light_decision[0] = "init";
-    last_fan_decision[0] = "init";
-}
-
-void ShowerGuardAlgo::reset_rh_window()
-{
-    //for (int i=0;i<sizeof(rh_avg_window)/sizeof(rh_avg_window[0]);++i)
-    //    rh_avg_window[i] = 0;
-
-    // rh_avg_window_pos = 0;
-
-    //for (int i=0;i<sizeof(rh_sliding_window)/sizeof(rh_sliding_window[0]);++i)
-    //    rh_sliding_window[i] = 0;
-
-    rh_sliding_window_pos = 0;
-}
-
-void ShowerGuardAlgo::update_rh_window(float rh)
-{
-    // add average to sliding window. if sliding window is full - shift left and add to the end
-
-    if (rh_sliding_window_pos < sizeof(rh_sliding_window) / sizeof(rh_sliding_window[0]))
-    {
-        rh_sliding_window[rh_sliding_window_pos] = rh;
-        rh_sliding_window_pos++;
-    }
-    else
-    {
-        for (int i = 0; i < sizeof(rh_sliding_window) / sizeof(rh_sliding_window[0]) - 1; ++i)
-            rh_sliding_window[i] = rh_sliding_window[i + 1];
-
-        rh_sliding_window[sizeof(rh_sliding_window) / sizeof(rh_sliding_window[0]) - 1] = rh;
-    }
-
-    /*
-    DEBUG("rh_sliding_window updated")
-    String dbg_str;
-
-    for (int i=0;i<sizeof(rh_sliding_window)/sizeof(rh_sliding_window[0]);++i)
-    {    
-        if (i > 0)
-        {
-            dbg_str += ",";
-        }
-        dbg_str += rh_sliding_window[i];
-    }
-    DEBUG("[%s]", dbg_str.c_str())
-    */
-}
-
-bool ShowerGuardAlgo::is_soft_rh_toggle_down_condition() const
-{
-    // current condition for soft toggling down of rh_switch is that the sliding window is fully filled and
-    // all its values are under the lowest 10 %of the span rh_off -> rh_on
-
-    if (rh_sliding_window_pos == sizeof(rh_sliding_window) / sizeof(rh_sliding_window[0])) // sliding window is fully filled
-    {
-        float upper = rh_off + float(rh_on - rh_off) / 10.0;
-
-        for (int i = 0; i < sizeof(rh_sliding_window) / sizeof(rh_sliding_window[0]); ++i)
-        {
-            if (rh_sliding_window[i] > upper)
-                return false;
-        }
-
-        return true;
-    }
-
-    return false;
-}
-
 void ShowerGuardHandler::start(const ShowerGuardConfig &_config)
 {
     if (_is_active)
@@ -1056,7 +724,7 @@ void ShowerGuardHandler::start(const ShowerGuardConfig &_config)
 
     config = _config;
     configure_hw();
-    algo.start(config);
+    algo.start(algo_params(config));
 
     _is_active = true;
     _is_finished = false;
@@ -1093,9 +761,53 @@ void ShowerGuardHandler::reconfigure(const ShowerGuardConfig &_config)
     if (!(config == _config))
     {
         TRACE("shower_guard_task: config changed")
+
+        // only the hw that has changed is touched, an output keeps its state if only its mode or linger changed
+
+        bool should_configure_rh = !(config.rh == _config.rh);
+        bool should_configure_temp = !(config.temp == _config.temp);
+        bool should_configure_motion = !(config.motion == _config.motion);
+        bool should_configure_lumi = !(config.lumi == _config.lumi);
+        bool should_configure_light = !(config.light.channel == _config.light.channel);
+        bool should_configure_fan = !(config.fan.channel == _config.fan.channel);
+        bool should_reconfigure_algo = !(config.rh == _config.rh && config.light == _config.light && config.fan == _config.fan);
+
         config = _config;
-        configure_hw();
-        algo.reconfigure(config);
+
+        if (should_configure_rh)
+        {
+            configure_hw_rh();
+        }
+
+        if (should_configure_temp)
+        {
+            configure_hw_temp();
+        }
+
+        if (should_configure_motion)
+        {
+            configure_hw_motion(config.motion);
+        }
+
+        if (should_configure_lumi)
+        {
+            configure_hw_lumi(config.lumi);
+        }
+
+        if (should_configure_light)
+        {
+            configure_hw_light(config.light);
+        }
+
+        if (should_configure_fan)
+        {
+            configure_hw_fan(config.fan);
+        }
+
+        if (should_reconfigure_algo)
+        {
+            algo.reconfigure(algo_params(config));
+        }
     }
 }
 
@@ -1133,8 +845,12 @@ void ShowerGuardHandler::task(void *parameter)
     unsigned motion_hys_count = 0;
     ShowerGuardStatus status_copy;
 
+    TelemetryLoop * loop_telemetry = telemetry_loop("shower_guard_task");
+
     while (_this->_is_active)
     {
+        telemetry_loop_mark(loop_telemetry);
+
         bool do_algo_loop = false;
 
         {
@@ -1252,7 +968,10 @@ void ShowerGuardHandler::task(void *parameter)
 
             if (do_algo_loop == true)
             {
-                _this->algo.loop_once(rh, temp, motion_hys);
+                time_t now_time;
+                time(&now_time);
+
+                _this->algo.loop_once(rh, temp, motion_hys, millis(), now_time);
 
                 bool last_light = light;
                 bool last_fan = fan;
@@ -1308,6 +1027,8 @@ void ShowerGuardHandler::task(void *parameter)
             status_copy.fan = fan;
             status_copy.light_decision = _this->algo.get_last_light_decision();
             status_copy.fan_decision = _this->algo.get_last_fan_decision();
+            status_copy.light_on_time = _this->algo.get_light_on_time();
+            status_copy.fan_on_time = _this->algo.get_fan_on_time();
 
             _this->status = status_copy;
         }
@@ -1329,8 +1050,8 @@ void ShowerGuardHandler::task(void *parameter)
                   temp, rh, (int)motion_hys, luminance_percent, (int) light_luminance_mask, (int)light, (int)fan, 
                   status_copy.light_decision.c_str(), status_copy.fan_decision.c_str())
 
-            _this->algo.debug_last_light_decision();
-            _this->algo.debug_last_fan_decision();
+            debug_decisions("light", _this->algo, true);
+            debug_decisions("fan", _this->algo, false);
         }
         else
         {
@@ -1729,4 +1450,107 @@ void reconfigure_shower_guard(const ShowerGuardConfig &_config)
     handler.reconfigure(_config);
 }
 
+String shower_guard_replay(const JsonVariant & json, JsonVariant & result)
+{
+    // runs a recorded trace through a separate algo instance with a clock taken from the trace itself, so a day
+    // of data replays in well under a second and the outcome only depends on the trace and the parameters;
+    // each trace row is one algo loop: [time (s), rh, temp, motion]
+
+    const size_t MAX_REPLAY_DECISIONS = 64;
+
+    if (json.containsKey("trace") == false || json["trace"].is<JsonArray>() == false)
+    {
+        return "trace is missing";
+    }
+
+    // parameters default to the running config (if any) and can be overridden one by one for sweeps
+
+    ShowerGuardConfig config;
+
+    if (handler.is_active())
+    {
+        config = handler.get_config();
+    }
+
+    if (json.containsKey("params"))
+    {
+        const JsonVariant & params = json["params"];
+
+        if (params.containsKey("light_linger"))
+        {
+            config.light.linger = params["light_linger"];
+        }
+        if (params.containsKey("fan_linger"))
+        {
+            config.fan.linger = params["fan_linger"];
+        }
+        if (params.containsKey("rh_on"))
+        {
+            config.fan.rh_on = params["rh_on"];
+        }
+        if (params.containsKey("rh_off"))
+        {
+            config.fan.rh_off = params["rh_off"];
+        }
+    }
+
+    if (config.fan.rh_off >= config.fan.rh_on)
+    {
+        return "rh_off should be less than rh_on";
+    }
+
+    ShowerGuardReplay replay(algo_params(config), format_time);
+
+    JsonArray trace = json["trace"].as<JsonArray>();
+    JsonArray decisions = result.createNestedArray("decisions");
+
+    size_t decisions_dropped = 0;
+
+    for (JsonArray::iterator it = trace.begin(); it != trace.end(); ++it)
+    {
+        JsonArray row = it->as<JsonArray>();
+
+        if (row.size() < 4)
+        {
+            return String("trace row ") + String((int) replay.get_rows()) + " should be [time, rh, temp, motion]";
+        }
+
+        time_t now_time = row[0].as<long>();
+
+        if (replay.push(now_time, row[1].as<float>(), row[2].as<float>(), row[3].as<bool>()) == false)
+        {
+            return String("trace row ") + String((int) replay.get_rows()) + " goes back in time";
+        }
+
+        if (replay.is_changed())
+        {
+            if (decisions.size() < MAX_REPLAY_DECISIONS)
+            {
+                const ShowerGuardAlgo & algo = replay.get_algo();
+
+                JsonObject decision = decisions.createNestedObject();
+                decision["time"] = long(now_time);
+                decision["light"] = algo.get_light();
+                decision["fan"] = algo.get_fan();
+                decision["light_decision"] = algo.get_last_light_decision();
+                decision["fan_decision"] = algo.get_last_fan_decision();
+            }
+            else
+            {
+                decisions_dropped++;
+            }
+        }
+    }
+
+    result["rows"] = replay.get_rows();
+    result["duration"] = replay.get_duration();
+    result["light_on_time"] = replay.get_algo().get_light_on_time();
+    result["fan_on_time"] = replay.get_algo().get_fan_on_time();
+    result["light_switches"] = replay.get_light_switches();
+    result["fan_switches"] = replay.get_fan_switches();
+    result["decisions_dropped"] = decisions_dropped;
+
+    return String();
+}
+
 #endif // INCLUDE_SHOWERGUARD
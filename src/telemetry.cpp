@@ -0,0 +1,302 @@
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+
+#include <telemetry.h>
+#include <latencyHistogram.h>
+#include <scheduler.h>
+#include <binarySemaphore.h>
+#include <trace.h>
+
+struct TelemetryLoop
+{
+    const char * name;
+    int64_t last_mark_us;
+    uint32_t max_period_us;
+    PeriodHistogram period;
+};
+
+class Telemetry
+{
+public:
+
+    static const size_t MAX_LOOPS = 16;
+    static const size_t MAX_TASKS = 32;
+
+    struct Task
+    {
+        char name[configMAX_TASK_NAME_LEN];
+        TaskHandle_t handle;
+        UBaseType_t priority;
+        eTaskState state;
+        uint32_t stack_free_min;
+        float cpu_percent;      // -1 if the run time stats are not built in
+        uint8_t core;
+    };
+
+    Telemetry()
+    {
+        loop_count = 0;
+        task_count = 0;
+        sample_job = SCHEDULER_NO_JOB;
+        last_total_run_time = 0;
+
+        for (size_t i=0; i<MAX_TASKS; ++i)
+        {
+            last_run_time[i].handle = NULL;
+            last_run_time[i].run_time = 0;
+        }
+    }
+
+    void start()
+    {
+        if (sample_job == SCHEDULER_NO_JOB)
+        {
+            sample_job = scheduler_add_interval("telemetry", TELEMETRY_SAMPLE_MS, sample_job_func, this);
+        }
+    }
+
+    TelemetryLoop * loop(const char * name)
+    {
+        Lock lock(semaphore);
+
+        for (size_t i=0; i<loop_count; ++i)
+        {
+            if (!strcmp(loops[i].name, name))
+            {
+                loops[i].last_mark_us = 0;  // the task has been started again, its first iteration has no period
+                return & loops[i];
+            }
+        }
+
+        if (loop_count >= MAX_LOOPS)
+        {
+            ERROR("telemetry: no room for loop %s", name)
+            return NULL;
+        }
+
+        TelemetryLoop & _loop = loops[loop_count++];
+        _loop.name = name;
+        _loop.last_mark_us = 0;
+        _loop.max_period_us = 0;
+        _loop.period.clear();
+
+        return & _loop;
+    }
+
+    void to_json(JsonVariant & json)
+    {
+        Lock lock(semaphore);
+
+        json.createNestedObject("heap");
+        JsonVariant heap = json["heap"];
+        heap_to_json(heap, "internal", MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+
+        if (heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0)
+        {
+            heap_to_json(heap, "psram", MALLOC_CAP_SPIRAM);
+        }
+
+        // an array, the names of the tasks of a module with several channels are the same
+
+        JsonArray tasks_json = json.createNestedArray("tasks");
+
+        for (size_t i=0; i<task_count; ++i)
+        {
+            const Task & task = tasks[i];
+
+            JsonObject task_json = tasks_json.createNestedObject();
+
+            task_json["name"] = String(task.name);
+            task_json["stack_free_min"] = task.stack_free_min;
+            task_json["priority"] = task.priority;
+            task_json["state"] = state_2_str(task.state);
+
+            if (task.cpu_percent >= 0)
+            {
+                task_json["cpu_percent"] = task.cpu_percent;
+                task_json["core"] = task.core;
+            }
+        }
+
+        json.createNestedObject("loops");
+        JsonVariant loops_json = json["loops"];
+
+        for (size_t i=0; i<loop_count; ++i)
+        {
+            const TelemetryLoop & _loop = loops[i];
+
+            loops_json.createNestedObject(_loop.name);
+            JsonVariant loop_json = loops_json[_loop.name];
+
+            loop_json["iterations"] = _loop.period.get_count();
+            loop_json["avg_period_us"] = _loop.period.get_count() == 0 ? 0 : uint32_t(_loop.period.get_sum_us() / _loop.period.get_count());
+
+            // upper bound of the bucket; beyond the last one it is the max, which is the upper bound of that bucket
+
+            uint32_t p99_period_us = _loop.period.get_percentile_us(99);
+            loop_json["p99_period_us"] = p99_period_us == 0 && _loop.period.get_count() > 0 ? _loop.max_period_us : p99_period_us;
+            loop_json["max_period_us"] = _loop.max_period_us;
+        }
+    }
+
+protected:
+
+    static void sample_job_func(void * parameter)
+    {
+        Telemetry * _this = (Telemetry *) parameter;
+        _this->sample();
+    }
+
+    void sample()
+    {
+        #if configUSE_TRACE_FACILITY == 1
+
+        // the buffers are members, the scheduler task has a small stack
+
+        uint32_t total_run_time = 0;
+        UBaseType_t count = uxTaskGetSystemState(status, MAX_TASKS, &total_run_time);
+
+        if (count == 0)
+        {
+            DEBUG("telemetry: more than %d tasks, not sampled", (int) MAX_TASKS)
+            return;
+        }
+
+        Lock lock(semaphore);
+
+        uint32_t total_delta = total_run_time - last_total_run_time;
+
+        for (UBaseType_t i=0; i<count; ++i)
+        {
+            Task & task = tasks[i];
+
+            strncpy(task.name, status[i].pcTaskName, sizeof(task.name) - 1);
+            task.name[sizeof(task.name) - 1] = 0;
+            task.handle = status[i].xHandle;
+            task.priority = status[i].uxCurrentPriority;
+            task.state = status[i].eCurrentState;
+            task.stack_free_min = status[i].usStackHighWaterMark;  // bytes on esp32
+            task.cpu_percent = -1;
+            task.core = 0;
+
+            #if configGENERATE_RUN_TIME_STATS == 1
+
+            uint32_t last = 0;
+
+            for (size_t j=0; j<MAX_TASKS; ++j)
+            {
+                if (last_run_time[j].handle == task.handle)
+                {
+                    last = last_run_time[j].run_time;
+                    break;
+                }
+            }
+
+            // share of one core, the tasks of both cores add up to 200% on a dual core
+
+            task.cpu_percent = total_delta == 0 ? 0 : float(status[i].ulRunTimeCounter - last) * 100 / float(total_delta);
+            task.core = status[i].xCoreID == tskNO_AFFINITY ? 0xff : uint8_t(status[i].xCoreID);
+
+            #endif
+
+            run_time[i].handle = task.handle;
+            run_time[i].run_time = status[i].ulRunTimeCounter;
+        }
+
+        for (size_t i=0; i<MAX_TASKS; ++i)
+        {
+            last_run_time[i] = i < count ? run_time[i] : LastRunTime();
+        }
+
+        task_count = count;
+        last_total_run_time = total_run_time;
+
+        #endif
+    }
+
+    static void heap_to_json(JsonVariant & json, const char * name, uint32_t caps)
+    {
+        json.createNestedObject(name);
+        JsonVariant heap = json[name];
+
+        heap["free"] = heap_caps_get_free_size(caps);
+        heap["largest_free_block"] = heap_caps_get_largest_free_block(caps);
+        heap["min_free"] = heap_caps_get_minimum_free_size(caps);
+    }
+
+    static const char * state_2_str(eTaskState state)
+    {
+        switch(state)
+        {
+            case eRunning: return "running";
+            case eReady: return "ready";
+            case eBlocked: return "blocked";
+            case eSuspended: return "suspended";
+            case eDeleted: return "deleted";
+            default: return "<unknown>";
+        }
+    }
+
+    struct LastRunTime
+    {
+        LastRunTime() : handle(NULL), run_time(0)
+        {
+        }
+
+        TaskHandle_t handle;
+        uint32_t run_time;
+    };
+
+    BinarySemaphore semaphore;
+
+    TelemetryLoop loops[MAX_LOOPS];
+    size_t loop_count;
+
+    Task tasks[MAX_TASKS];
+    size_t task_count;
+
+    TaskStatus_t status[MAX_TASKS];
+    LastRunTime run_time[MAX_TASKS];
+    LastRunTime last_run_time[MAX_TASKS];
+    uint32_t last_total_run_time;
+
+    SchedulerJobId sample_job;
+};
+
+static Telemetry telemetry;
+
+void start_telemetry()
+{
+    telemetry.start();
+}
+
+TelemetryLoop * telemetry_loop(const char * name)
+{
+    return telemetry.loop(name);
+}
+
+void telemetry_loop_mark(TelemetryLoop * loop)
+{
+    if (loop == NULL)
+    {
+        return;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+
+    if (loop->last_mark_us != 0)
+    {
+        int64_t _period_us = now_us - loop->last_mark_us;
+        uint32_t period_us = _period_us < int64_t(UINT32_MAX) ? uint32_t(_period_us) : UINT32_MAX;
+        loop->period.record(period_us);
+        loop->max_period_us = period_us > loop->max_period_us ? period_us : loop->max_period_us;
+    }
+
+    loop->last_mark_us = now_us;
+}
+
+void get_telemetry(JsonVariant & json)
+{
+    telemetry.to_json(json);
+}
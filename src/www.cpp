@@ -6,15 +6,28 @@
 #include <rest.h>
 #include <trace.h>
 #include <www.h>
+#include <routeMetrics.h>
+#include <esp_timer.h>
 
 WebServer webServer(80);
 
 #define MAX_BODY_SIZE 16000
 
-#define ASSERT_BODY_SIZE(_body_) if (_body_.length() > MAX_BODY_SIZE) { ERROR("JSON body exceeds %d bytes", (int) MAX_BODY_SIZE); _body_.clear(); }
+// per route, filled in the dispatch of the route tables below
+
+static RouteMetrics * current_route_metrics = NULL;
+
+#define ASSERT_BODY_SIZE(_body_) if (_body_.length() > MAX_BODY_SIZE) { ERROR("JSON body exceeds %d bytes", (int) MAX_BODY_SIZE); _body_.clear(); \
+                                                                        if (current_route_metrics != NULL) current_route_metrics->body_too_big++; }
 
 /*
 
+RESPONSE FORMAT of the GET documents (ping, wifiinfo, get, get pm, get autonom, rfid-lock codes, mains-probe 
+calibration data, poplog): JSON, or MessagePack (Content-Type: application/msgpack) if the Accept header of 
+the request has application/msgpack or application/x-msgpack; same document either way. If the Accept header 
+lists neither these nor application/json, application/* or */* (e.g. only application/cbor), the response is 
+406 Not Acceptable. Request bodies are JSON.
+
 REST POST restart
 URL: <base>/restart
 BODY: none
@@ -37,6 +50,15 @@ RESPONSE:
         "is_configured": true
       },
 
+    "boot":
+      {
+        "stages": {"eeprom": 212, "keybox": 236, "autonom": 237, "wifi": 3850, "www": 3861, "setup": 3870, "ntp": 4420},
+        "ready": {"network": true, "time": true, "www": true}
+      },
+
+  # boot stages: ms since power-on at the end of each stage in the order they were done; the functions are
+  # started hardware-only first, then the ones that need the network; ntp comes in the background
+
   # if ?info parameter is given include:
   # wifi info
 
@@ -345,7 +367,8 @@ ESP32-S2, OBS! gpio34 at startup == high makes target go back to programming mod
                         {"output":{"gpio":17, "inverted":false}, "max_voltage":10.0, "loopback":{"gpio":1,"atten":0, "ratio":0.20408}},
                         {"output":{"gpio":13, "inverted":false}, "max_voltage":10.0, "loopback":{"gpio":3,"atten":0, "ratio":0.20408}},
                         {"output":{"gpio":14, "inverted":false}, "max_voltage":10.0, "loopback":{"gpio":5,"atten":0, "ratio":0.20408}},
-                        {"output":{"gpio":18, "inverted":false}, "max_voltage":10.0, "loopback":{"gpio":7,"atten":0, "ratio":0.20408}}
+                        {"output":{"gpio":18, "inverted":false}, "max_voltage":10.0, "loopback":{"gpio":7,"atten":0, "ratio":0.20408},
+                         "slew_rate":0.5, "freq":1000, "resolution":16}  // optional: V/s hw fade (0 - immediate), pwm Hz and duty bits (0 - default 4000 / 14)
                         ],
             
 
@@ -408,6 +431,8 @@ ESP32-S2, OBS! gpio34 at startup == high makes target go back to programming mod
         
         "sound":{"hw":"TDA8425", "addr":"0x41", "mute":{"gpio":9, "inverted":false}, "volume":100, "volume_low":30, 
                  "gain_low_pass":7, "gain_band_pass":0, "gain_high_pass":10,
+                 "fade":300, "schedule_fade":30, "fade_curve":2,   // fade in ms, schedule_fade in s, curve 0-step 1-linear 2-smooth
+                 "loudness":8, "limiter":-1,   // i2s path: dB of bass boost at volume 0, dBFS ceiling; 0 - off
                  "schedule":[1,1,1,1,0,0,2,2,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1]},
 
         "tm1638":{"dio":{"channel":{"gpio":37}}, "clk":{"channel":{"gpio":38}}},
@@ -505,6 +530,53 @@ RESPONSE:
 {
 }
 
+REST POST action
+URL: <base>/action/autonom/shower-guard/replay
+BODY: 
+{
+ "params":{"light_linger":60, "fan_linger":300, "rh_on":55, "rh_off":50},     all optional, default to running config
+ "trace":[[1718000000, 48.5, 22.1, false], [1718000010, 49.0, 22.1, true], ...] 
+}
+RESPONSE: 
+{
+ "decisions":[{"time":1718000000, "light":true, "fan":true, "light_decision":"motion at ...", "fan_decision":"..."}, ...],
+ "rows":2, "duration":10, "light_on_time":10, "fan_on_time":10, "light_switches":0, "fan_switches":0, 
+ "decisions_dropped":0
+}
+
+NOTE: each trace row is one algo loop [time (s), rh, temp, motion] as the shower-guard task would run it (averaged rh 
+every 10 s and at motion changes); the clock comes from the trace so the replay runs as fast as the device can; 
+only changes of light / fan are listed (at most 64); lumi masking and non-auto modes are not part of the replay;
+the trace should be split into parts to fit the JSON buffer
+
+REST POST action
+URL: <base>/action/autonom/batch
+BODY: 
+{
+ "mode":"sequential",          or "parallel", optional, default sequential
+ "stop_on_error":false,        optional
+ "actions":[{"action":"zero2ten/output", "params":{"channel":0, "value":5.5}}, 
+            {"action":"zero2ten/output", "params":{"channel":1, "value":2}},
+            {"action":"proportional/actuate", "params":{"channel":0, "value":50, "ref":0}},
+            {"action":"zero2ten/input", "params":{"channel":0}}, ...]
+}
+RESPONSE: 
+{
+ "results":[{"action":"zero2ten/output"}, {"action":"zero2ten/output", "error":"..."}, 
+            {"action":"proportional/actuate", "skipped":true}, {"action":"zero2ten/input", "value":"4.98"}, ...],
+ "errors":1
+}
+
+NOTE: the actions are the action routes below by name with their query arguments as params (keybox/actuate, 
+rfid-lock/unlock, proportional/calibrate, proportional/actuate, zero2ten/input, zero2ten/output, mains-probe/input_v,
+mains-probe/input_a_high, mains-probe/input_a_low, multi/uart_command, multi/audio_control), at most 32; the body 
+can also be just the array of the actions; sequential runs them in order, parallel runs the actions of each function 
+in order but the functions side by side; stop_on_error skips the remaining actions (of the function in parallel)
+after the first error; only a run of consecutive zero2ten/output or of consecutive proportional/actuate is done under 
+one lock of the module and counts as one step for stop_on_error, every other action takes the lock of its module on 
+its own as its single route does; in parallel the functions that are not done after 10 s are left to finish on their 
+own and their actions are reported with "error":"timed out"
+
 REST POST action
 URL: <base>/action/autonom/keybox/actuate?channel=XX
 BODY: none
@@ -578,6 +650,18 @@ RESPONSE:
 {
 }
 
+REST GET get motor current signature of the last move
+URL: <base>/get/autonom/proportional/signature?channel=XX
+BODY: none
+RESPONSE: 
+{
+ "direction":"open", "result":"endstop", "duration":6120, "interval":80, "peak":0.31,
+ "samples":[<floats: current averaged over each interval>]
+}
+
+NOTE: "result" is one of elapsed, endstop, timeout, no load, cancelled, retargeted, stall; "stall_at" (ms from motor start) 
+is only present if a stall was detected; "interval" doubles as needed for the whole move to fit the sample buffer
+
 REST POST action
 URL: <base>/action/autonom/zero2ten/calibrate_input?6channel=XX&value=YY // without the value -> uncalibrate
 BODY: none
@@ -659,11 +743,17 @@ URL: <base>/get/autonom/mains-probe/calibration_data
 BODY: none
 RESPONSE: 
 {
- "input_v":[{"addr":<addr>, "index":<channel>, x_2_y_map[<floats: x1,y1,x2,y2...>], "poly_beta":[<floats: c0,c1,c2...>]}, ...],
- "input_a_high":[{"addr":<addr>, "index":<channel>, x_2_y_map[<floats: x1,y1,x2,y2...>], "poly_beta":[<floats: c0,c1,c2...>]}, ...],
- "input_a_low":[{"addr":"", "index":<channel>, x_2_y_map[<floats: x1,y1,x2,y2...>], "poly_beta":[<floats: c0,c1,c2...>]}, ...]
+ "input_v":[{"addr":<addr>, "index":<channel>, x_2_y_map[<floats: x1,y1,x2,y2...>], "poly_beta":[<floats: c0,c1,c2...>],
+    "confidence":{"points":<int>, "rejected":<int>, "order":<int>, "rms":<float>, "beta_stderr":[<floats: c0,c1,c2...>]}}, ...],
+ "input_a_high":[{"addr":<addr>, "index":<channel>, x_2_y_map[<floats: x1,y1,x2,y2...>], "poly_beta":[<floats: c0,c1,c2...>],
+    "confidence":{"points":<int>, "rejected":<int>, "order":<int>, "rms":<float>, "beta_stderr":[<floats: c0,c1,c2...>]}}, ...],
+ "input_a_low":[{"addr":"", "index":<channel>, x_2_y_map[<floats: x1,y1,x2,y2...>], "poly_beta":[<floats: c0,c1,c2...>],
+    "confidence":{...}}, ...]
 }
 
+// x_2_y_map holds the last points only, the fit covers all points taken in; rms is the relative rms error of the fit,
+// beta_stderr the standard error of the coefficients (both 0 while the points fit exactly)
+
 REST POST action 
 URL: <base>/action/autonom/mains-probe/import_calibration_data
 BODY:  
@@ -737,6 +827,28 @@ RESPONSE:
             0,
             0
         ]
+    },
+    "autonom": { <see get autonom> },
+    "system": {
+        "uptime": "00d 02h 13m 05s",
+        "request_arena": {"size": 17408, "high_water": 8192, "overflows": 0, "refused_resets": 0},
+        "mqtt": {"broker": "192.168.1.10", "enabled": true, "client_id": "harvester-246f28a1b2c4",    // only with mqtt,
+                 "connected": true, "state": 0,    // enabled only with MQTT_BROKER_HOST
+                 "connects": 1, "published": 812, "publish_failures": 0, "actions": 3, "action_errors": 0},
+        "heap": {
+            "internal": {"free": 101234, "largest_free_block": 65524, "min_free": 84012},
+            "psram": {"free": 4150000, "largest_free_block": 4128756, "min_free": 4100000}   // only with PSRAM
+        },
+        "tasks": [      // sampled every 10 s
+            {"name": "multi_task", "stack_free_min": 1320, "priority": 1, "state": "blocked", 
+             "cpu_percent": 2.5, "core": 255},     // cpu_percent (of one core since the previous sample) and 
+                                                   // core (255 - any) only if run time stats are built in
+            ...
+        ],
+        "loops": {      // period of the iterations of the handler loops, work plus delay
+            "multi_task": {"iterations": 52110, "avg_period_us": 10230, "p99_period_us": 16384, "max_period_us": 812000},
+            ...
+        }               // p99 is the upper bound of its power-of-two bucket (1 ms .. 18 min), max_period_us beyond
     }
 }
 
@@ -757,13 +869,32 @@ RESPONSE:
     ]
 }
 
+REST GET metrics
+URL: <base>/metrics
+BODY: none
+RESPONSE: Prometheus text format, per route (the path below <base>) and method:
+
+# TYPE harvester_http_requests_total counter
+harvester_http_requests_total{route="/get/autonom",method="GET"} 12
+# TYPE harvester_http_body_too_big_total counter
+harvester_http_body_too_big_total{route="/setup/autonom",method="POST"} 0
+# TYPE harvester_http_request_duration_seconds histogram
+harvester_http_request_duration_seconds_bucket{route="/get/autonom",method="GET",le="0.000512"} 0
+...
+harvester_http_request_duration_seconds_bucket{route="/get/autonom",method="GET",le="+Inf"} 12
+harvester_http_request_duration_seconds_sum{route="/get/autonom",method="GET"} 0.431
+harvester_http_request_duration_seconds_count{route="/get/autonom",method="GET"} 12
+
+the duration is the time in the handler, from dispatch until the response is sent; the histogram is only
+listed for routes that had requests since boot
+
 REST GET get autonom
 URL: <base>/get/autonom
 BODY: none
 RESPONSE: 
 {
     {
-        "shower-guard":{"temp":22.1,"rh":19.8,"motion":false,"light":false,"fan":false,"light_decision":"","fan_decision":"rh-low 44.7/45.0 at 2022-12-16 11:04:53"},   
+        "shower-guard":{"temp":22.1,"rh":19.8,"motion":false,"light":false,"fan":false,"light_decision":"","fan_decision":"rh-low 44.7/45.0 at 2022-12-16 11:04:53","light_on_time":1260,"fan_on_time":5400},   
     }
 
     {
@@ -782,7 +913,7 @@ RESPONSE:
     }   
     
     { 
-        "proportional":{"channel[0]":{"state":"idle", "error":"", "value":22, "config_open_time":6.2, "calib_open_time":6.0}, ...}},   
+        "proportional":{"channel[0]":{"state":"idle", "error":"", "value":22, "config_open_time":6.2, "calib_open_time":6.0, "position":220, "position_drift":15}, ...}},   
     }
 
     {
@@ -810,7 +941,9 @@ RESPONSE:
             "is_streaming": true,
             "url_index": 1,
             "url_name": "ffh-de",
-            "bitrate": 128000
+            "bitrate": 128000,
+            "connect_millis": 420,
+            "switch_millis": 910    // from the latest change of channel to its first audio
         },
         "fm": {
             "is_streaming": false,
@@ -828,8 +961,15 @@ RESPONSE:
             "volume": 40
         },
         "commited_volume": 40,
+        "current_volume": 40,   // differs from commited_volume while fading
         "title": "Pat Benatar - Love Is A Battlefield",
-        "status": ""
+        "status": "",
+        "memory": {
+            "free_heap": 101234,
+            "min_free_heap": 84012,
+            "largest_free_block": 65524,
+            "fragmentation": 0.35   // share of the free heap that cannot be had in one piece
+        }
         }
     }
 
@@ -868,8 +1008,81 @@ RESPONSE:
 NOTE for proportional: "calib_open_time" can be variated with "calib_open_2_closed_time" and "calib_closed_2_open_time",  
 subject to #ifdef
 
+REST GET poplog
+URL: <base>/poplog
+BODY: none
+RESPONSE: 
+{
+    "log": { <the text log since the previous pop> },
+    "log_ring": { <as below, the records since the previous pop> },
+    "system": { <see get> }
+}
+
+REST GET poplog from a cursor
+URL: <base>/poplog?since=<seq>&max=<records, 64 at most and by default>
+BODY: none
+RESPONSE (gzip or deflate encoded if the request accepts it): 
+{
+    "records": [
+        {"seq": 1022, "millis": 81250, "module": "mains-probe", "level": "debug", "text": "input_v_raw[addr=0x40][1]=0.812 V"},
+        ...
+    ],
+    "overflow": {"from": 900, "lost": 14},  // only if records from since on have been overwritten already
+    "reset": true,                          // only if since is ahead of the log, the unit has restarted
+    "next": 1023,                           // since of the following call
+    "more": false,                          // true: the batch was bounded, ask again right away
+    "dropped": {"mains-probe": 12},         // since boot, records that did not fit into the ring, per module
+    "levels": {"main": "debug", "www": "debug", ..., "mains-probe": "trace", ...}
+}
+
+the binary log of the hot paths is formatted here; the last 128 records are kept, reading does not remove them,
+so a collector resends its cursor after a lost response; the text log is only served by /poplog without since
+
+REST POST action
+URL: <base>/action/log/level?module=<main, www, autonom, keybox, shower-guard, rfid-lock, proportional, zero2ten, 
+                                    mains-probe, multi, audio or * for all>&level=<off, error, trace or debug>
+BODY: none
+RESPONSE: 
+{
+}
+
+only the binary log (log_ring in poplog) is filtered, until the next restart
+
 */
 
+// the format of the document of a GET route from the Accept header of the request; false if none of the
+// accepted types is served, 406 has been sent then
+
+static bool accept_document(RestDocument & document)
+{
+    document.format = rest_format_of(webServer.header("Accept").c_str());
+
+    if (document.format == rfNotAcceptable)
+    {
+        webServer.sendHeader("Vary", "Accept");
+        webServer.send(406, "application/json", "{\"error\":\"not acceptable, documents are application/json or application/msgpack\"}");
+        return false;
+    }
+
+    return true;
+}
+
+// a document of a GET route, JSON or the binary format of the request
+
+static void send_document(const String & r, const RestDocument & document)
+{
+    webServer.sendHeader("Vary", "Accept");
+
+    if (document.body != NULL)
+    {
+        webServer.send_P(200, rest_format_content_type(document.format), document.body, document.body_length);
+    }
+    else
+    {
+        webServer.send(200, "application/json", r.c_str());
+    }
+}
+
 void on_restart()
 {
     TRACE("*** RESTART REQUESTED VIA REST ***")
@@ -883,6 +1096,13 @@ void on_restart()
 
 void on_ping()
 {
+    RestDocument document;
+
+    if (accept_document(document) == false)
+    {
+        return;
+    }
+
     bool include_info = false;
 
     if (webServer.hasArg("info") == true)
@@ -890,16 +1110,23 @@ void on_ping()
         include_info = true;
     }
 
-    String r = restPing(include_info);
-    webServer.send(200, "application/json", r.c_str());
+    String r = restPing(include_info, document);
+    send_document(r, document);
     onboard_led_blink_once = true;
     onboard_led_paired = true;
 }
 
 void on_wifiinfo()
 {
-    String r = restWifiInfo();
-    webServer.send(200, "application/json", r.c_str());
+    RestDocument document;
+
+    if (accept_document(document) == false)
+    {
+        return;
+    }
+
+    String r = restWifiInfo(document);
+    send_document(r, document);
     onboard_led_blink_once = true;
     onboard_led_paired = true;
 }
@@ -1019,24 +1246,28 @@ void on_cleanup_autonom()
     onboard_led_paired = true;
 }
 
-void on_action_autonom_keybox_actuate()
+void on_action_autonom_shower_guard_replay()
 {
-    String channel_str;
-    String r;    
+    DEBUG("on_action_autonom_shower_guard_replay")
+
+    String body;
+    String response;
 
-    if (webServer.hasArg("channel") == true)
+    if (webServer.hasArg("plain") == false)
     {
-        channel_str = webServer.arg("channel");        
-        r = restActionAutonomKeyboxActuate(channel_str);
+        ERROR("shower-guard replay POST request without a payload")
     }
     else
     {
-        r = "Wrong or missing arguments";
+        body = webServer.arg("plain");
+        ASSERT_BODY_SIZE(body)
     }
 
+    String r = restActionAutonomShowerGuardReplay(body, response);
+
     if (r.isEmpty())
     {
-        webServer.send(200, "application/json", "{}");
+        webServer.send(200, "application/json", response.c_str());
     }
     else
     {
@@ -1045,46 +1276,32 @@ void on_action_autonom_keybox_actuate()
 
     onboard_led_blink_once = true;
     onboard_led_paired = true;
+
+    DEBUG("on_action_autonom_shower_guard_replay done")
 }
 
-void on_action_autonom_rfid_lock_program()
+void on_action_autonom_batch()
 {
-    String code_str;
-    String timeout_str;
-
-    bool argument_ok = true;
-    String r;    
+    DEBUG("on_action_autonom_batch")
 
-    if (webServer.hasArg("code") == true)
-    {
-        code_str = webServer.arg("code");        
-    }
-    else
-    {
-        argument_ok = false;
-    }
+    String body;
+    String response;
 
-    if (webServer.hasArg("timeout") == true)
+    if (webServer.hasArg("plain") == false)
     {
-        timeout_str = webServer.arg("timeout");        
+        ERROR("batch POST request without a payload")
     }
     else
     {
-        argument_ok = false;
+        body = webServer.arg("plain");
+        ASSERT_BODY_SIZE(body)
     }
 
-    if (argument_ok == true)
-    {
-        r = restActionAutonomRfidLockProgram(code_str, (uint16_t) timeout_str.toInt());
-    }
-    else
-    {
-        r = "Wrong or missing arguments";
-    }
+    String r = restActionAutonomBatch(body, response);
 
     if (r.isEmpty())
     {
-        webServer.send(200, "application/json", "{}");
+        webServer.send(200, "application/json", response.c_str());
     }
     else
     {
@@ -1093,6 +1310,8 @@ void on_action_autonom_rfid_lock_program()
 
     onboard_led_blink_once = true;
     onboard_led_paired = true;
+
+    DEBUG("on_action_autonom_batch done")
 }
 
 void on_action_autonom_rfid_lock_add_code()
@@ -1162,587 +1381,503 @@ void on_action_autonom_rfid_lock_add_code()
     onboard_led_paired = true;
 }
 
-void on_action_autonom_rfid_lock_delete_code()
+void on_get_autonom_rfid_lock_codes()
 {
-    String name_str;
-
-    bool argument_ok = true;
-    String r;    
+    RestDocument document;
 
-    if (webServer.hasArg("name") == true)
-    {
-        name_str = webServer.arg("name");        
-    }
-    else
+    if (accept_document(document) == false)
     {
-        argument_ok = false;
+        return;
     }
 
-    if (argument_ok == true)
-    {
-        r = restActionAutonomRfidLockDeleteCode(name_str);
-    }
-    else
-    {
-        r = "Wrong or missing arguments";
-    }
+    DEBUG("on_get_autonom_rfid_lock_codes")
+    String r = restGetAutonomRfidLockCodes(document);
+    DEBUG("%s", r.c_str())
+    send_document(r, document);
+    onboard_led_blink_once = true;
+    onboard_led_paired = true;
+}
 
-    if (r.isEmpty())
-    {
-        webServer.send(200, "application/json", "{}");
-    }
-    else
+void on_get_autonom_mains_probe_calibration_data()
+{
+    RestDocument document;
+
+    if (accept_document(document) == false)
     {
-        webServer.send(500, "application/json", String("{\"error\":\"" + r + "\"}"));
+        return;
     }
 
+    DEBUG("on_get_autonom_mains_probe_calibration_data")
+    String r = restGetAutonomMainsProbeCalibrationData(document);
+    DEBUG("%s", r.c_str())
+    send_document(r, document);
     onboard_led_blink_once = true;
     onboard_led_paired = true;
 }
 
-void on_action_autonom_rfid_lock_delete_all_codes()
+void on_action_autonom_mains_probe_import_calibration_data()
 {
-    DEBUG("on_action_autonom_rfid_lock_delete_all_codes")
-    String r;    
+    DEBUG("on_action_autonom_mains_probe_import_calibration_data")
 
-    r = restActionAutonomRfidLockDeleteAllCodes();
+    String body;
 
-    if (r.isEmpty())
+    if (webServer.hasArg("plain") == false)
     {
-        webServer.send(200, "application/json", "{}");
+        ERROR("mains-probe import calibration data POST request without a payload")
     }
     else
     {
-        webServer.send(500, "application/json", String("{\"error\":\"" + r + "\"}"));
+        body = webServer.arg("plain");
+        ASSERT_BODY_SIZE(body)
     }
 
+    String r = restActionAutonomMainsProbeImportCalibrationData(body);
+
+    webServer.send(200, "application/json", r.c_str());
     onboard_led_blink_once = true;
     onboard_led_paired = true;
+
+    DEBUG("on_action_autonom_mains_probe_import_calibration_data done")
 }
 
-void on_action_autonom_rfid_lock_unlock()
+void on_action_autonom_multi_set_volatile()
 {
-    String lock_channel_str;
+    DEBUG("on_action_autonom_multi_set_volatile")
 
-    bool argument_ok = true;
-    String r;    
+    String body;
 
-    if (webServer.hasArg("lock_channel") == true)
+    if (webServer.hasArg("plain") == false)
     {
-        lock_channel_str = webServer.arg("lock_channel");        
+        ERROR("multi set volatile POST request without a payload")
     }
     else
     {
-        argument_ok = false;
+        body = webServer.arg("plain");
+        ASSERT_BODY_SIZE(body)
     }
 
-    if (argument_ok == true)
-    {
-        r = restActionAutonomRfidLockUnlock(lock_channel_str);
-    }
-    else
-    {
-        r = "Wrong or missing arguments";
-    }
+    String r = restActionAutonomMultiSetVolatile(body);
 
-    if (r.isEmpty())
-    {
-        webServer.send(200, "application/json", "{}");
-    }
-    else
+    webServer.send(200, "application/json", r.c_str());
+    onboard_led_blink_once = true;
+    onboard_led_paired = true;
+
+    DEBUG("on_action_autonom_multi_set_volatile done")
+}
+
+void on_reset()
+{
+    String resetStamp;
+
+    if (webServer.hasArg("reset_stamp") == true)
     {
-        webServer.send(500, "application/json", String("{\"error\":\"" + r + "\"}"));
+        resetStamp = webServer.arg("reset_stamp");
     }
 
+    String r = restReset(resetStamp);
+    webServer.send(200, "application/json", r.c_str());
     onboard_led_blink_once = true;
     onboard_led_paired = true;
 }
 
-void on_get_autonom_rfid_lock_codes()
+void on_reset_pm()
 {
-    DEBUG("on_get_autonom_rfid_lock_codes")
-    String r = restGetAutonomRfidLockCodes();
-    DEBUG("%s", r.c_str())
+    String resetStamp;
+
+    if (webServer.hasArg("reset_stamp") == true)
+    {
+        resetStamp = webServer.arg("reset_stamp");
+    }
+
+    String r = restResetPm(resetStamp);
     webServer.send(200, "application/json", r.c_str());
     onboard_led_blink_once = true;
     onboard_led_paired = true;
 }
 
-void on_action_autonom_proportional_calibrate()
+void on_get()
 {
-    String channel_str;
-    String r;    
+    RestDocument document;
 
-    if (webServer.hasArg("channel") == true)
-    {
-        channel_str = webServer.arg("channel");        
-        r = restActionAutonomProportionalCalibrate(channel_str);
-    }
-    else
+    if (accept_document(document) == false)
     {
-        r = "Wrong or missing arguments";
+        return;
     }
 
-    if (r.isEmpty())
-    {
-        webServer.send(200, "application/json", "{}");
-    }
-    else
+    String resetStamp;
+
+    if (webServer.hasArg("reset_stamp") == true)
     {
-        webServer.send(500, "application/json", String("{\"error\":\"" + r + "\"}"));
+        resetStamp = webServer.arg("reset_stamp");
     }
 
+    String r = restGet(resetStamp, document);
+    DEBUG("%s", r.c_str())
+    send_document(r, document);
     onboard_led_blink_once = true;
     onboard_led_paired = true;
 }
 
-void on_action_autonom_proportional_actuate()
+void on_get_pm()
 {
-    String channel_str;
-    String value_str;
-    String ref_str;
-    String r;    
+    RestDocument document;
 
-    if (webServer.hasArg("channel") == true && webServer.hasArg("value") == true)
+    if (accept_document(document) == false)
     {
-        channel_str = webServer.arg("channel");        
-        value_str = webServer.arg("value");        
-        
-        if (webServer.hasArg("ref") == true)
-        {
-            ref_str = webServer.arg("ref"); 
-        }
-        
-        r = restActionAutonomProportionalActuate(channel_str, value_str, ref_str);
+        return;
     }
-    else
+
+    String resetStamp;
+    DEBUG("on_get_pm")
+
+    if (webServer.hasArg("reset_stamp") == true)
     {
-        r = "Wrong or missing arguments";
-    }
-
-    if (r.isEmpty())
-    {
-        webServer.send(200, "application/json", "{}");
-    }
-    else
-    {
-        webServer.send(500, "application/json", String("{\"error\":\"" + r + "\"}"));
+        resetStamp = webServer.arg("reset_stamp");
     }
 
+    String r = restGetPm(resetStamp, document);
+    send_document(r, document);
     onboard_led_blink_once = true;
     onboard_led_paired = true;
 }
 
-void on_action_autonom_zero2ten_calibrate_input()
+void on_get_autonom()
 {
-    String channel_str;
-    String value_str;
-    String r;    
+    RestDocument document;
 
-    if (webServer.hasArg("channel") == true)
-    {
-        channel_str = webServer.arg("channel");        
-
-        if (webServer.hasArg("value") == true)
-        {
-            value_str = webServer.arg("value");        
-        }
-        // otherwise - uncalibrate
-        
-        r = restActionAutonomZero2tenCalibrateInput(channel_str, value_str);
-    }
-    else
-    {
-        r = "Wrong or missing arguments";
-    }
-
-    if (r.isEmpty())
-    {
-        webServer.send(200, "application/json", "{}");
-    }
-    else
+    if (accept_document(document) == false)
     {
-        webServer.send(500, "application/json", String("{\"error\":\"" + r + "\"}"));
+        return;
     }
 
+    DEBUG("on_get_autonom")
+    String r = restGetAutonom(document);
+    DEBUG("%s", r.c_str())
+    send_document(r, document);
     onboard_led_blink_once = true;
     onboard_led_paired = true;
 }
 
-void on_action_autonom_zero2ten_input()
+void on_pop_log()
 {
-    String channel_str;
-    String value_str;
-    String r;    
+    RestDocument document;
 
-    if (webServer.hasArg("channel") == true)
+    if (accept_document(document) == false)
     {
-        channel_str = webServer.arg("channel");        
-        
-        r = restActionAutonomZero2tenInput(channel_str, value_str);
-    }
-    else
-    {
-        r = "Wrong or missing arguments";
+        return;
     }
 
-    if (r.isEmpty())
+    if (webServer.hasArg("since") == true)
     {
-        webServer.send(200, "application/json", String("{\"value\":\"" + value_str + "\"}"));
-    }
-    else
-    {
-        webServer.send(500, "application/json", String("{\"error\":\"" + r + "\"}"));
-    }
+        const char * body = NULL;
+        size_t body_length = 0;
+        const char * content_encoding = NULL;
 
-    onboard_led_blink_once = true;
-    onboard_led_paired = true;
-}
+        String r = restPopLogSince(webServer.arg("since"), webServer.arg("max"), webServer.header("Accept-Encoding"), 
+                                   document.format, body, body_length, content_encoding);
 
-void on_action_autonom_zero2ten_calibrate_output()
-{
-    String channel_str;
-    String value_str;
-    String r;    
+        if (r.length() == 0)
+        {
+            webServer.sendHeader("Vary", "Accept, Accept-Encoding");
 
-    if (webServer.hasArg("channel") == true)
-    {
-        channel_str = webServer.arg("channel");        
+            if (content_encoding != NULL)
+            {
+                webServer.sendHeader("Content-Encoding", content_encoding);
+            }
 
-        if (webServer.hasArg("value") == true)
+            webServer.send_P(200, rest_format_content_type(document.format), body, body_length);
+        }
+        else
         {
-            value_str = webServer.arg("value");        
+            webServer.send(400, "application/json", String("{\"error\":\"" + r + "\"}"));
         }
-        // otherwise - uncalibrate
-
-        r = restActionAutonomZero2tenCalibrateOutput(channel_str, value_str);
     }
     else
     {
-        r = "Wrong or missing arguments";
-    }
-
-    if (r.isEmpty())
-    {
-        webServer.send(200, "application/json", "{}");
-    }
-    else
-    {
-        webServer.send(500, "application/json", String("{\"error\":\"" + r + "\"}"));
+        String r = restPopLog(document);
+        send_document(r, document);
     }
 
     onboard_led_blink_once = true;
     onboard_led_paired = true;
 }
 
-void on_action_autonom_zero2ten_output()
-{
-    String channel_str;
-    String value_str;
-    String r;    
+void on_metrics();
+
+// routes that only take query arguments are declared in a table: the arguments are described by name, type and
+// whether they are required, they are collected in one pass over the arguments of the request and checked by
+// type before the rest function is called; the response follows from the kind of the route
+
+enum RouteParamType
+{
+    rptString = 0,
+    rptIndex = 1,    // unsigned decimal: channel, timeout, volume ...
+    rptFloat = 2,
+    rptAddr = 3      // i2c address, hex with or without 0x
+};
+
+enum RouteResponseKind
+{
+    rrkEmpty = 0,     // {}
+    rrkValue = 1,     // {"value":"<out>"}
+    rrkResponse = 2,  // {"response":"<out>"}
+    rrkBody = 3       // <out> as is
+};
+
+static const uint8_t MAX_ROUTE_PARAMS = 4;
+
+struct RouteParam
+{
+    const char * name;
+    uint8_t type;
+    bool required;
+};
+
+struct RouteArgs
+{
+    String value[MAX_ROUTE_PARAMS];   // empty if not present
+};
+
+typedef String (*RouteCall)(const RouteArgs & args, String & out);
+
+struct QueryRoute
+{
+    const char * uri;
+    HTTPMethod method;
+    RouteParam params[MAX_ROUTE_PARAMS];
+    uint8_t response_kind;
+    RouteCall call;
+};
+
+struct Route
+{
+    const char * uri;
+    HTTPMethod method;
+    void (*handler)();
+};
+
+static String call_keybox_actuate(const RouteArgs & a, String &) { return restActionAutonomKeyboxActuate(a.value[0]); }
+static String call_rfid_lock_program(const RouteArgs & a, String &) { return restActionAutonomRfidLockProgram(a.value[0], (uint16_t) a.value[1].toInt()); }
+static String call_rfid_lock_delete_code(const RouteArgs & a, String &) { return restActionAutonomRfidLockDeleteCode(a.value[0]); }
+static String call_rfid_lock_delete_all_codes(const RouteArgs &, String &) { return restActionAutonomRfidLockDeleteAllCodes(); }
+static String call_rfid_lock_unlock(const RouteArgs & a, String &) { return restActionAutonomRfidLockUnlock(a.value[0]); }
+static String call_proportional_calibrate(const RouteArgs & a, String &) { return restActionAutonomProportionalCalibrate(a.value[0]); }
+static String call_proportional_actuate(const RouteArgs & a, String &) { return restActionAutonomProportionalActuate(a.value[0], a.value[1], a.value[2]); }
+static String call_proportional_signature(const RouteArgs & a, String & out) { return restGetAutonomProportionalSignature(a.value[0], out); }
+static String call_zero2ten_calibrate_input(const RouteArgs & a, String &) { return restActionAutonomZero2tenCalibrateInput(a.value[0], a.value[1]); }
+static String call_zero2ten_input(const RouteArgs & a, String & out) { return restActionAutonomZero2tenInput(a.value[0], out); }
+static String call_zero2ten_calibrate_output(const RouteArgs & a, String &) { return restActionAutonomZero2tenCalibrateOutput(a.value[0], a.value[1]); }
+static String call_zero2ten_output(const RouteArgs & a, String &) { return restActionAutonomZero2tenOutput(a.value[0], a.value[1]); }
+static String call_mains_probe_calibrate_v(const RouteArgs & a, String &) { return restActionAutonomMainsProbeCalibrateV(a.value[0], a.value[1], a.value[2]); }
+static String call_mains_probe_calibrate_a_high(const RouteArgs & a, String &) { return restActionAutonomMainsProbeCalibrateAHigh(a.value[0], a.value[1], a.value[2]); }
+static String call_mains_probe_calibrate_a_low(const RouteArgs & a, String &) { return restActionAutonomMainsProbeCalibrateALow(a.value[0], a.value[1]); }
+static String call_mains_probe_input_v(const RouteArgs & a, String & out) { return restActionAutonomMainsProbeInputV(a.value[0], a.value[1], out); }
+static String call_mains_probe_input_a_high(const RouteArgs & a, String & out) { return restActionAutonomMainsProbeInputAHigh(a.value[0], a.value[1], out); }
+static String call_mains_probe_input_a_low(const RouteArgs & a, String & out) { return restActionAutonomMainsProbeInputALow(a.value[0], out); }
+static String call_multi_uart_command(const RouteArgs & a, String & out) { return restActionAutonomMultiUartCommand(a.value[0], out); }
+static String call_multi_audio_control(const RouteArgs & a, String & out) { return restActionAutonomMultiAudioControl(a.value[0], a.value[1], a.value[2], out); }
+static String call_log_level(const RouteArgs & a, String &) { return restActionLogLevel(a.value[0], a.value[1]); }
+
+#define API_URI(_path_) "/" HARVESTER_API_KEY _path_
+
+static constexpr QueryRoute query_routes[] =
+{
+    {API_URI("/action/autonom/keybox/actuate"), HTTP_POST, {{"channel", rptIndex, true}}, rrkEmpty, call_keybox_actuate},
+    {API_URI("/action/autonom/rfid-lock/program"), HTTP_POST, {{"code", rptString, true}, {"timeout", rptIndex, true}}, rrkEmpty, call_rfid_lock_program},
+    {API_URI("/action/autonom/rfid-lock/delete_code"), HTTP_POST, {{"name", rptString, true}}, rrkEmpty, call_rfid_lock_delete_code},
+    {API_URI("/action/autonom/rfid-lock/delete_all_codes"), HTTP_POST, {}, rrkEmpty, call_rfid_lock_delete_all_codes},
+    {API_URI("/action/autonom/rfid-lock/unlock"), HTTP_POST, {{"lock_channel", rptIndex, true}}, rrkEmpty, call_rfid_lock_unlock},
+    {API_URI("/action/autonom/proportional/calibrate"), HTTP_POST, {{"channel", rptIndex, true}}, rrkEmpty, call_proportional_calibrate},
+    {API_URI("/action/autonom/proportional/actuate"), HTTP_POST, {{"channel", rptIndex, true}, {"value", rptIndex, true}, {"ref", rptIndex, false}},
+        rrkEmpty, call_proportional_actuate},
+    {API_URI("/get/autonom/proportional/signature"), HTTP_GET, {{"channel", rptIndex, true}}, rrkBody, call_proportional_signature},
+    {API_URI("/action/autonom/zero2ten/calibrate_input"), HTTP_POST, {{"channel", rptIndex, true}, {"value", rptFloat, false}}, rrkEmpty, call_zero2ten_calibrate_input},
+    {API_URI("/action/autonom/zero2ten/input"), HTTP_POST, {{"channel", rptIndex, true}}, rrkValue, call_zero2ten_input},
+    {API_URI("/action/autonom/zero2ten/calibrate_output"), HTTP_POST, {{"channel", rptIndex, true}, {"value", rptFloat, false}}, rrkEmpty, call_zero2ten_calibrate_output},
+    {API_URI("/action/autonom/zero2ten/output"), HTTP_POST, {{"channel", rptIndex, true}, {"value", rptFloat, true}}, rrkEmpty, call_zero2ten_output},
+    {API_URI("/action/autonom/mains-probe/calibrate_v"), HTTP_POST, {{"addr", rptAddr, false}, {"channel", rptIndex, true}, {"value", rptFloat, false}},
+        rrkEmpty, call_mains_probe_calibrate_v},
+    {API_URI("/action/autonom/mains-probe/calibrate_a_high"), HTTP_POST, {{"addr", rptAddr, false}, {"channel", rptIndex, true}, {"value", rptFloat, false}},
+        rrkEmpty, call_mains_probe_calibrate_a_high},
+    {API_URI("/action/autonom/mains-probe/calibrate_a_low"), HTTP_POST, {{"channel", rptIndex, true}, {"value", rptFloat, false}}, rrkEmpty, call_mains_probe_calibrate_a_low},
+    {API_URI("/action/autonom/mains-probe/input_v"), HTTP_POST, {{"addr", rptAddr, false}, {"channel", rptIndex, true}}, rrkValue, call_mains_probe_input_v},
+    {API_URI("/action/autonom/mains-probe/input_a_high"), HTTP_POST, {{"addr", rptAddr, false}, {"channel", rptIndex, true}}, rrkValue, call_mains_probe_input_a_high},
+    {API_URI("/action/autonom/mains-probe/input_a_low"), HTTP_POST, {{"channel", rptIndex, true}}, rrkValue, call_mains_probe_input_a_low},
+    {API_URI("/action/autonom/multi/uart_command"), HTTP_POST, {{"command", rptString, true}}, rrkResponse, call_multi_uart_command},
+    {API_URI("/action/autonom/multi/audio_control"), HTTP_POST, {{"source", rptString, false}, {"channel", rptIndex, false}, {"volume", rptIndex, false}},
+        rrkResponse, call_multi_audio_control},
+    {API_URI("/action/log/level"), HTTP_POST, {{"module", rptString, true}, {"level", rptString, true}}, rrkEmpty, call_log_level}
+};
+
+static constexpr Route routes[] =
+{
+    {API_URI("/restart"), HTTP_POST, on_restart},
+    {API_URI("/ping"), HTTP_GET, on_ping},
+    {API_URI("/wifiinfo"), HTTP_GET, on_wifiinfo},
+    {API_URI("/setup"), HTTP_POST, on_setup},
+    {API_URI("/setup/pm"), HTTP_POST, on_setup_pm},
+    {API_URI("/setup/autonom"), HTTP_POST, on_setup_autonom},
+    {API_URI("/cleanup"), HTTP_POST, on_cleanup},
+    {API_URI("/cleanup/pm"), HTTP_POST, on_cleanup_pm},
+    {API_URI("/cleanup/autonom"), HTTP_POST, on_cleanup_autonom},
+    {API_URI("/action/autonom/shower-guard/replay"), HTTP_POST, on_action_autonom_shower_guard_replay},
+    {API_URI("/action/autonom/batch"), HTTP_POST, on_action_autonom_batch},
+    {API_URI("/action/autonom/rfid-lock/add_code"), HTTP_POST, on_action_autonom_rfid_lock_add_code},
+    {API_URI("/get/autonom/rfid-lock/codes"), HTTP_GET, on_get_autonom_rfid_lock_codes},
+    {API_URI("/get/autonom/mains-probe/calibration_data"), HTTP_GET, on_get_autonom_mains_probe_calibration_data},
+    {API_URI("/action/autonom/mains-probe/import_calibration_data"), HTTP_POST, on_action_autonom_mains_probe_import_calibration_data},
+    {API_URI("/action/autonom/multi/set_volatile"), HTTP_POST, on_action_autonom_multi_set_volatile},
+    {API_URI("/reset"), HTTP_POST, on_reset},
+    {API_URI("/reset/pm"), HTTP_POST, on_reset_pm},
+    {API_URI("/get"), HTTP_GET, on_get},
+    {API_URI("/get/pm"), HTTP_GET, on_get_pm},
+    {API_URI("/get/autonom"), HTTP_GET, on_get_autonom},
+    {API_URI("/poplog"), HTTP_GET, on_pop_log},
+    {API_URI("/metrics"), HTTP_GET, on_metrics}
+};
+
+static RouteMetrics query_route_metrics[sizeof(query_routes)/sizeof(query_routes[0])];
+static RouteMetrics route_metrics[sizeof(routes)/sizeof(routes[0])];
+
+// handlers run one at a time in the task of wwwHandleClient(), so are the metrics
+
+class RouteTimer
+{
+public:
+
+    RouteTimer(RouteMetrics & _metrics) : metrics(_metrics)
+    {
+        current_route_metrics = & metrics;
+        start_us = esp_timer_get_time();
+    }
+
+    ~RouteTimer()
+    {
+        metrics.latency.record(uint32_t(esp_timer_get_time() - start_us));
+        current_route_metrics = NULL;
+    }
+
+protected:
+
+    RouteMetrics & metrics;
+    int64_t start_us;
+};
+
+static bool is_route_param_valid(const String & value, uint8_t type)
+{
+    const char * str = value.c_str();
+    char * end = NULL;
+
+    switch(type)
+    {
+        case rptIndex:
+
+            if (*str == 0)
+            {
+                return false;
+            }
 
-    if (webServer.hasArg("channel") == true && webServer.hasArg("value") == true)
-    {
-        channel_str = webServer.arg("channel");        
-        value_str = webServer.arg("value");        
-        
-        r = restActionAutonomZero2tenOutput(channel_str, value_str);
-    }
-    else
-    {
-        r = "Wrong or missing arguments";
-    }
+            for (; *str != 0; ++str)
+            {
+                if (isdigit(*str) == false)
+                {
+                    return false;
+                }
+            }
+            return true;
 
-    if (r.isEmpty())
-    {
-        webServer.send(200, "application/json", "{}");
-    }
-    else
-    {
-        webServer.send(500, "application/json", String("{\"error\":\"" + r + "\"}"));
-    }
+        case rptFloat:
 
-    onboard_led_blink_once = true;
-    onboard_led_paired = true;
-}
+            strtof(str, &end);
+            return end != str && *end == 0;
 
-void on_action_autonom_mains_probe_calibrate_v()
-{
-    String addr_str;
-    String channel_str;
-    String value_str;
-    String r;    
+        case rptAddr:
 
-    if (webServer.hasArg("addr") == true)
-    {
-        addr_str = webServer.arg("addr");
-    }
+            if (str[0] == '0' && (str[1] == 'x' || str[1] == 'X'))
+            {
+                str += 2;
+            }
 
-    if (webServer.hasArg("channel") == true)
-    {
-        channel_str = webServer.arg("channel");        
+            if (*str == 0)
+            {
+                return false;
+            }
 
-        if (webServer.hasArg("value") == true)
-        {
-            value_str = webServer.arg("value");        
-        }
-        // otherwise - uncalibrate
-        
-        r = restActionAutonomMainsProbeCalibrateV(addr_str, channel_str, value_str);
-    }
-    else
-    {
-        r = "Wrong or missing arguments";
-    }
+            for (; *str != 0; ++str)
+            {
+                if (isxdigit(*str) == false)
+                {
+                    return false;
+                }
+            }
+            return true;
 
-    if (r.isEmpty())
-    {
-        webServer.send(200, "application/json", "{}");
+        default:
+            return true;
     }
-    else
-    {
-        webServer.send(500, "application/json", String("{\"error\":\"" + r + "\"}"));
-    }
-
-    onboard_led_blink_once = true;
-    onboard_led_paired = true;
 }
 
-void on_action_autonom_mains_probe_calibrate_a_high()
+static void on_query_route(const QueryRoute & route)
 {
-    String addr_str;
-    String channel_str;
-    String value_str;
-    String r;    
+    RouteArgs args;
+    bool present[MAX_ROUTE_PARAMS] = {false};
+    String r;
 
-    if (webServer.hasArg("addr") == true)
+    for (int i=0; i<webServer.args(); ++i)
     {
-        addr_str = webServer.arg("addr");
-    }
+        const String name = webServer.argName(i);
 
-    if (webServer.hasArg("channel") == true)
-    {
-        channel_str = webServer.arg("channel");        
-
-        if (webServer.hasArg("value") == true)
+        for (uint8_t k=0; k<MAX_ROUTE_PARAMS && route.params[k].name != NULL; ++k)
         {
-            value_str = webServer.arg("value");        
+            if (present[k] == false && strcmp(name.c_str(), route.params[k].name) == 0)
+            {
+                args.value[k] = webServer.arg(i);
+                present[k] = true;
+                break;
+            }
         }
-        // otherwise - uncalibrate
-        
-        r = restActionAutonomMainsProbeCalibrateAHigh(addr_str, channel_str, value_str);
-    }
-    else
-    {
-        r = "Wrong or missing arguments";
-    }
-
-    if (r.isEmpty())
-    {
-        webServer.send(200, "application/json", "{}");
-    }
-    else
-    {
-        webServer.send(500, "application/json", String("{\"error\":\"" + r + "\"}"));
     }
 
-    onboard_led_blink_once = true;
-    onboard_led_paired = true;
-}
-
-void on_action_autonom_mains_probe_calibrate_a_low()
-{
-    String channel_str;
-    String value_str;
-    String r;    
-
-    if (webServer.hasArg("channel") == true)
+    for (uint8_t k=0; k<MAX_ROUTE_PARAMS && route.params[k].name != NULL && r.isEmpty(); ++k)
     {
-        channel_str = webServer.arg("channel");        
-
-        if (webServer.hasArg("value") == true)
+        if (present[k] == false)
         {
-            value_str = webServer.arg("value");        
+            if (route.params[k].required)
+            {
+                r = "Wrong or missing arguments";
+            }
+        }
+        else if ((route.params[k].required || args.value[k].length() > 0) &&
+                 is_route_param_valid(args.value[k], route.params[k].type) == false)
+        {
+            r = String("Invalid value of argument ") + route.params[k].name;
         }
-        // otherwise - uncalibrate
-        
-        r = restActionAutonomMainsProbeCalibrateALow(channel_str, value_str);
-    }
-    else
-    {
-        r = "Wrong or missing arguments";
-    }
-
-    if (r.isEmpty())
-    {
-        webServer.send(200, "application/json", "{}");
-    }
-    else
-    {
-        webServer.send(500, "application/json", String("{\"error\":\"" + r + "\"}"));
-    }
-
-    onboard_led_blink_once = true;
-    onboard_led_paired = true;
-}
-
-void on_action_autonom_mains_probe_input_v()
-{
-    String addr_str;
-    String channel_str;
-    String value_str;
-    String r;    
-
-    if (webServer.hasArg("addr") == true)
-    {
-        addr_str = webServer.arg("addr");
-    }
-
-    if (webServer.hasArg("channel") == true)
-    {
-        channel_str = webServer.arg("channel");        
-        
-        r = restActionAutonomMainsProbeInputV(addr_str, channel_str, value_str);
-    }
-    else
-    {
-        r = "Wrong or missing arguments";
-    }
-
-    if (r.isEmpty())
-    {
-        webServer.send(200, "application/json", String("{\"value\":\"" + value_str + "\"}"));
-    }
-    else
-    {
-        webServer.send(500, "application/json", String("{\"error\":\"" + r + "\"}"));
-    }
-
-    onboard_led_blink_once = true;
-    onboard_led_paired = true;
-}
-
-void on_action_autonom_mains_probe_input_a_high()
-{
-    String addr_str;
-    String channel_str;
-    String value_str;
-    String r;    
-
-    if (webServer.hasArg("addr") == true)
-    {
-        addr_str = webServer.arg("addr");
-    }
-
-    if (webServer.hasArg("channel") == true)
-    {
-        channel_str = webServer.arg("channel");        
-        
-        r = restActionAutonomMainsProbeInputAHigh(addr_str, channel_str, value_str);
-    }
-    else
-    {
-        r = "Wrong or missing arguments";
-    }
-
-    if (r.isEmpty())
-    {
-        webServer.send(200, "application/json", String("{\"value\":\"" + value_str + "\"}"));
-    }
-    else
-    {
-        webServer.send(500, "application/json", String("{\"error\":\"" + r + "\"}"));
     }
 
-    onboard_led_blink_once = true;
-    onboard_led_paired = true;
-}
-
-void on_action_autonom_mains_probe_input_a_low()
-{
-    String channel_str;
-    String value_str;
-    String r;    
-
-    if (webServer.hasArg("channel") == true)
-    {
-        channel_str = webServer.arg("channel");        
-        
-        r = restActionAutonomMainsProbeInputALow(channel_str, value_str);
-    }
-    else
-    {
-        r = "Wrong or missing arguments";
-    }
+    String out;
 
     if (r.isEmpty())
     {
-        webServer.send(200, "application/json", String("{\"value\":\"" + value_str + "\"}"));
-    }
-    else
-    {
-        webServer.send(500, "application/json", String("{\"error\":\"" + r + "\"}"));
-    }
-
-    onboard_led_blink_once = true;
-    onboard_led_paired = true;
-}
-
-void on_get_autonom_mains_probe_calibration_data()
-{
-    DEBUG("on_get_autonom_mains_probe_calibration_data")
-    String r = restGetAutonomMainsProbeCalibrationData();
-    DEBUG("%s", r.c_str())
-    webServer.send(200, "application/json", r.c_str());
-    onboard_led_blink_once = true;
-    onboard_led_paired = true;
-}
-
-void on_action_autonom_mains_probe_import_calibration_data()
-{
-    DEBUG("on_action_autonom_mains_probe_import_calibration_data")
-
-    String body;
-
-    if (webServer.hasArg("plain") == false)
-    {
-        ERROR("mains-probe import calibration data POST request without a payload")
-    }
-    else
-    {
-        body = webServer.arg("plain");
-        ASSERT_BODY_SIZE(body)
-    }
-
-    String r = restActionAutonomMainsProbeImportCalibrationData(body);
-
-    webServer.send(200, "application/json", r.c_str());
-    onboard_led_blink_once = true;
-    onboard_led_paired = true;
-
-    DEBUG("on_action_autonom_mains_probe_import_calibration_data done")
-}
-
-void on_action_autonom_multi_uart_command()
-{
-    String command;
-    String response;
-    String r;    
-
-    if (webServer.hasArg("command") == true)
-    {
-        command = webServer.arg("command");        
-        
-        r = restActionAutonomMultiUartCommand(command, response);
-    }
-    else
-    {
-        r = "Wrong or missing arguments";
+        r = route.call(args, out);
     }
 
     if (r.isEmpty())
     {
-        webServer.send(200, "application/json", String("{\"response\":\"" + response + "\"}"));
+        switch(route.response_kind)
+        {
+            case rrkValue:
+                webServer.send(200, "application/json", String("{\"value\":\"" + out + "\"}"));
+                break;
+            case rrkResponse:
+                webServer.send(200, "application/json", String("{\"response\":\"" + out + "\"}"));
+                break;
+            case rrkBody:
+                webServer.send(200, "application/json", out.c_str());
+                break;
+            default:
+                webServer.send(200, "application/json", "{}");
+                break;
+        }
     }
     else
     {
@@ -1753,190 +1888,73 @@ void on_action_autonom_multi_uart_command()
     onboard_led_paired = true;
 }
 
-void on_action_autonom_multi_audio_control()
+static const char * method_text(HTTPMethod method)
 {
-    String source;
-    String channel;
-    String volume;
-    String response;
-    String r;    
-
-    if (webServer.hasArg("source") == true)
-    {
-        source = webServer.arg("source");        
-    }
-
-    if (webServer.hasArg("channel") == true)
-    {
-        channel = webServer.arg("channel");        
-    }
-
-    if (webServer.hasArg("volume") == true)
-    {
-        volume = webServer.arg("volume");        
-    }
-
-    r = restActionAutonomMultiAudioControl(source, channel, volume, response);
-    
-    if (r.isEmpty())
-    {
-        webServer.send(200, "application/json", String("{\"response\":\"" + response + "\"}"));
-    }
-    else
-    {
-        webServer.send(500, "application/json", String("{\"error\":\"" + r + "\"}"));
-    }
-
-    onboard_led_blink_once = true;
-    onboard_led_paired = true;
+    return method == HTTP_GET ? "GET" : (method == HTTP_POST ? "POST" : "OTHER");
 }
 
-void on_action_autonom_multi_set_volatile()
-{
-    DEBUG("on_action_autonom_multi_set_volatile")
-
-    String body;
+// sent in chunks, see route_metrics_exposition()
 
-    if (webServer.hasArg("plain") == false)
-    {
-        ERROR("multi set volatile POST request without a payload")
-    }
-    else
-    {
-        body = webServer.arg("plain");
-        ASSERT_BODY_SIZE(body)
-    }
-
-    String r = restActionAutonomMultiSetVolatile(body);
-
-    webServer.send(200, "application/json", r.c_str());
-    onboard_led_blink_once = true;
-    onboard_led_paired = true;
-
-    DEBUG("on_action_autonom_multi_set_volatile done")
-}
-
-void on_reset()
+void on_metrics()
 {
-    String resetStamp;
-
-    if (webServer.hasArg("reset_stamp") == true)
-    {
-        resetStamp = webServer.arg("reset_stamp");
-    }
+    webServer.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    webServer.send(200, "text/plain; version=0.0.4", "");
 
-    String r = restReset(resetStamp);
-    webServer.send(200, "application/json", r.c_str());
-    onboard_led_blink_once = true;
-    onboard_led_paired = true;
-}
+    const size_t route_count = sizeof(routes)/sizeof(routes[0]);
+    const size_t query_route_count = sizeof(query_routes)/sizeof(query_routes[0]);
+    const size_t api_prefix_length = sizeof("/" HARVESTER_API_KEY) - 1;
 
-void on_reset_pm()
-{
-    String resetStamp;
+    String text;
+    text.reserve(2048);
 
-    if (webServer.hasArg("reset_stamp") == true)
-    {
-        resetStamp = webServer.arg("reset_stamp");
-    }
+    route_metrics_exposition(text, route_count + query_route_count,
+        [&](size_t i, const char * & route, const char * & method, const RouteMetrics * & metrics)
+        {
+            if (i < route_count)
+            {
+                route = routes[i].uri + api_prefix_length;
+                method = method_text(routes[i].method);
+                metrics = & route_metrics[i];
+            }
+            else
+            {
+                route = query_routes[i - route_count].uri + api_prefix_length;
+                method = method_text(query_routes[i - route_count].method);
+                metrics = & query_route_metrics[i - route_count];
+            }
+        },
+        [](const String & chunk)
+        {
+            webServer.sendContent(chunk);
+        });
 
-    String r = restResetPm(resetStamp);
-    webServer.send(200, "application/json", r.c_str());
-    onboard_led_blink_once = true;
-    onboard_led_paired = true;
+    webServer.sendContent("");
 }
 
-void on_get()
+void wwwSetupRouting()
 {
-    String resetStamp;
+    static const char * collected_headers[] = {"Accept", "Accept-Encoding"};
+    webServer.collectHeaders(collected_headers, sizeof(collected_headers)/sizeof(collected_headers[0]));
 
-    if (webServer.hasArg("reset_stamp") == true)
+    for (size_t i=0; i<sizeof(routes)/sizeof(routes[0]); ++i)
     {
-        resetStamp = webServer.arg("reset_stamp");
+        webServer.on(routes[i].uri, routes[i].method, [i]()
+        {
+            RouteTimer timer(route_metrics[i]);
+            routes[i].handler();
+            restEndRequest();
+        });
     }
 
-    String r = restGet(resetStamp);
-    DEBUG("%s", r.c_str())
-    webServer.send(200, "application/json", r.c_str());
-    onboard_led_blink_once = true;
-    onboard_led_paired = true;
-}
-
-void on_get_pm()
-{
-    String resetStamp;
-    DEBUG("on_get_pm")
-
-    if (webServer.hasArg("reset_stamp") == true)
+    for (size_t i=0; i<sizeof(query_routes)/sizeof(query_routes[0]); ++i)
     {
-        resetStamp = webServer.arg("reset_stamp");
+        webServer.on(query_routes[i].uri, query_routes[i].method, [i]()
+        {
+            RouteTimer timer(query_route_metrics[i]);
+            on_query_route(query_routes[i]);
+            restEndRequest();
+        });
     }
-
-    String r = restGetPm(resetStamp);
-    webServer.send(200, "application/json", r.c_str());
-    onboard_led_blink_once = true;
-    onboard_led_paired = true;
-}
-
-void on_get_autonom()
-{
-    DEBUG("on_get_autonom")
-    String r = restGetAutonom();
-    DEBUG("%s", r.c_str())
-    webServer.send(200, "application/json", r.c_str());
-    onboard_led_blink_once = true;
-    onboard_led_paired = true;
-}
-
-void on_pop_log()
-{
-    String r = restPopLog();
-    webServer.send(200, "application/json", r.c_str());
-    onboard_led_blink_once = true;
-    onboard_led_paired = true;
-}
-
-void wwwSetupRouting()
-{
-    webServer.on("/" HARVESTER_API_KEY "/restart", HTTP_POST, on_restart);
-    webServer.on("/" HARVESTER_API_KEY "/ping", HTTP_GET, on_ping);
-    webServer.on("/" HARVESTER_API_KEY "/wifiinfo", HTTP_GET, on_wifiinfo);
-    webServer.on("/" HARVESTER_API_KEY "/setup", HTTP_POST, on_setup);
-    webServer.on("/" HARVESTER_API_KEY "/setup/pm", HTTP_POST, on_setup_pm);
-    webServer.on("/" HARVESTER_API_KEY "/setup/autonom", HTTP_POST, on_setup_autonom);
-    webServer.on("/" HARVESTER_API_KEY "/cleanup", HTTP_POST, on_cleanup);
-    webServer.on("/" HARVESTER_API_KEY "/cleanup/pm", HTTP_POST, on_cleanup_pm);
-    webServer.on("/" HARVESTER_API_KEY "/cleanup/autonom", HTTP_POST, on_cleanup_autonom);
-    webServer.on("/" HARVESTER_API_KEY "/action/autonom/keybox/actuate", HTTP_POST, on_action_autonom_keybox_actuate);
-    webServer.on("/" HARVESTER_API_KEY "/action/autonom/rfid-lock/program", HTTP_POST, on_action_autonom_rfid_lock_program);
-    webServer.on("/" HARVESTER_API_KEY "/action/autonom/rfid-lock/add_code", HTTP_POST, on_action_autonom_rfid_lock_add_code);
-    webServer.on("/" HARVESTER_API_KEY "/action/autonom/rfid-lock/delete_code", HTTP_POST, on_action_autonom_rfid_lock_delete_code);
-    webServer.on("/" HARVESTER_API_KEY "/action/autonom/rfid-lock/delete_all_codes", HTTP_POST, on_action_autonom_rfid_lock_delete_all_codes);
-    webServer.on("/" HARVESTER_API_KEY "/action/autonom/rfid-lock/unlock", HTTP_POST, on_action_autonom_rfid_lock_unlock);
-    webServer.on("/" HARVESTER_API_KEY "/get/autonom/rfid-lock/codes", HTTP_GET, on_get_autonom_rfid_lock_codes);
-    webServer.on("/" HARVESTER_API_KEY "/action/autonom/proportional/calibrate", HTTP_POST, on_action_autonom_proportional_calibrate);
-    webServer.on("/" HARVESTER_API_KEY "/action/autonom/proportional/actuate", HTTP_POST, on_action_autonom_proportional_actuate);
-    webServer.on("/" HARVESTER_API_KEY "/action/autonom/zero2ten/calibrate_input", HTTP_POST, on_action_autonom_zero2ten_calibrate_input);
-    webServer.on("/" HARVESTER_API_KEY "/action/autonom/zero2ten/input", HTTP_POST, on_action_autonom_zero2ten_input);
-    webServer.on("/" HARVESTER_API_KEY "/action/autonom/zero2ten/calibrate_output", HTTP_POST, on_action_autonom_zero2ten_calibrate_output);
-    webServer.on("/" HARVESTER_API_KEY "/action/autonom/zero2ten/output", HTTP_POST, on_action_autonom_zero2ten_output);
-    webServer.on("/" HARVESTER_API_KEY "/action/autonom/mains-probe/calibrate_v", HTTP_POST, on_action_autonom_mains_probe_calibrate_v);
-    webServer.on("/" HARVESTER_API_KEY "/action/autonom/mains-probe/calibrate_a_high", HTTP_POST, on_action_autonom_mains_probe_calibrate_a_high);
-    webServer.on("/" HARVESTER_API_KEY "/action/autonom/mains-probe/calibrate_a_low", HTTP_POST, on_action_autonom_mains_probe_calibrate_a_low);
-    webServer.on("/" HARVESTER_API_KEY "/action/autonom/mains-probe/input_v", HTTP_POST, on_action_autonom_mains_probe_input_v);
-    webServer.on("/" HARVESTER_API_KEY "/action/autonom/mains-probe/input_a_high", HTTP_POST, on_action_autonom_mains_probe_input_a_high);
-    webServer.on("/" HARVESTER_API_KEY "/action/autonom/mains-probe/input_a_low", HTTP_POST, on_action_autonom_mains_probe_input_a_low);
-    webServer.on("/" HARVESTER_API_KEY "/get/autonom/mains-probe/calibration_data", HTTP_GET, on_get_autonom_mains_probe_calibration_data);
-    webServer.on("/" HARVESTER_API_KEY "/action/autonom/mains-probe/import_calibration_data", HTTP_POST, on_action_autonom_mains_probe_import_calibration_data);
-    webServer.on("/" HARVESTER_API_KEY "/action/autonom/multi/uart_command", HTTP_POST, on_action_autonom_multi_uart_command);
-    webServer.on("/" HARVESTER_API_KEY "/action/autonom/multi/audio_control", HTTP_POST, on_action_autonom_multi_audio_control);
-    webServer.on("/" HARVESTER_API_KEY "/action/autonom/multi/set_volatile", HTTP_POST, on_action_autonom_multi_set_volatile);
-    webServer.on("/" HARVESTER_API_KEY "/reset", HTTP_POST, on_reset);
-    webServer.on("/" HARVESTER_API_KEY "/reset/pm", HTTP_POST, on_reset_pm);
-    webServer.on("/" HARVESTER_API_KEY "/get", HTTP_GET, on_get);
-    webServer.on("/" HARVESTER_API_KEY "/get/pm", HTTP_GET, on_get_pm);
-    webServer.on("/" HARVESTER_API_KEY "/get/autonom", HTTP_GET, on_get_autonom);
-    webServer.on("/" HARVESTER_API_KEY "/poplog", HTTP_GET, on_pop_log);
 }
 
 void wwwBegin()
@@ -7,7 +7,11 @@
 #include <autonom.h>
 #include <gpio.h>
 #include <binarySemaphore.h>
+#include <telemetry.h>
 #include <mapTable.h>
+#include <gainLut.h>
+#include <gainTables.h>
+#include <scheduler.h>
 #include <Wire.h>
 #include <deque>
 #include <epromImage.h>
@@ -369,6 +373,21 @@ void Zero2tenConfig::OutputChannel::from_json(const JsonVariant &json)
         const JsonVariant &_json = json["loopback"];
         loopback.from_json(_json);
     }
+
+    if (json.containsKey("slew_rate"))
+    {
+        slew_rate = (float) json["slew_rate"];
+    }
+
+    if (json.containsKey("freq"))
+    {
+        freq = (uint32_t) json["freq"];
+    }
+
+    if (json.containsKey("resolution"))
+    {
+        resolution = (uint8_t) (int) json["resolution"];
+    }
 }
 
 void Zero2tenConfig::OutputChannel::to_eprom(std::ostream &os) const
@@ -376,6 +395,9 @@ void Zero2tenConfig::OutputChannel::to_eprom(std::ostream &os) const
     output.to_eprom(os);
     os.write((const char *)&max_voltage, sizeof(max_voltage));
     loopback.to_eprom(os);
+    os.write((const char *)&slew_rate, sizeof(slew_rate));
+    os.write((const char *)&freq, sizeof(freq));
+    os.write((const char *)&resolution, sizeof(resolution));
 }
 
 bool Zero2tenConfig::OutputChannel::from_eprom(std::istream &is)
@@ -385,6 +407,9 @@ bool Zero2tenConfig::OutputChannel::from_eprom(std::istream &is)
     output.from_eprom(is);
     is.read((char *)&max_voltage, sizeof(max_voltage));
     loopback.from_eprom(is);
+    is.read((char *)&slew_rate, sizeof(slew_rate));
+    is.read((char *)&freq, sizeof(freq));
+    is.read((char *)&resolution, sizeof(resolution));
 
     return is_valid() && !is.bad();
 }
@@ -515,6 +540,34 @@ public:
     const ledc_mode_t PWM_SPEED_MODE = LEDC_LOW_SPEED_MODE;
     const uint32_t PWM_HPOINT = 0;
 
+    // outputs with a slew rate move by the ledc fade engine, the hardware steps the duty without the cpu;
+    // a running fade cannot be retargeted, a value that comes in meanwhile waits and the task starts it
+    // when the fade is over
+
+    const uint32_t FADE_END_MARGIN_MS = 20;
+
+    struct OutputFadeData
+    {
+        OutputFadeData()
+        {
+            timer = LEDC_TIMER_0;
+            resolution = 0;
+            fade_end_millis = 0;
+            is_fading = false;
+            is_pending = false;
+            pending_value = 0;
+            pending_no_fade = false;
+        }
+
+        ledc_timer_t timer;
+        uint8_t resolution;
+        uint32_t fade_end_millis;
+        bool is_fading;
+        bool is_pending;
+        float pending_value;
+        bool pending_no_fade;
+    };
+
     class InputChannelData
     {
     public:
@@ -620,41 +673,15 @@ public:
     Zero2tenHandler()
     {
         _data_needs_save = false;
+        _fade_installed = false;
 
         _is_active = false;
         _is_finished = true;
 
-        // * output gain is what the duty cycle is multiplied with
-
-        const float output_gain_function[] =   // by true rmc multimeter
-        {
-            1, 1,
-            2, 1,
-            3, 1,
-            4, 1,
-            5, 1,
-            6, 1,
-            7, 1.002,
-            8, 1.002,
-            9, 1.003,
-            10, 1.005
-        };
-
-        // * input gain is what the measured value is multiplied with to get the final result
-
-        const float input_gain_function[] =
-        {
-            1, 1,
-            2, 1,
-            3, 1,
-            4, 1,
-            5, 1,
-            6, 1,
-            7, 1,
-            8, 1,
-            9, .995,
-            10, .995
-        };
+        _temp2out_algo_due = false;
+        temp2out_algo_job = SCHEDULER_NO_JOB;
+
+        // * the gain functions are in gainTables.h, earlier measurements:
 
         /*    1, 0.87,  by oscilloscope?
             2, 0.95,
@@ -694,8 +721,8 @@ public:
             10, 1.01954023
         */
 
-        output_gain_map_table.init_table(output_gain_function, (sizeof(output_gain_function)/sizeof(float))/2);
-        input_gain_map_table.init_table(input_gain_function, (sizeof(input_gain_function)/sizeof(float))/2);
+        output_gain_lut.init(zero2ten_output_gain_function, GAIN_FUNCTION_POINTS(zero2ten_output_gain_function));
+        input_gain_lut.init(zero2ten_input_gain_function, GAIN_FUNCTION_POINTS(zero2ten_input_gain_function));
     }
 
     ~Zero2tenHandler()
@@ -728,7 +755,8 @@ public:
     String input(size_t channel, float & value, bool no_trace = false);
     String calibrate_output(size_t channel, float value);
     String uncalibrate_output(size_t channel);
-    String output(size_t channel, float value);
+    String output(size_t channel, float value, bool no_fade = false);
+    void output_batch(const std::vector<std::pair<size_t, float>> & outputs, std::vector<String> & results);  // one lock for all
 
     bool does_data_need_save();
     void data_saved();
@@ -744,9 +772,16 @@ protected:
     void configure_channels();
     void configure_applets();
 
+    void output_pending();
+    bool stop_fade(size_t channel);    // the caller locks; false if the target cannot stop a fade
+    String _output(size_t channel, float value, bool no_fade);    // the caller locks
+
     unsigned analog_read(uint8_t gpio);
 
     static void task(void *parameter);
+    static void temp2out_algo_job_func(void *parameter);
+
+    static const uint32_t TEMP2OUT_ALGO_INTERVAL_MS = 60000;
 
     BinarySemaphore semaphore;
     Zero2tenConfig config;
@@ -754,16 +789,21 @@ protected:
 
     std::vector<InputChannelData> input_channel_data;
     std::vector<OutputChannelData> output_channel_data;
+    std::vector<OutputFadeData> output_fade_data;
  
     std::map<String, AppletHandler*> applet_handlers;
 
     bool _data_needs_save;
+    bool _fade_installed;
 
     bool _is_active;
     bool _is_finished;
 
-    MapTable input_gain_map_table;
-    MapTable output_gain_map_table;
+    volatile bool _temp2out_algo_due;
+    SchedulerJobId temp2out_algo_job;
+
+    GainLut input_gain_lut;
+    GainLut output_gain_lut;
 };
 
 static Zero2tenHandler handler;
@@ -773,12 +813,9 @@ bool Zero2tenHandler::AppletHandler::algo_fTemp2out(Zero2tenStatus::Applet & sta
 {
     status.output_value = 0;
 
-    time_t _time_t;
-    time(& _time_t);
     tm _tm = {0};
-    _tm = *localtime(&_time_t);
 
-    if (_tm.tm_year+1900 > 2000) // otherwise - NTP failed to fetch time 
+    if (scheduler_get_local_time(_tm))
     {
         char buf[64];
         sprintf(buf, "%d-%02d-%02d %02d:%02d.%02d", _tm.tm_year+1900,  _tm.tm_mon+1, _tm.tm_mday, _tm.tm_hour, _tm.tm_min, _tm.tm_sec);
@@ -927,6 +964,8 @@ void Zero2tenHandler::start(const Zero2tenConfig &_config)
         1,                   // Task priority
         NULL                 // Task handle
     );
+
+    temp2out_algo_job = scheduler_add_interval("zero2ten_temp2out", TEMP2OUT_ALGO_INTERVAL_MS, temp2out_algo_job_func, this);
 }
 
 void Zero2tenHandler::stop()
@@ -937,6 +976,9 @@ void Zero2tenHandler::stop()
     {
     }
 
+    scheduler_remove(temp2out_algo_job);
+    temp2out_algo_job = SCHEDULER_NO_JOB;
+
     _is_active = false;
 
     while(_is_finished == false)
@@ -974,6 +1016,14 @@ void Zero2tenHandler::reconfigure(const Zero2tenConfig &_config)
     }
 }
 
+void Zero2tenHandler::temp2out_algo_job_func(void *parameter)
+{
+    // runs in the scheduler task, the algo itself reads sensors and is left to the handler task
+
+    Zero2tenHandler *_this = (Zero2tenHandler *)parameter;
+    _this->_temp2out_algo_due = true;
+}
+
 void Zero2tenHandler::task(void *parameter)
 {
     Zero2tenHandler *_this = (Zero2tenHandler *)parameter;
@@ -983,11 +1033,12 @@ void Zero2tenHandler::task(void *parameter)
     const size_t SAVE_DATA_INTERVAL = 10; // seconds
     unsigned long last_save_data_millis = millis();
 
-    const size_t TEMP2OUT_ALGO_INTERVAL = 60; // seconds
-    unsigned long last_temp2out_algo_millis = 0;  // will run first time
+    TelemetryLoop * loop_telemetry = telemetry_loop("zero2ten_task");
 
     while (_this->_is_active)
     {
+        telemetry_loop_mark(loop_telemetry);
+
         // automatically refresh input values in status
 
         { Lock lock(_this->semaphore);
@@ -1001,10 +1052,11 @@ void Zero2tenHandler::task(void *parameter)
 
         unsigned long now_millis = millis();
 
-        if (now_millis < last_temp2out_algo_millis || 
-            (now_millis-last_temp2out_algo_millis)/1000 >= TEMP2OUT_ALGO_INTERVAL)
+        _this->output_pending();
+
+        if (_this->_temp2out_algo_due)
         {
-            last_temp2out_algo_millis = now_millis;
+            _this->_temp2out_algo_due = false;
 
             for (auto it=_this->config.applets.begin(); it!=_this->config.applets.end();++it)
             {
@@ -1074,25 +1126,18 @@ void Zero2tenHandler::configure_channels()
         analogSetPinAttenuation(it->gpio, (adc_attenuation_t)it->atten);
     }
 
-    ledc_timer_config_t _ledc_timer_config;
-    memset(& _ledc_timer_config, 0, sizeof(_ledc_timer_config));
-    _ledc_timer_config.speed_mode = PWM_SPEED_MODE;
-    _ledc_timer_config.duty_resolution = PWM_RESOLUTION;
-    _ledc_timer_config.timer_num = LEDC_TIMER_0;
-    _ledc_timer_config.freq_hz = PWM_FREQ;
-    _ledc_timer_config.clk_cfg = LEDC_AUTO_CLK;
-
-    esp_err_t esp_r = ledc_timer_config(& _ledc_timer_config);
-
-    if (esp_r != ESP_OK)
-    {
-        status.status = String("failed to configure ledc timer, ") + esp_err_2_string(esp_r); 
-        ERROR(status.status.c_str())
-        // but continue anyway
-    }
-    else
+    if (_fade_installed == false)
     {
-        TRACE("configure ledc timer OK")
+        esp_err_t esp_r = ledc_fade_func_install(0);
+
+        if (esp_r != ESP_OK && esp_r != ESP_ERR_INVALID_STATE)  // the latter if already installed
+        {
+            ERROR("failed to install ledc fade, outputs will not fade, %s", esp_err_2_string(esp_r).c_str())
+        }
+        else
+        {
+            _fade_installed = true;
+        }
     }
 
     //status.output_channels.clear();
@@ -1101,6 +1146,68 @@ void Zero2tenHandler::configure_channels()
 
     output_channel_data.resize(config.output_channels.size());
 
+    output_fade_data.clear();
+    output_fade_data.resize(config.output_channels.size());
+
+    // channels with the same frequency and resolution share a timer
+
+    std::vector<std::pair<uint32_t, uint8_t>> timers;
+
+    i=0;
+
+    for (auto it=config.output_channels.begin(); it!=config.output_channels.end(); ++it, ++i)
+    {
+        uint32_t freq = it->freq ? it->freq : PWM_FREQ;
+        uint8_t resolution = it->resolution ? it->resolution : (uint8_t) PWM_RESOLUTION;
+        auto timer = std::make_pair(freq, resolution);
+
+        auto found = std::find(timers.begin(), timers.end(), timer);
+        size_t timer_index = found - timers.begin();
+
+        if (found == timers.end())
+        {
+            if (timers.size() < LEDC_TIMER_MAX)
+            {
+                timers.push_back(timer);
+            }
+            else
+            {
+                status.output_channels[i].status = String("no ledc timer left for freq ") + String(freq) + 
+                                                   " and resolution " + String((int) resolution) + ", using the first timer"; 
+                ERROR(status.output_channels[i].status.c_str())
+                timer_index = 0;
+            }
+        }
+
+        output_fade_data[i].timer = ledc_timer_t(LEDC_TIMER_0 + timer_index);
+        output_fade_data[i].resolution = timers[timer_index].second;
+    }
+
+    for (size_t t=0; t<timers.size(); ++t)
+    {
+        ledc_timer_config_t _ledc_timer_config;
+        memset(& _ledc_timer_config, 0, sizeof(_ledc_timer_config));
+        _ledc_timer_config.speed_mode = PWM_SPEED_MODE;
+        _ledc_timer_config.duty_resolution = ledc_timer_bit_t(timers[t].second);
+        _ledc_timer_config.timer_num = ledc_timer_t(LEDC_TIMER_0 + t);
+        _ledc_timer_config.freq_hz = timers[t].first;
+        _ledc_timer_config.clk_cfg = LEDC_AUTO_CLK;
+
+        esp_err_t esp_r = ledc_timer_config(& _ledc_timer_config);
+
+        if (esp_r != ESP_OK)
+        {
+            status.status = String("failed to configure ledc timer ") + String((int) t) + " for freq " + String(timers[t].first) + 
+                            " and resolution " + String((int) timers[t].second) + ", " + esp_err_2_string(esp_r); 
+            ERROR(status.status.c_str())
+            // but continue anyway
+        }
+        else
+        {
+            TRACE("configure ledc timer %d OK, freq %lu, resolution %d", (int) t, (unsigned long) timers[t].first, (int) timers[t].second)
+        }
+    }
+
     i=0;
 
     for (auto it=config.output_channels.begin(); it!=config.output_channels.end(); ++it, ++i)
@@ -1128,7 +1235,7 @@ void Zero2tenHandler::configure_channels()
         _ledc_channel_config.speed_mode = PWM_SPEED_MODE;
         _ledc_channel_config.channel = _channel;
         _ledc_channel_config.intr_type = LEDC_INTR_DISABLE;
-        _ledc_channel_config.timer_sel = LEDC_TIMER_0;
+        _ledc_channel_config.timer_sel = output_fade_data[i].timer;
         _ledc_channel_config.duty = 0;
         _ledc_channel_config.hpoint = PWM_HPOINT; // phase
         _ledc_channel_config.flags.output_invert = 0;
@@ -1146,7 +1253,7 @@ void Zero2tenHandler::configure_channels()
         analogSetPinAttenuation(it->loopback.gpio, (adc_attenuation_t)it->loopback.atten);
 
         DEBUG("re-outputting value")
-        output(i, output_channel_data[i].value);
+        output(i, output_channel_data[i].value, true);
     }
 
     _data_needs_save = true;
@@ -1211,16 +1318,7 @@ String Zero2tenHandler::calibrate_input(size_t channel, float value)
                     if (_value > 0)
                     {
                         float calibration_coefficient = value / _value;
-                        float gain = 1;
-                        
-                        try
-                        {
-                            gain = input_gain_map_table.x_to_y(value); 
-                        }
-                        catch(const char * str)
-                        {
-                            ERROR("output gain function is invalid, assuming gain=1")
-                        }
+                        float gain = input_gain_lut.x_to_y(value);
 
                         calibration_coefficient = calibration_coefficient / gain;
                         input_channel_data[channel].calibration_coefficient = calibration_coefficient;
@@ -1343,16 +1441,7 @@ String Zero2tenHandler::input(size_t channel, float & value, bool no_trace)
 
         if (_is_calibrated(input_channel_data[channel].calibration_coefficient) == true)
         {
-            float relative_calibration_coefficient = 1;
-
-            try
-            {
-                relative_calibration_coefficient = input_gain_map_table.x_to_y(value) * input_channel_data[channel].calibration_coefficient;
-            }
-            catch(const char * str)
-            {
-                ERROR("input gain function is invalid, assuming relative_calibration_coefficient=1")
-            }
+            float relative_calibration_coefficient = input_gain_lut.x_to_y(value) * input_channel_data[channel].calibration_coefficient;
 
             value = value * relative_calibration_coefficient;
 
@@ -1404,16 +1493,7 @@ String Zero2tenHandler::calibrate_output(size_t channel, float value)
                     // correspond to gain 1.0
 
                     float calibration_coefficient = output_channel_data[channel].value / value;
-                    float gain = 1;
-                    
-                    try
-                    {
-                        gain = output_gain_map_table.x_to_y(value); 
-                    }
-                    catch(const char * str)
-                    {
-                        ERROR("output gain function is invalid, assuming gain=1")
-                    }
+                    float gain = output_gain_lut.x_to_y(value);
 
                     output_channel_data[channel].calibration_coefficient = calibration_coefficient / gain;
 
@@ -1423,7 +1503,7 @@ String Zero2tenHandler::calibrate_output(size_t channel, float value)
                     TRACE("calculated calibration coefficient raw for output channel %d is %f, gain is %f", (int) channel, calibration_coefficient, gain)
                     TRACE("adjusted calibration coefficient (gain 1.0) for output channel %d is set to %f", (int) channel, output_channel_data[channel].calibration_coefficient)
 
-                    output(channel, value);  // this will also set _data_needs_save at success
+                    output(channel, value, true);  // this will also set _data_needs_save at success
                 }
                 else
                 {
@@ -1469,7 +1549,7 @@ String Zero2tenHandler::uncalibrate_output(size_t channel)
 
             TRACE("calibration coefficient for output channel %d is reset", (int) channel)
 
-            output(channel, output_channel_data[channel].value);  // this will also set _data_needs_save at success
+            output(channel, output_channel_data[channel].value, true);  // this will also set _data_needs_save at success
         }
     }
     else
@@ -1482,69 +1562,152 @@ String Zero2tenHandler::uncalibrate_output(size_t channel)
 }
 
 
-String Zero2tenHandler::output(size_t channel, float value)
+String Zero2tenHandler::output(size_t channel, float value, bool no_fade)
 {
-    TRACE("setting output channel %d to value %f", (int) channel, value)
-    String r;
+    Lock lock(semaphore);
+    return _output(channel, value, no_fade);
+}
 
+void Zero2tenHandler::output_batch(const std::vector<std::pair<size_t, float>> & outputs, std::vector<String> & results)
+{
     Lock lock(semaphore);
 
-    if (channel < output_channel_data.size())
+    for (size_t i=0; i<outputs.size(); ++i)
+    {
+        results[i] = _output(outputs[i].first, outputs[i].second, false);
+    }
+}
+
+String Zero2tenHandler::_output(size_t channel, float value, bool no_fade)
+{
+    TRACE("setting output channel %d to value %f", (int) channel, value)
+    String r;
+
+    if (channel < output_channel_data.size() && channel < output_fade_data.size())
     {
         float max_voltage = config.output_channels[channel].max_voltage;
         status.output_channels[channel].calibration_coefficient = output_channel_data[channel].calibration_coefficient;  // always make sure it is synced 
         
         if (value >= 0 && value <= max_voltage)
         {
-            float relative_calibration_coefficient = 1;
+            OutputFadeData & fade_data = output_fade_data[channel];
 
-            if (_is_calibrated(output_channel_data[channel].calibration_coefficient))
+            if (fade_data.is_fading && int32_t(millis() - fade_data.fade_end_millis) < 0)
             {
-                try
+                if (no_fade == false)
                 {
-                    relative_calibration_coefficient = output_gain_map_table.x_to_y(value) * output_channel_data[channel].calibration_coefficient;
+                    TRACE("output channel %d is fading, value %f will follow", (int) channel, value)
+
+                    fade_data.is_pending = true;
+                    fade_data.pending_value = value;
+                    fade_data.pending_no_fade = no_fade;
+                    return r;
                 }
-                catch(const char * str)
+
+                // a calibration step acts at once, the fade is cut short and a pending value is dropped,
+                // it is older than this one; where the fade cannot be stopped the value replaces the pending
+                // one and goes out without a fade at the end of the running one
+
+                if (stop_fade(channel) == false)
                 {
-                    ERROR("output gain function is invalid, assuming relative_calibration_coefficient=1")
+                    TRACE("output channel %d is fading, value %f will follow without a fade", (int) channel, value)
+
+                    fade_data.is_pending = true;
+                    fade_data.pending_value = value;
+                    fade_data.pending_no_fade = no_fade;
+                    return r;
                 }
 
+                TRACE("output channel %d is fading, stopped for value %f", (int) channel, value)
+            }
+
+            fade_data.is_fading = false;
+            fade_data.is_pending = false;
+
+            float relative_calibration_coefficient = 1;
+
+            if (_is_calibrated(output_channel_data[channel].calibration_coefficient))
+            {
+                relative_calibration_coefficient = output_gain_lut.x_to_y(value) * output_channel_data[channel].calibration_coefficient;
+
                 TRACE("calibration coefficient %f, relative calibration coefficient %f", output_channel_data[channel].calibration_coefficient,
                       relative_calibration_coefficient)
             }
             
-            uint32_t duty = (uint32_t) (((value * relative_calibration_coefficient) / max_voltage) * float((1ul << PWM_RESOLUTION)-1));
+            const uint32_t max_duty = (1ul << fade_data.resolution)-1;
+            uint32_t duty = (uint32_t) (((value * relative_calibration_coefficient) / max_voltage) * float(max_duty));
             ledc_channel_t _ledc_channel = ledc_channel_t(LEDC_CHANNEL_0 + channel);
 
-            TRACE("calculated duty as %lu / %lu from calibrated value %f / %f", (unsigned long)duty, (unsigned long)((1ul << PWM_RESOLUTION)-1), value, max_voltage)
+            TRACE("calculated duty as %lu / %lu from calibrated value %f / %f", (unsigned long)duty, (unsigned long)max_duty, value, max_voltage)
 
-            //esp_err_t esp_r = ledc_set_duty_and_update(PWM_SPEED_MODE, _ledc_channel, duty, PWM_HPOINT);
+            float slew_rate = config.output_channels[channel].slew_rate;
+            uint32_t fade_ms = 0;
 
-            esp_err_t esp_r = ledc_set_duty(PWM_SPEED_MODE, _ledc_channel, duty);
-            
-            if (esp_r != ESP_OK)
+            if (no_fade == false && _fade_installed && slew_rate > 0)
             {
-                status.output_channels[channel].status = String("failed to set duty on channel ") + String((int) channel) + ", " + esp_err_2_string(esp_r); 
-                ERROR(status.output_channels[channel].status.c_str())
+                fade_ms = (uint32_t) (fabs(value - output_channel_data[channel].value) / slew_rate * 1000);
+            }
+
+            esp_err_t esp_r = ESP_OK;
+
+            if (fade_ms > 0)
+            {
+                TRACE("fading output channel %d over %lu ms", (int) channel, (unsigned long) fade_ms)
+
+                esp_r = ledc_set_fade_with_time(PWM_SPEED_MODE, _ledc_channel, duty, (int) fade_ms);
+
+                if (esp_r != ESP_OK)
+                {
+                    status.output_channels[channel].status = String("failed to set fade on channel ") + String((int) channel) + ", " + esp_err_2_string(esp_r); 
+                    ERROR(status.output_channels[channel].status.c_str())
+                }
+                else
+                {
+                    esp_r = ledc_fade_start(PWM_SPEED_MODE, _ledc_channel, LEDC_FADE_NO_WAIT);
+
+                    if (esp_r != ESP_OK)
+                    {
+                        status.output_channels[channel].status = String("failed to start fade on channel ") + String((int) channel) + ", " + esp_err_2_string(esp_r); 
+                        ERROR(status.output_channels[channel].status.c_str())
+                    }
+                    else
+                    {
+                        fade_data.is_fading = true;
+                        fade_data.fade_end_millis = millis() + fade_ms + FADE_END_MARGIN_MS;
+                    }
+                }
             }
             else
             {
-                esp_r = ledc_update_duty(PWM_SPEED_MODE, _ledc_channel);
+                //esp_err_t esp_r = ledc_set_duty_and_update(PWM_SPEED_MODE, _ledc_channel, duty, PWM_HPOINT);
 
+                esp_r = ledc_set_duty(PWM_SPEED_MODE, _ledc_channel, duty);
+                
                 if (esp_r != ESP_OK)
                 {
-                    status.output_channels[channel].status = String("failed to update duty on channel ") + String((int) channel) + ", " + esp_err_2_string(esp_r); 
+                    status.output_channels[channel].status = String("failed to set duty on channel ") + String((int) channel) + ", " + esp_err_2_string(esp_r); 
                     ERROR(status.output_channels[channel].status.c_str())
                 }
                 else
                 {
-                    status.output_channels[channel].value = value;
-                    output_channel_data[channel].value = value;    
-                    status.output_channels[channel].duty = (float) duty /  float((1ul << PWM_RESOLUTION)-1); 
-                    _data_needs_save = true;
-                    status.output_channels[channel].status.clear();
+                    esp_r = ledc_update_duty(PWM_SPEED_MODE, _ledc_channel);
+
+                    if (esp_r != ESP_OK)
+                    {
+                        status.output_channels[channel].status = String("failed to update duty on channel ") + String((int) channel) + ", " + esp_err_2_string(esp_r); 
+                        ERROR(status.output_channels[channel].status.c_str())
+                    }
                 }
             }
+
+            if (esp_r == ESP_OK)
+            {
+                status.output_channels[channel].value = value;
+                output_channel_data[channel].value = value;    
+                status.output_channels[channel].duty = (float) duty /  float(max_duty); 
+                _data_needs_save = true;
+                status.output_channels[channel].status.clear();
+            }
         }
         else
         {
@@ -1559,6 +1722,69 @@ String Zero2tenHandler::output(size_t channel, float value)
     return r;
 }
 
+bool Zero2tenHandler::stop_fade(size_t channel)
+{
+    #if SOC_LEDC_SUPPORT_FADE_STOP
+
+    OutputFadeData & fade_data = output_fade_data[channel];
+
+    esp_err_t esp_r = ledc_fade_stop(PWM_SPEED_MODE, ledc_channel_t(LEDC_CHANNEL_0 + channel));
+
+    if (esp_r != ESP_OK)
+    {
+        ERROR("failed to stop fade on channel %d, %s", (int) channel, esp_err_2_string(esp_r).c_str())
+    }
+
+    fade_data.is_fading = false;
+    fade_data.is_pending = false;
+
+    return true;
+
+    #else
+
+    // no fade stop on this target (classic esp32), waiting out the rest of the fade would hold the semaphore
+    // for up to max_voltage / slew_rate
+
+    return false;
+
+    #endif
+}
+
+void Zero2tenHandler::output_pending()
+{
+    // values that came in while their channel was fading
+
+    for (size_t i=0; ; ++i)
+    {
+        bool is_pending = false;
+        float value = 0;
+        bool no_fade = false;
+
+        {Lock lock(semaphore);
+
+        if (i >= output_fade_data.size())
+        {
+            break;
+        }
+
+        OutputFadeData & fade_data = output_fade_data[i];
+
+        if (fade_data.is_pending && int32_t(millis() - fade_data.fade_end_millis) >= 0)
+        {
+            fade_data.is_fading = false;
+            fade_data.is_pending = false;
+            is_pending = true;
+            value = fade_data.pending_value;
+            no_fade = fade_data.pending_no_fade;
+        }}
+
+        if (is_pending)
+        {
+            output(i, value, no_fade);
+        }
+    }
+}
+
 bool Zero2tenHandler::does_data_need_save() 
 {
     return _data_needs_save;
@@ -1691,7 +1917,7 @@ bool Zero2tenHandler::data_from_eprom(std::istream &is)
 
         for (auto it=output_channel_data.begin(); it!=output_channel_data.end(); ++it, ++i)
         {
-            output(i, it->value);
+            output(i, it->value, true);
         }
 
         _data_needs_save = false;  // output(..) sets this to true, but we just read the values from eprom 
@@ -1921,5 +2147,37 @@ String zero2ten_output(const String & channel_str, const String & value_str)
     return "Parameter error";
 }
 
+void zero2ten_output_batch(const std::vector<std::pair<String, String>> & channel_values, std::vector<String> & results)
+{
+    results.assign(channel_values.size(), String());
+
+    std::vector<std::pair<size_t, float>> outputs;
+    std::vector<size_t> indices;    // of the outputs in channel_values
+
+    for (size_t i=0; i<channel_values.size(); ++i)
+    {
+        const String & channel_str = channel_values[i].first;
+        const String & value_str = channel_values[i].second;
+
+        if (!channel_str.isEmpty() && !value_str.isEmpty() && __is_number_or_empty(channel_str) && __is_number_or_empty(value_str))
+        {
+            outputs.push_back(std::make_pair((size_t) channel_str.toInt(), (float) value_str.toFloat()));
+            indices.push_back(i);
+        }
+        else
+        {
+            results[i] = "Parameter error";
+        }
+    }
+
+    std::vector<String> output_results(outputs.size());
+    handler.output_batch(outputs, output_results);
+
+    for (size_t i=0; i<indices.size(); ++i)
+    {
+        results[indices[i]] = output_results[i];
+    }
+}
+
 
 #endif // INCLUDE_ZERO2TEN
@@ -0,0 +1,138 @@
+#!/bin/sh
+# checks the MQTT transport of a unit against a mosquitto broker, with the mosquitto clients
+# (mosquitto_sub / mosquitto_pub, 1.5 or later); the unit has to be built with INCLUDE_MQTT and
+# MQTT_BROKER_HOST pointing at the broker
+#
+# usage: mqtt_check.sh [-h broker] [-p port] [-t prefix] [-a action] [-j args] client_id
+#
+#   client_id  harvester-<mac> of the unit, see "mqtt" in the system part of /get
+#   -a, -j     the action that is run and its arguments (JSON without "id"), zero2ten/input {"channel": 0}
+#              by default; use one that the unit has and that is harmless to run
+#
+# checks, in this order:
+#   online     <prefix>/online is retained "true"
+#   status     <prefix>/status has a retained JSON object with all functions
+#   action     an action with an id gets a result with the same id and no error
+#   expired    an action with "expires" in the past is refused
+#   bad json   a payload that is not JSON is refused
+#
+# exits with the number of failed checks
+
+BROKER=localhost
+PORT=1883
+PREFIX=harvester
+ACTION=zero2ten/input
+ARGS='"channel": 0'
+WAIT=10
+
+while getopts "h:p:t:a:j:" opt
+do
+    case $opt in
+        h) BROKER=$OPTARG ;;
+        p) PORT=$OPTARG ;;
+        t) PREFIX=$OPTARG ;;
+        a) ACTION=$OPTARG ;;
+        j) ARGS=$(echo "$OPTARG" | sed -e 's/^ *{//' -e 's/} *$//') ;;
+        *) sed -n '6,11p' "$0"; exit 2 ;;
+    esac
+done
+
+shift $((OPTIND - 1))
+
+if [ $# -ne 1 ]
+then
+    sed -n '6,11p' "$0"
+    exit 2
+fi
+
+TOPIC=$PREFIX/$1
+FAILED=0
+OUT=$(mktemp)
+trap 'rm -f "$OUT"' EXIT
+
+pass() { echo "ok      $1"; }
+fail() { echo "FAILED  $1: $2"; FAILED=$((FAILED + 1)); }
+
+sub() { mosquitto_sub -h "$BROKER" -p "$PORT" "$@"; }
+pub() { mosquitto_pub -h "$BROKER" -p "$PORT" "$@"; }
+
+# a JSON object of the given members and the arguments of the action
+
+payload()
+{
+    if [ -n "$ARGS" ]
+    then
+        echo "{$1, $ARGS}"
+    else
+        echo "{$1}"
+    fi
+}
+
+# runs an action and leaves its result in $OUT: the result topic is subscribed before the action goes out
+
+action()
+{
+    sub -t "$TOPIC/result/$ACTION" -C 1 -W $WAIT > "$OUT" &
+    SUB_PID=$!
+    sleep 1
+    pub -t "$TOPIC/action/$ACTION" -q 1 -m "$1"
+    wait $SUB_PID 2>/dev/null
+}
+
+# online
+
+ONLINE=$(sub -t "$TOPIC/online" -C 1 -W $WAIT -F '%r %p' 2>/dev/null)
+
+if [ "$ONLINE" = "1 true" ]
+then
+    pass "online"
+else
+    fail "online" "expected retained true, got '$ONLINE'"
+fi
+
+# status, the retained message is delivered at once on subscribe and first, the changes follow it unretained
+
+sub -t "$TOPIC/status" -C 1 -W 3 -F '%r %p' > "$OUT" 2>/dev/null
+
+if grep -q "^1 {" "$OUT"
+then
+    pass "status ($(($(wc -c < "$OUT") - 3)) bytes)"
+else
+    fail "status" "expected a retained JSON object, got '$(cat "$OUT")'"
+fi
+
+# action and result
+
+ID=check-$$-$(date +%s)
+action "$(payload "\"id\": \"$ID\"")"
+
+if grep -q "\"id\":\"$ID\"" "$OUT" && ! grep -q '"error"' "$OUT"
+then
+    pass "action $ACTION: $(cat "$OUT")"
+else
+    fail "action $ACTION" "result '$(cat "$OUT")'"
+fi
+
+# expired, the unit refuses it once its clock is set
+
+action "$(payload "\"id\": \"$ID-expired\", \"expires\": 1")"
+
+if grep -q "\"id\":\"$ID-expired\"" "$OUT" && grep -q 'action expired' "$OUT"
+then
+    pass "expired"
+else
+    fail "expired" "result '$(cat "$OUT")'"
+fi
+
+# bad json
+
+action "not json"
+
+if grep -q 'payload is not JSON' "$OUT"
+then
+    pass "bad json"
+else
+    fail "bad json" "result '$(cat "$OUT")'"
+fi
+
+exit $FAILED
@@ -0,0 +1,192 @@
+// host simulator of the shower-guard decisions: replays recorded traces through the same algo as the device
+// (include/showerGuardAlgo.h) with the clock of the trace, for sweeping the parameters over fleet data
+//
+// build: g++ -std=gnu++17 -O2 -I include test/sim/shower_guard_sim.cpp -o shower_guard_sim
+//
+// usage: shower_guard_sim [--light-linger 60,120] [--fan-linger 300] [--rh-on 55,60] [--rh-off 50] [--decisions]
+//                         trace.csv ...
+//
+// a trace is CSV with a row per algo loop: time (epoch s), rh, temp, motion (0/1)[, lumi]; lines that do not
+// start with a digit are skipped (headers, comments); lumi masking lives in the task and is not simulated
+//
+// prints a CSV line per trace and parameter set: the on-time of light and fan is what the energy estimate is
+// based on; with --decisions every change of light / fan is printed before with its decision strings
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#include <showerGuardAlgo.h>
+
+struct TraceRow
+{
+    time_t time;
+    float rh;
+    float temp;
+    bool motion;
+};
+
+static std::vector<unsigned> parse_list(const char * s)
+{
+    std::vector<unsigned> values;
+
+    while (*s)
+    {
+        values.push_back(unsigned(strtoul(s, (char **) &s, 10)));
+
+        if (*s == ',')
+        {
+            s++;
+        }
+        else if (*s != 0)
+        {
+            fprintf(stderr, "bad list '%s'\n", s);
+            exit(2);
+        }
+    }
+
+    return values;
+}
+
+static bool read_trace(const char * path, std::vector<TraceRow> & rows)
+{
+    FILE * f = fopen(path, "r");
+
+    if (f == NULL)
+    {
+        return false;
+    }
+
+    char line[256];
+
+    while (fgets(line, sizeof(line), f))
+    {
+        if (isdigit((unsigned char) line[0]) == 0)
+        {
+            continue;
+        }
+
+        long time;
+        float rh;
+        float temp;
+        int motion;
+
+        if (sscanf(line, "%ld,%f,%f,%d", &time, &rh, &temp, &motion) == 4)
+        {
+            rows.push_back({time_t(time), rh, temp, motion != 0});
+        }
+    }
+
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char ** argv)
+{
+    std::vector<unsigned> light_lingers = {60};
+    std::vector<unsigned> fan_lingers = {60};
+    std::vector<unsigned> rh_ons = {55};
+    std::vector<unsigned> rh_offs = {50};
+    std::vector<const char *> paths;
+    bool print_decisions = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--light-linger") && i+1 < argc)
+        {
+            light_lingers = parse_list(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--fan-linger") && i+1 < argc)
+        {
+            fan_lingers = parse_list(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--rh-on") && i+1 < argc)
+        {
+            rh_ons = parse_list(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--rh-off") && i+1 < argc)
+        {
+            rh_offs = parse_list(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--decisions"))
+        {
+            print_decisions = true;
+        }
+        else
+        {
+            paths.push_back(argv[i]);
+        }
+    }
+
+    if (paths.empty())
+    {
+        fprintf(stderr, "usage: %s [--light-linger a,b] [--fan-linger a,b] [--rh-on a,b] [--rh-off a,b] [--decisions] trace.csv ...\n", argv[0]);
+        return 2;
+    }
+
+    printf("trace,light_linger,fan_linger,rh_on,rh_off,rows,duration,light_on_time,fan_on_time,light_switches,fan_switches\n");
+
+    size_t total_rows = 0;
+    clock_t started = clock();
+
+    for (const char * path : paths)
+    {
+        std::vector<TraceRow> trace;
+
+        if (read_trace(path, trace) == false)
+        {
+            fprintf(stderr, "cannot read %s\n", path);
+            return 1;
+        }
+
+        for (unsigned light_linger : light_lingers)
+        for (unsigned fan_linger : fan_lingers)
+        for (unsigned rh_on : rh_ons)
+        for (unsigned rh_off : rh_offs)
+        {
+            if (rh_off >= rh_on)
+            {
+                continue;
+            }
+
+            ShowerGuardAlgoParams params;
+            params.light_linger = light_linger;
+            params.fan_linger = fan_linger;
+            params.rh_on = rh_on;
+            params.rh_off = rh_off;
+
+            ShowerGuardReplay replay(params);
+
+            for (const TraceRow & row : trace)
+            {
+                if (replay.push(row.time, row.rh, row.temp, row.motion) == false)
+                {
+                    fprintf(stderr, "%s: row %d goes back in time\n", path, (int) replay.get_rows());
+                    return 1;
+                }
+
+                if (print_decisions && replay.is_changed())
+                {
+                    const ShowerGuardAlgo & algo = replay.get_algo();
+                    printf("# %ld light=%d fan=%d light_decision=\"%s\" fan_decision=\"%s\"\n", long(row.time),
+                           (int) algo.get_light(), (int) algo.get_fan(), algo.get_last_light_decision(), algo.get_last_fan_decision());
+                }
+            }
+
+            total_rows += replay.get_rows();
+
+            printf("%s,%u,%u,%u,%u,%d,%ld,%u,%u,%d,%d\n", path, light_linger, fan_linger, rh_on, rh_off,
+                   (int) replay.get_rows(), replay.get_duration(), replay.get_algo().get_light_on_time(),
+                   replay.get_algo().get_fan_on_time(), (int) replay.get_light_switches(), (int) replay.get_fan_switches());
+        }
+    }
+
+    double seconds = double(clock() - started) / CLOCKS_PER_SEC;
+    fprintf(stderr, "%d rows in %.3f s\n", (int) total_rows, seconds);
+
+    return 0;
+}
@@ -0,0 +1,304 @@
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <audioDsp.h>
+
+// the fixed-point tone / loudness / limiter stage against a double reference of the same cookbook shelves,
+// and its cost per sample next to the i2s budget
+
+static const uint32_t SAMPLE_RATE = 44100;
+
+struct RefShelf
+{
+    double b0, b1, b2, a1, a2;
+    double x1, x2, y1, y2;
+
+    RefShelf(bool is_high, double gain, double freq, double sample_rate)
+    {
+        double A = pow(10, gain / 40);
+        double w0 = 2 * M_PI * freq / sample_rate;
+        double cos_w0 = cos(w0);
+        double alpha = sin(w0) / 2 * sqrt(2);
+        double beta = 2 * sqrt(A) * alpha;
+        double sign = is_high ? -1 : 1;
+
+        double a0 = (A + 1) + sign * (A - 1) * cos_w0 + beta;
+        b0 = A * ((A + 1) - sign * (A - 1) * cos_w0 + beta) / a0;
+        b1 = sign * 2 * A * ((A - 1) - sign * (A + 1) * cos_w0) / a0;
+        b2 = A * ((A + 1) - sign * (A - 1) * cos_w0 - beta) / a0;
+        a1 = -sign * 2 * ((A - 1) + sign * (A + 1) * cos_w0) / a0;
+        a2 = ((A + 1) + sign * (A - 1) * cos_w0 - beta) / a0;
+        x1 = x2 = y1 = y2 = 0;
+    }
+
+    double run(double x0)
+    {
+        double y0 = b0 * x0 + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+        x2 = x1; x1 = x0;
+        y2 = y1; y1 = y0;
+        return y0;
+    }
+};
+
+// a sum of tones from 40 Hz to 12 kHz plus some noise, stereo with a different phase per channel
+
+static std::vector<int16_t> test_signal(size_t frames, double amplitude)
+{
+    std::vector<int16_t> pcm(frames * 2);
+    const double freqs[] = { 40, 110, 250, 1000, 4000, 9000, 12000 };
+    uint32_t seed = 1;
+
+    for (size_t i = 0; i < frames; ++i)
+    {
+        for (int c = 0; c < 2; ++c)
+        {
+            double v = 0;
+
+            for (double f : freqs)
+            {
+                v += sin(2 * M_PI * f * double(i) / SAMPLE_RATE + c);
+            }
+
+            seed = seed * 1664525u + 1013904223u;
+            v = v / 7 + (double((seed >> 16) & 0xff) - 128) / 1280;
+            pcm[i*2 + c] = int16_t(lround(v * amplitude));
+        }
+    }
+
+    return pcm;
+}
+
+struct Error
+{
+    double max;
+    double rms;
+};
+
+static Error compare_with_reference(int bass, int treble, double amplitude)
+{
+    const size_t FRAMES = 1024;
+    const size_t BUFFERS = 32;
+
+    AudioDsp dsp;
+    AudioDsp::Params params;
+    params.tone_enabled = true;
+    params.bass = int8_t(bass);
+    params.treble = int8_t(treble);
+    dsp.configure(params);
+
+    std::vector<RefShelf> bass_ref(2, RefShelf(false, bass, AudioDsp::BASS_FREQ, SAMPLE_RATE));
+    std::vector<RefShelf> treble_ref(2, RefShelf(true, treble, AudioDsp::TREBLE_FREQ, SAMPLE_RATE));
+
+    std::vector<int16_t> pcm = test_signal(FRAMES * BUFFERS, amplitude);
+    std::vector<int16_t> out = pcm;
+
+    for (size_t b = 0; b < BUFFERS; ++b)
+    {
+        dsp.process(out.data() + b * FRAMES * 2, FRAMES, 2, SAMPLE_RATE);
+    }
+
+    Error error = {0, 0};
+
+    for (size_t i = 0; i < pcm.size(); ++i)
+    {
+        int c = int(i % 2);
+        double ref = double(pcm[i]);
+
+        if (bass != 0)
+        {
+            ref = bass_ref[c].run(ref);
+        }
+
+        if (treble != 0)
+        {
+            ref = treble_ref[c].run(ref);
+        }
+
+        double e = fabs(double(out[i]) - ref);
+        error.max = e > error.max ? e : error.max;
+        error.rms += e * e;
+    }
+
+    error.rms = sqrt(error.rms / double(pcm.size()));
+    return error;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_shelves_follow_the_float_reference(void)
+{
+    const int gains[][2] = { {12, 0}, {0, 12}, {-15, 0}, {0, -15}, {9, -6}, {-6, 9}, {15, 15} };
+
+    for (const auto & g : gains)
+    {
+        // amplitude leaves room for +15 dB without clipping
+
+        Error e = compare_with_reference(g[0], g[1], 3000);
+
+        char msg[96];
+        snprintf(msg, sizeof(msg), "bass %d treble %d: max %.2f rms %.3f lsb", g[0], g[1], e.max, e.rms);
+        TEST_MESSAGE(msg);
+
+        // the output is rounded to 16 bit, the reference is not: half an lsb of that plus the coefficient rounding
+
+        TEST_ASSERT_LESS_OR_EQUAL(2.0, e.max);
+        TEST_ASSERT_LESS_OR_EQUAL(0.7, e.rms);
+    }
+}
+
+void test_flat_settings_leave_the_samples_alone(void)
+{
+    AudioDsp dsp;
+    AudioDsp::Params params;
+    params.tone_enabled = true;
+    dsp.configure(params);
+
+    std::vector<int16_t> pcm = test_signal(1024, 20000);
+    std::vector<int16_t> out = pcm;
+    dsp.process(out.data(), 1024, 2, SAMPLE_RATE);
+
+    TEST_ASSERT_FALSE(dsp.is_active());
+    TEST_ASSERT_EQUAL_MEMORY(pcm.data(), out.data(), pcm.size() * sizeof(int16_t));
+}
+
+void test_loudness_fades_out_towards_full_volume(void)
+{
+    // loudness is a bass / treble boost that shrinks with the volume: at full volume nothing changes
+
+    AudioDsp dsp;
+    AudioDsp::Params params;
+    params.loudness = 10;
+    dsp.configure(params);
+    dsp.set_volume(100);
+
+    std::vector<int16_t> pcm = test_signal(1024, 3000);
+    std::vector<int16_t> out = pcm;
+    dsp.process(out.data(), 1024, 2, SAMPLE_RATE);
+    TEST_ASSERT_EQUAL_MEMORY(pcm.data(), out.data(), pcm.size() * sizeof(int16_t));
+
+    // at volume 0 it is the full boost, the 40 Hz tone comes out louder
+
+    dsp.set_volume(0);
+    std::vector<int16_t> low(8192 * 2);
+
+    for (size_t i = 0; i < 8192; ++i)
+    {
+        low[i*2] = low[i*2 + 1] = int16_t(lround(1000 * sin(2 * M_PI * 40 * double(i) / SAMPLE_RATE)));
+    }
+
+    dsp.process(low.data(), 8192, 2, SAMPLE_RATE);
+
+    int peak = 0;
+
+    for (size_t i = 4096 * 2; i < low.size(); ++i)
+    {
+        peak = abs(low[i]) > peak ? abs(low[i]) : peak;
+    }
+
+    // +10 dB on a low shelf is x3.16 well below the corner
+
+    TEST_ASSERT_GREATER_THAN(2800, peak);
+    TEST_ASSERT_LESS_THAN(3300, peak);
+}
+
+void test_limiter_holds_the_ceiling(void)
+{
+    AudioDsp dsp;
+    AudioDsp::Params params;
+    params.limiter = -6;
+    dsp.configure(params);
+
+    std::vector<int16_t> pcm = test_signal(44100, 32000);
+    dsp.process(pcm.data(), 44100, 2, SAMPLE_RATE);
+
+    int ceiling = int(32767 * pow(10, -6.0 / 20));
+    int peak = 0;
+
+    for (int16_t s : pcm)
+    {
+        peak = abs(s) > peak ? abs(s) : peak;
+    }
+
+    TEST_ASSERT_LESS_OR_EQUAL(ceiling, peak);
+    TEST_ASSERT_GREATER_THAN(ceiling * 9 / 10, peak);    // limited, not muted
+}
+
+void test_cost_per_sample(void)
+{
+    // every stage on: both shelves, loudness and the limiter, stereo 44.1 kHz in the 1024 frame buffers of the decoder
+
+    const size_t FRAMES = 1024;
+    const size_t BUFFERS = 2000;
+
+    AudioDsp dsp;
+    AudioDsp::Params params;
+    params.tone_enabled = true;
+    params.bass = 6;
+    params.treble = -3;
+    params.loudness = 6;
+    params.limiter = -1;
+    dsp.configure(params);
+    dsp.set_volume(40);
+
+    std::vector<int16_t> source = test_signal(FRAMES, 12000);
+    std::vector<int16_t> pcm = source;
+
+    dsp.process(pcm.data(), FRAMES, 2, SAMPLE_RATE);    // coefficients outside the measurement
+
+    auto started = std::chrono::steady_clock::now();
+
+    #if defined(__x86_64__) || defined(__i386__)
+    uint64_t started_cycles = __rdtsc();
+    #endif
+
+    for (size_t b = 0; b < BUFFERS; ++b)
+    {
+        pcm = source;
+        dsp.process(pcm.data(), FRAMES, 2, SAMPLE_RATE);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    double samples = double(FRAMES * BUFFERS * 2);
+    double ns_per_sample = seconds * 1e9 / samples;
+
+    char msg[128];
+
+    #if defined(__x86_64__) || defined(__i386__)
+    double cycles_per_sample = double(__rdtsc() - started_cycles) / samples;
+    snprintf(msg, sizeof(msg), "%.1f ns, %.1f tsc cycles per sample; real time x%.0f at 44.1 kHz stereo",
+             ns_per_sample, cycles_per_sample, 1e9 / (ns_per_sample * SAMPLE_RATE * 2));
+    #else
+    snprintf(msg, sizeof(msg), "%.1f ns per sample; real time x%.0f at 44.1 kHz stereo",
+             ns_per_sample, 1e9 / (ns_per_sample * SAMPLE_RATE * 2));
+    #endif
+
+    TEST_MESSAGE(msg);
+
+    // the budget of the i2s path is 11.3 us per sample; the host should be far below it, a regression that
+    // reintroduces floats or divisions per sample shows as an order of magnitude here
+
+    TEST_ASSERT_LESS_THAN(200.0, ns_per_sample);
+}
+
+int main(int argc, char ** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_shelves_follow_the_float_reference);
+    RUN_TEST(test_flat_settings_leave_the_samples_alone);
+    RUN_TEST(test_loudness_fades_out_towards_full_volume);
+    RUN_TEST(test_limiter_holds_the_ceiling);
+    RUN_TEST(test_cost_per_sample);
+    return UNITY_END();
+}
@@ -0,0 +1,204 @@
+#include <unity.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include <deflate.h>
+
+// the deflate encoder of the log responses against zlib as the reference inflater: raw, zlib and gzip streams
+// of log-like text, random bytes and the edge cases decode to the input, and the checksums match zlib's
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static std::string log_text(size_t length)
+{
+    std::string text;
+    unsigned seq = 0;
+
+    while (text.size() < length)
+    {
+        char line[128];
+        snprintf(line, sizeof(line), "{\"seq\":%u,\"millis\":%u,\"level\":\"TRACE\",\"text\":\"proportional channel %u actuate\"},",
+                 seq, seq * 137, seq % 4);
+        text += line;
+        seq++;
+    }
+
+    text.resize(length);
+    return text;
+}
+
+static std::string random_bytes(size_t length, unsigned seed)
+{
+    std::string bytes(length, 0);
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        seed = seed * 1103515245u + 12345u;
+        bytes[i] = char(seed >> 16);
+    }
+
+    return bytes;
+}
+
+// window bits of inflateInit2 for each format of the encoder
+
+static int window_bits(uint8_t format)
+{
+    return format == DeflateEncoder::dfRaw ? -15 : (format == DeflateEncoder::dfZlib ? 15 : 15 + 16);
+}
+
+static bool compress(const std::string & in, uint8_t format, std::vector<uint8_t> & out)
+{
+    static uint16_t hash[DeflateEncoder::HASH_SIZE];
+
+    out.resize(in.size() + in.size() / 8 + 64);
+    size_t length = DeflateEncoder::compress((const uint8_t *) in.data(), in.size(), out.data(), out.size(), hash, format);
+    out.resize(length);
+
+    return length > 0;
+}
+
+static bool inflate_reference(const std::vector<uint8_t> & in, uint8_t format, size_t expected_length, std::string & out)
+{
+    z_stream stream = {};
+
+    if (inflateInit2(&stream, window_bits(format)) != Z_OK)
+    {
+        return false;
+    }
+
+    out.assign(expected_length + 16, 0);
+
+    stream.next_in = (Bytef *) in.data();
+    stream.avail_in = (uInt) in.size();
+    stream.next_out = (Bytef *) &out[0];
+    stream.avail_out = (uInt) out.size();
+
+    int r = inflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+
+    // the whole stream is taken, trailer included
+
+    bool ok = r == Z_STREAM_END && stream.avail_in == 0;
+    inflateEnd(&stream);
+
+    return ok;
+}
+
+static void check_round_trip(const std::string & in, uint8_t format)
+{
+    std::vector<uint8_t> compressed;
+    std::string inflated;
+
+    TEST_ASSERT_TRUE(compress(in, format, compressed));
+    TEST_ASSERT_TRUE(inflate_reference(compressed, format, in.size(), inflated));
+    TEST_ASSERT_EQUAL(in.size(), inflated.size());
+    TEST_ASSERT_TRUE(in == inflated);
+}
+
+void test_log_text_round_trip(void)
+{
+    const size_t lengths[] = { 1, 2, 3, 4, 100, 4096, 40000, DeflateEncoder::MAX_INPUT_LENGTH };
+    const uint8_t formats[] = { DeflateEncoder::dfRaw, DeflateEncoder::dfZlib, DeflateEncoder::dfGzip };
+
+    for (size_t length : lengths)
+    {
+        for (uint8_t format : formats)
+        {
+            check_round_trip(log_text(length), format);
+        }
+    }
+}
+
+void test_log_text_shrinks(void)
+{
+    std::string in = log_text(16384);
+    std::vector<uint8_t> compressed;
+
+    TEST_ASSERT_TRUE(compress(in, DeflateEncoder::dfGzip, compressed));
+
+    char message[64];
+    snprintf(message, sizeof(message), "16384 bytes of log to %d", (int) compressed.size());
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_LESS_OR_EQUAL(in.size() / 3, compressed.size());
+}
+
+void test_random_bytes_round_trip(void)
+{
+    // no matches to speak of, the 9 bit literals of 144..255 make it grow
+
+    for (unsigned seed = 1; seed <= 4; ++seed)
+    {
+        check_round_trip(random_bytes(5000, seed), DeflateEncoder::dfZlib);
+    }
+}
+
+void test_long_runs_round_trip(void)
+{
+    // matches of the full 258 bytes, overlapping their source (distance 1), and distances up to the window
+
+    check_round_trip(std::string(20000, 'a'), DeflateEncoder::dfRaw);
+    check_round_trip(std::string(1000, 'a') + std::string(1000, 'b') + std::string(1000, 'a'), DeflateEncoder::dfRaw);
+
+    std::string block = random_bytes(300, 7);
+    std::string far = block + random_bytes(32768 - 300, 8) + block + random_bytes(2000, 9) + block;
+    check_round_trip(far, DeflateEncoder::dfGzip);
+}
+
+void test_empty_input(void)
+{
+    check_round_trip(std::string(), DeflateEncoder::dfRaw);
+    check_round_trip(std::string(), DeflateEncoder::dfZlib);
+    check_round_trip(std::string(), DeflateEncoder::dfGzip);
+}
+
+void test_checksums_match_zlib(void)
+{
+    std::string in = log_text(10000) + random_bytes(3000, 3);
+
+    TEST_ASSERT_EQUAL(crc32(0, (const Bytef *) in.data(), (uInt) in.size()),
+                      DeflateEncoder::crc32((const uint8_t *) in.data(), in.size()));
+    TEST_ASSERT_EQUAL(adler32(1, (const Bytef *) in.data(), (uInt) in.size()),
+                      DeflateEncoder::adler32((const uint8_t *) in.data(), in.size()));
+}
+
+void test_output_too_small(void)
+{
+    // 0 means it did not fit, the caller sends the input as it is
+
+    static uint16_t hash[DeflateEncoder::HASH_SIZE];
+    std::string in = random_bytes(1000, 5);
+    std::vector<uint8_t> out(500);
+
+    TEST_ASSERT_EQUAL(0, DeflateEncoder::compress((const uint8_t *) in.data(), in.size(), out.data(), out.size(), hash, DeflateEncoder::dfGzip));
+
+    in = log_text(DeflateEncoder::MAX_INPUT_LENGTH + 1);
+    out.resize(in.size());
+
+    TEST_ASSERT_EQUAL(0, DeflateEncoder::compress((const uint8_t *) in.data(), in.size(), out.data(), out.size(), hash, DeflateEncoder::dfRaw));
+}
+
+int main(int argc, char ** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_log_text_round_trip);
+    RUN_TEST(test_log_text_shrinks);
+    RUN_TEST(test_random_bytes_round_trip);
+    RUN_TEST(test_long_runs_round_trip);
+    RUN_TEST(test_empty_input);
+    RUN_TEST(test_checksums_match_zlib);
+    RUN_TEST(test_output_too_small);
+    return UNITY_END();
+}
@@ -0,0 +1,182 @@
+#include <unity.h>
+
+#include <stdio.h>
+
+#include <gainLut.h>
+#include <gainTables.h>
+
+// the fixed-point gain tables against the float path they replaced: the segment search of MapTable::x_to_y over
+// the same pairs, swept densely over the full input range and beyond it (where the lut clamps to the nearest end)
+
+static const int SWEEP_STEPS = 200000;
+
+// one Q16 step of y plus the float rounding of the interpolation
+
+static const float MAX_EVEN_ERROR = 3e-5f;
+
+static float reference_x_to_y(const float * pairs, size_t count, float x)
+{
+    if (x <= pairs[0])
+    {
+        return pairs[1];
+    }
+
+    if (x >= pairs[(count-1)*2])
+    {
+        return pairs[(count-1)*2+1];
+    }
+
+    size_t segment = 0;
+
+    while (x > pairs[(segment+1)*2])
+    {
+        segment++;
+    }
+
+    double x0 = pairs[segment*2], y0 = pairs[segment*2+1];
+    double x1 = pairs[(segment+1)*2], y1 = pairs[(segment+1)*2+1];
+
+    return float(y0 + (y1 - y0) * (double(x) - x0) / (x1 - x0));
+}
+
+static float max_error(const GainLut & lut, const float * pairs, size_t count, float margin, float & worst_x)
+{
+    float from = pairs[0] - margin;
+    float to = pairs[(count-1)*2] + margin;
+    float max = 0;
+
+    for (int i = 0; i <= SWEEP_STEPS; ++i)
+    {
+        float x = from + (to - from) * float(i) / float(SWEEP_STEPS);
+        float error = fabsf(lut.x_to_y(x) - reference_x_to_y(pairs, count, x));
+
+        if (error > max)
+        {
+            max = error;
+            worst_x = x;
+        }
+    }
+
+    return max;
+}
+
+static void check_table(const char * name, const float * pairs, size_t count, float margin)
+{
+    GainLut lut;
+    TEST_ASSERT_TRUE(lut.init(pairs, count));
+
+    float worst_x = 0;
+    float error = max_error(lut, pairs, count, margin, worst_x);
+
+    char message[128];
+    snprintf(message, sizeof(message), "%s: max error %.2e at x %.4f", name, error, worst_x);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_LESS_OR_EQUAL(MAX_EVEN_ERROR, error);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_zero2ten_output_table(void)
+{
+    // 0..10 V is what the outputs are set to, the table starts at 1 V
+
+    check_table("zero2ten output", zero2ten_output_gain_function, GAIN_FUNCTION_POINTS(zero2ten_output_gain_function), 2);
+}
+
+void test_zero2ten_input_table(void)
+{
+    // the inputs read up to about 11 V
+
+    check_table("zero2ten input", zero2ten_input_gain_function, GAIN_FUNCTION_POINTS(zero2ten_input_gain_function), 2);
+}
+
+void test_mains_probe_tables(void)
+{
+    check_table("mains probe v", mains_probe_input_v_gain_function, GAIN_FUNCTION_POINTS(mains_probe_input_v_gain_function), 5);
+    check_table("mains probe a high", mains_probe_input_a_high_gain_function, GAIN_FUNCTION_POINTS(mains_probe_input_a_high_gain_function), 5);
+    check_table("mains probe a low", mains_probe_input_a_low_gain_function, GAIN_FUNCTION_POINTS(mains_probe_input_a_low_gain_function), 5);
+}
+
+void test_grid_points_are_exact(void)
+{
+    // the points of an even table are on the grid, only the Q16 rounding of y is left
+
+    const float * pairs = zero2ten_output_gain_function;
+    size_t count = GAIN_FUNCTION_POINTS(zero2ten_output_gain_function);
+
+    GainLut lut;
+    lut.init(pairs, count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        TEST_ASSERT_FLOAT_WITHIN(1.0f / 65536, pairs[i*2+1], lut.x_to_y(pairs[i*2]));
+    }
+}
+
+void test_uneven_table(void)
+{
+    // an uneven table is sampled: the error is bounded by the corners that fall between grid points, which
+    // is the slope change times half a grid step
+
+    const float pairs[] =
+    {
+        0, 0.8,
+        0.5, 0.9,
+        3, 1.0,
+        3.1, 1.05,
+        10, 1.02
+    };
+
+    size_t count = GAIN_FUNCTION_POINTS(pairs);
+
+    GainLut lut;
+    TEST_ASSERT_TRUE(lut.init(pairs, count));
+
+    float worst_x = 0;
+    float error = max_error(lut, pairs, count, 1, worst_x);
+
+    char message[128];
+    snprintf(message, sizeof(message), "uneven: max error %.2e at x %.4f", error, worst_x);
+    TEST_MESSAGE(message);
+
+    // steepest slope is 0.5 / V, a grid step is 10 / 128 V
+
+    TEST_ASSERT_LESS_OR_EQUAL(0.5f * (10.0f / 128) / 2 + MAX_EVEN_ERROR, error);
+}
+
+void test_invalid_tables(void)
+{
+    GainLut lut;
+
+    TEST_ASSERT_FALSE(lut.init(NULL, 0));
+    TEST_ASSERT_EQUAL_FLOAT(1, lut.x_to_y(5));
+
+    const float single[] = {1, 2};
+    TEST_ASSERT_FALSE(lut.init(single, 1));
+    TEST_ASSERT_EQUAL_FLOAT(1, lut.x_to_y(1));
+
+    const float descending[] = {1, 2, 3, 2, 2, 2};
+    TEST_ASSERT_FALSE(lut.init(descending, 3));
+    TEST_ASSERT_EQUAL_FLOAT(1, lut.x_to_y(2));
+    TEST_ASSERT_EQUAL_FLOAT(1, lut.x_to_y(-100));
+    TEST_ASSERT_EQUAL_FLOAT(1, lut.x_to_y(100));
+}
+
+int main(int argc, char ** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_zero2ten_output_table);
+    RUN_TEST(test_zero2ten_input_table);
+    RUN_TEST(test_mains_probe_tables);
+    RUN_TEST(test_grid_points_are_exact);
+    RUN_TEST(test_uneven_table);
+    RUN_TEST(test_invalid_tables);
+    return UNITY_END();
+}
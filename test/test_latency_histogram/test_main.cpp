@@ -0,0 +1,97 @@
+#include <unity.h>
+
+#include <latencyHistogram.h>
+
+// the buckets of the request latencies and of the loop periods, the latter have to reach well past seconds
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_bucket_bounds(void)
+{
+    TEST_ASSERT_EQUAL(0, LatencyHistogram::bucket_of(0));
+    TEST_ASSERT_EQUAL(0, LatencyHistogram::bucket_of(512));
+    TEST_ASSERT_EQUAL(1, LatencyHistogram::bucket_of(513));
+    TEST_ASSERT_EQUAL(1, LatencyHistogram::bucket_of(1024));
+    TEST_ASSERT_EQUAL(LatencyHistogram::NUM_BUCKETS - 1, LatencyHistogram::bucket_of(UINT32_MAX));
+
+    // each sample is within the upper bound of its bucket and above the one before
+
+    for (uint32_t us = 1; us < 100000000; us = us * 3 / 2 + 1)
+    {
+        uint8_t i = PeriodHistogram::bucket_of(us);
+
+        if (i < PeriodHistogram::NUM_BUCKETS - 1)
+        {
+            TEST_ASSERT_LESS_OR_EQUAL(PeriodHistogram::get_upper_bound_us(i), us);
+        }
+
+        if (i > 0)
+        {
+            TEST_ASSERT_GREATER_THAN(PeriodHistogram::get_upper_bound_us(i - 1), us);
+        }
+    }
+}
+
+void test_last_finite_bucket(void)
+{
+    // request latencies: 8.4 s, loop periods: 18 min
+
+    TEST_ASSERT_EQUAL(8388608, LatencyHistogram::get_upper_bound_us(LatencyHistogram::NUM_BUCKETS - 2));
+    TEST_ASSERT_EQUAL(0, LatencyHistogram::get_upper_bound_us(LatencyHistogram::NUM_BUCKETS - 1));
+
+    TEST_ASSERT_EQUAL(1024, PeriodHistogram::get_upper_bound_us(0));
+    TEST_ASSERT_EQUAL(uint32_t(1) << 30, PeriodHistogram::get_upper_bound_us(PeriodHistogram::NUM_BUCKETS - 2));
+    TEST_ASSERT_EQUAL(0, PeriodHistogram::get_upper_bound_us(PeriodHistogram::NUM_BUCKETS - 1));
+}
+
+void test_loop_of_seconds_has_a_p99(void)
+{
+    // a loop that sleeps 10 s between iterations was in +Inf of the latency buckets and reported a p99 of 0
+
+    LatencyHistogram latency;
+    PeriodHistogram period;
+
+    for (int i = 0; i < 100; ++i)
+    {
+        latency.record(10000000 + i * 1000);
+        period.record(10000000 + i * 1000);
+    }
+
+    TEST_ASSERT_EQUAL(0, latency.get_percentile_us(99));
+    TEST_ASSERT_EQUAL(16777216, period.get_percentile_us(99));
+    TEST_ASSERT_EQUAL(100, period.get_count());
+}
+
+void test_percentile(void)
+{
+    PeriodHistogram period;
+
+    TEST_ASSERT_EQUAL(0, period.get_percentile_us(99));
+
+    for (int i = 0; i < 99; ++i)
+    {
+        period.record(10000);
+    }
+
+    period.record(1000000);
+
+    TEST_ASSERT_EQUAL(16384, period.get_percentile_us(50));
+    TEST_ASSERT_EQUAL(1048576, period.get_percentile_us(99));
+    TEST_ASSERT_EQUAL(99 * 10000 + 1000000, period.get_sum_us());
+}
+
+int main(int argc, char ** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_bucket_bounds);
+    RUN_TEST(test_last_finite_bucket);
+    RUN_TEST(test_loop_of_seconds_has_a_p99);
+    RUN_TEST(test_percentile);
+    return UNITY_END();
+}
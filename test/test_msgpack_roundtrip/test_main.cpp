@@ -0,0 +1,245 @@
+#include <unity.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <ArduinoJson.h>
+
+// the GET documents go out as JSON or MessagePack from the same JsonDocument (rest.cpp serializeDocument): both
+// encodings of a document are decoded again and have to give the same values; MessagePack keeps the values as
+// they are, JSON prints numbers with 9 digits and an integral float as an integer, so numbers compare by value
+
+static const size_t DOCUMENT_SIZE = 8192;
+static const size_t BUFFER_SIZE = 8192;
+
+static char mismatch[128];
+
+static bool same(JsonVariantConst a, JsonVariantConst b, bool exact, const char * path)
+{
+    bool r = true;
+
+    if (a.is<JsonObjectConst>())
+    {
+        JsonObjectConst oa = a.as<JsonObjectConst>();
+        JsonObjectConst ob = b.as<JsonObjectConst>();
+
+        r = b.is<JsonObjectConst>() && oa.size() == ob.size();
+
+        for (JsonPairConst kv : oa)
+        {
+            if (r == false)
+            {
+                break;
+            }
+
+            r = ob.containsKey(kv.key().c_str()) && same(kv.value(), ob[kv.key().c_str()], exact, kv.key().c_str());
+        }
+    }
+    else if (a.is<JsonArrayConst>())
+    {
+        JsonArrayConst aa = a.as<JsonArrayConst>();
+        JsonArrayConst ab = b.as<JsonArrayConst>();
+
+        r = b.is<JsonArrayConst>() && aa.size() == ab.size();
+
+        for (size_t i = 0; r && i < aa.size(); ++i)
+        {
+            r = same(aa[i], ab[i], exact, path);
+        }
+    }
+    else if (a.isNull())
+    {
+        r = b.isNull();
+    }
+    else if (a.is<bool>())
+    {
+        r = b.is<bool>() && a.as<bool>() == b.as<bool>();
+    }
+    else if (a.is<const char *>())
+    {
+        r = b.is<const char *>() && strcmp(a.as<const char *>(), b.as<const char *>()) == 0;
+    }
+    else if (exact && a.is<long long>())
+    {
+        r = b.is<long long>() && a.as<long long>() == b.as<long long>();
+    }
+    else if (exact)
+    {
+        r = b.is<double>() && b.is<long long>() == false && a.as<double>() == b.as<double>();
+    }
+    else
+    {
+        double da = a.as<double>();
+        double db = b.as<double>();
+
+        r = b.is<double>() && fabs(da - db) <= 1e-8 * fmax(fabs(da), fabs(db));
+    }
+
+    if (r == false && mismatch[0] == 0)
+    {
+        snprintf(mismatch, sizeof(mismatch), "mismatch at \"%s\"", path);
+    }
+
+    return r;
+}
+
+static void round_trip(const JsonDocument & document, size_t & json_length, size_t & msgpack_length)
+{
+    static char json[BUFFER_SIZE];
+    static char msgpack[BUFFER_SIZE];
+
+    json_length = serializeJson(document, json, sizeof(json));
+    msgpack_length = serializeMsgPack(document, msgpack, sizeof(msgpack));
+
+    TEST_ASSERT_TRUE(json_length > 0 && json_length < sizeof(json));
+    TEST_ASSERT_TRUE(msgpack_length > 0 && msgpack_length < sizeof(msgpack));
+
+    DynamicJsonDocument from_json(DOCUMENT_SIZE);
+    DynamicJsonDocument from_msgpack(DOCUMENT_SIZE);
+
+    TEST_ASSERT_TRUE(deserializeJson(from_json, json, json_length) == DeserializationError::Ok);
+    TEST_ASSERT_TRUE(deserializeMsgPack(from_msgpack, msgpack, msgpack_length) == DeserializationError::Ok);
+
+    mismatch[0] = 0;
+
+    // MessagePack gives back the document as it was, value and type
+
+    bool exact = same(document.as<JsonVariantConst>(), from_msgpack.as<JsonVariantConst>(), true, "");
+
+    if (exact == false)
+    {
+        TEST_MESSAGE(mismatch);
+    }
+
+    TEST_ASSERT_TRUE(exact);
+
+    // and the client decoding either one sees the same values
+
+    bool equal = same(from_json.as<JsonVariantConst>(), from_msgpack.as<JsonVariantConst>(), false, "");
+
+    if (equal == false)
+    {
+        TEST_MESSAGE(mismatch);
+    }
+
+    TEST_ASSERT_TRUE(equal);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_scalars(void)
+{
+    DynamicJsonDocument document(DOCUMENT_SIZE);
+
+    document["zero"] = 0;
+    document["small"] = 7;
+    document["negative"] = -1234;
+    document["uint8"] = 200;
+    document["uint16"] = 60000;
+    document["uint32_max"] = 4294967295UL;
+    document["int32_min"] = -2147483647L - 1;
+    document["epoch_ms"] = 1760000000123LL;
+    document["float"] = 242.8183136f;
+    document["double"] = 0.1 + 0.2;
+    document["integral_float"] = 1.0;
+    document["tiny"] = 1e-7;
+    document["huge"] = 3.4e38;
+    document["true"] = true;
+    document["false"] = false;
+    document["null"] = (char *) NULL;
+    document["empty"] = "";
+    document["text"] = "Pat Benatar - Love Is A Battlefield";
+    document["utf8"] = "Zürich \xe2\x82\xac";
+    document["escapes"] = "quote \" backslash \\ newline \n tab \t";
+
+    size_t json_length, msgpack_length;
+    round_trip(document, json_length, msgpack_length);
+}
+
+void test_get_like_document(void)
+{
+    // the shape of /get: nested objects, arrays of objects, numbers of every kind
+
+    DynamicJsonDocument document(DOCUMENT_SIZE);
+
+    document["version"] = "1.3";
+
+    JsonArray sw_caps = document.createNestedArray("sw_caps");
+    sw_caps.add("mainsProbe");
+    sw_caps.add("multi");
+
+    JsonObject system = document.createNestedObject("system");
+    system["uptime"] = "01d 02h 03m 04s";
+
+    JsonObject heap = system.createNestedObject("heap").createNestedObject("internal");
+    heap["free"] = 101234;
+    heap["largest_free_block"] = 65524;
+    heap["fragmentation"] = 0.35f;
+
+    JsonArray tasks = system.createNestedArray("tasks");
+
+    for (int i = 0; i < 12; ++i)
+    {
+        JsonObject task = tasks.createNestedObject();
+        task["name"] = i % 2 ? "multi_task" : "scheduler";
+        task["stack_free_min"] = 1320 + i * 17;
+        task["priority"] = i % 3;
+        task["cpu_percent"] = 2.5f * i;
+    }
+
+    JsonObject channels = document.createNestedObject("mains-probe").createNestedObject("input_v_channels").createNestedObject("0x40");
+
+    for (int i = 0; i < 3; ++i)
+    {
+        char name[16];
+        snprintf(name, sizeof(name), "channel[%d]", i);
+
+        JsonObject channel = channels.createNestedObject(name);
+        channel["value"] = 242.8183136f + i * 0.7f;
+        channel["status"] = "";
+    }
+
+    JsonArray samples = document.createNestedArray("samples");
+
+    for (int i = 0; i < 64; ++i)
+    {
+        samples.add(sin(i * 0.1) * 1000);
+    }
+
+    size_t json_length, msgpack_length;
+    round_trip(document, json_length, msgpack_length);
+
+    char message[64];
+    snprintf(message, sizeof(message), "json %d bytes, msgpack %d bytes", (int) json_length, (int) msgpack_length);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_LESS_THAN(json_length, msgpack_length);
+}
+
+void test_empty_containers(void)
+{
+    DynamicJsonDocument document(DOCUMENT_SIZE);
+
+    document.createNestedObject("object");
+    document.createNestedArray("array");
+    document.createNestedArray("nested").createNestedArray().createNestedObject();
+
+    size_t json_length, msgpack_length;
+    round_trip(document, json_length, msgpack_length);
+}
+
+int main(int argc, char ** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_scalars);
+    RUN_TEST(test_get_like_document);
+    RUN_TEST(test_empty_containers);
+    return UNITY_END();
+}
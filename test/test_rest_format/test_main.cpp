@@ -0,0 +1,70 @@
+#include <unity.h>
+
+#include <restFormat.h>
+
+// the format of the GET documents from the Accept header, per request
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_no_accept_is_json(void)
+{
+    TEST_ASSERT_EQUAL(rfJson, rest_format_of(NULL));
+    TEST_ASSERT_EQUAL(rfJson, rest_format_of(""));
+    TEST_ASSERT_EQUAL(rfJson, rest_format_of("  "));
+}
+
+void test_json_and_wildcards(void)
+{
+    TEST_ASSERT_EQUAL(rfJson, rest_format_of("application/json"));
+    TEST_ASSERT_EQUAL(rfJson, rest_format_of("*/*"));
+    TEST_ASSERT_EQUAL(rfJson, rest_format_of("application/*"));
+    TEST_ASSERT_EQUAL(rfJson, rest_format_of("Application/JSON; charset=utf-8"));
+    TEST_ASSERT_EQUAL(rfJson, rest_format_of("text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8"));
+}
+
+void test_msgpack(void)
+{
+    TEST_ASSERT_EQUAL(rfMsgPack, rest_format_of("application/msgpack"));
+    TEST_ASSERT_EQUAL(rfMsgPack, rest_format_of("application/x-msgpack"));
+    TEST_ASSERT_EQUAL(rfMsgPack, rest_format_of("application/json, application/msgpack;q=0.9"));
+    TEST_ASSERT_EQUAL(rfMsgPack, rest_format_of("application/cbor,application/msgpack"));
+
+    // a type that only starts like it is another one
+
+    TEST_ASSERT_EQUAL(rfNotAcceptable, rest_format_of("application/msgpack2"));
+}
+
+void test_cbor_is_not_acceptable(void)
+{
+    TEST_ASSERT_EQUAL(rfNotAcceptable, rest_format_of("application/cbor"));
+    TEST_ASSERT_EQUAL(rfNotAcceptable, rest_format_of(" application/cbor ; q=1"));
+    TEST_ASSERT_EQUAL(rfNotAcceptable, rest_format_of("application/cbor, text/plain"));
+
+    // CBOR with a fallback the device serves
+
+    TEST_ASSERT_EQUAL(rfJson, rest_format_of("application/cbor, application/json;q=0.5"));
+    TEST_ASSERT_EQUAL(rfJson, rest_format_of("application/cbor,*/*;q=0.1"));
+}
+
+void test_content_type(void)
+{
+    TEST_ASSERT_EQUAL_STRING("application/json", rest_format_content_type(rfJson));
+    TEST_ASSERT_EQUAL_STRING("application/msgpack", rest_format_content_type(rfMsgPack));
+}
+
+int main(int argc, char ** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_no_accept_is_json);
+    RUN_TEST(test_json_and_wildcards);
+    RUN_TEST(test_msgpack);
+    RUN_TEST(test_cbor_is_not_acceptable);
+    RUN_TEST(test_content_type);
+    return UNITY_END();
+}
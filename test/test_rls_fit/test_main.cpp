@@ -0,0 +1,244 @@
+#include <unity.h>
+
+#include <stdio.h>
+#include <sstream>
+
+#include <rlsFit.h>
+
+// the recursive least squares fit of the mains-probe calibration: exact polynoms come out exact at every order,
+// a point far off the others is rejected, a replaced point is taken out by a downdate and the state survives
+// the eprom round trip
+
+// relative, the prior of the estimator (INITIAL_P) biases the fit by about its inverse
+
+static const double EXACT = 1e-6;
+
+// the residuals the prior leaves behind in the sum of squares of the first points
+
+static const double EXACT_RMS = 1e-4;
+
+// the weight of mainsProbe, the fit minimizes the relative error
+
+static double weight(double y)
+{
+    return y != 0 ? 1. / (y * y) : 1.;
+}
+
+static double quadratic(double x)
+{
+    return 0.5 + 2 * x + 0.1 * x * x;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_one_point_goes_through_zero(void)
+{
+    RlsPolyFit fit;
+
+    TEST_ASSERT_EQUAL(RlsPolyFit::rAccepted, fit.add(2, 5, weight(5)));
+    TEST_ASSERT_EQUAL(1, fit.get_order());
+
+    double beta[RlsPolyFit::MAX_ORDER+1];
+    fit.get_beta(beta);
+
+    TEST_ASSERT_FLOAT_WITHIN(EXACT, 0, beta[0]);
+    TEST_ASSERT_FLOAT_WITHIN(2.5 * EXACT, 2.5, beta[1]);
+    TEST_ASSERT_FLOAT_WITHIN(EXACT, 0, beta[2]);
+    TEST_ASSERT_FLOAT_WITHIN(10 * EXACT, 10, fit.calc(4));
+}
+
+void test_two_points_are_a_line(void)
+{
+    RlsPolyFit fit;
+
+    fit.add(1, 4, weight(4));
+    fit.add(3, 10, weight(10));
+
+    TEST_ASSERT_EQUAL(1, fit.get_order());
+
+    double beta[RlsPolyFit::MAX_ORDER+1];
+    fit.get_beta(beta);
+
+    TEST_ASSERT_FLOAT_WITHIN(EXACT, 1, beta[0]);
+    TEST_ASSERT_FLOAT_WITHIN(3 * EXACT, 3, beta[1]);
+    TEST_ASSERT_FLOAT_WITHIN(EXACT, 0, beta[2]);
+}
+
+void test_quadratic_is_exact(void)
+{
+    RlsPolyFit fit;
+
+    for (int x = 1; x <= 8; ++x)
+    {
+        TEST_ASSERT_EQUAL(RlsPolyFit::rAccepted, fit.add(x, quadratic(x), weight(quadratic(x))));
+    }
+
+    TEST_ASSERT_EQUAL(8, fit.get_points());
+    TEST_ASSERT_EQUAL(0, fit.get_rejected());
+    TEST_ASSERT_EQUAL(2, fit.get_order());
+
+    double beta[RlsPolyFit::MAX_ORDER+1];
+    fit.get_beta(beta);
+
+    TEST_ASSERT_FLOAT_WITHIN(0.5 * EXACT, 0.5, beta[0]);
+    TEST_ASSERT_FLOAT_WITHIN(2 * EXACT, 2, beta[1]);
+    TEST_ASSERT_FLOAT_WITHIN(0.1 * EXACT, 0.1, beta[2]);
+    TEST_ASSERT_LESS_OR_EQUAL(EXACT_RMS, fit.get_rms());
+
+    // the points fit exactly, the standard errors only come from the residuals of the prior
+
+    double beta_stderr[RlsPolyFit::MAX_ORDER+1];
+    fit.get_beta_stderr(beta_stderr);
+
+    for (int i = 0; i <= RlsPolyFit::MAX_ORDER; ++i)
+    {
+        TEST_ASSERT_LESS_OR_EQUAL(1e-3 * beta[i], beta_stderr[i]);
+    }
+}
+
+void test_outlier_is_rejected(void)
+{
+    RlsPolyFit fit;
+
+    for (int x = 1; x <= 6; ++x)
+    {
+        fit.add(x, quadratic(x), weight(quadratic(x)));
+    }
+
+    double before = fit.calc(7);
+
+    // within OUTLIER_MIN of relative error it is a point like any other, far off it is rejected and does not
+    // move the fit
+
+    double y = quadratic(7) * 1.3;
+    TEST_ASSERT_EQUAL(RlsPolyFit::rRejected, fit.add(7, y, weight(y)));
+    TEST_ASSERT_EQUAL(6, fit.get_points());
+    TEST_ASSERT_EQUAL(1, fit.get_rejected());
+    TEST_ASSERT_FLOAT_WITHIN(1e-12, before, fit.calc(7));
+
+    y = quadratic(7) * 1.01;
+    TEST_ASSERT_EQUAL(RlsPolyFit::rAccepted, fit.add(7, y, weight(y)));
+    TEST_ASSERT_EQUAL(7, fit.get_points());
+
+    // without the check (refit from stored points) nothing is rejected
+
+    y = quadratic(8) * 2;
+    TEST_ASSERT_EQUAL(RlsPolyFit::rAccepted, fit.add(8, y, weight(y), false));
+    TEST_ASSERT_EQUAL(1, fit.get_rejected());
+}
+
+void test_downdate_on_replace(void)
+{
+    // a wrong point at x=3 replaced by the right one ends where a fit of the right points starts
+
+    RlsPolyFit fit;
+    RlsPolyFit reference;
+
+    double wrong = quadratic(3) * 1.5;
+
+    for (int x = 1; x <= 6; ++x)
+    {
+        double y = x == 3 ? wrong : quadratic(x);
+        fit.add(x, y, weight(y), false);
+        reference.add(x, quadratic(x), weight(quadratic(x)));
+    }
+
+    TEST_ASSERT_GREATER_THAN(0.01, fit.get_rms());
+
+    TEST_ASSERT_TRUE(fit.remove(3, wrong, weight(wrong)));
+    TEST_ASSERT_EQUAL(5, fit.get_points());
+    TEST_ASSERT_EQUAL(RlsPolyFit::rAccepted, fit.add(3, quadratic(3), weight(quadratic(3))));
+    TEST_ASSERT_EQUAL(6, fit.get_points());
+
+    double beta[RlsPolyFit::MAX_ORDER+1];
+    double reference_beta[RlsPolyFit::MAX_ORDER+1];
+    fit.get_beta(beta);
+    reference.get_beta(reference_beta);
+
+    for (int i = 0; i <= RlsPolyFit::MAX_ORDER; ++i)
+    {
+        TEST_ASSERT_FLOAT_WITHIN(EXACT, reference_beta[i], beta[i]);
+    }
+
+    TEST_ASSERT_LESS_OR_EQUAL(EXACT_RMS, fit.get_rms());
+}
+
+void test_downdate_needs_spare_points(void)
+{
+    // with no more points than coefficients every point pins the quadratic, the fit has to be rebuilt
+
+    RlsPolyFit fit;
+
+    for (int x = 1; x <= 3; ++x)
+    {
+        fit.add(x, quadratic(x), weight(quadratic(x)));
+    }
+
+    TEST_ASSERT_FALSE(fit.remove(2, quadratic(2), weight(quadratic(2))));
+    TEST_ASSERT_EQUAL(3, fit.get_points());
+    TEST_ASSERT_FALSE(fit.remove(2, quadratic(2), 0));
+}
+
+void test_invalid_points(void)
+{
+    RlsPolyFit fit;
+
+    TEST_ASSERT_EQUAL(RlsPolyFit::rInvalid, fit.add(0, 1, 1));     // the first point scales x
+    TEST_ASSERT_EQUAL(RlsPolyFit::rInvalid, fit.add(1, 1, 0));
+    TEST_ASSERT_EQUAL(RlsPolyFit::rInvalid, fit.add(1, NAN, 1));
+    TEST_ASSERT_EQUAL(RlsPolyFit::rInvalid, fit.add(INFINITY, 1, 1));
+    TEST_ASSERT_TRUE(fit.is_empty());
+    TEST_ASSERT_EQUAL(0, fit.get_order());
+    TEST_ASSERT_FLOAT_WITHIN(0, 0, fit.calc(1));
+}
+
+void test_eprom_round_trip(void)
+{
+    RlsPolyFit fit;
+
+    for (int x = 1; x <= 5; ++x)
+    {
+        fit.add(x * 40, quadratic(x) * 3, weight(quadratic(x) * 3));
+    }
+
+    std::stringstream stream;
+    fit.to_eprom(stream);
+
+    RlsPolyFit loaded;
+    TEST_ASSERT_TRUE(loaded.from_eprom(stream));
+    TEST_ASSERT_EQUAL(fit.get_points(), loaded.get_points());
+    TEST_ASSERT_EQUAL(fit.get_order(), loaded.get_order());
+
+    // the state goes to eprom as float
+
+    for (int x = 0; x <= 300; x += 25)
+    {
+        TEST_ASSERT_FLOAT_WITHIN(1e-5 * fabs(fit.calc(x)) + 1e-6, fit.calc(x), loaded.calc(x));
+    }
+
+    // a damaged record leaves an empty fit, the points are refitted then
+
+    std::stringstream truncated(stream.str().substr(0, 6));
+    TEST_ASSERT_FALSE(loaded.from_eprom(truncated));
+    TEST_ASSERT_TRUE(loaded.is_empty());
+}
+
+int main(int argc, char ** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_one_point_goes_through_zero);
+    RUN_TEST(test_two_points_are_a_line);
+    RUN_TEST(test_quadratic_is_exact);
+    RUN_TEST(test_outlier_is_rejected);
+    RUN_TEST(test_downdate_on_replace);
+    RUN_TEST(test_downdate_needs_spare_points);
+    RUN_TEST(test_invalid_points);
+    RUN_TEST(test_eprom_round_trip);
+    return UNITY_END();
+}
@@ -0,0 +1,150 @@
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#include <routeMetrics.h>
+
+// the /metrics exposition as on_metrics() sends it, with the chunks collected instead of sent
+
+static const size_t ROUTE_COUNT = 4;
+
+static const char * route_names[ROUTE_COUNT] = {"ping", "get", "action/autonom/multi/play", "metrics"};
+static const char * route_methods[ROUTE_COUNT] = {"GET", "GET", "POST", "GET"};
+
+static RouteMetrics metrics[ROUTE_COUNT];
+
+struct Exposition
+{
+    std::vector<std::string> chunks;
+    std::string text;
+    bool has_empty_chunk;
+};
+
+static Exposition expose()
+{
+    Exposition exposition;
+    exposition.has_empty_chunk = false;
+
+    std::string text;
+
+    route_metrics_exposition(text, ROUTE_COUNT,
+        [](size_t i, const char * & route, const char * & method, const RouteMetrics * & _metrics)
+        {
+            route = route_names[i];
+            method = route_methods[i];
+            _metrics = & metrics[i];
+        },
+        [&](const std::string & chunk)
+        {
+            exposition.has_empty_chunk = exposition.has_empty_chunk || chunk.empty();
+            exposition.chunks.push_back(chunk);
+            exposition.text += chunk;
+        });
+
+    return exposition;
+}
+
+static size_t occurrences(const std::string & text, const std::string & what)
+{
+    size_t n = 0;
+
+    for (size_t at = text.find(what); at != std::string::npos; at = text.find(what, at + 1))
+    {
+        n++;
+    }
+
+    return n;
+}
+
+void setUp(void)
+{
+    for (size_t i = 0; i < ROUTE_COUNT; ++i)
+    {
+        metrics[i] = RouteMetrics();
+    }
+}
+
+void tearDown(void)
+{
+}
+
+void test_partly_used_route_table_gives_the_full_exposition(void)
+{
+    // routes 0 and 2 were called, 1 and 3 not: their duration chunks are empty and must not end the response
+
+    metrics[0].latency.record(300);
+    metrics[0].latency.record(1500);
+    metrics[2].latency.record(20000);
+    metrics[2].body_too_big = 1;
+
+    Exposition exposition = expose();
+
+    TEST_ASSERT_FALSE(exposition.has_empty_chunk);
+
+    TEST_ASSERT_EQUAL(1, occurrences(exposition.text, "# TYPE harvester_http_requests_total counter\n"));
+    TEST_ASSERT_EQUAL(1, occurrences(exposition.text, "# TYPE harvester_http_body_too_big_total counter\n"));
+    TEST_ASSERT_EQUAL(1, occurrences(exposition.text, "# TYPE harvester_http_request_duration_seconds histogram\n"));
+
+    TEST_ASSERT_EQUAL(ROUTE_COUNT, occurrences(exposition.text, "harvester_http_requests_total{"));
+    TEST_ASSERT_EQUAL(ROUTE_COUNT, occurrences(exposition.text, "harvester_http_body_too_big_total{"));
+
+    // the histogram of the called routes only, all buckets up to +Inf
+
+    TEST_ASSERT_EQUAL(2, occurrences(exposition.text, "harvester_http_request_duration_seconds_count{"));
+    TEST_ASSERT_EQUAL(2, occurrences(exposition.text, "harvester_http_request_duration_seconds_sum{"));
+    TEST_ASSERT_EQUAL(2 * LatencyHistogram::NUM_BUCKETS, occurrences(exposition.text, "harvester_http_request_duration_seconds_bucket{"));
+
+    TEST_ASSERT_TRUE(exposition.text.find("harvester_http_requests_total{route=\"ping\",method=\"GET\"} 2\n") != std::string::npos);
+    TEST_ASSERT_TRUE(exposition.text.find("harvester_http_requests_total{route=\"metrics\",method=\"GET\"} 0\n") != std::string::npos);
+    TEST_ASSERT_TRUE(exposition.text.find("harvester_http_body_too_big_total{route=\"action/autonom/multi/play\",method=\"POST\"} 1\n") != std::string::npos);
+    TEST_ASSERT_TRUE(exposition.text.find("harvester_http_request_duration_seconds_bucket{route=\"ping\",method=\"GET\",le=\"0.000512\"} 1\n") != std::string::npos);
+    TEST_ASSERT_TRUE(exposition.text.find("harvester_http_request_duration_seconds_bucket{route=\"ping\",method=\"GET\",le=\"+Inf\"} 2\n") != std::string::npos);
+    TEST_ASSERT_TRUE(exposition.text.find("harvester_http_request_duration_seconds_count{route=\"action/autonom/multi/play\",method=\"POST\"} 1\n") != std::string::npos);
+
+    // the last family is still there after the unused routes in the middle
+
+    size_t duration_type = exposition.text.find("# TYPE harvester_http_request_duration_seconds histogram\n");
+    TEST_ASSERT_TRUE(exposition.text.find("route=\"action/autonom/multi/play\",method=\"POST\",le=\"+Inf\"", duration_type) != std::string::npos);
+}
+
+void test_unused_route_table_gives_all_families(void)
+{
+    Exposition exposition = expose();
+
+    TEST_ASSERT_FALSE(exposition.has_empty_chunk);
+
+    // a type line per family, one chunk per route for the counters, nothing for the durations
+
+    TEST_ASSERT_EQUAL(3 + 2 * ROUTE_COUNT, exposition.chunks.size());
+    TEST_ASSERT_EQUAL(1, occurrences(exposition.text, "# TYPE harvester_http_request_duration_seconds histogram\n"));
+    TEST_ASSERT_EQUAL(0, occurrences(exposition.text, "harvester_http_request_duration_seconds_count{"));
+    TEST_ASSERT_EQUAL_STRING("# TYPE harvester_http_request_duration_seconds histogram\n", exposition.chunks.back().c_str());
+}
+
+void test_families_come_as_groups(void)
+{
+    for (size_t i = 0; i < ROUTE_COUNT; ++i)
+    {
+        metrics[i].latency.record(1000);
+    }
+
+    Exposition exposition = expose();
+
+    size_t last_requests = exposition.text.rfind("harvester_http_requests_total{");
+    size_t first_body_too_big = exposition.text.find("harvester_http_body_too_big_total{");
+    size_t last_body_too_big = exposition.text.rfind("harvester_http_body_too_big_total{");
+    size_t first_duration = exposition.text.find("harvester_http_request_duration_seconds_bucket{");
+
+    TEST_ASSERT_TRUE(last_requests < first_body_too_big);
+    TEST_ASSERT_TRUE(last_body_too_big < first_duration);
+}
+
+int main(int argc, char ** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_partly_used_route_table_gives_the_full_exposition);
+    RUN_TEST(test_unused_route_table_gives_all_families);
+    RUN_TEST(test_families_come_as_groups);
+    return UNITY_END();
+}
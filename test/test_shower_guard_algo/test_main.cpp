@@ -0,0 +1,162 @@
+#include <unity.h>
+#include <vector>
+
+#include <showerGuardAlgo.h>
+
+// decisions of the shower-guard algo on synthetic traces with the clock taken from the trace
+
+struct Row
+{
+    time_t time;
+    float rh;
+    bool motion;
+};
+
+static const time_t T0 = 1718000000;
+
+static ShowerGuardAlgoParams params(unsigned light_linger, unsigned fan_linger, unsigned rh_on, unsigned rh_off)
+{
+    ShowerGuardAlgoParams p;
+    p.light_linger = light_linger;
+    p.fan_linger = fan_linger;
+    p.rh_on = rh_on;
+    p.rh_off = rh_off;
+    return p;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_light_lingers_after_motion(void)
+{
+    ShowerGuardReplay replay(params(60, 60, 55, 50));
+
+    // motion in the first row only, a loop every 10 s, rh stays low
+
+    for (time_t t = 0; t <= 300; t += 10)
+    {
+        TEST_ASSERT_TRUE(replay.push(T0 + t, 40, 22, t == 0));
+
+        bool expected = t < 60;
+        TEST_ASSERT_EQUAL(expected, replay.get_algo().get_light());
+        TEST_ASSERT_EQUAL(expected, replay.get_algo().get_fan());
+    }
+
+    TEST_ASSERT_EQUAL_STRING("linger out", replay.get_algo().get_last_light_decision());
+    TEST_ASSERT_EQUAL(60, replay.get_algo().get_light_on_time());
+    TEST_ASSERT_EQUAL(60, replay.get_algo().get_fan_on_time());
+    TEST_ASSERT_EQUAL(1, replay.get_light_switches());
+    TEST_ASSERT_EQUAL(300, replay.get_duration());
+}
+
+void test_fan_follows_rh_hysteresis(void)
+{
+    ShowerGuardReplay replay(params(10, 10, 55, 50));
+
+    // no motion after the first linger, rh goes up over rh_on and back under rh_off
+
+    const float rhs[] = { 40, 40, 45, 52, 56, 60, 58, 53, 51, 49, 45 };
+    const bool fans[] = { true, false, false, false, true, true, true, true, true, false, false };
+
+    for (size_t i = 0; i < sizeof(rhs)/sizeof(rhs[0]); ++i)
+    {
+        TEST_ASSERT_TRUE(replay.push(T0 + time_t(i) * 10, rhs[i], 22, false));
+        TEST_ASSERT_EQUAL(fans[i], replay.get_algo().get_fan());
+    }
+
+    TEST_ASSERT_TRUE(strncmp(replay.get_algo().get_last_fan_decision(), "rh-low 49.0/50.0 at 2024-06-10", 30) == 0);
+    TEST_ASSERT_EQUAL(3, replay.get_fan_switches());
+}
+
+void test_soft_toggle_down(void)
+{
+    ShowerGuardReplay replay(params(10, 10, 60, 50));
+
+    // over rh_on once, then a full window just above rh_off: the fan goes off without reaching rh_off
+
+    TEST_ASSERT_TRUE(replay.push(T0, 65, 22, false));
+
+    time_t t = T0;
+    bool fan_off = false;
+
+    for (int i = 0; i < 20 && fan_off == false; ++i)
+    {
+        t += 10;
+        replay.push(t, 50.5, 22, false);
+        fan_off = replay.get_algo().get_fan() == false;
+    }
+
+    TEST_ASSERT_TRUE(fan_off);
+    TEST_ASSERT_TRUE(strncmp(replay.get_algo().get_last_fan_decision(), "rh-soft-down", 12) == 0);
+}
+
+void test_replay_is_deterministic(void)
+{
+    std::vector<Row> trace;
+
+    uint32_t seed = 12345;
+
+    for (int i = 0; i < 8640; ++i)      // a day at 10 s
+    {
+        seed = seed * 1664525u + 1013904223u;
+        float rh = 40 + float((seed >> 8) % 3000) / 100;
+        bool motion = ((seed >> 20) % 50) == 0;
+        trace.push_back({T0 + time_t(i) * 10, rh, motion});
+    }
+
+    ShowerGuardReplay a(params(120, 300, 60, 52));
+    ShowerGuardReplay b(params(120, 300, 60, 52));
+
+    for (const Row & row : trace)
+    {
+        a.push(row.time, row.rh, 22, row.motion);
+        b.push(row.time, row.rh, 22, row.motion);
+
+        TEST_ASSERT_EQUAL(a.is_changed(), b.is_changed());
+        TEST_ASSERT_EQUAL_STRING(a.get_algo().get_last_fan_decision(), b.get_algo().get_last_fan_decision());
+    }
+
+    TEST_ASSERT_EQUAL(8640, a.get_rows());
+    TEST_ASSERT_EQUAL(a.get_algo().get_fan_on_time(), b.get_algo().get_fan_on_time());
+    TEST_ASSERT_EQUAL(a.get_fan_switches(), b.get_fan_switches());
+    TEST_ASSERT_LESS_OR_EQUAL(86400, a.get_algo().get_light_on_time());
+}
+
+void test_replay_refuses_going_back_in_time(void)
+{
+    ShowerGuardReplay replay(params(60, 60, 55, 50));
+
+    TEST_ASSERT_TRUE(replay.push(T0 + 10, 40, 22, false));
+    TEST_ASSERT_FALSE(replay.push(T0, 40, 22, false));
+    TEST_ASSERT_EQUAL(1, replay.get_rows());
+}
+
+void test_replay_forces_auto_mode(void)
+{
+    ShowerGuardAlgoParams p = params(60, 60, 55, 50);
+    p.light_mode = ShowerGuardAlgoParams::mOff;
+    p.fan_mode = ShowerGuardAlgoParams::mOff;
+
+    ShowerGuardReplay replay(p);
+    replay.push(T0, 40, 22, true);
+
+    TEST_ASSERT_TRUE(replay.get_algo().get_light());
+    TEST_ASSERT_TRUE(replay.get_algo().get_fan());
+}
+
+int main(int argc, char ** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_light_lingers_after_motion);
+    RUN_TEST(test_fan_follows_rh_hysteresis);
+    RUN_TEST(test_soft_toggle_down);
+    RUN_TEST(test_replay_is_deterministic);
+    RUN_TEST(test_replay_refuses_going_back_in_time);
+    RUN_TEST(test_replay_forces_auto_mode);
+    return UNITY_END();
+}
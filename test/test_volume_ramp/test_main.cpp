@@ -0,0 +1,218 @@
+#include <unity.h>
+
+#include <volumeRamp.h>
+
+// the fade of the TDA8425 volume as the multi task drives it: a tick every TICK_MS, at most one write per tick
+
+static const uint32_t TICK_MS = 20;
+
+struct Writes
+{
+    int count;
+    uint8_t first;
+    uint8_t last;
+    bool monotonic_up;
+    bool monotonic_down;
+    uint32_t last_ms;
+};
+
+static Writes run(VolumeRamp & ramp, uint32_t from_ms, uint32_t to_ms)
+{
+    Writes w = {0, 0, ramp.get_current(), true, true, 0};
+    uint8_t previous = ramp.get_current();
+
+    for (uint32_t now = from_ms; now <= to_ms; now += TICK_MS)
+    {
+        uint8_t volume;
+
+        if (ramp.tick(now, volume))
+        {
+            if (w.count == 0)
+            {
+                w.first = volume;
+            }
+
+            w.monotonic_up = w.monotonic_up && volume > previous;
+            w.monotonic_down = w.monotonic_down && volume < previous;
+            w.count++;
+            w.last = volume;
+            w.last_ms = now;
+            previous = volume;
+        }
+    }
+
+    return w;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_step_is_written_on_the_next_tick(void)
+{
+    VolumeRamp ramp;
+    ramp.reset(10);
+    ramp.set_target(40, 1000, VolumeRamp::cStep, 0);
+
+    Writes w = run(ramp, 0, 1000);
+
+    TEST_ASSERT_EQUAL(1, w.count);
+    TEST_ASSERT_EQUAL(40, w.first);
+    TEST_ASSERT_EQUAL(0, w.last_ms);
+    TEST_ASSERT_FALSE(ramp.is_ramping());
+}
+
+void test_linear_fade_reaches_the_endpoints(void)
+{
+    VolumeRamp ramp;
+    ramp.reset(0);
+    ramp.set_target(63, 1000, VolumeRamp::cLinear, 0);
+
+    Writes w = run(ramp, 0, 2000);
+
+    TEST_ASSERT_TRUE(w.monotonic_up);
+    TEST_ASSERT_EQUAL(63, w.last);
+    TEST_ASSERT_EQUAL(1000, w.last_ms);
+    TEST_ASSERT_EQUAL(50, w.count);     // 1000 ms / 20 ms ticks, each one a new value on a 63 step span
+    TEST_ASSERT_FALSE(ramp.is_ramping());
+
+    // halfway is halfway
+
+    VolumeRamp half;
+    half.reset(0);
+    half.set_target(60, 1000, VolumeRamp::cLinear, 0);
+    run(half, 0, 500);
+    TEST_ASSERT_EQUAL(30, half.get_current());
+}
+
+void test_smooth_fade_is_monotonic_and_slow_at_the_ends(void)
+{
+    VolumeRamp ramp;
+    ramp.reset(63);
+    ramp.set_target(0, 2000, VolumeRamp::cSmooth, 0);
+
+    uint8_t volume;
+    uint8_t at_100ms = 63;
+    uint8_t at_1000ms = 63;
+
+    for (uint32_t now = 0; now <= 2000; now += TICK_MS)
+    {
+        uint8_t before = ramp.get_current();
+
+        if (ramp.tick(now, volume))
+        {
+            TEST_ASSERT_LESS_THAN(before, volume);
+        }
+
+        if (now == 100)
+        {
+            at_100ms = ramp.get_current();
+        }
+
+        if (now == 1000)
+        {
+            at_1000ms = ramp.get_current();
+        }
+    }
+
+    TEST_ASSERT_EQUAL(0, ramp.get_current());
+
+    // the linear fade would be at 60 after 100 ms and at 32 halfway
+
+    TEST_ASSERT_GREATER_OR_EQUAL(62, at_100ms);
+    TEST_ASSERT_TRUE(at_1000ms == 31 || at_1000ms == 32);
+}
+
+void test_requests_between_ticks_coalesce(void)
+{
+    VolumeRamp ramp;
+    ramp.reset(20);
+
+    // a burst of UI presses between two ticks: one write, to the last target
+
+    for (uint8_t v = 21; v <= 30; ++v)
+    {
+        ramp.set_target(v, 0, VolumeRamp::cStep, 5);
+    }
+
+    Writes w = run(ramp, 20, 200);
+
+    TEST_ASSERT_EQUAL(1, w.count);
+    TEST_ASSERT_EQUAL(30, w.last);
+}
+
+void test_same_target_keeps_the_fade_timing(void)
+{
+    VolumeRamp ramp;
+    ramp.reset(0);
+    ramp.set_target(50, 1000, VolumeRamp::cLinear, 0);
+    run(ramp, 0, 400);
+
+    ramp.set_target(50, 1000, VolumeRamp::cLinear, 400);
+
+    Writes w = run(ramp, 420, 2000);
+    TEST_ASSERT_EQUAL(1000, w.last_ms);
+}
+
+void test_retarget_mid_fade_starts_from_the_written_value(void)
+{
+    VolumeRamp ramp;
+    ramp.reset(0);
+    ramp.set_target(60, 1000, VolumeRamp::cLinear, 0);
+    run(ramp, 0, 500);
+
+    uint8_t mid = ramp.get_current();
+    TEST_ASSERT_EQUAL(30, mid);
+
+    // back down: no jump, the first write is next to the value written last and the fade runs down from there
+
+    ramp.set_target(10, 400, VolumeRamp::cLinear, 510);
+    Writes w = run(ramp, 520, 2000);
+
+    TEST_ASSERT_TRUE(w.monotonic_down);
+    TEST_ASSERT_LESS_OR_EQUAL(2, mid - w.first);
+    TEST_ASSERT_EQUAL(10, w.last);
+    TEST_ASSERT_EQUAL(920, w.last_ms);
+    TEST_ASSERT_FALSE(ramp.is_ramping());
+}
+
+void test_fade_survives_millis_wrap(void)
+{
+    VolumeRamp ramp;
+    ramp.reset(0);
+
+    uint32_t start = 0xffffffffu - 300;
+    ramp.set_target(40, 1000, VolumeRamp::cLinear, start);
+
+    uint8_t volume;
+    uint8_t previous = 0;
+    uint32_t now = start;
+
+    for (int i = 0; i <= 50; ++i, now += TICK_MS)
+    {
+        if (ramp.tick(now, volume))
+        {
+            TEST_ASSERT_GREATER_THAN(previous, volume);
+            previous = volume;
+        }
+    }
+
+    TEST_ASSERT_EQUAL(40, ramp.get_current());
+}
+
+int main(int argc, char ** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_step_is_written_on_the_next_tick);
+    RUN_TEST(test_linear_fade_reaches_the_endpoints);
+    RUN_TEST(test_smooth_fade_is_monotonic_and_slow_at_the_ends);
+    RUN_TEST(test_requests_between_ticks_coalesce);
+    RUN_TEST(test_same_target_keeps_the_fade_timing);
+    RUN_TEST(test_retarget_mid_fade_starts_from_the_written_value);
+    RUN_TEST(test_fade_survives_millis_wrap);
+    return UNITY_END();
+}